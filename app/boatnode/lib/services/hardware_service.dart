@@ -1,6 +1,7 @@
 import 'dart:convert';
 import 'dart:async';
 import 'dart:io';
+import 'dart:typed_data';
 
 import 'package:flutter_blue_plus/flutter_blue_plus.dart';
 import 'package:internet_connection_checker/internet_connection_checker.dart';
@@ -211,6 +212,16 @@ class HardwareService {
     });
 
     try {
+      // Bigger MTU lets the node batch several status records per notify.
+      // iOS negotiates on its own.
+      if (Platform.isAndroid) {
+        try {
+          await device.requestMtu(185);
+        } catch (e) {
+          LogService.w("MTU request failed, staying at default");
+        }
+      }
+
       // Discover Services
       List<BluetoothService> services = await device.discoverServices();
       for (var service in services) {
@@ -257,8 +268,57 @@ class HardwareService {
 
   static Map<String, dynamic> _lastBleData = {};
 
+  // Binary status frame v1 (firmware/lib/BoatBle/boat_ble_status.h):
+  // [ver][n] then n x 17-byte records, oldest first, little-endian.
+  static const int _statusVer = 1;
+  static const int _statusRecLen = 17;
+  static const List<String> _loraStates = [
+    "Idle",
+    "Joining",
+    "Joined",
+    "Joined (sent)",
+    "Join Fail",
+  ];
+
+  static bool _onStatusFrame(List<int> value) {
+    if (value.length < 2 || value[0] != _statusVer) return false;
+    int n = value[1];
+    if (n == 0 || value.length < 2 + n * _statusRecLen) return false;
+
+    // Only the newest record matters for the dashboard
+    final rec = ByteData.sublistView(
+      Uint8List.fromList(value),
+      2 + (n - 1) * _statusRecLen,
+      2 + n * _statusRecLen,
+    );
+    final flags = rec.getUint8(16);
+    final fix = (flags & 0x01) != 0;
+    final lora = (flags >> 4) & 0x07;
+    final loraName = lora < _loraStates.length ? _loraStates[lora] : "Unknown";
+
+    _lastBleData['S'] = rec.getUint8(14).toString();
+    _lastBleData['Lat'] = fix
+        ? (rec.getInt32(2, Endian.little) / 1e7).toString()
+        : '0';
+    _lastBleData['Lon'] = fix
+        ? (rec.getInt32(6, Endian.little) / 1e7).toString()
+        : '0';
+    _lastBleData['Spd'] = (rec.getUint16(10, Endian.little) / 100).toString();
+    _lastBleData['Hdg'] = (rec.getUint16(12, Endian.little) / 100).toString();
+    _lastBleData['Bat'] = rec.getUint8(15).toString();
+    _lastBleData['Journey'] = ((flags & 0x02) != 0).toString();
+    if (_lastBleData['St'] != loraName) {
+      _lastBleData['St'] = loraName;
+      _loraStatusController.add(loraName);
+    }
+    return true;
+  }
+
   static void _onDataReceived(List<int> value) {
-    String data = utf8.decode(value);
+    if (_onStatusFrame(value)) return;
+
+    // Older firmware: ASCII key:value line
+    String data = utf8.decode(value, allowMalformed: true);
     LogService.d("BLE Data Received: $data");
 
     try {
@@ -0,0 +1,257 @@
+#include "fleet.h"
+#include <boat_json.h>
+#include <boat_mesh.h>
+#include <host_lora.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fstream>
+#include <map>
+
+static const float SENS_DBM[] = {-123, -126, -129, -132, -134.5, -137};  // SF7..SF12, 125 kHz
+static const uint32_t CHANNELS_HZ[] = {865062500, 865402500, 865985000};  // IN865 default channels
+static const double HARBOUR_LAT = 9.5, HARBOUR_LON = 76.3;                // off Kochi
+
+// Standard alphabet, padding optional; -1 if malformed or longer than cap
+static int base64Decode(const char *in, uint8_t *out, size_t cap) {
+  static const char *a = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  uint32_t acc = 0;
+  int bits = 0;
+  size_t n = 0;
+  for (; *in && *in != '='; in++) {
+    const char *p = strchr(a, *in);
+    if (!p) return -1;
+    acc = acc << 6 | (p - a);
+    bits += 6;
+    if (bits < 8) continue;
+    bits -= 8;
+    if (n == cap) return -1;
+    out[n++] = acc >> bits;
+  }
+  return (int)n;
+}
+
+// RFC 3339 to unix us; 0 if it is not one
+static uint64_t parseTime(const char *s) {
+  struct tm tm = {};
+  int n = 0;
+  if (sscanf(s, "%4d-%2d-%2dT%2d:%2d:%2d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min,
+             &tm.tm_sec, &n) != 6)
+    return 0;
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  s += n;
+  uint64_t us = 0;
+  if (*s == '.') {
+    uint32_t scale = 100000;
+    for (s++; *s >= '0' && *s <= '9'; s++, scale /= 10) us += (*s - '0') * scale;
+  }
+  int64_t off = 0;
+  if (*s == '+' || *s == '-') {
+    int h = 0, m = 0;
+    sscanf(s + 1, "%2d:%2d", &h, &m);
+    off = (*s == '+' ? 1 : -1) * (h * 3600 + m * 60);
+  }
+  return (uint64_t)((int64_t)timegm(&tm) - off) * 1000000 + us;
+}
+
+void Fleet::deviceKeys(const FleetConfig &cfg, uint32_t boat, uint8_t nwkSKey[16], uint8_t appSKey[16]) {
+  loraWanDeriveKeys(cfg.master, cfg.devAddr + boat, nwkSKey, appSKey);
+}
+
+Fleet::Fleet(const FleetConfig &cfg, uint64_t startUs) : cfg_(cfg), startUs_(startUs), rng_(cfg.seed) {
+  std::uniform_real_distribution<double> uni(-1.0, 1.0);
+  std::normal_distribution<double> rssi(cfg.rssiMean, cfg.rssiSd);
+  std::uniform_int_distribution<int> sf(cfg.sfMin, cfg.sfMax);
+  boats_.resize(cfg.boats);
+  for (uint32_t i = 0; i < cfg.boats; i++) {
+    Boat &b = boats_[i];
+    uint8_t nwk[16], app[16];
+    deviceKeys(cfg, i, nwk, app);
+    b.dev.reset(new LoraWanAbp(cfg.devAddr + i, nwk, app, cfg.fcnt));
+    b.id = cfg.firstId + i;
+    b.sf = sf(rng_);
+    b.rssi = rssi(rng_);
+    b.lat = HARBOUR_LAT + uni(rng_) * 0.2;
+    b.lon = HARBOUR_LON + uni(rng_) * 0.2;
+    b.vn = uni(rng_) * 4;
+    b.ve = uni(rng_) * 4;
+    b.movedUs = startUs;
+  }
+  Ev e = {};
+  if (cfg.rate > 0) {
+    e.kind = EV_ARRIVAL;
+    e.at = nextArrival(startUs);
+    q_.push(e);
+    return;
+  }
+  std::uniform_real_distribution<double> first(0, cfg.periodS * 1e6);
+  e.kind = EV_REPORT;
+  for (uint32_t i = 0; i < cfg.boats; i++) {
+    e.boat = i;
+    e.at = startUs + (uint64_t)first(rng_);
+    q_.push(e);
+  }
+}
+
+// Poisson at rate x burst inside each 1 s burst, nothing in the burst - 1 s after it
+uint64_t Fleet::nextArrival(uint64_t now) {
+  double r = cfg_.rate * cfg_.burst;
+  std::exponential_distribution<double> gap(r / 1e6);
+  uint64_t t = now + (uint64_t)gap(rng_);
+  if (cfg_.burst <= 1) return t;
+  uint64_t cycle = (uint64_t)(cfg_.burst * 1e6), off = (t - startUs_) % cycle;
+  if (off < 1000000) return t;
+  return t - off + cycle + (uint64_t)gap(rng_);  // memoryless: start over in the next burst
+}
+
+bool Fleet::loadTrace(const char *path, double speed) {
+  std::ifstream f(path);
+  if (!f) return false;
+  q_ = decltype(q_)();
+  std::map<uint16_t, uint32_t> byId;
+  uint64_t t0 = 0, last = 0;
+  std::string line;
+  while (std::getline(f, line)) {
+    struct { uint8_t fPort; char data[128]; char time[40]; } ev = {};
+    const JsonField fl[] = {
+      JSON_UINT_FIELD("fPort", ev.fPort),
+      JSON_STR_FIELD("data", ev.data),
+      JSON_STR_FIELD("time", ev.time),
+    };
+    uint32_t got;
+    Ev e = {};
+    int len = -1;
+    if (jsonBind(line.data(), line.size(), fl, 3, &got) == JSON_OK && (got & 3) == 3)
+      len = base64Decode(ev.data, e.buf, FLEET_MAX_PAYLOAD);
+    if (len < 2 || len > FLEET_MAX_PAYLOAD) { st_.skipped++; continue; }
+    uint64_t t = (got & 4) ? parseTime(ev.time) : 0;
+    if (!t) t = last;
+    if (!t0) t0 = t;
+    last = t;
+    uint16_t src = e.buf[0] | e.buf[1] << 8;  // Pkt.src, or a backlog's [u16 src]
+    auto it = byId.find(src);
+    if (it == byId.end()) {
+      if (byId.size() == boats_.size()) { st_.skipped++; continue; }
+      it = byId.emplace(src, byId.size()).first;
+    }
+    e.kind = EV_TRACE;
+    e.boat = it->second;
+    e.port = ev.fPort;
+    e.len = len;
+    e.at = startUs_ + (uint64_t)((t >= t0 ? t - t0 : 0) / speed);
+    q_.push(e);
+  }
+  return !q_.empty();
+}
+
+void Fleet::report(uint64_t now, uint32_t bi) {
+  Boat &b = boats_[bi];
+  double dt = (now - b.movedUs) / 1e6;
+  b.movedUs = now;
+  b.lat += b.vn * dt / 111320.0;
+  b.lon += b.ve * dt / (111320.0 * cos(b.lat * DEG_TO_RAD));
+  NavState s = {};
+  s.valid = true;
+  s.lat1e7 = (int32_t)(b.lat * 1e7);
+  s.lon1e7 = (int32_t)(b.lon * 1e7);
+  s.spd_cms = (uint16_t)(sqrt(b.vn * b.vn + b.ve * b.ve) * 100);
+  s.hdg_cdeg = (uint16_t)fmod(atan2(b.ve, b.vn) * RAD_TO_DEG * 100 + 36000, 36000);
+  char name[16];
+  snprintf(name, sizeof(name), "Boat %u", b.id);
+  Pkt p;
+  pktBuild(p, b.id, b.seq++, s, 80, b.id, name);
+  send(now, bi, FLEET_PKT_FPORT, (const uint8_t *)&p, sizeof(p));
+  st_.reports++;
+
+  std::uniform_real_distribution<double> uni(0, 1);
+  Ev e = {};
+  if (boats_.size() > 1 && uni(rng_) < cfg_.relayProb && meshRelay(p, *(Pkt *)e.buf)) {
+    std::uniform_int_distribution<uint32_t> other(1, boats_.size() - 1);
+    std::uniform_int_distribution<uint32_t> delay(MESH_RELAY_MIN_MS, MESH_RELAY_MAX_MS);
+    e.kind = EV_RELAY;
+    e.boat = (bi + other(rng_)) % boats_.size();
+    e.port = FLEET_PKT_FPORT;
+    e.len = sizeof(Pkt);
+    e.at = now + hostLoraTimeOnAirUs(sizeof(Pkt) + 13, b.sf, 125, 5, true) + delay(rng_) * 1000ULL;
+    q_.push(e);
+    st_.relays++;
+  }
+}
+
+void Fleet::send(uint64_t now, uint32_t bi, uint8_t port, const uint8_t *payload, uint8_t len) {
+  Boat &b = boats_[bi];
+  Ev e = {};
+  e.kind = EV_END;
+  e.boat = bi;
+  e.len = b.dev->uplink(port, payload, len, e.buf);
+  if (!e.len) return;
+  e.sf = b.sf;
+  e.at = now + hostLoraTimeOnAirUs(e.len, b.sf, 125, 5, true);
+  q_.push(e);
+  st_.frames++;
+}
+
+void Fleet::end(const Ev &e, std::vector<Delivery> &out) {
+  const Boat &b = boats_[e.boat];
+  std::uniform_real_distribution<double> uni(0, 1);
+  std::normal_distribution<double> fade(0, 3);
+  std::uniform_int_distribution<int> chan(0, 2);
+  uint8_t ch = chan(rng_);
+  uint16_t home = e.boat % cfg_.gateways;
+  bool heard = false;
+  for (uint16_t g = 0; g < cfg_.gateways; g++) {
+    if (g != home && uni(rng_) >= cfg_.dupProb) continue;
+    float rssi = b.rssi + fade(rng_) - (g != home ? 15 * uni(rng_) : 0);
+    if (rssi < SENS_DBM[e.sf - 7]) continue;
+    Delivery d;
+    d.gateway = g;
+    d.pkt.monoUs = e.at;
+    d.pkt.unixUs = 0;
+    d.pkt.freqHz = CHANNELS_HZ[ch];
+    d.pkt.chan = ch;
+    d.pkt.sf = e.sf;
+    d.pkt.rssi = rssi;
+    d.pkt.lsnr = rssi - FLEET_NOISE_DBM > 13.5 ? 13.5 : rssi - FLEET_NOISE_DBM;
+    d.pkt.len = e.len;
+    memcpy(d.pkt.data, e.buf, e.len);
+    out.push_back(d);
+    st_.receptions++;
+    heard = true;
+  }
+  if (!heard) st_.lost++;
+}
+
+uint64_t Fleet::run(uint64_t nowUs, std::vector<Delivery> &out) {
+  while (!q_.empty() && q_.top().at <= nowUs) {
+    Ev e = q_.top();
+    q_.pop();
+    switch (e.kind) {
+      case EV_REPORT: {
+        report(e.at, e.boat);
+        std::uniform_real_distribution<double> jitter(0, FLEET_REPORT_JITTER_S * 1e6);
+        e.at += (uint64_t)(cfg_.periodS * 1e6 + jitter(rng_));
+        q_.push(e);
+        break;
+      }
+      case EV_ARRIVAL: {
+        std::uniform_int_distribution<uint32_t> boat(0, boats_.size() - 1);
+        report(e.at, boat(rng_));
+        e.at = nextArrival(e.at);
+        q_.push(e);
+        break;
+      }
+      case EV_RELAY:
+        send(e.at, e.boat, e.port, e.buf, e.len);
+        break;
+      case EV_TRACE:
+        send(e.at, e.boat, e.port, e.buf, e.len);
+        st_.traced++;
+        break;
+      case EV_END:
+        end(e, out);
+        break;
+    }
+  }
+  return q_.empty() ? UINT64_MAX : q_.top().at;
+}
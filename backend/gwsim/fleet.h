@@ -0,0 +1,108 @@
+/*
+  Fleet - the boats behind boat_gwsim's gateways
+
+  Each boat is an ABP device (lorawan.h) sending its Pkt on FPort 10,
+  built by pktBuild() from a drifting position as BoatNode v2's
+  lorawanSend() of its own report. Traffic is one of
+
+    - per boat, every periodS plus 0..REPORT_JITTER_S, first one at random
+    - fleet-wide Poisson at rate/s; burst > 1 makes it come in 1 s bursts
+      at rate x burst with burst - 1 s of silence between, same mean
+    - a trace: recorded up events replayed at their own pace (loadTrace)
+
+  With relayProb a report is also sent by another boat after the mesh
+  relay delay, meshRelay()'d, as a joined boat forwards what it hears.
+
+  Reception: a boat has a home gateway (boat % gateways) and a mean RSSI
+  there drawn from N(rssiMean, rssiSd); every other gateway also hears a
+  frame with dupProb, 0..15 dB weaker. Each frame fades by N(0, 3 dB) per
+  gateway and is lost below the SF's sensitivity; SNR is RSSI over a
+  -117 dBm noise floor. Frames arrive at the gateways when they end.
+*/
+#pragma once
+
+#include "gateway.h"
+#include "lorawan.h"
+#include <boat_pkt.h>
+#include <memory>
+#include <queue>
+#include <random>
+
+const uint16_t FLEET_REPORT_JITTER_S = 20;
+const float    FLEET_NOISE_DBM       = -117;   // 125 kHz, 6 dB noise figure
+const uint8_t  FLEET_PKT_FPORT       = 10;
+const uint8_t  FLEET_MAX_PAYLOAD     = 51;     // slowest IN865 data rates
+
+struct FleetConfig {
+  uint32_t boats = 100;
+  uint16_t firstId = 1;         // mesh id of boat 0, boats.device_id
+  uint16_t gateways = 1;
+  uint8_t sfMin = 9, sfMax = 9;
+  double rssiMean = -105, rssiSd = 8;
+  double dupProb = 0.3;
+  double relayProb = 0;
+  double periodS = 120;
+  double rate = 0;              // > 0: Poisson instead of per-boat periods
+  double burst = 1;
+  uint32_t devAddr = 0x26011000;  // boat i is devAddr + i
+  uint8_t master[16] = {0};
+  uint32_t fcnt = 0;
+  uint64_t seed = 1;
+};
+
+struct FleetStats {
+  uint64_t frames = 0, reports = 0, relays = 0, traced = 0, receptions = 0, lost = 0, skipped = 0;
+};
+
+struct Delivery {
+  uint16_t gateway;
+  RxPkt pkt;
+};
+
+class Fleet {
+public:
+  Fleet(const FleetConfig &cfg, uint64_t startUs);
+
+  // Replays newline-delimited ChirpStack up events (fPort, data, time) speed
+  // times faster, each sent by the boat whose mesh id starts the payload.
+  // Replaces the generated traffic; false if nothing usable was read.
+  bool loadTrace(const char *path, double speed);
+
+  // Runs everything due by nowUs; frames that ended go to out (unixUs left 0).
+  // Returns when the next event is due, UINT64_MAX when there is none.
+  uint64_t run(uint64_t nowUs, std::vector<Delivery> &out);
+
+  const FleetStats &stats() const { return st_; }
+  static void deviceKeys(const FleetConfig &cfg, uint32_t boat, uint8_t nwkSKey[16], uint8_t appSKey[16]);
+
+private:
+  enum Kind : uint8_t { EV_REPORT, EV_ARRIVAL, EV_RELAY, EV_TRACE, EV_END };
+  struct Ev {
+    uint64_t at;
+    Kind kind;
+    uint32_t boat;
+    uint8_t port, sf, len;
+    uint8_t buf[LORAWAN_MAX_PHY];
+    bool operator>(const Ev &o) const { return at > o.at; }
+  };
+  struct Boat {
+    std::unique_ptr<LoraWanAbp> dev;
+    uint16_t id, seq = 0;
+    uint8_t sf;
+    float rssi;
+    double lat, lon, vn, ve;   // degrees, m/s
+    uint64_t movedUs;
+  };
+
+  void report(uint64_t now, uint32_t b);
+  void send(uint64_t now, uint32_t b, uint8_t port, const uint8_t *payload, uint8_t len);
+  void end(const Ev &e, std::vector<Delivery> &out);
+  uint64_t nextArrival(uint64_t now);
+
+  FleetConfig cfg_;
+  uint64_t startUs_;
+  std::vector<Boat> boats_;
+  std::priority_queue<Ev, std::vector<Ev>, std::greater<Ev>> q_;
+  std::mt19937_64 rng_;
+  FleetStats st_;
+};
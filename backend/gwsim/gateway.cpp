@@ -0,0 +1,164 @@
+#include "gateway.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+enum : uint8_t { PUSH_DATA = 0, PUSH_ACK = 1, PULL_DATA = 2, PULL_RESP = 3, PULL_ACK = 4, TX_ACK = 5 };
+
+static void base64(std::string &out, const uint8_t *in, size_t len) {
+  static const char *a = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (size_t i = 0; i < len; i += 3) {
+    uint32_t v = in[i] << 16 | (i + 1 < len ? in[i + 1] << 8 : 0) | (i + 2 < len ? in[i + 2] : 0);
+    out += a[v >> 18 & 63];
+    out += a[v >> 12 & 63];
+    out += i + 1 < len ? a[v >> 6 & 63] : '=';
+    out += i + 2 < len ? a[v & 63] : '=';
+  }
+}
+
+/* ------------ GwStats ------------- */
+void GwStats::add(const GwStats &o) {
+  rxpk += o.rxpk; pushes += o.pushes; pushAcks += o.pushAcks; lateAcks += o.lateAcks;
+  pulls += o.pulls; pullAcks += o.pullAcks; downlinks += o.downlinks; stats += o.stats;
+  for (uint32_t i = 0; i < GW_LAT_BINS; i++) ackLat[i] += o.ackLat[i];
+}
+
+double GwStats::ackQuantileMs(double q) const {
+  uint64_t n = 0, seen = 0;
+  for (uint32_t c : ackLat) n += c;
+  if (!n) return 0;
+  for (uint32_t i = 0; i < GW_LAT_BINS; i++) {
+    seen += ackLat[i];
+    if (seen >= q * n) return (i + 0.5) * GW_LAT_BIN_US / 1000.0;
+  }
+  return GW_LAT_BINS * GW_LAT_BIN_US / 1000.0;
+}
+
+/* ------------ SemtechGateway ------------- */
+SemtechGateway::SemtechGateway(uint64_t eui, const sockaddr_storage &server, socklen_t serverLen, uint32_t tmstOffset)
+    : eui_(eui), tmstOffset_(tmstOffset), token_(tmstOffset & 0xFFFF) {
+  fd_ = socket(server.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd_ >= 0 && connect(fd_, (const sockaddr *)&server, serverLen)) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+SemtechGateway::~SemtechGateway() {
+  if (fd_ >= 0) close(fd_);
+}
+
+std::string SemtechGateway::header(uint8_t type) {
+  std::string h(12, '\0');
+  token_++;
+  h[0] = 2;
+  h[1] = token_ >> 8;
+  h[2] = token_ & 0xFF;
+  h[3] = type;
+  for (int i = 0; i < 8; i++) h[4 + i] = eui_ >> (56 - 8 * i) & 0xFF;
+  return h;
+}
+
+void SemtechGateway::send(const std::string &d) {
+  // A full socket buffer loses the datagram, as UDP would on the way
+  if (fd_ >= 0) ::send(fd_, d.data(), d.size(), 0);
+}
+
+void SemtechGateway::push(const std::string &json, uint64_t nowUs) {
+  std::string d = header(PUSH_DATA) + json;
+  pending_[token_] = nowUs;
+  st_.pushes++;
+  send(d);
+}
+
+void SemtechGateway::tick(uint64_t nowUs, uint64_t unixUs) {
+  if (nowUs >= nextFetchUs_) {
+    nextFetchUs_ = nowUs + GW_FETCH_MS * 1000;
+    for (size_t i = 0; i < queue_.size(); i += GW_NB_PKT_MAX) {
+      std::string j = "{\"rxpk\":[";
+      for (size_t k = i; k < queue_.size() && k < i + GW_NB_PKT_MAX; k++) {
+        const RxPkt &p = queue_[k];
+        time_t t = p.unixUs / 1000000;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        char buf[320];
+        strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+        std::string iso = buf;
+        snprintf(buf, sizeof(buf),
+                 "%s{\"tmst\":%u,\"time\":\"%s.%06uZ\",\"chan\":%u,\"rfch\":0,\"freq\":%.6f,\"stat\":1,"
+                 "\"modu\":\"LORA\",\"datr\":\"SF%uBW125\",\"codr\":\"4/5\",\"rssi\":%.0f,\"lsnr\":%.1f,\"size\":%u,"
+                 "\"data\":\"",
+                 k > i ? "," : "", (uint32_t)(p.monoUs + tmstOffset_), iso.c_str(), (unsigned)(p.unixUs % 1000000),
+                 p.chan, p.freqHz / 1e6, p.sf, p.rssi, p.lsnr, p.len);
+        j += buf;
+        base64(j, p.data, p.len);
+        j += "\"}";
+        st_.rxpk++;
+        rxnb_++;
+      }
+      j += "]}";
+      push(j, nowUs);
+    }
+    queue_.clear();
+    // Unanswered pushes: the bridge or the network dropped them
+    for (auto it = pending_.begin(); it != pending_.end();)
+      it = nowUs - it->second > GW_ACK_TIMEOUT_MS * 1000 ? pending_.erase(it) : std::next(it);
+  }
+  if (nowUs >= nextPullUs_) {
+    nextPullUs_ = nowUs + GW_KEEPALIVE_S * 1000000ULL;
+    send(header(PULL_DATA));
+    st_.pulls++;
+  }
+  if (nowUs >= nextStatUs_) {
+    if (nextStatUs_) {
+      time_t t = unixUs / 1000000;
+      struct tm tm;
+      gmtime_r(&t, &tm);
+      char ts[32], buf[256];
+      strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S GMT", &tm);
+      snprintf(buf, sizeof(buf),
+               "{\"stat\":{\"time\":\"%s\",\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":0}}",
+               ts, rxnb_, rxnb_, rxnb_, st_.pushes ? 100.0 * st_.pushAcks / st_.pushes : 100.0, dwnb_);
+      push(buf, nowUs);
+      st_.stats++;
+      rxnb_ = dwnb_ = 0;
+    }
+    nextStatUs_ = nowUs + GW_STAT_S * 1000000ULL;
+  }
+}
+
+void SemtechGateway::readable(uint64_t nowUs) {
+  uint8_t buf[4096];
+  for (;;) {
+    ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+    if (n < 0) return;  // EAGAIN, or ICMP unreachable while nobody listens
+    if (n < 4 || buf[0] != 2) continue;
+    uint16_t token = buf[1] << 8 | buf[2];
+    switch (buf[3]) {
+      case PUSH_ACK: {
+        auto it = pending_.find(token);
+        if (it == pending_.end()) { st_.lateAcks++; break; }
+        uint64_t us = nowUs - it->second;
+        st_.ackLat[us / GW_LAT_BIN_US < GW_LAT_BINS ? us / GW_LAT_BIN_US : GW_LAT_BINS - 1]++;
+        st_.pushAcks++;
+        pending_.erase(it);
+        break;
+      }
+      case PULL_ACK:
+        st_.pullAcks++;
+        break;
+      case PULL_RESP: {
+        st_.downlinks++;
+        dwnb_++;
+        std::string ack = header(TX_ACK);
+        ack[1] = buf[1];  // TX_ACK echoes the PULL_RESP token
+        ack[2] = buf[2];
+        ack += "{\"txpk_ack\":{\"error\":\"NONE\"}}";
+        send(ack);
+        break;
+      }
+    }
+  }
+}
@@ -0,0 +1,83 @@
+/*
+  SemtechGateway - a packet forwarder talking the Semtech UDP protocol
+
+  What lora_pkt_fwd (global_conf.json's gateway_conf) exchanges with the
+  gateway bridge on serv_port_up / serv_port_down:
+
+    PUSH_DATA  [2][token][0][EUI]{"rxpk":[...]} or {"stat":{...}}  <- PUSH_ACK [2][token][1]
+    PULL_DATA  [2][token][2][EUI], every keepalive_interval         <- PULL_ACK [2][token][4]
+    PULL_RESP  [2][token][3]{"txpk":{...}}, a downlink              -> TX_ACK   [2][token][5][EUI]{"txpk_ack":...}
+
+  One socket per gateway carries both directions, which the bridge
+  accepts as long as up and down ports are the same (1700 in the conf).
+  rx() queues a received frame; fetch() sends the queue as the forwarder
+  does, at most GW_NB_PKT_MAX rxpk per PUSH_DATA, every GW_FETCH_MS. The
+  time from each PUSH_DATA to its ACK goes into GwStats. Downlinks are
+  acknowledged, counted and not transmitted anywhere.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const uint8_t  GW_NB_PKT_MAX       = 8;
+const uint32_t GW_FETCH_MS         = 10;
+const uint32_t GW_KEEPALIVE_S      = 10;   // keepalive_interval
+const uint32_t GW_STAT_S           = 30;   // stat_interval
+const uint32_t GW_ACK_TIMEOUT_MS   = 100;  // push_timeout_ms
+const uint32_t GW_LAT_BIN_US       = 50;
+const uint32_t GW_LAT_BINS         = 2000;  // up to 100 ms, the last bin takes the rest
+
+struct RxPkt {
+  uint64_t monoUs, unixUs;  // end of the frame
+  uint32_t freqHz;
+  uint8_t chan, sf;
+  float rssi, lsnr;
+  uint8_t len;
+  uint8_t data[255];
+};
+
+struct GwStats {
+  uint64_t rxpk = 0, pushes = 0, pushAcks = 0, lateAcks = 0;
+  uint64_t pulls = 0, pullAcks = 0, downlinks = 0, stats = 0;
+  std::vector<uint32_t> ackLat;  // PUSH_DATA to PUSH_ACK, GW_LAT_BIN_US bins
+
+  GwStats() : ackLat(GW_LAT_BINS) {}
+  void add(const GwStats &o);
+  double ackQuantileMs(double q) const;
+};
+
+class SemtechGateway {
+public:
+  SemtechGateway(uint64_t eui, const sockaddr_storage &server, socklen_t serverLen, uint32_t tmstOffset);
+  ~SemtechGateway();
+
+  int fd() const { return fd_; }
+  uint64_t eui() const { return eui_; }
+  void rx(const RxPkt &p) { queue_.push_back(p); }
+  // Due fetch, keepalive and stat datagrams; nowUs is CLOCK_MONOTONIC, unixUs the wall clock
+  void tick(uint64_t nowUs, uint64_t unixUs);
+  // Reads what the bridge sent
+  void readable(uint64_t nowUs);
+
+  const GwStats &stats() const { return st_; }
+
+private:
+  void send(const std::string &d);
+  std::string header(uint8_t type);
+  void push(const std::string &json, uint64_t nowUs);
+
+  uint64_t eui_;
+  int fd_;
+  uint32_t tmstOffset_;
+  uint16_t token_;
+  std::vector<RxPkt> queue_;
+  std::unordered_map<uint16_t, uint64_t> pending_;  // PUSH_DATA token -> sent at
+  uint64_t nextFetchUs_ = 0, nextPullUs_ = 0, nextStatUs_ = 0;
+  uint32_t rxnb_ = 0, dwnb_ = 0;  // since the last stat
+  GwStats st_;
+};
@@ -0,0 +1,95 @@
+#include "lorawan.h"
+#include <openssl/evp.h>
+#include <string.h>
+
+static EVP_CIPHER_CTX *aesEcb(const uint8_t key[16]) {
+  EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+  EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, key, NULL);
+  EVP_CIPHER_CTX_set_padding(ctx, 0);
+  return ctx;
+}
+
+// RFC 4493 subkey: x << 1, xor 0x87 into the last byte if the top bit fell off
+static void cmacShift(const uint8_t in[16], uint8_t out[16]) {
+  uint8_t carry = 0;
+  for (int i = 15; i >= 0; i--) {
+    out[i] = in[i] << 1 | carry;
+    carry = in[i] >> 7;
+  }
+  if (carry) out[15] ^= 0x87;
+}
+
+LoraWanAbp::LoraWanAbp(uint32_t devAddr, const uint8_t nwkSKey[16], const uint8_t appSKey[16], uint32_t fcnt)
+    : devAddr_(devAddr), fcnt_(fcnt), nwk_(aesEcb(nwkSKey)), app_(aesEcb(appSKey)) {
+  uint8_t zero[16] = {0}, l[16];
+  aes(nwk_, zero, l);
+  cmacShift(l, k1_);
+  cmacShift(k1_, k2_);
+}
+
+LoraWanAbp::~LoraWanAbp() {
+  EVP_CIPHER_CTX_free(nwk_);
+  EVP_CIPHER_CTX_free(app_);
+}
+
+void LoraWanAbp::aes(EVP_CIPHER_CTX *ctx, const uint8_t in[16], uint8_t out[16]) {
+  int n;
+  EVP_EncryptUpdate(ctx, out, &n, in, 16);
+}
+
+size_t LoraWanAbp::uplink(uint8_t fport, const uint8_t *payload, size_t len, uint8_t *out) {
+  if (len + 13 > LORAWAN_MAX_PHY) return 0;
+  uint32_t fc = fcnt_++;
+  size_t n = 0;
+  out[n++] = 0x40;  // unconfirmed data up
+  memcpy(out + n, &devAddr_, 4); n += 4;
+  out[n++] = 0;     // FCtrl: no ADR, no FOpts
+  out[n++] = fc & 0xFF;
+  out[n++] = fc >> 8 & 0xFF;
+  out[n++] = fport;
+
+  // FRMPayload: xor with AES(AppSKey, A_i), i from 1
+  uint8_t a[16] = {0x01, 0, 0, 0, 0, 0}, s[16];
+  memcpy(a + 6, &devAddr_, 4);
+  memcpy(a + 10, &fc, 4);
+  for (size_t i = 0; i < len; i += 16) {
+    a[15] = i / 16 + 1;
+    aes(app_, a, s);
+    for (size_t k = 0; k < 16 && i + k < len; k++) out[n + i + k] = payload[i + k] ^ s[k];
+  }
+  n += len;
+
+  // MIC: CMAC over B0 | msg, B0 a full block so only msg's tail needs padding
+  uint8_t b0[16] = {0x49, 0, 0, 0, 0, 0}, x[16], blk[16];
+  memcpy(b0 + 6, &devAddr_, 4);
+  memcpy(b0 + 10, &fc, 4);
+  b0[15] = n;
+  aes(nwk_, b0, x);
+  size_t nb = (n + 15) / 16;
+  for (size_t b = 0; b < nb; b++) {
+    size_t off = b * 16, rem = n - off;
+    if (b + 1 < nb) {
+      for (int k = 0; k < 16; k++) blk[k] = x[k] ^ out[off + k];
+    } else {
+      for (int k = 0; k < 16; k++) {
+        uint8_t m = (size_t)k < rem ? out[off + k] : (size_t)k == rem ? 0x80 : 0;
+        blk[k] = x[k] ^ m ^ (rem == 16 ? k1_[k] : k2_[k]);
+      }
+    }
+    aes(nwk_, blk, x);
+  }
+  memcpy(out + n, x, 4);
+  return n + 4;
+}
+
+void loraWanDeriveKeys(const uint8_t master[16], uint32_t devAddr, uint8_t nwkSKey[16], uint8_t appSKey[16]) {
+  EVP_CIPHER_CTX *ctx = aesEcb(master);
+  uint8_t in[16] = {0};
+  int n;
+  memcpy(in + 1, &devAddr, 4);
+  in[0] = 1;
+  EVP_EncryptUpdate(ctx, nwkSKey, &n, in, 16);
+  in[0] = 2;
+  EVP_EncryptUpdate(ctx, appSKey, &n, in, 16);
+  EVP_CIPHER_CTX_free(ctx);
+}
@@ -0,0 +1,45 @@
+/*
+  LoraWanAbp - LoRaWAN 1.0.x data uplinks from an ABP device, as bytes
+
+  uplink() returns the PHYPayload a node would put on air:
+
+    [MHDR 0x40][DevAddr][FCtrl 0][FCnt][FPort][FRMPayload][MIC]
+
+  FRMPayload encrypted with AppSKey (AES-128 CTR, A_i blocks) and the MIC
+  the first four bytes of AES-CMAC(NwkSKey, B0 | msg), both as in the
+  1.0.3 specification, so a network server with the same session accepts
+  it. Keys come from loraWanDeriveKeys(), which lets a generator and a
+  provisioning script agree on thousands of sessions from one master key.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+const size_t LORAWAN_MAX_PHY = 255;
+
+class LoraWanAbp {
+public:
+  LoraWanAbp(uint32_t devAddr, const uint8_t nwkSKey[16], const uint8_t appSKey[16], uint32_t fcnt = 0);
+  ~LoraWanAbp();
+  LoraWanAbp(const LoraWanAbp &) = delete;
+  LoraWanAbp &operator=(const LoraWanAbp &) = delete;
+
+  // PHYPayload into out[LORAWAN_MAX_PHY]; returns its length, 0 if len is too long
+  size_t uplink(uint8_t fport, const uint8_t *payload, size_t len, uint8_t *out);
+
+  uint32_t devAddr() const { return devAddr_; }
+  uint32_t fcnt() const { return fcnt_; }
+
+private:
+  void aes(EVP_CIPHER_CTX *ctx, const uint8_t in[16], uint8_t out[16]);
+
+  uint32_t devAddr_, fcnt_;
+  EVP_CIPHER_CTX *nwk_, *app_;
+  uint8_t k1_[16], k2_[16];  // CMAC subkeys of NwkSKey
+};
+
+// Session keys of the device with devAddr under master: AES(master, [1|2][DevAddr][0...])
+void loraWanDeriveKeys(const uint8_t master[16], uint32_t devAddr, uint8_t nwkSKey[16], uint8_t appSKey[16]);
@@ -0,0 +1,216 @@
+/*
+  boat_gwsim - Semtech UDP packet forwarders and a fleet of boats behind them
+
+    boat_gwsim [-s host[:port]] [-g gateways] [-e gateway_eui] [-d seconds]
+               [-n boats] [-i first_id] [-p period_s | -r rate [-b burst]]
+               [-T trace [-x speed]] [-f sf[-sf]] [-q rssi] [-Q rssi_sd]
+               [-D dup_prob] [-R relay_prob] [-a devaddr] [-k master_key]
+               [-F fcnt] [-z seed] [-K]
+
+  Stands in for the concentrator of firmware/chirpstack (global_conf.json):
+  g gateways, EUIs counting up from the conf's gateway_ID, send PUSH_DATA
+  / PULL_DATA to the gateway bridge at -s (default localhost:1700) and
+  carry the uplinks of n boats (fleet.h) for -d seconds, or until the -T
+  trace is done. Prints a line every 10 s and a summary: frames, rxpk,
+  PUSH_ACK latency, missing acks and downlinks (e.g. nearby digests).
+
+  ChirpStack only takes frames from devices it knows: -K prints each
+  boat's ABP session (DevEUI, DevAddr, NwkSKey, AppSKey, mesh id) as CSV
+  for provisioning and exits. The sessions follow from -a, -k and -n, so
+  the same flags give the same devices every run; a restart begins again
+  at FCnt -F, so raise it or turn off frame-counter checks on the profile.
+*/
+#include "fleet.h"
+#include <getopt.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+const uint32_t STATS_MS = 10000;
+const uint32_t DRAIN_MS = 500;   // for the last acks
+
+static volatile sig_atomic_t stopping = 0;
+static void onSignal(int) { stopping = 1; }
+
+static uint64_t monoUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint64_t unixUs() {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static bool parseHex(const char *s, uint8_t *out, size_t n) {
+  if (strlen(s) != 2 * n) return false;
+  for (size_t i = 0; i < n; i++)
+    if (sscanf(s + 2 * i, "%2hhx", &out[i]) != 1) return false;
+  return true;
+}
+
+static void printHex(const uint8_t *b, size_t n) {
+  for (size_t i = 0; i < n; i++) printf("%02x", b[i]);
+}
+
+static void report(const char *tag, double s, const FleetStats &f, const GwStats &g) {
+  printf("[gwsim] %s %.0f s: %llu frames (%.0f/s, %llu relayed, %llu traced, %llu lost), %llu rxpk in %llu pushes\n",
+         tag, s, (unsigned long long)f.frames, s > 0 ? f.frames / s : 0, (unsigned long long)f.relays,
+         (unsigned long long)f.traced, (unsigned long long)f.lost, (unsigned long long)g.rxpk,
+         (unsigned long long)g.pushes);
+  printf("[gwsim] %s acks %llu/%llu (p50 %.2f ms, p99 %.2f ms, %llu late), pull acks %llu/%llu, %llu downlinks\n",
+         tag, (unsigned long long)g.pushAcks, (unsigned long long)g.pushes, g.ackQuantileMs(0.5),
+         g.ackQuantileMs(0.99), (unsigned long long)g.lateAcks, (unsigned long long)g.pullAcks,
+         (unsigned long long)g.pulls, (unsigned long long)g.downlinks);
+}
+
+int main(int argc, char **argv) {
+  FleetConfig cfg;
+  const char *server = "localhost:1700", *trace = NULL;
+  uint64_t eui = 0x0016c001f1d2c841ULL;  // gateway_ID in global_conf.json
+  double seconds = 60, speed = 1;
+  bool provision = false;
+  static const uint8_t MASTER[16] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                                     0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+  memcpy(cfg.master, MASTER, 16);
+  for (int c; (c = getopt(argc, argv, "s:g:e:d:n:i:p:r:b:T:x:f:q:Q:D:R:a:k:F:z:K")) != -1;) {
+    switch (c) {
+      case 's': server = optarg; break;
+      case 'g': cfg.gateways = atoi(optarg); break;
+      case 'e': eui = strtoull(optarg, NULL, 16); break;
+      case 'd': seconds = atof(optarg); break;
+      case 'n': cfg.boats = atoi(optarg); break;
+      case 'i': cfg.firstId = atoi(optarg); break;
+      case 'p': cfg.periodS = atof(optarg); break;
+      case 'r': cfg.rate = atof(optarg); break;
+      case 'b': cfg.burst = atof(optarg); break;
+      case 'T': trace = optarg; break;
+      case 'x': speed = atof(optarg); break;
+      case 'f': {
+        int lo, hi;
+        int n = sscanf(optarg, "%d-%d", &lo, &hi);
+        cfg.sfMin = lo;
+        cfg.sfMax = n == 2 ? hi : lo;
+        break;
+      }
+      case 'q': cfg.rssiMean = atof(optarg); break;
+      case 'Q': cfg.rssiSd = atof(optarg); break;
+      case 'D': cfg.dupProb = atof(optarg); break;
+      case 'R': cfg.relayProb = atof(optarg); break;
+      case 'a': cfg.devAddr = strtoul(optarg, NULL, 16); break;
+      case 'k':
+        if (!parseHex(optarg, cfg.master, 16)) { fprintf(stderr, "-k takes 32 hex digits\n"); return 2; }
+        break;
+      case 'F': cfg.fcnt = strtoul(optarg, NULL, 10); break;
+      case 'z': cfg.seed = strtoull(optarg, NULL, 10); break;
+      case 'K': provision = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-s host[:port]] [-g gateways] [-e gateway_eui] [-d seconds]\n"
+                        "       [-n boats] [-i first_id] [-p period_s | -r rate [-b burst]]\n"
+                        "       [-T trace [-x speed]] [-f sf[-sf]] [-q rssi] [-Q rssi_sd]\n"
+                        "       [-D dup_prob] [-R relay_prob] [-a devaddr] [-k master_key]\n"
+                        "       [-F fcnt] [-z seed] [-K]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (!cfg.boats || cfg.boats + cfg.firstId > 65536 || !cfg.firstId || !cfg.gateways || seconds <= 0 ||
+      cfg.sfMin < 7 || cfg.sfMax > 12 || cfg.sfMin > cfg.sfMax || cfg.periodS <= 0 || cfg.rate < 0 ||
+      cfg.burst < 1 || speed <= 0) {
+    fprintf(stderr, "bad arguments\n");
+    return 2;
+  }
+
+  if (provision) {
+    printf("dev_eui,dev_addr,nwk_s_key,app_s_key,mesh_id\n");
+    for (uint32_t i = 0; i < cfg.boats; i++) {
+      uint8_t nwk[16], app[16];
+      Fleet::deviceKeys(cfg, i, nwk, app);
+      uint32_t addr = cfg.devAddr + i;
+      printf("b0a7b0a7%08x,%08x,", addr, addr);
+      printHex(nwk, 16);
+      printf(",");
+      printHex(app, 16);
+      printf(",%u\n", cfg.firstId + i);
+    }
+    return 0;
+  }
+
+  std::string host(server), port("1700");
+  size_t colon = host.rfind(':');
+  if (colon != std::string::npos && host.find(':') == colon) {
+    port = host.substr(colon + 1);
+    host.resize(colon);
+  }
+  addrinfo hints = {}, *res;
+  hints.ai_socktype = SOCK_DGRAM;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res)) {
+    fprintf(stderr, "cannot resolve %s\n", server);
+    return 1;
+  }
+  sockaddr_storage sa = {};
+  memcpy(&sa, res->ai_addr, res->ai_addrlen);
+  socklen_t saLen = res->ai_addrlen;
+  freeaddrinfo(res);
+
+  uint64_t t0 = monoUs(), wall0 = unixUs();
+  std::mt19937 rng(cfg.seed);
+  std::vector<std::unique_ptr<SemtechGateway>> gws;
+  std::vector<pollfd> pfds;
+  for (uint16_t g = 0; g < cfg.gateways; g++) {
+    gws.emplace_back(new SemtechGateway(eui + g, sa, saLen, rng()));
+    if (gws.back()->fd() < 0) { perror("gateway socket"); return 1; }
+    pfds.push_back({gws.back()->fd(), POLLIN, 0});
+  }
+  Fleet fleet(cfg, t0);
+  if (trace && !fleet.loadTrace(trace, speed)) {
+    fprintf(stderr, "%s: no usable events\n", trace);
+    return 1;
+  }
+  printf("[gwsim] %u boats, %u gateways from %016llx -> %s, %s\n", cfg.boats, cfg.gateways,
+         (unsigned long long)eui, server,
+         trace ? "trace" : cfg.rate > 0 ? "Poisson" : "periodic");
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  uint64_t endUs = trace ? UINT64_MAX : t0 + (uint64_t)(seconds * 1e6), stopAt = 0, lastStats = t0;
+  std::vector<Delivery> out;
+  for (;;) {
+    uint64_t now = monoUs();
+    if (!stopAt && (stopping || now >= endUs)) stopAt = now;
+    uint64_t next = stopAt ? UINT64_MAX : fleet.run(now, out);
+    if (next == UINT64_MAX && !stopAt) stopAt = now;  // trace done
+    for (Delivery &d : out) {
+      d.pkt.unixUs = wall0 + (d.pkt.monoUs - t0);
+      gws[d.gateway]->rx(d.pkt);
+    }
+    out.clear();
+    for (auto &g : gws) g->tick(now, wall0 + (now - t0));
+    if (stopAt && now - stopAt >= DRAIN_MS * 1000) break;
+
+    int waitMs = next <= now ? 0 : (int)std::min<uint64_t>((next - now) / 1000, GW_FETCH_MS);
+    if (poll(pfds.data(), pfds.size(), waitMs) > 0) {
+      now = monoUs();
+      for (size_t i = 0; i < pfds.size(); i++)
+        if (pfds[i].revents) gws[i]->readable(now);
+    }
+    if (now - lastStats >= STATS_MS * 1000ULL) {
+      GwStats g;
+      for (auto &gw : gws) g.add(gw->stats());
+      report("at", (now - t0) / 1e6, fleet.stats(), g);
+      lastStats = now;
+    }
+  }
+
+  GwStats g;
+  for (auto &gw : gws) g.add(gw->stats());
+  report("total", (stopAt - t0) / 1e6, fleet.stats(), g);
+  uint64_t missing = g.pushes - g.pushAcks;
+  if (missing) printf("[gwsim] %llu pushes without an ack\n", (unsigned long long)missing);
+  return 0;
+}
@@ -0,0 +1,267 @@
+#include "ingest.h"
+#include <boat_json.h>
+#include <boat_pkt.h>
+#include <boat_journal.h>
+#include <string.h>
+
+/* ------------ text ------------- */
+// v / 10^decimals, exactly, e.g. lat1e7 with 7
+static void appendFixed(std::string &s, int64_t v, int decimals) {
+  char buf[24], *p = buf + sizeof(buf);
+  bool neg = v < 0;
+  uint64_t u = neg ? -(uint64_t)v : (uint64_t)v;
+  for (int i = 0; i < decimals; i++) { *--p = '0' + u % 10; u /= 10; }
+  if (decimals) *--p = '.';
+  do { *--p = '0' + u % 10; u /= 10; } while (u);
+  if (neg) *--p = '-';
+  s.append(p, buf + sizeof(buf) - p);
+}
+
+// ChirpStack writes RFC 3339; anything else is not passed into COPY text
+static bool timeUsable(const char *t) {
+  size_t n = strlen(t);
+  if (n < 19) return false;
+  for (size_t i = 0; i < n; i++)
+    if (!strchr("0123456789-:.+TZ", t[i])) return false;
+  return true;
+}
+
+static void formatTime(char *out, size_t cap, time_t t) {
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  strftime(out, cap, "%Y-%m-%d %H:%M:%S+00", &tm);
+}
+
+int base64Decode(const char *in, size_t len, uint8_t *out, size_t cap) {
+  static int8_t map[256];
+  if (!map['B']) {
+    memset(map, -1, sizeof(map));
+    const char *a = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int i = 0; i < 64; i++) map[(uint8_t)a[i]] = i;
+  }
+  while (len && in[len - 1] == '=') len--;
+  if (len % 4 == 1) return -1;
+  size_t n = 0;
+  uint32_t acc = 0;
+  int bits = 0;
+  for (size_t i = 0; i < len; i++) {
+    int8_t v = map[(uint8_t)in[i]];
+    if (v < 0) return -1;
+    acc = acc << 6 | v;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      if (n == cap) return -1;
+      out[n++] = acc >> bits;
+    }
+  }
+  return (int)n;
+}
+
+std::string base64Encode(const uint8_t *in, size_t len) {
+  static const char *a = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string s;
+  s.reserve((len + 2) / 3 * 4);
+  for (size_t i = 0; i < len; i += 3) {
+    uint32_t v = in[i] << 16 | (i + 1 < len ? in[i + 1] << 8 : 0) | (i + 2 < len ? in[i + 2] : 0);
+    s += a[v >> 18 & 63];
+    s += a[v >> 12 & 63];
+    s += i + 1 < len ? a[v >> 6 & 63] : '=';
+    s += i + 2 < len ? a[v & 63] : '=';
+  }
+  return s;
+}
+
+// Both ids go into an MQTT topic: hex and dashes only, no wildcards or levels
+static bool idUsable(const char *s, size_t min) {
+  size_t n = strlen(s);
+  if (n < min) return false;
+  for (size_t i = 0; i < n; i++)
+    if (!strchr("0123456789abcdefABCDEF-", s[i])) return false;
+  return true;
+}
+
+std::string ingestDownlink(const IngestDigest &d, const std::string &payload, std::string &topic) {
+  topic = std::string("application/") + d.appId + "/device/" + d.devEui + "/command/down";
+  char port[8];
+  snprintf(port, sizeof(port), "%u", INGEST_DIGEST_FPORT);
+  return std::string("{\"devEui\":\"") + d.devEui + "\",\"confirmed\":false,\"fPort\":" + port + ",\"data\":\"" +
+         base64Encode((const uint8_t *)payload.data(), payload.size()) + "\"}";
+}
+
+/* ------------ Ingest ------------- */
+Ingest::Ingest() : index_(65536, -1) {}
+
+void Ingest::setBoats(const std::vector<std::pair<uint16_t, std::string>> &boats) {
+  std::vector<int32_t> next(65536, -1);
+  for (const auto &m : boats) {
+    int32_t i = index_[m.first];
+    if (i < 0) {
+      i = boats_.size();
+      boats_.emplace_back();
+    }
+    boats_[i].uuid = m.second;
+    next[m.first] = i;
+  }
+  index_.swap(next);
+}
+
+Ingest::Boat *Ingest::boat(uint16_t id, int32_t *slot) {
+  int32_t i = index_[id];
+  if (i < 0) {
+    if (!anyBoat_) return nullptr;
+    char uuid[40];
+    snprintf(uuid, sizeof(uuid), "00000000-0000-0000-0000-%012u", id);
+    i = index_[id] = boats_.size();
+    boats_.emplace_back();
+    boats_.back().uuid = uuid;
+  }
+  if (slot) *slot = i;
+  return &boats_[i];
+}
+
+bool Ingest::Recent::seen(uint16_t k) {
+  for (uint8_t i = 0; i < n; i++)
+    if (keys[i] == k) return true;
+  keys[pos] = k;
+  pos = (pos + 1) % INGEST_DEDUP;
+  if (n < INGEST_DEDUP) n++;
+  return false;
+}
+
+void Ingest::addHistory(const Boat &b, int32_t lat1e7, int32_t lon1e7, uint8_t batt, uint16_t spd, uint16_t hdg,
+                        const char *time) {
+  if (historyRows_ >= INGEST_MAX_ROWS) { st_.dropped++; return; }
+  history_ += b.uuid;
+  history_ += '\t'; appendFixed(history_, lat1e7, 7);
+  history_ += '\t'; appendFixed(history_, lon1e7, 7);
+  history_ += '\t'; appendFixed(history_, batt, 0);
+  history_ += '\t'; appendFixed(history_, spd, 2);   // m/s
+  history_ += '\t'; appendFixed(history_, hdg, 2);   // degrees
+  history_ += '\t'; history_ += time;
+  history_ += '\n';
+  historyRows_++;
+}
+
+void Ingest::wantDigest(int32_t slot, const char *deviceInfo, size_t len, time_t now) {
+  Boat &b = boats_[slot];
+  if (b.digestAsked || (b.digestAt && now - b.digestAt < (time_t)digestSecs_)) return;
+  IngestDigest d;
+  const JsonField f[] = {
+    JSON_STR_FIELD("devEui", d.devEui),
+    JSON_STR_FIELD("applicationId", d.appId),
+  };
+  uint32_t got;
+  if (jsonBind(deviceInfo, len, f, 2, &got) != JSON_OK || got != 3) return;
+  if (strlen(d.devEui) != 16 || !idUsable(d.devEui, 16) || !idUsable(d.appId, 1)) return;
+  d.boatId = b.uuid;
+  d.slot = slot;
+  b.digestAsked = true;
+  digests_.push_back(d);
+  st_.digests++;
+}
+
+void Ingest::takeDigests(std::vector<IngestDigest> &out) {
+  for (const IngestDigest &d : digests_) boats_[d.slot].digestAsked = false;
+  out.swap(digests_);
+  digests_.clear();
+}
+
+void Ingest::digestSent(const IngestDigest &d, time_t now) {
+  if (d.slot >= 0 && d.slot < (int32_t)boats_.size()) boats_[d.slot].digestAt = now;
+}
+
+bool Ingest::uplink(const char *json, size_t len, time_t now) {
+  st_.events++;
+  struct { uint8_t fPort; char data[255]; char time[40]; JsonSpan dev; } ev = {};
+  const JsonField f[] = {
+    JSON_UINT_FIELD("fPort", ev.fPort),
+    JSON_STR_FIELD("data", ev.data),
+    JSON_STR_FIELD("time", ev.time),
+    JSON_OBJ_FIELD("deviceInfo", ev.dev),
+  };
+  uint32_t got;
+  if (jsonBind(json, len, f, 4, &got) != JSON_OK) { st_.bad++; return false; }
+  if (!(got & 1) || (ev.fPort != INGEST_PKT_FPORT && ev.fPort != INGEST_BACKLOG_FPORT)) {
+    st_.otherPort++;
+    return false;
+  }
+  uint8_t buf[192];
+  int n = (got & 2) ? base64Decode(ev.data, strlen(ev.data), buf, sizeof(buf)) : -1;
+  if (n < 0) { st_.bad++; return false; }
+  if (!(got & 4) || !timeUsable(ev.time)) formatTime(ev.time, sizeof(ev.time), now);
+
+  if (ev.fPort == INGEST_PKT_FPORT) {
+    Pkt p;
+    if (n != sizeof(Pkt)) { st_.badFrame++; return false; }
+    memcpy(&p, buf, sizeof(p));
+    if (!pktCheck(p)) { st_.badFrame++; return false; }
+    int32_t slot;
+    Boat *b = boat(p.src, &slot);
+    if (!b) { st_.unknownBoat++; return false; }
+    // Only the boat itself uplinks a report at hops 0; without a fix it could not place a digest
+    if (digestSecs_ && !p.hops && (got & 8) && (p.lat1e7 || p.lon1e7)) wantDigest(slot, ev.dev.p, ev.dev.len, now);
+    if (b->seqs.seen(p.seq)) { st_.duplicates++; return false; }
+    st_.pkts++;
+    if (!p.lat1e7 && !p.lon1e7) return true;  // no fix yet
+    addHistory(*b, p.lat1e7, p.lon1e7, p.batt_pc, p.spd_cms, p.hdg_cdeg, ev.time);
+    // A relayed copy of an older report can come after a newer one
+    if (b->hasLive && (int16_t)(p.seq - b->liveSeq) < 0) return true;
+    if (!b->dirty) dirty_.push_back(slot);
+    b->hasLive = b->dirty = true;
+    b->liveSeq = p.seq;
+    b->lat1e7 = p.lat1e7; b->lon1e7 = p.lon1e7;
+    b->spd_cms = p.spd_cms; b->hdg_cdeg = p.hdg_cdeg;
+    b->batt_pc = p.batt_pc;
+    memcpy(b->time, ev.time, sizeof(b->time));
+    return true;
+  }
+
+  // Backlog: [u16 src][journal body]; a block can come twice (a LoRaWAN
+  // retry, two boats forwarding it), so its crc stands in for a seq.
+  JournalRec recs[JOURNAL_BODY_MAX];
+  size_t nr = n > 2 ? journalDecode(buf + 2, n - 2, recs, JOURNAL_BODY_MAX) : 0;
+  if (!nr) { st_.badFrame++; return false; }
+  uint16_t src = buf[0] | buf[1] << 8;
+  Boat *b = boat(src, nullptr);
+  if (!b) { st_.unknownBoat++; return false; }
+  if (b->blocks.seen(crc16_ccitt(buf + 2, n - 2))) { st_.duplicates++; return false; }
+  char t[40];
+  for (size_t i = 0; i < nr; i++) {
+    formatTime(t, sizeof(t), recs[i].t);
+    addHistory(*b, recs[i].lat1e7, recs[i].lon1e7, recs[i].batt_pc, recs[i].spd_cms, recs[i].hdg_cdeg, t);
+  }
+  st_.journalRecs += nr;
+  return true;
+}
+
+IngestWrite Ingest::flush(IngestSink &sink) {
+  if (!pending()) return INGEST_WRITTEN;
+  live_.clear();
+  for (int32_t i : dirty_) {
+    const Boat &b = boats_[i];
+    live_ += b.uuid;
+    live_ += '\t'; appendFixed(live_, b.lat1e7, 7);
+    live_ += '\t'; appendFixed(live_, b.lon1e7, 7);
+    live_ += '\t'; appendFixed(live_, b.hdg_cdeg, 2);
+    live_ += '\t'; appendFixed(live_, b.spd_cms, 2);
+    live_ += '\t'; appendFixed(live_, b.batt_pc, 0);
+    live_ += '\t'; live_ += b.time;
+    live_ += '\n';
+  }
+  IngestWrite w = sink.write(history_, historyRows_, live_, dirty_.size());
+  if (w == INGEST_RETRY) return w;
+  if (w == INGEST_WRITTEN) {
+    st_.flushes++;
+    st_.historyRows += historyRows_;
+    st_.liveRows += dirty_.size();
+  } else {
+    st_.rejected++;
+    st_.rejectedRows += historyRows_ + dirty_.size();
+  }
+  for (int32_t i : dirty_) boats_[i].dirty = false;
+  dirty_.clear();
+  history_.clear();
+  historyRows_ = 0;
+  return w;
+}
@@ -0,0 +1,151 @@
+/*
+  Ingest - ChirpStack uplink events to boat_logs / boat_live_locations rows
+
+  uplink() takes one "up" event as ChirpStack's JSON marshaler writes it
+  (the HTTP integration's body, or an MQTT .../event/up payload) and reads
+  fPort, data and time with jsonBind(); deviceInfo, rxInfo and the rest
+  are skipped unread. Payloads are what BoatNode v2 sends:
+
+    LORAWAN_FPORT  10   a Pkt (boat_pkt.h), the boat's own or one it relayed
+    BACKLOG_FPORT  12   [u16 src][journal body] (boat_journal.h)
+
+  Every boat in reach of a gateway forwards the Pkts it hears, so one
+  report arrives several times; it becomes history once per (src, seq),
+  and the newest per boat is its live row. Journal records are history
+  only. Rows are kept as COPY text until flush() hands them to a sink, so
+  a flush costs one COPY per table and one upsert however many uplinks
+  went into it. Boats are matched by boats.device_id, their mesh id.
+
+  With digestEvery() set, a boat's own report (hops 0: nodes uplink what
+  they heard one hop on, meshUplink() in boat_mesh.h) asks for a nearby
+  digest (boat_digest.h) to go back to the device that sent it, at most
+  that often per boat. The device is the event's deviceInfo.devEui in
+  application deviceInfo.applicationId; takeDigests() hands the requests
+  out and ingestDownlink() makes ChirpStack's MQTT enqueue of the answer.
+  The interval runs from digestSent(): a request that sent nothing (no
+  live row yet, nobody near, MQTT or the database down) is made again by
+  the boat's next report.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+const uint8_t  INGEST_PKT_FPORT     = 10;
+const uint8_t  INGEST_DIGEST_FPORT  = 11;     // downlink
+const uint8_t  INGEST_BACKLOG_FPORT = 12;
+const uint8_t  INGEST_DEDUP         = 32;       // recent seqs and backlog blocks remembered per boat
+const uint32_t INGEST_MAX_ROWS      = 1000000;  // history held while the sink is down
+
+struct IngestStats {
+  uint64_t events = 0;       // uplink() calls
+  uint64_t bad = 0;          // not JSON, no data, bad base64
+  uint64_t otherPort = 0;    // not a port we decode
+  uint64_t badFrame = 0;     // Pkt CRC / length, journal body
+  uint64_t unknownBoat = 0;
+  uint64_t duplicates = 0;   // (src, seq) seen already
+  uint64_t pkts = 0;
+  uint64_t journalRecs = 0;
+  uint64_t dropped = 0;      // history rows over INGEST_MAX_ROWS
+  uint64_t rejected = 0;     // batches the sink refused for their data
+  uint64_t rejectedRows = 0; // history + live rows in those
+  uint64_t historyRows = 0;  // written by flush()
+  uint64_t liveRows = 0;
+  uint64_t flushes = 0;
+  uint64_t digests = 0;      // requested of takeDigests()
+};
+
+// A digest to send: get_nearby_digest() for boats.id boatId, to devEui
+struct IngestDigest {
+  std::string boatId;
+  char devEui[17];
+  char appId[40];
+  int32_t slot = -1;  // Ingest's own, for digestSent()
+};
+
+// Where flush() puts a batch. Both strings are COPY text, one row per line:
+//   history  boat_logs (boat_id, lat, lon, battery_level, speed, heading, recorded_at)
+//   live     boat_live_locations (boat_id, lat, lon, heading, speed, battery_level, last_updated)
+// at most one live row per boat. INGEST_RETRY keeps the batch for the next
+// flush (the sink was unreachable or busy); INGEST_REJECTED means the rows
+// themselves will never go in, and the batch is dropped.
+enum IngestWrite { INGEST_WRITTEN, INGEST_RETRY, INGEST_REJECTED };
+
+class IngestSink {
+public:
+  virtual ~IngestSink() {}
+  virtual IngestWrite write(const std::string &history, size_t historyRows, const std::string &live,
+                            size_t liveRows) = 0;
+};
+
+class Ingest {
+public:
+  Ingest();
+
+  // Mesh id -> boats.id; replaces the previous map, keeps dedup state and pending rows
+  void setBoats(const std::vector<std::pair<uint16_t, std::string>> &boats);
+  // Unknown mesh ids get a made-up boats.id (000...0<id>), for runs without a database
+  void acceptAnyBoat(bool on) { anyBoat_ = on; }
+
+  // At most one digest per boat every secs; 0 (the default) asks for none
+  void digestEvery(uint32_t secs) { digestSecs_ = secs; }
+
+  // One up event; now stands in for a missing or unusable "time" and paces
+  // digests. false: not ingested
+  bool uplink(const char *json, size_t len, time_t now);
+
+  size_t pending() const { return historyRows_ + dirty_.size(); }
+  IngestWrite flush(IngestSink &sink);
+  const IngestStats &stats() const { return st_; }
+  // The digests asked for since the last call
+  void takeDigests(std::vector<IngestDigest> &out);
+  // d went out as a downlink at now; the boat asks for none for digestEvery()
+  void digestSent(const IngestDigest &d, time_t now);
+
+private:
+  // The last INGEST_DEDUP keys; seen() remembers k if it is new
+  struct Recent {
+    uint16_t keys[INGEST_DEDUP];
+    uint8_t n = 0, pos = 0;
+    bool seen(uint16_t k);
+  };
+
+  struct Boat {
+    std::string uuid;
+    Recent seqs, blocks;
+    bool hasLive = false, dirty = false;
+    uint16_t liveSeq;
+    int32_t lat1e7, lon1e7;
+    uint16_t spd_cms, hdg_cdeg;
+    uint8_t batt_pc;
+    char time[40];
+    time_t digestAt = 0;      // last digest sent
+    bool digestAsked = false; // in digests_
+  };
+
+  Boat *boat(uint16_t id, int32_t *slot);
+  void addHistory(const Boat &b, int32_t lat1e7, int32_t lon1e7, uint8_t batt, uint16_t spd, uint16_t hdg,
+                  const char *time);
+  void wantDigest(int32_t slot, const char *deviceInfo, size_t len, time_t now);
+
+  std::vector<int32_t> index_;  // mesh id -> boats_, -1 unknown
+  std::vector<Boat> boats_;
+  std::vector<int32_t> dirty_;  // boats_ with a live row to write
+  std::string history_, live_;
+  size_t historyRows_ = 0;
+  bool anyBoat_ = false;
+  uint32_t digestSecs_ = 0;
+  std::vector<IngestDigest> digests_;
+  IngestStats st_;
+};
+
+// Decodes base64 (standard alphabet, padding optional) into out[cap]; returns the length, -1 if malformed
+int base64Decode(const char *in, size_t len, uint8_t *out, size_t cap);
+std::string base64Encode(const uint8_t *in, size_t len);
+
+// ChirpStack's MQTT enqueue of payload on INGEST_DIGEST_FPORT for d: the
+// topic, application/<app>/device/<devEui>/command/down, and its JSON body
+std::string ingestDownlink(const IngestDigest &d, const std::string &payload, std::string &topic);
@@ -0,0 +1,347 @@
+#include "ingest_io.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+const size_t HTTP_MAX_REQUEST = 64 * 1024;
+const uint16_t MQTT_KEEPALIVE_S = 60;
+const uint32_t MQTT_MAX_BACKOFF_MS = 30000;
+const size_t MQTT_MAX_PACKET = 256 * 1024;
+
+/* ------------ IoLoop ------------- */
+IoLoop::IoLoop() : ep_(epoll_create1(EPOLL_CLOEXEC)) {}
+
+IoLoop::~IoLoop() { ::close(ep_); }
+
+void IoLoop::add(int fd, uint32_t events, IoHandler *h) {
+  if ((size_t)fd >= handlers_.size()) handlers_.resize(fd + 1);
+  handlers_[fd] = h;
+  epoll_event ev = {};
+  ev.events = events;
+  ev.data.fd = fd;
+  epoll_ctl(ep_, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void IoLoop::mod(int fd, uint32_t events) {
+  epoll_event ev = {};
+  ev.events = events;
+  ev.data.fd = fd;
+  epoll_ctl(ep_, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void IoLoop::del(int fd) {
+  epoll_ctl(ep_, EPOLL_CTL_DEL, fd, NULL);
+  if ((size_t)fd < handlers_.size()) handlers_[fd] = nullptr;
+}
+
+bool IoLoop::poll(int timeoutMs) {
+  epoll_event evs[64];
+  int n = epoll_wait(ep_, evs, 64, timeoutMs);
+  if (n < 0) return errno == EINTR;
+  for (int i = 0; i < n; i++) {
+    int fd = evs[i].data.fd;
+    // A handler can close fds further down the list
+    if ((size_t)fd < handlers_.size() && handlers_[fd]) handlers_[fd]->ready(fd, evs[i].events);
+  }
+  return true;
+}
+
+static void setNonBlocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); }
+
+/* ------------ HttpSource ------------- */
+HttpSource::~HttpSource() {
+  for (size_t fd = 0; fd < conns_.size(); fd++)
+    if (conns_[fd]) drop(fd);
+  if (lfd_ >= 0) { loop_.del(lfd_); ::close(lfd_); }
+}
+
+bool HttpSource::listen(uint16_t port) {
+  lfd_ = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int one = 1, zero = 0;
+  setsockopt(lfd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  setsockopt(lfd_, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+  sockaddr_in6 a = {};
+  a.sin6_family = AF_INET6;
+  a.sin6_addr = in6addr_any;
+  a.sin6_port = htons(port);
+  if (lfd_ < 0 || bind(lfd_, (sockaddr *)&a, sizeof(a)) || ::listen(lfd_, 512)) {
+    perror("[http] listen");
+    return false;
+  }
+  loop_.add(lfd_, EPOLLIN, this);
+  return true;
+}
+
+void HttpSource::accept() {
+  for (;;) {
+    int fd = accept4(lfd_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if ((size_t)fd >= conns_.size()) conns_.resize(fd + 1);
+    conns_[fd] = new Conn;
+    loop_.add(fd, EPOLLIN | EPOLLRDHUP, this);
+  }
+}
+
+void HttpSource::drop(int fd) {
+  loop_.del(fd);
+  ::close(fd);
+  delete conns_[fd];
+  conns_[fd] = nullptr;
+}
+
+void HttpSource::ready(int fd, uint32_t events) {
+  if (fd == lfd_) { accept(); return; }
+  Conn &c = *conns_[fd];
+  if (events & EPOLLOUT) {
+    flushOut(fd, c);
+    if (!conns_[fd]) return;
+  }
+  if (!(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) return;
+  char buf[16384];
+  for (;;) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n > 0) { c.in.append(buf, n); continue; }
+    if (n < 0 && errno == EAGAIN) break;
+    drop(fd);  // EOF or error; a half-read request is lost with it
+    return;
+  }
+  serve(fd, c);
+}
+
+// Answers every complete request in c.in, pipelined ones included
+void HttpSource::serve(int fd, Conn &c) {
+  size_t pos = 0;
+  while (!c.close) {
+    size_t hdrEnd = c.in.find("\r\n\r\n", pos);
+    if (hdrEnd == std::string::npos) {
+      if (c.in.size() - pos > HTTP_MAX_REQUEST) {
+        c.out += "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        c.close = true;
+      }
+      break;
+    }
+    const char *h = c.in.data() + pos, *he = c.in.data() + hdrEnd;
+    const char *lineEnd = (const char *)memchr(h, '\r', he - h + 1);
+    size_t clen = 0;
+    bool chunked = false;
+    for (const char *l = lineEnd + 2; l < he;) {
+      const char *le = (const char *)memchr(l, '\r', he - l + 1);
+      std::string v(l, le - l);
+      if (!strncasecmp(l, "content-length:", 15)) clen = strtoul(v.c_str() + 15, NULL, 10);
+      else if (!strncasecmp(l, "transfer-encoding:", 18)) chunked = true;
+      else if (!strncasecmp(l, "connection:", 11) && strcasestr(v.c_str() + 11, "close")) c.close = true;
+      l = le + 2;
+    }
+    if (chunked || clen > HTTP_MAX_REQUEST) {
+      c.out += chunked ? "HTTP/1.1 411 Length Required\r\n" : "HTTP/1.1 413 Payload Too Large\r\n";
+      c.out += "Content-Length: 0\r\nConnection: close\r\n\r\n";
+      c.close = true;
+      break;
+    }
+    size_t bodyAt = hdrEnd + 4;
+    if (c.in.size() - bodyAt < clen) break;
+
+    requests_++;
+    std::string line(h, lineEnd - h);
+    size_t q = line.find('?');
+    bool up = !line.compare(0, 5, "POST ") && q != std::string::npos && line.find("event=up", q) != std::string::npos;
+    if (up) fn_(ctx_, c.in.data() + bodyAt, clen);
+    c.out += c.close ? "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+                     : "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+    pos = bodyAt + clen;
+  }
+  c.in.erase(0, pos);
+  flushOut(fd, c);
+}
+
+void HttpSource::flushOut(int fd, Conn &c) {
+  while (!c.out.empty()) {
+    ssize_t n = ::write(fd, c.out.data(), c.out.size());
+    if (n < 0 && errno == EAGAIN) {
+      loop_.mod(fd, EPOLLIN | EPOLLRDHUP | EPOLLOUT);
+      return;
+    }
+    if (n <= 0) { drop(fd); return; }
+    c.out.erase(0, n);
+  }
+  if (c.close) { drop(fd); return; }
+  loop_.mod(fd, EPOLLIN | EPOLLRDHUP);
+}
+
+/* ------------ MqttSource ------------- */
+static void putStr(std::string &s, const std::string &v) {
+  s += (char)(v.size() >> 8);
+  s += (char)(v.size() & 0xFF);
+  s += v;
+}
+
+// Fixed header with the remaining-length varint
+static std::string packet(uint8_t hdr, const std::string &body) {
+  std::string s(1, (char)hdr);
+  size_t n = body.size();
+  do {
+    uint8_t b = n % 128;
+    n /= 128;
+    s += (char)(n ? b | 0x80 : b);
+  } while (n);
+  return s + body;
+}
+
+MqttSource::~MqttSource() { close(); }
+
+void MqttSource::configure(const char *host, uint16_t port, const char *topic, const char *user, const char *pass) {
+  host_ = host;
+  port_ = port;
+  topic_ = topic;
+  user_ = user ? user : "";
+  pass_ = pass ? pass : "";
+}
+
+bool MqttSource::open() {
+  addrinfo hints = {}, *res;
+  hints.ai_socktype = SOCK_STREAM;
+  char port[8];
+  snprintf(port, sizeof(port), "%u", port_);
+  if (getaddrinfo(host_.c_str(), port, &hints, &res)) return false;
+  for (addrinfo *a = res; a && fd_ < 0; a = a->ai_next) {
+    fd_ = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+    if (fd_ >= 0 && ::connect(fd_, a->ai_addr, a->ai_addrlen)) { ::close(fd_); fd_ = -1; }
+  }
+  freeaddrinfo(res);
+  if (fd_ < 0) return false;
+  setNonBlocking(fd_);
+  loop_.add(fd_, EPOLLIN | EPOLLRDHUP, this);
+
+  char id[32];
+  snprintf(id, sizeof(id), "boat-ingest-%d", (int)getpid());
+  std::string b;
+  putStr(b, "MQTT");
+  b += (char)4;  // 3.1.1
+  b += (char)(0x02 | (user_.empty() ? 0 : 0x80) | (pass_.empty() ? 0 : 0x40));  // clean session
+  b += (char)(MQTT_KEEPALIVE_S >> 8);
+  b += (char)(MQTT_KEEPALIVE_S & 0xFF);
+  putStr(b, id);
+  if (!user_.empty()) putStr(b, user_);
+  if (!pass_.empty()) putStr(b, pass_);
+  send(packet(0x10, b));
+  return true;
+}
+
+void MqttSource::close() {
+  if (fd_ < 0) return;
+  loop_.del(fd_);
+  ::close(fd_);
+  fd_ = -1;
+  up_ = false;
+  in_.clear();
+}
+
+void MqttSource::send(const std::string &pkt) {
+  // Control packets and downlinks, a few hundred bytes: the socket buffer takes them whole
+  if (fd_ >= 0 && ::write(fd_, pkt.data(), pkt.size()) != (ssize_t)pkt.size()) close();
+}
+
+void MqttSource::tick(uint32_t nowMs) {
+  if (host_.empty()) return;
+  if (fd_ < 0) {
+    if ((int32_t)(nowMs - retryAtMs_) < 0) return;
+    if (open()) { lastTxMs_ = nowMs; return; }
+    fprintf(stderr, "[mqtt] cannot reach %s:%u, retry in %u s\n", host_.c_str(), port_, backoffMs_ / 1000);
+    retryAtMs_ = nowMs + backoffMs_;
+    backoffMs_ = backoffMs_ * 2 > MQTT_MAX_BACKOFF_MS ? MQTT_MAX_BACKOFF_MS : backoffMs_ * 2;
+    return;
+  }
+  if (nowMs - lastTxMs_ >= MQTT_KEEPALIVE_S * 500u) {
+    send(std::string("\xC0\x00", 2));  // PINGREQ
+    lastTxMs_ = nowMs;
+  }
+}
+
+bool MqttSource::publish(const std::string &topic, const std::string &payload) {
+  if (!up_) return false;
+  std::string b;
+  putStr(b, topic);
+  send(packet(0x30, b + payload));
+  return fd_ >= 0;
+}
+
+void MqttSource::ready(int fd, uint32_t events) {
+  char buf[16384];
+  for (;;) {
+    ssize_t n = read(fd_, buf, sizeof(buf));
+    if (n > 0) { in_.append(buf, n); continue; }
+    if (n < 0 && errno == EAGAIN) break;
+    fprintf(stderr, "[mqtt] connection lost\n");
+    close();
+    return;
+  }
+  size_t pos = 0;
+  while (in_.size() - pos >= 2) {
+    const uint8_t *p = (const uint8_t *)in_.data() + pos, *end = (const uint8_t *)in_.data() + in_.size();
+    size_t len = 0, i = 1;
+    bool done = false;
+    while (!done && i < 5 && p + i < end) {
+      len |= (size_t)(p[i] & 0x7F) << (7 * (i - 1));
+      done = !(p[i++] & 0x80);
+    }
+    if (!done) {
+      if (i == 5) { close(); return; }  // malformed length
+      break;
+    }
+    if (len > MQTT_MAX_PACKET) { close(); return; }
+    if ((size_t)(end - p) < i + len) break;
+    handle(p[0], p + i, len);
+    if (fd_ < 0) return;
+    pos += i + len;
+  }
+  in_.erase(0, pos);
+}
+
+void MqttSource::handle(uint8_t type, const uint8_t *p, size_t len) {
+  switch (type >> 4) {
+    case 2:  // CONNACK
+      if (len < 2 || p[1]) {
+        fprintf(stderr, "[mqtt] refused, code %u\n", len < 2 ? 255 : p[1]);
+        close();
+        return;
+      }
+      {
+        std::string b("\x00\x01", 2);  // packet id 1
+        putStr(b, topic_);
+        b += (char)0;  // QoS 0
+        send(packet(0x82, b));
+      }
+      if (fd_ < 0) return;
+      up_ = true;
+      backoffMs_ = 1000;
+      fprintf(stderr, "[mqtt] connected to %s:%u, %s\n", host_.c_str(), port_, topic_.c_str());
+      break;
+    case 3: {  // PUBLISH
+      if (len < 2) return;
+      size_t tl = p[0] << 8 | p[1], off = 2 + tl;
+      uint8_t qos = (type >> 1) & 3;
+      if (qos) off += 2;
+      if (off > len) return;
+      if (qos == 1) send(packet(0x40, std::string((const char *)p + 2 + tl, 2)));  // PUBACK
+      std::string topic((const char *)p + 2, tl);
+      if (topic.size() >= 9 && !topic.compare(topic.size() - 9, 9, "/event/up")) {
+        messages_++;
+        fn_(ctx_, (const char *)p + off, len - off);
+      }
+      break;
+    }
+    default:  // SUBACK, PINGRESP
+      break;
+  }
+}
@@ -0,0 +1,103 @@
+/*
+  Where boat_ingest's uplink events come from, all on one epoll loop
+
+  HttpSource  ChirpStack's HTTP integration (marshaler JSON): it POSTs
+              every event to the configured URL with ?event=<type>. "up"
+              bodies go to the callback, every request is answered 200.
+              HTTP/1.1 with keep-alive, Content-Length bodies only.
+  MqttSource  MQTT 3.1.1 subscriber for the integration topic,
+              application/+/device/+/event/up by default, QoS 0. Reconnects
+              from tick() with backoff and keeps the session alive.
+              publish() sends on the same session, for downlinks.
+
+  Protobuf-marshalled events are not decoded; set the integration to JSON.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+typedef void (*UplinkFn)(void *ctx, const char *json, size_t len);
+
+class IoHandler {
+public:
+  virtual ~IoHandler() {}
+  virtual void ready(int fd, uint32_t events) = 0;
+};
+
+class IoLoop {
+public:
+  IoLoop();
+  ~IoLoop();
+  void add(int fd, uint32_t events, IoHandler *h);
+  void mod(int fd, uint32_t events);
+  void del(int fd);
+  // Handles what is ready within timeoutMs; false on an epoll error
+  bool poll(int timeoutMs);
+
+private:
+  int ep_;
+  std::vector<IoHandler *> handlers_;  // by fd
+};
+
+class HttpSource : public IoHandler {
+public:
+  HttpSource(IoLoop &loop, UplinkFn fn, void *ctx) : loop_(loop), fn_(fn), ctx_(ctx) {}
+  ~HttpSource();
+  bool listen(uint16_t port);
+  void ready(int fd, uint32_t events) override;
+
+  uint64_t requests() const { return requests_; }
+
+private:
+  struct Conn {
+    std::string in, out;
+    bool close = false;
+  };
+  void accept();
+  void serve(int fd, Conn &c);
+  void flushOut(int fd, Conn &c);
+  void drop(int fd);
+
+  IoLoop &loop_;
+  UplinkFn fn_;
+  void *ctx_;
+  int lfd_ = -1;
+  std::vector<Conn *> conns_;  // by fd
+  uint64_t requests_ = 0;
+};
+
+class MqttSource : public IoHandler {
+public:
+  MqttSource(IoLoop &loop, UplinkFn fn, void *ctx) : loop_(loop), fn_(fn), ctx_(ctx) {}
+  ~MqttSource();
+  void configure(const char *host, uint16_t port, const char *topic, const char *user, const char *pass);
+  // Connects, reconnects and pings as due; call at least once a second
+  void tick(uint32_t nowMs);
+  void ready(int fd, uint32_t events) override;
+
+  // QoS 0; false while not connected
+  bool publish(const std::string &topic, const std::string &payload);
+
+  bool connected() const { return up_; }
+  uint64_t messages() const { return messages_; }
+
+private:
+  bool open();
+  void close();
+  void send(const std::string &pkt);
+  void handle(uint8_t type, const uint8_t *p, size_t len);
+
+  IoLoop &loop_;
+  UplinkFn fn_;
+  void *ctx_;
+  std::string host_, topic_, user_, pass_;
+  uint16_t port_ = 1883;
+  int fd_ = -1;
+  bool up_ = false;
+  std::string in_;
+  uint32_t retryAtMs_ = 0, backoffMs_ = 1000, lastTxMs_ = 0;
+  uint64_t messages_ = 0;
+};
@@ -0,0 +1,252 @@
+/*
+  boat_ingest - ChirpStack uplinks into the database in batches
+
+    boat_ingest [-l http_port] [-m host[:port]] [-t topic] [-U user] [-P pass]
+                [-f events|-] [-r repeat] [-d conninfo | -n]
+                [-w window_ms] [-b batch_rows] [-g digest_s]
+
+  Takes up events from ChirpStack's HTTP integration (-l) and/or its MQTT
+  integration (-m, topic -t), or from a file of newline-delimited events
+  (-f, '-' for stdin: a capture, or the local stand-in for both), decodes
+  them with Ingest (ingest.h) and writes them through PgSink (pg_sink.h)
+  to the database given by -d, a libpq conninfo (absent: the PG*
+  environment). A batch goes out once it holds -b history rows (default
+  5000), else every -w ms (default 1000), which is also how long live rows
+  are coalesced. -n writes nowhere and takes any boat, to time the decode
+  path on its own.
+
+  With -m and a database, a boat's own reports are answered with a nearby
+  digest on FPort 11 (boat_digest.h), published to ChirpStack's
+  .../command/down topic for the device they came from, at most every -g
+  seconds per boat (default 600, 0 for none). ChirpStack queues it for the
+  node's next receive window. The HTTP integration has no downlink path.
+
+  With -f the run ends with the input (-r times over) and prints the rate;
+  otherwise a stats line every 10 s until SIGINT / SIGTERM, which flush
+  what is pending first.
+*/
+#include "ingest.h"
+#include "ingest_io.h"
+#include "pg_sink.h"
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+const uint32_t BOATS_REFRESH_MS = 60000;
+const uint32_t STATS_MS = 10000;
+
+class NullSink : public IngestSink {
+public:
+  IngestWrite write(const std::string &history, size_t historyRows, const std::string &live, size_t liveRows) override {
+    bytes += history.size() + live.size();
+    return INGEST_WRITTEN;
+  }
+  uint64_t bytes = 0;
+};
+
+static volatile sig_atomic_t stopping = 0;
+static void onSignal(int) { stopping = 1; }
+
+static uint32_t nowMs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static double cpuSec() {
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Ingest ingest;
+static time_t wallNow;
+
+static void onUplink(void *, const char *json, size_t len) { ingest.uplink(json, len, wallNow); }
+
+// Only a digest that went out starts the boat's -g interval; the rest are
+// asked for again by its next report
+static void sendDigests(PgSink &pg, MqttSource &mq, uint64_t &sent) {
+  static std::vector<IngestDigest> due;
+  ingest.takeDigests(due);
+  std::string payload, topic;
+  for (const IngestDigest &d : due) {
+    if (!mq.connected()) break;
+    if (!pg.nearbyDigest(d.boatId, payload)) {
+      fprintf(stderr, "[ingest] cannot read digest: %s\n", pg.error());
+      break;
+    }
+    if (payload.size() <= 2) continue;  // nobody near
+    std::string body = ingestDownlink(d, payload, topic);
+    if (mq.publish(topic, body)) {
+      ingest.digestSent(d, wallNow);
+      sent++;
+    }
+  }
+}
+
+// false while the sink cannot take batches; a rejected batch is gone, not retried
+static bool flush(IngestSink &sink, PgSink *pg) {
+  static bool failing = false;
+  size_t rows = ingest.pending();
+  IngestWrite w = ingest.flush(sink);
+  bool ok = w != INGEST_RETRY;
+  if (w == INGEST_REJECTED)
+    fprintf(stderr, "[ingest] batch rejected, dropped %zu rows: SQLSTATE %s: %s\n", rows, pg ? pg->sqlState() : "",
+            pg ? pg->error() : "");
+  if (!ok && !failing) fprintf(stderr, "[ingest] write failed, holding %zu rows: %s\n", ingest.pending(), pg ? pg->error() : "");
+  if (ok && failing) fprintf(stderr, "[ingest] writing again\n");
+  failing = !ok;
+  return ok;
+}
+
+static bool loadBoats(PgSink &pg) {
+  std::vector<std::pair<uint16_t, std::string>> boats;
+  if (!pg.loadBoats(boats)) {
+    fprintf(stderr, "[ingest] cannot read boats: %s\n", pg.error());
+    return false;
+  }
+  ingest.setBoats(boats);
+  return true;
+}
+
+static bool readAll(const char *path, std::string &out) {
+  FILE *f = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+  if (!f) return false;
+  char buf[65536];
+  for (size_t n; (n = fread(buf, 1, sizeof(buf), f));) out.append(buf, n);
+  if (f != stdin) fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int httpPort = 0, repeat = 1;
+  uint32_t windowMs = 1000, batchRows = 5000, digestS = 600;
+  const char *mqtt = NULL, *topic = "application/+/device/+/event/up", *user = NULL, *pass = NULL;
+  const char *file = NULL, *conninfo = "";
+  bool dry = false;
+  for (int c; (c = getopt(argc, argv, "l:m:t:U:P:f:r:d:nw:b:g:")) != -1;) {
+    switch (c) {
+      case 'l': httpPort = atoi(optarg); break;
+      case 'm': mqtt = optarg; break;
+      case 't': topic = optarg; break;
+      case 'U': user = optarg; break;
+      case 'P': pass = optarg; break;
+      case 'f': file = optarg; break;
+      case 'r': repeat = atoi(optarg); break;
+      case 'd': conninfo = optarg; break;
+      case 'n': dry = true; break;
+      case 'w': windowMs = atoi(optarg); break;
+      case 'b': batchRows = atoi(optarg); break;
+      case 'g': digestS = atoi(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-l http_port] [-m host[:port]] [-t topic] [-U user] [-P pass]\n"
+                        "       [-f events|-] [-r repeat] [-d conninfo | -n] [-w window_ms] [-b batch_rows]\n"
+                        "       [-g digest_s]\n", argv[0]);
+        return 2;
+    }
+  }
+  if ((!file && !httpPort && !mqtt) || (file && (httpPort || mqtt)) || httpPort < 0 || httpPort > 65535 ||
+      repeat < 1 || !windowMs || !batchRows) {
+    fprintf(stderr, "bad arguments: one of -f, or -l and/or -m\n");
+    return 2;
+  }
+
+  NullSink null;
+  PgSink *pg = dry ? NULL : new PgSink(conninfo);
+  IngestSink &sink = pg ? (IngestSink &)*pg : null;
+  if (dry) ingest.acceptAnyBoat(true);
+  else if (!loadBoats(*pg)) return 1;
+  if (pg && mqtt) ingest.digestEvery(digestS);
+  wallNow = time(NULL);
+
+  if (file) {
+    std::string in;
+    if (!readAll(file, in)) { perror(file); return 1; }
+    double c0 = cpuSec();
+    uint32_t t0 = nowMs();
+    for (int r = 0; r < repeat; r++) {
+      for (size_t pos = 0; pos < in.size();) {
+        size_t end = in.find('\n', pos);
+        if (end == std::string::npos) end = in.size();
+        if (end > pos) ingest.uplink(in.data() + pos, end - pos, wallNow);
+        pos = end + 1;
+        if (ingest.pending() >= batchRows && !flush(sink, pg)) return 1;
+      }
+    }
+    if (!flush(sink, pg)) return 1;
+    double wall = (nowMs() - t0) / 1000.0, cpu = cpuSec() - c0;
+    const IngestStats &s = ingest.stats();
+    printf("[ingest] %llu events in %.3f s (%.3f s cpu): %.0f events/s\n", (unsigned long long)s.events, wall, cpu,
+           cpu > 0 ? s.events / cpu : 0);
+    printf("[ingest] %llu pkts + %llu journal records -> %llu history rows, %llu live rows in %llu flushes\n",
+           (unsigned long long)s.pkts, (unsigned long long)s.journalRecs, (unsigned long long)s.historyRows,
+           (unsigned long long)s.liveRows, (unsigned long long)s.flushes);
+    printf("[ingest] skipped: %llu duplicates, %llu unknown boats, %llu bad frames, %llu other ports, %llu bad events, "
+           "%llu dropped, %llu rows in %llu rejected batches\n", (unsigned long long)s.duplicates,
+           (unsigned long long)s.unknownBoat, (unsigned long long)s.badFrame, (unsigned long long)s.otherPort,
+           (unsigned long long)s.bad, (unsigned long long)s.dropped, (unsigned long long)s.rejectedRows,
+           (unsigned long long)s.rejected);
+    return 0;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+  IoLoop loop;
+  HttpSource http(loop, onUplink, NULL);
+  MqttSource mq(loop, onUplink, NULL);
+  if (httpPort && !http.listen(httpPort)) return 1;
+  if (mqtt) {
+    std::string host(mqtt);
+    uint16_t port = 1883;
+    size_t colon = host.rfind(':');
+    if (colon != std::string::npos && host.find(':') == colon) {
+      port = atoi(host.c_str() + colon + 1);
+      host.resize(colon);
+    }
+    mq.configure(host.c_str(), port, topic, user, pass);
+  }
+  if (httpPort) fprintf(stderr, "[http] listening on %d\n", httpPort);
+
+  uint32_t lastFlush = nowMs(), lastBoats = lastFlush, lastStats = lastFlush;
+  IngestStats prev = ingest.stats();
+  uint64_t digests = 0, prevDigests = 0;
+  while (!stopping) {
+    wallNow = time(NULL);
+    uint32_t now = nowMs();
+    mq.tick(now);
+    if (!loop.poll(100)) { perror("epoll"); break; }
+    now = nowMs();
+    if (ingest.pending() >= batchRows || (ingest.pending() && now - lastFlush >= windowMs)) {
+      flush(sink, pg);
+      lastFlush = now;
+    }
+    if (pg && mqtt) sendDigests(*pg, mq, digests);
+    if (pg && now - lastBoats >= BOATS_REFRESH_MS) {
+      loadBoats(*pg);
+      lastBoats = now;
+    }
+    if (now - lastStats >= STATS_MS) {
+      const IngestStats &s = ingest.stats();
+      double dt = (now - lastStats) / 1000.0;
+      fprintf(stderr, "[ingest] %.0f events/s, %llu history, %llu live, %llu dup, %llu unknown, %llu bad, "
+              "%llu rejected, %llu digests, %zu pending\n",
+              (s.events - prev.events) / dt, (unsigned long long)(s.historyRows - prev.historyRows),
+              (unsigned long long)(s.liveRows - prev.liveRows), (unsigned long long)(s.duplicates - prev.duplicates),
+              (unsigned long long)(s.unknownBoat - prev.unknownBoat),
+              (unsigned long long)(s.bad + s.badFrame - prev.bad - prev.badFrame),
+              (unsigned long long)(s.rejectedRows - prev.rejectedRows), (unsigned long long)(digests - prevDigests),
+              ingest.pending());
+      prev = s;
+      prevDigests = digests;
+      lastStats = now;
+    }
+  }
+  flush(sink, pg);
+  delete pg;
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include "pg_sink.h"
+#include <libpq-fe.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *LIVE_COLS = "(boat_id, lat, lon, heading, speed, battery_level, last_updated)";
+
+PgSink::~PgSink() {
+  if (conn_) PQfinish(conn_);
+}
+
+IngestWrite pgClassify(const char *s) {
+  if (!s || strlen(s) != 5) return INGEST_RETRY;
+  return !strncmp(s, "22", 2) || !strncmp(s, "23", 2) ? INGEST_REJECTED : INGEST_RETRY;
+}
+
+// r, if any, is the failed result: it has the SQLSTATE
+void PgSink::fail(PGresult *r) {
+  const char *s = r ? PQresultErrorField(r, PG_DIAG_SQLSTATE) : NULL;
+  state_ = s ? s : "";
+  err_ = conn_ ? PQerrorMessage(conn_) : "no connection";
+  while (!err_.empty() && err_.back() == '\n') err_.pop_back();
+  if (conn_ && PQstatus(conn_) != CONNECTION_OK) {
+    PQfinish(conn_);
+    conn_ = nullptr;
+  }
+}
+
+bool PgSink::connect() {
+  if (conn_) return true;
+  conn_ = PQconnectdb(conninfo_.c_str());
+  if (PQstatus(conn_) != CONNECTION_OK) { fail(NULL); return false; }
+  return exec("create temp table if not exists ingest_live as "
+              "select boat_id, lat, lon, heading, speed, battery_level, last_updated "
+              "from public.boat_live_locations with no data");
+}
+
+bool PgSink::exec(const char *sql) {
+  PGresult *r = PQexec(conn_, sql);
+  ExecStatusType st = PQresultStatus(r);
+  bool ok = st == PGRES_COMMAND_OK || st == PGRES_TUPLES_OK;
+  if (!ok) fail(r);
+  PQclear(r);
+  return ok;
+}
+
+bool PgSink::copy(const char *sql, const std::string &data) {
+  PGresult *r = PQexec(conn_, sql);
+  if (PQresultStatus(r) != PGRES_COPY_IN) { fail(r); PQclear(r); return false; }
+  PQclear(r);
+  bool ok = PQputCopyData(conn_, data.data(), (int)data.size()) == 1;
+  if (PQputCopyEnd(conn_, ok ? NULL : "ingest: put failed") != 1) ok = false;
+  if (!ok) fail(NULL);
+  while ((r = PQgetResult(conn_))) {
+    if (PQresultStatus(r) != PGRES_COMMAND_OK && ok) { ok = false; fail(r); }
+    PQclear(r);
+  }
+  return ok;
+}
+
+IngestWrite PgSink::write(const std::string &history, size_t historyRows, const std::string &live, size_t liveRows) {
+  if (!connect()) return INGEST_RETRY;
+  std::string upsert = std::string("insert into public.boat_live_locations ") + LIVE_COLS +
+    " select boat_id, lat, lon, heading, speed, battery_level, last_updated from ingest_live"
+    " on conflict (boat_id) do update set lat = excluded.lat, lon = excluded.lon,"
+    " heading = excluded.heading, speed = excluded.speed, battery_level = excluded.battery_level,"
+    " last_updated = excluded.last_updated"
+    " where boat_live_locations.last_updated is null"
+    " or boat_live_locations.last_updated <= excluded.last_updated";
+  std::string copyLive = std::string("copy ingest_live ") + LIVE_COLS + " from stdin";
+  bool ok = exec("begin") &&
+            (!historyRows || copy("copy public.boat_logs (boat_id, lat, lon, battery_level, speed, heading, recorded_at)"
+                                  " from stdin", history)) &&
+            (!liveRows || (copy(copyLive.c_str(), live) && exec(upsert.c_str()) && exec("truncate ingest_live"))) &&
+            exec("commit");
+  if (ok) return INGEST_WRITTEN;
+  IngestWrite w = pgClassify(state_.c_str());
+  if (conn_) {
+    std::string e = err_, s = state_;
+    exec("rollback");
+    err_ = e;
+    state_ = s;
+  }
+  return w;
+}
+
+bool PgSink::loadBoats(std::vector<std::pair<uint16_t, std::string>> &out) {
+  if (!connect()) return false;
+  PGresult *r = PQexec(conn_, "select mesh_id, id::text from (select id, case when device_id ~ '^[0-9]{1,5}$'"
+                              " then device_id::int end as mesh_id from public.boats) b"
+                              " where mesh_id between 1 and 65535");
+  if (PQresultStatus(r) != PGRES_TUPLES_OK) {
+    fail(r);
+    PQclear(r);
+    return false;
+  }
+  out.clear();
+  for (int i = 0; i < PQntuples(r); i++)
+    out.emplace_back((uint16_t)atoi(PQgetvalue(r, i, 0)), PQgetvalue(r, i, 1));
+  PQclear(r);
+  return true;
+}
+
+bool PgSink::nearbyDigest(const std::string &boatId, std::string &out) {
+  if (!connect()) return false;
+  const char *v[1] = {boatId.c_str()};
+  PGresult *r = PQexecParams(conn_, "select public.get_nearby_digest(device_id) from public.boats where id = $1::uuid",
+                             1, NULL, v, NULL, NULL, 1);  // binary: the bytea as it is
+  if (PQresultStatus(r) != PGRES_TUPLES_OK) {
+    fail(r);
+    PQclear(r);
+    return false;
+  }
+  out.clear();
+  if (PQntuples(r) == 1 && !PQgetisnull(r, 0, 0)) out.assign(PQgetvalue(r, 0, 0), PQgetlength(r, 0, 0));
+  PQclear(r);
+  return true;
+}
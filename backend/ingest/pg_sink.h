@@ -0,0 +1,56 @@
+/*
+  PgSink - Ingest batches into Postgres over libpq
+
+  A flush is one transaction:
+
+    COPY public.boat_logs (...) FROM STDIN
+    COPY ingest_live FROM STDIN                     (session temp table)
+    INSERT INTO public.boat_live_locations SELECT ... FROM ingest_live
+      ON CONFLICT (boat_id) DO UPDATE ... unless the stored row is newer
+    TRUNCATE ingest_live
+
+  so history costs one round trip per batch instead of one per row, and a
+  boat's live row is written once per flush however many reports it sent.
+  Connect as a role that bypasses RLS (Supabase's service role or the
+  database owner). conninfo is a libpq string; "" takes the PG* environment
+  variables. After a failure the next call reconnects.
+
+  A failed batch is INGEST_REJECTED when its SQLSTATE says the data is at
+  fault, classes 22 (data exception, e.g. a value out of range) and 23
+  (integrity constraint, e.g. a boat deleted since the last boats load):
+  the same rows would fail again however often they were sent. Anything
+  else, the connection above all, is INGEST_RETRY.
+*/
+#pragma once
+
+#include "ingest.h"
+
+typedef struct pg_conn PGconn;
+typedef struct pg_result PGresult;
+
+// What a failure with this SQLSTATE means for the batch
+IngestWrite pgClassify(const char *sqlstate);
+
+class PgSink : public IngestSink {
+public:
+  explicit PgSink(const char *conninfo) : conninfo_(conninfo) {}
+  ~PgSink();
+
+  IngestWrite write(const std::string &history, size_t historyRows, const std::string &live, size_t liveRows) override;
+
+  // boats.device_id -> boats.id for the ids a node can send (1..65535)
+  bool loadBoats(std::vector<std::pair<uint16_t, std::string>> &out);
+  // get_nearby_digest() (schema v10) for boats.id boatId; out is empty if it has none
+  bool nearbyDigest(const std::string &boatId, std::string &out);
+  const char *error() const { return err_.c_str(); }
+  const char *sqlState() const { return state_.c_str(); }  // of the last failure, "" if there was none
+
+private:
+  bool connect();
+  bool exec(const char *sql);
+  bool copy(const char *sql, const std::string &data);
+  void fail(PGresult *r);
+
+  std::string conninfo_, err_, state_;
+  PGconn *conn_ = nullptr;
+};
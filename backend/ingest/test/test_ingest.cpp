@@ -0,0 +1,130 @@
+// Ingest: uplink decoding, dedup, and what flush() does with each sink answer
+#include "host_test.h"
+#include "ingest.h"
+#include "pg_sink.h"
+#include <boat_pkt.h>
+#include <string.h>
+
+class FakeSink : public IngestSink {
+public:
+  IngestWrite write(const std::string &history, size_t historyRows, const std::string &live, size_t liveRows) override {
+    calls++;
+    if (answer == INGEST_WRITTEN) { rows += historyRows; liveTotal += liveRows; }
+    return answer;
+  }
+  IngestWrite answer = INGEST_WRITTEN;
+  int calls = 0;
+  size_t rows = 0, liveTotal = 0;
+};
+
+static bool report(Ingest &in, uint16_t src, uint16_t seq, uint8_t hops = 0, time_t now = 1000,
+                   const char *devEui = "0102030405060708") {
+  NavState s = {};
+  s.valid = true;
+  s.lat1e7 = 95000000 + seq;
+  s.lon1e7 = 763000000;
+  Pkt p;
+  pktBuild(p, src, seq, s, 80, src, "Boat");
+  p.hops = hops;
+  pktSign(p);
+  std::string ev = std::string("{\"deviceInfo\":{\"applicationId\":\"5c1e0000-aaaa-bbbb-cccc-0123456789ab\",") +
+                   "\"devEui\":\"" + devEui + "\",\"tags\":{}},\"fPort\":10,\"data\":\"" +
+                   base64Encode((const uint8_t *)&p, sizeof(p)) + "\",\"time\":\"2026-10-18T10:00:00Z\"}";
+  return in.uplink(ev.data(), ev.size(), now);
+}
+
+int main() {
+  // Data errors are final, everything else is worth another try
+  CHECK_EQ(pgClassify("23503"), INGEST_REJECTED);  // foreign key: boat deleted
+  CHECK_EQ(pgClassify("22003"), INGEST_REJECTED);  // numeric out of range
+  CHECK_EQ(pgClassify("08006"), INGEST_RETRY);     // connection failure
+  CHECK_EQ(pgClassify("40001"), INGEST_RETRY);     // serialization failure
+  CHECK_EQ(pgClassify("57P01"), INGEST_RETRY);     // admin shutdown
+  CHECK_EQ(pgClassify(""), INGEST_RETRY);
+  CHECK_EQ(pgClassify(NULL), INGEST_RETRY);
+
+  Ingest in;
+  in.setBoats({{7, "11111111-1111-1111-1111-111111111111"}, {8, "22222222-2222-2222-2222-222222222222"}});
+  CHECK(report(in, 7, 1));
+  CHECK(!report(in, 7, 1));  // the same report through a second gateway
+  CHECK(report(in, 8, 1));
+  CHECK(!report(in, 9, 1));  // not a known boat
+  CHECK_EQ(in.stats().duplicates, 1);
+  CHECK_EQ(in.stats().unknownBoat, 1);
+  CHECK_EQ(in.pending(), 4);  // two history rows, two live rows
+
+  // Retry keeps the batch, and what arrives meanwhile joins it
+  FakeSink sink;
+  sink.answer = INGEST_RETRY;
+  CHECK_EQ(in.flush(sink), INGEST_RETRY);
+  CHECK_EQ(in.pending(), 4);
+  CHECK(report(in, 7, 2));
+  CHECK_EQ(in.pending(), 5);
+
+  // Rejected: the batch is dropped and counted, not sent again
+  sink.answer = INGEST_REJECTED;
+  CHECK_EQ(in.flush(sink), INGEST_REJECTED);
+  CHECK_EQ(in.pending(), 0);
+  CHECK_EQ(in.stats().rejected, 1);
+  CHECK_EQ(in.stats().rejectedRows, 5);
+  CHECK_EQ(in.stats().flushes, 0);
+  CHECK_EQ(in.flush(sink), INGEST_WRITTEN);  // nothing left to write
+  CHECK_EQ(sink.calls, 2);
+
+  // And the next batch goes through normally
+  sink.answer = INGEST_WRITTEN;
+  CHECK(report(in, 7, 3));
+  CHECK(report(in, 8, 2));
+  CHECK_EQ(in.flush(sink), INGEST_WRITTEN);
+  CHECK_EQ(sink.rows, 2);
+  CHECK_EQ(sink.liveTotal, 2);
+  CHECK_EQ(in.stats().historyRows, 2);
+  CHECK_EQ(in.pending(), 0);
+
+  // No digests unless asked for
+  std::vector<IngestDigest> due;
+  in.takeDigests(due);
+  CHECK_EQ(due.size(), 0);
+
+  // A boat's own report asks for one, for the device it came through; a
+  // relayed copy (hops 1 and up) or one while a request is queued does not
+  in.digestEvery(600);
+  CHECK(report(in, 8, 3, 1, 2000, "1111111111111111"));
+  CHECK(report(in, 7, 4, 0, 2000));
+  CHECK(!report(in, 7, 4, 0, 2001, "a0a0a0a0a0a0a0a0"));  // another gateway, same report
+  CHECK(report(in, 7, 5, 0, 2010));
+  in.takeDigests(due);
+  CHECK_EQ(due.size(), 1);
+  CHECK(due[0].boatId == "11111111-1111-1111-1111-111111111111");
+  CHECK(!strcmp(due[0].devEui, "0102030405060708"));
+  CHECK_EQ(in.stats().digests, 1);
+
+  // Nothing was sent (no live row yet, nobody near): the next report asks again
+  CHECK(report(in, 7, 50, 0, 2030));
+  in.takeDigests(due);
+  CHECK_EQ(due.size(), 1);
+  // Sent: then not again for the interval
+  in.digestSent(due[0], 2030);
+  CHECK(report(in, 7, 51, 0, 2629));
+  in.takeDigests(due);
+  CHECK_EQ(due.size(), 0);
+  CHECK(report(in, 7, 6, 0, 2630));
+  CHECK(!report(in, 9, 1, 0, 2600));  // unknown boat
+  CHECK(report(in, 8, 4, 0, 2600, "not/a+topic#0000"));  // nothing safe to publish to
+  in.takeDigests(due);
+  CHECK_EQ(due.size(), 1);
+  in.takeDigests(due);
+  CHECK_EQ(due.size(), 0);
+
+  // What goes to ChirpStack: FPort 11, the digest's bytes as they are
+  const uint8_t digest[] = {0xD1, 0x01, 8, 0, 0x10, 0x27, 0x20, 0x4E, 4, 64, 3};
+  IngestDigest d = {"x", "0102030405060708", "app-1"};
+  std::string topic, body = ingestDownlink(d, std::string((const char *)digest, sizeof(digest)), topic);
+  CHECK(topic == "application/app-1/device/0102030405060708/command/down");
+  CHECK(body == "{\"devEui\":\"0102030405060708\",\"confirmed\":false,\"fPort\":11,\"data\":\"" +
+                base64Encode(digest, sizeof(digest)) + "\"}");
+  uint8_t back[16];
+  CHECK_EQ(base64Decode(base64Encode(digest, sizeof(digest)).c_str(), 16, back, sizeof(back)), (int)sizeof(digest));
+  CHECK(!memcmp(back, digest, sizeof(digest)));
+  return TEST_END();
+}
@@ -0,0 +1,3 @@
+-- Revert script for supabase_schema-v10.sql
+
+drop function if exists public.get_nearby_digest(text, interval);
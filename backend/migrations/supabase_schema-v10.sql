@@ -0,0 +1,75 @@
+-- Nearby-boat digest for LoRaWAN downlinks (FPort 11)
+-- Returns the payload a boat's node decodes with digestDecode() in
+-- firmware/lib/BoatDigest/boat_digest.h: the nearest boats the backend knows,
+-- for nodes that have a gateway but no mesh neighbours.
+--
+-- Boats are identified on the mesh by their numeric device_id (1..65535);
+-- boats without one cannot be addressed by the node and are left out.
+-- Returns null if the device is unknown or has no live location yet.
+create or replace function public.get_nearby_digest(
+  p_device_id text,
+  p_max_age interval default interval '4 hours'
+)
+returns bytea
+language plpgsql
+security definer
+as $$
+declare
+  v_boat uuid;
+  v_lat double precision;
+  v_lon double precision;
+  v_out bytea;
+  v_n int := 0;
+  v_off int;
+  v_q bigint;
+  r record;
+begin
+  select b.id, loc.lat, loc.lon into v_boat, v_lat, v_lon
+  from public.boats b
+  join public.boat_live_locations loc on loc.boat_id = b.id
+  where b.device_id = p_device_id;
+
+  if v_boat is null then return null; end if;
+
+  -- [0xD1][n] then up to 5 entries of 9 bytes (boat_digest.h)
+  v_out := decode(repeat('00', 2 + 9 * 5), 'hex');
+  v_out := set_byte(v_out, 0, 209);
+
+  for r in
+    select
+      (case when b.device_id ~ '^[0-9]{1,5}$' then b.device_id::int end) as mesh_id,
+      n.lat, n.lon, n.heading, n.speed, n.last_updated
+    from public.get_nearby_boats(v_lat, v_lon, 50000, null) n
+    join public.boats b on b.id = n.boat_id
+    where n.boat_id <> v_boat
+      and n.last_updated > now() - p_max_age
+    order by n.distance_meters asc
+  loop
+    continue when r.mesh_id is null or r.mesh_id < 1 or r.mesh_id > 65535;
+    exit when v_n = 5;
+    v_off := 2 + 9 * v_n;
+
+    v_out := set_byte(v_out, v_off, r.mesh_id & 255);
+    v_out := set_byte(v_out, v_off + 1, r.mesh_id >> 8);
+
+    -- Low 16 bits of the 2e-5 degree grid; the node restores the rest from its own fix
+    v_q := floor(r.lat * 50000)::bigint & 65535;
+    v_out := set_byte(v_out, v_off + 2, (v_q & 255)::int);
+    v_out := set_byte(v_out, v_off + 3, (v_q >> 8)::int);
+    v_q := floor(r.lon * 50000)::bigint & 65535;
+    v_out := set_byte(v_out, v_off + 4, (v_q & 255)::int);
+    v_out := set_byte(v_out, v_off + 5, (v_q >> 8)::int);
+
+    -- speed is m/s from the app, sent in 25 cm/s steps; heading in 1/256 turns
+    v_out := set_byte(v_out, v_off + 6, least(255, greatest(0, round(coalesce(r.speed, 0) * 4)))::int);
+    v_out := set_byte(v_out, v_off + 7, ((round(coalesce(r.heading, 0) * 256 / 360)::int % 256) + 256) % 256);
+    v_out := set_byte(v_out, v_off + 8,
+      least(255, floor(extract(epoch from now() - r.last_updated) / 60))::int);
+
+    v_n := v_n + 1;
+  end loop;
+
+  v_out := set_byte(v_out, 1, v_n);
+  return substring(v_out from 1 for 2 + 9 * v_n);
+end;
+$$;
@@ -31,10 +31,14 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <WiFi.h>
-#include <WebServer.h>
+#include <boat_http.h>
+#include <boat_json.h>
 #include <Preferences.h>
 #include <RadioLib.h>
 #include <TinyGPSPlus.h>
+#include <boat_prof.h>
+#include <boat_seq.h>
+#include <boat_lmic_session.h>
 
 extern "C" {
   #include <lmic.h>
@@ -82,7 +86,7 @@ const float ADC_SCALE = (ADC_R_TOP + ADC_R_BOT) / ADC_R_BOT;
 SX1276 lora = new Module(PIN_LORA_NSS, PIN_LORA_DIO0, PIN_LORA_RST, 18);
 TinyGPSPlus gps;
 HardwareSerial GPSSerial(2);
-WebServer http(80);
+BoatHttp http(80);
 Preferences prefs;
 
 bool paired = false;
@@ -96,7 +100,7 @@ bool wanJoined = false;
 bool meshHeardRecently = false;
 uint32_t lastMeshHeardMs = 0;
 uint32_t nextSendAtMs = 0;
-uint16_t seqno = 0;
+BoatSeq seq;  // Pkt.seq, persisted in reserved blocks (boat_seq.h)
 
 /* ------------ PACKET STRUCT (37 bytes) ------------- */
 #pragma pack(push,1)
@@ -247,47 +251,41 @@ String makePairSSID() {
   return String(b);
 }
 
+struct PairReq {
+  char boatId[40];
+  uint16_t userId;       // 0 when the app leaves it out
+  char displayName[40];  // cut to 12 UTF-8 bytes on air by buildPkt()
+};
+
 void handlePair() {
   if (!pairingAPon) { http.send(403,"application/json","{\"ok\":false}"); return; }
-  if (http.method()!=HTTP_POST) { http.send(405); return; }
-
-  String body = http.arg("plain");
-
-  // Extract boat_id
-  int bi = body.indexOf("\"boat_id\"");
-  if (bi < 0) { http.send(400,"application/json","{\"err\":\"missing boat_id\"}"); return; }
-  int c = body.indexOf(':', bi);
-  int q1 = body.indexOf('"', c);
-  int q2 = body.indexOf('"', q1+1);
-  String newBoatId = body.substring(q1+1, q2);
-
-  // user_id
-  int ui = body.indexOf("\"user_id\"");
-  uint16_t uid = 0;
-  if (ui >= 0) {
-    int c2 = body.indexOf(':', ui);
-    int e  = body.indexOf(',', c2);
-    if (e < 0) e = body.indexOf('}', c2);
-    String ustr = body.substring(c2+1, e);
-    uid = (uint16_t) ustr.toInt();
+  if (http.method()!=BH_POST) { http.send(405); return; }
+
+  size_t len;
+  const char *body = http.body(len);
+  PairReq req = {};
+  const JsonField fields[] = {
+    JSON_STR_FIELD("boat_id", req.boatId),
+    JSON_UINT_FIELD("user_id", req.userId),
+    JSON_STR_FIELD("display_name", req.displayName),
+  };
+  uint32_t seen;
+  int err = jsonBind(body, len, fields, 3, &seen);
+  if (err != JSON_OK) {
+    http.send(400, "application/json", String("{\"err\":\"") + jsonErrStr(err) + "\"}");
+    return;
   }
+  if (!(seen & 1) || !req.boatId[0]) { http.send(400,"application/json","{\"err\":\"missing boat_id\"}"); return; }
 
-  // display_name
-  String dname="";
-  int di = body.indexOf("\"display_name\"");
-  if (di >= 0) {
-    int c3 = body.indexOf(':', di);
-    int dq1 = body.indexOf('"', c3);
-    int dq2 = body.indexOf('"', dq1+1);
-    dname = body.substring(dq1+1, dq2);
-  }
+  savePairing(req.boatId, req.userId, req.displayName);
 
-  savePairing(newBoatId, uid, dname);
-
-  http.send(200, "application/json",
-      String("{\"ok\":true,\"boat_id\":\"") + newBoatId +
-      "\",\"user_id\":" + uid +
-      ",\"display_name\":\"" + dname + "\"}");
+  char bid[96], dname[96];
+  jsonEscape(bid, sizeof(bid), req.boatId);
+  jsonEscape(dname, sizeof(dname), req.displayName);
+  char out[256];
+  snprintf(out, sizeof(out), "{\"ok\":true,\"boat_id\":\"%s\",\"user_id\":%u,\"display_name\":\"%s\"}",
+           bid, req.userId, dname);
+  http.send(200, "application/json", out);
 
   ledState = LED_BLUE_PAIRED;
   ledStamp = millis();
@@ -305,8 +303,8 @@ void startPairingAP() {
   if (pairingAPon) return;
   String ssid=makePairSSID();
   WiFi.softAP(ssid.c_str(), "pairme-1234");
-  http.on("/pair", HTTP_POST, handlePair);
-  http.on("/reset", HTTP_POST, handleReset);
+  http.on("/pair", BH_POST, handlePair);
+  http.on("/reset", BH_POST, handleReset);
   http.begin();
   pairingAPon = true;
   pairingAPOffAt = millis() + 10*60*1000;
@@ -340,7 +338,7 @@ int utf8_truncate(const char *src, uint8_t *out, int maxBytes) {
 /* ------------- BUILD PACKET ------------- */
 void buildPkt(Pkt &p) {
   p.src = boatId_u16;
-  p.seq = ++seqno;
+  p.seq = (uint16_t)seq.next();
 
   if (gps.location.isValid()) {
     p.lat1e7 = (int32_t)(gps.location.lat()*1e7);
@@ -400,13 +398,20 @@ void lorawanInit() {
   LMIC_setupChannel(0,865062500,DR_RANGE_MAP(DR_SF12,DR_SF7),0);
   LMIC_setupChannel(1,865402500,DR_RANGE_MAP(DR_SF12,DR_SF7),0);
   LMIC_setupChannel(2,865985000,DR_RANGE_MAP(DR_SF12,DR_SF7),0);
-  LMIC_startJoining();
+  // A saved session brings its own channel plan and counters; no join airtime.
+  // Link checks are what raise EV_LINK_DEAD if the network has forgotten it.
+  if (lmicSessionRestore()) { wanJoined=true; LMIC_setLinkCheckMode(1); }
+  else LMIC_startJoining();
+  Serial.printf("[wan] session %s\n", lmicSessionSource());
 }
 
 void onLmicEvent(ev_t ev) {
-  if (ev==EV_JOINED) wanJoined=true;
+  if (ev==EV_JOINED) { wanJoined=true; lmicSessionSave(); }
   if (ev==EV_JOIN_FAILED) wanJoined=false;
+  if (ev==EV_TXCOMPLETE) lmicSessionTx();
+  if (ev==EV_LINK_DEAD) { wanJoined=false; lmicSessionForget(); LMIC_unjoinAndRejoin(); }
 }
+void onEvent(ev_t ev) { onLmicEvent(ev); }
 
 bool lorawanSend(const uint8_t *buf, uint8_t len) {
   if (!wanJoined) return false;
@@ -436,15 +441,96 @@ void handleStatus() {
   http.send(200,"application/json", out);
 }
 
+/* Deferred /request_fix.
+   POST returns at once: 200 with the fix if one is fresh, otherwise 202 and a
+   ticket to poll with GET /request_fix?ticket=N. POST ?wait=1 parks the
+   connection instead and serviceFixRequests() answers it from loop() when the
+   GPS publishes a fresh fix or FIX_WAIT_MS runs out. Nothing here blocks. */
+const uint32_t FIX_WAIT_MS   = 8000;
+const uint32_t FIX_FRESH_MS  = 3000;
+const uint32_t FIX_TICKET_TTL_MS = 60000;
+const uint8_t  FIX_SLOTS     = 4;
+
+struct FixReq {
+  uint16_t ticket;    // 0 = slot free
+  uint32_t since;     // millis() when requested
+  uint32_t doneAt;
+  bool done;
+  bool ok;
+  bool parked;
+  uint32_t httpTicket;  // parked connection, answered with http.reply()
+};
+FixReq fixReqs[FIX_SLOTS];
+uint16_t nextFixTicket = 1;
+
+bool gpsFixFresh() {
+  return gps.location.isValid() && gps.location.age() < FIX_FRESH_MS;
+}
+
+String fixJson(bool ok, uint16_t ticket) {
+  String out = "{\"ok\":" + String(ok ? "true" : "false");
+  if (ticket) out += ",\"ticket\":" + String(ticket);
+  if (ok) {
+    out += ",\"lat\":" + String(gps.location.lat(), 6);
+    out += ",\"lon\":" + String(gps.location.lng(), 6);
+    out += ",\"age_ms\":" + String(gps.location.age());
+  }
+  return out + "}";
+}
+
+FixReq *findFixReq(uint16_t ticket) {
+  for (auto &r : fixReqs) if (r.ticket && r.ticket == ticket) return &r;
+  return NULL;
+}
+
 void handleFix() {
-  uint32_t t0=millis();
-  bool ok=false;
-  while (millis()-t0<8000) {
-    while(GPSSerial.available()) gps.encode(GPSSerial.read());
-    if (gps.location.isValid() && gps.location.age()<3000) { ok=true; break;}
-    delay(200);
+  if (gpsFixFresh()) { http.send(200, "application/json", fixJson(true, 0)); return; }
+
+  FixReq *r = NULL;
+  for (auto &f : fixReqs) if (!f.ticket) { r = &f; break; }
+  if (!r) { http.send(503, "application/json", "{\"ok\":false,\"err\":\"busy\"}"); return; }
+
+  r->ticket = nextFixTicket++;
+  if (!nextFixTicket) nextFixTicket = 1;
+  r->since = millis();
+  r->done = r->ok = false;
+  r->parked = http.arg("wait") == "1";
+  if (r->parked) {
+    r->httpTicket = http.defer();  // answered later by serviceFixRequests()
+    return;
+  }
+  http.send(202, "application/json",
+      "{\"ok\":false,\"pending\":true,\"ticket\":" + String(r->ticket) + "}");
+}
+
+void handleFixPoll() {
+  FixReq *r = findFixReq((uint16_t)http.arg("ticket").toInt());
+  if (!r || r->parked) { http.send(404, "application/json", "{\"ok\":false,\"err\":\"no ticket\"}"); return; }
+  if (!r->done) {
+    http.send(202, "application/json", "{\"ok\":false,\"pending\":true,\"ticket\":" + String(r->ticket) + "}");
+    return;
+  }
+  http.send(r->ok ? 200 : 500, "application/json", fixJson(r->ok, r->ticket));
+  r->ticket = 0;
+}
+
+void serviceFixRequests() {
+  bool fresh = gpsFixFresh();
+  uint32_t now = millis();
+  for (auto &r : fixReqs) {
+    if (!r.ticket) continue;
+    if (!r.done && (fresh || now - r.since >= FIX_WAIT_MS)) {
+      r.done = true; r.ok = fresh; r.doneAt = now;
+    }
+    if (r.parked && !http.pending(r.httpTicket)) {
+      r.ticket = 0;  // phone hung up
+    } else if (r.done && r.parked) {
+      http.reply(r.httpTicket, r.ok ? 200 : 500, "application/json", fixJson(r.ok, 0));
+      r.ticket = 0;
+    } else if (r.done && now - r.doneAt > FIX_TICKET_TTL_MS) {
+      r.ticket = 0;  // never collected
+    }
   }
-  http.send(ok?200:500,"application/json", ok?"{\"ok\":true}":"{\"ok\":false}");
 }
 
 void handleBeaconReq() {
@@ -455,13 +541,22 @@ void handleBeaconReq() {
   http.send(200,"application/json","{\"ok\":true}");
 }
 
+void handleMetrics() {
+  static char buf[2560];
+  profWriteJson(buf, sizeof(buf));
+  http.send(200, "application/json", buf);
+  if (http.arg("reset") == "1") profReset();
+}
+
 void startRescueAP() {
   if (rescueAPon) { rescueAPOffAt = millis()+600000; return; }
   String ssid="BOAT-"+boatId;
   WiFi.softAP(ssid.c_str(),"findme-1234");
-  http.on("/status", HTTP_GET, handleStatus);
-  http.on("/request_fix", HTTP_POST, handleFix);
-  http.on("/beacon", HTTP_POST, handleBeaconReq);
+  http.on("/status", BH_GET, handleStatus);
+  http.on("/request_fix", BH_POST, handleFix);
+  http.on("/request_fix", BH_GET, handleFixPoll);
+  http.on("/beacon", BH_POST, handleBeaconReq);
+  http.on("/metrics", BH_GET, handleMetrics);
   http.begin();
   rescueAPon=true;
   rescueAPOffAt=millis()+600000;
@@ -481,6 +576,8 @@ void setup() {
   analogReadResolution(12);
 
   loadPairing();
+  seq.begin();
+  Serial.printf("[seq] boot epoch %lu\n", (unsigned long)seq.epoch());
 
   if (!paired) {
     startPairingAP();
@@ -496,9 +593,12 @@ void setup() {
 
 /* ------------- LOOP ------------- */
 void loop() {
-  os_runloop_once();
+  { PROF_SCOPE("loop.lmic"); os_runloop_once(); }
 
-  while(GPSSerial.available()) gps.encode(GPSSerial.read());
+  {
+    PROF_SCOPE("loop.gps");
+    while(GPSSerial.available()) gps.encode(GPSSerial.read());
+  }
 
   if (pairingAPon && (long)(millis()-pairingAPOffAt)>0)
     stopPairingAP();
@@ -512,8 +612,14 @@ void loop() {
     }
   }
 
-  if (rescueAPon) {
+  serviceFixRequests();
+
+  if (pairingAPon || rescueAPon) {
+    PROF_SCOPE("loop.http");
     http.handleClient();
+  }
+
+  if (rescueAPon) {
     if ((long)(millis()-rescueAPOffAt)>0) {
       http.stop();
       WiFi.softAPdisconnect(true);
@@ -524,6 +630,7 @@ void loop() {
   // Mesh reception
   uint8_t buf[128]; size_t bl=sizeof(buf);
   if (meshReceive(buf, bl) && bl==sizeof(Pkt)) {
+    PROF_SCOPE("loop.relay");
     lastMeshHeardMs=millis();
     meshHeardRecently=true;
     Pkt *rp=(Pkt*)buf;
@@ -542,6 +649,7 @@ void loop() {
     nextSendAtMs = millis() + REPORT_SEC*1000 + random(0,REPORT_JITTER_S*1000);
 
     if (paired) {
+      PROF_SCOPE("loop.report");
       Pkt p; memset(&p,0,sizeof(p));
       buildPkt(p);
       if ((millis()-lastMeshHeardMs)<MESH_STALE_MS) {
@@ -563,5 +671,11 @@ void loop() {
   }
 
   ledUpdate();
+
+  static uint32_t lastProf=0;
+  if (millis()-lastProf>60000) {
+    profPrint(Serial);
+    lastProf=millis();
+  }
   delay(10);
 }
\ No newline at end of file
@@ -4,18 +4,49 @@
     - "Any-cast Gateway": Forwards mesh packets to LoRaWAN if connected.
     - JSON API: GET /nearby for mobile app.
     - In-memory cache of nearby boats.
+    - Fixed-point Kalman filter on GPS fixes (packets + CPA use filtered state).
+    - GPS hot start: last fix/time/ephemeris replayed into the receiver at boot.
+    - FreeRTOS tasks: radio/LMIC and GPS on core 1, HTTP and LED on core 0,
+      linked by bounded queues (see TASKS below).
+    - Tickless radio loop: sleeps in ESP32 light sleep until the next LMIC job,
+      report, mesh TX, LED edge or GPS burst; DIO0 and the GPS UART wake it.
+    - Journal: every report goes to an append-only flash log; fixes that did
+      not leave over LoRaWAN drain later, over LoRaWAN or via a mesh neighbour.
+    - Energy budget: calibrated battery reading, LiPo curve, and a planner
+      that trades report interval, relaying, LoRaWAN DR and the LED for
+      lasting to a target runtime (GET /status, POST /energy).
+    - Cloud digest: the backend's nearest boats arrive as a LoRaWAN downlink
+      and fill /nearby (source "cloud") when no mesh neighbour is in range.
+    - Board-independent logic (packet, nav filter, nearby cache, LED patterns,
+      mesh relay rule) is in lib/BoatCore and also builds on a PC
+      (firmware/CMakeLists.txt); firmware/sim runs the flood with 100s of boats.
     - All previous features (Pairing, Rescue, etc.)
 */
 
 #include <Arduino.h>
 #include <SPI.h>
 #include <WiFi.h>
-#include <WebServer.h>
+#include <boat_http.h>
+#include <boat_json.h>
 #include <Preferences.h>
 #include <RadioLib.h>
 #include <TinyGPSPlus.h>
 #include <vector>
 #include <algorithm>
+#include <esp_sleep.h>
+#include <driver/uart.h>
+#include <boat_prof.h>
+#include <boat_journal.h>
+#include <boat_seq.h>
+#include <boat_energy.h>
+#include <boat_lmic_session.h>
+#include <boat_digest.h>
+#include <boat_pkt.h>
+#include <boat_mesh_radio.h>
+#include <boat_nav.h>
+#include <boat_nearby.h>
+#include <boat_led.h>
+#include <boat_mesh.h>
 
 extern "C" {
   #include <lmic.h>
@@ -23,25 +54,31 @@ extern "C" {
 }
 
 /* ------------ REGION & RADIO CONFIG ------------- */
-const float MESH_FREQ_MHZ = 865.2;
-const uint8_t MESH_SF = 9;
-const int8_t MESH_TX_DBM = 14;
+// Mesh channel: MESH_FREQ_MHZ, MESH_SF, MESH_TX_DBM in boat_mesh_radio.h
 const uint32_t MESH_STALE_MS = 10UL * 60UL * 1000UL;
 
-const uint16_t REPORT_SEC = 120;
+const uint16_t REPORT_SEC = 120;  // first report; after that the energy tier's interval
 const uint16_t REPORT_JITTER_S = 20;
 
+// Build with -D BOAT_LIGHT_SLEEP=0 for the always-awake baseline.
+#ifndef BOAT_LIGHT_SLEEP
+#define BOAT_LIGHT_SLEEP 1
+#endif
+
 /* ------------ LoRaWAN KEYS — REPLACE THESE ------------ */
 static const u1_t PROGMEM APPEUI[8] = {0};
 static const u1_t PROGMEM DEVEUI[8] = {0};
 static const u1_t PROGMEM APPKEY[16] = {0};
 const uint8_t LORAWAN_FPORT = 10;
+const uint8_t DIGEST_FPORT = 11;   // downlink, nearest boats per the backend, see boat_digest.h
+const uint8_t BACKLOG_FPORT = 12;  // [u16 src][journal body], see boat_journal.h
 
 /* ------------ PINS ------------- */
 const int PIN_LORA_NSS  = 5;
 const int PIN_LORA_DIO0 = 26;
 const int PIN_LORA_RST  = 14;
 const int PIN_GPS_RX    = 16;
+const int PIN_GPS_TX    = 17;  // ESP TX -> GPS RX, used for UBX aiding
 const int PIN_BTN       = 0;
 const int PIN_BATT_ADC  = 34;
 const int PIN_RGB_R     = 15;
@@ -49,14 +86,18 @@ const int PIN_RGB_G     = 4;
 const int PIN_RGB_B     = 13;
 const int PIN_BUZZER    = 27;
 
-const float ADC_VREF = 3.3;
 const float ADC_SCALE = (10000.0 + 37000.0) / 37000.0;
 
+const uint16_t ENERGY_CAPACITY_MAH = 2000;
+const uint16_t ENERGY_TARGET_H     = 14;      // a day's trip, from boot; POST /energy changes it
+const uint32_t ENERGY_PERIOD_MS    = 30000;
+
 /* ------------ GLOBALS ------------- */
 SX1276 lora = new Module(PIN_LORA_NSS, PIN_LORA_DIO0, PIN_LORA_RST, 18);
+MeshRadio mesh = {&lora, false, true};  // radio task; listen follows the energy tier
 TinyGPSPlus gps;
-HardwareSerial GPSSerial(2);
-WebServer http(80);
+HardwareSerial GPSSerial(1);  // UART1: ESP32 can only light-sleep-wake on UART0/1
+BoatHttp http(80);
 Preferences prefs;
 
 bool paired = false;
@@ -65,139 +106,421 @@ uint16_t boatId_u16 = 0;
 String displayName = "";
 uint16_t userId_u16 = 0;
 
-bool wanJoined = false;
+volatile bool wanJoined = false;
 bool meshHeardRecently = false;
-uint32_t lastMeshHeardMs = 0;
+volatile uint32_t lastMeshHeardMs = 0;
 uint32_t nextSendAtMs = 0;
-uint16_t seqno = 0;
+BoatSeq seq;  // Pkt.seq, persisted in reserved blocks (boat_seq.h)
+
+// The ui task reads the battery and is the only one to run the planner
+// (boat_energy.h); the radio task only looks at energyTierNow, http and
+// buildPkt at energySnapshot(). POST /energy leaves its settings in
+// energyReq for the ui task to pick up. energyMux guards energyPub and
+// energyReq only: the planner's float math never runs inside it.
+struct EnergyReq {
+  uint8_t seen;                 // bit 0 targetEndS, bit 1 capacityMah
+  uint32_t targetEndS;
+  uint16_t capacityMah;
+  uint32_t gen, doneGen;        // requests posted / requests reflected in energyPub
+};
+EnergyPlanner energy;        // ui task only
+EnergyStatus energyPub;
+EnergyReq energyReq = {};
+volatile uint8_t energyTierNow = 0;
+portMUX_TYPE energyMux = portMUX_INITIALIZER_UNLOCKED;
+
+const EnergyTier &energyTier() { return ENERGY_TIERS[energyTierNow]; }
+
+EnergyStatus energySnapshot() {
+  portENTER_CRITICAL(&energyMux);
+  EnergyStatus e = energyPub;
+  portEXIT_CRITICAL(&energyMux);
+  return e;
+}
+
+BoatJournal journal;         // radio task only
+uint32_t journalTxAddr = 0;  // block riding in the pending LoRaWAN uplink
+
+/* ------------ NAV FILTER (fixed-point Kalman, boat_nav.h) ------------- */
+NavFilter navFilter;  // GPS task only
+NavState nav;         // written by the GPS task only; others use navSnapshot()
+portMUX_TYPE navMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int32_t rawTo1e7(const RawDegrees &r) {
+  int32_t v = (int32_t)r.deg * 10000000L + (int32_t)(r.billionths / 100);
+  return r.negative ? -v : v;
+}
+
+NavState navSnapshot() {
+  portENTER_CRITICAL(&navMux);
+  NavState n = nav;
+  portEXIT_CRITICAL(&navMux);
+  return n;
+}
+
+// Feed one GPS fix. Call when gps.location.isUpdated().
+void navUpdate(uint32_t now) {
+  if (!gps.location.isValid()) return;
+  NavFix f;
+  f.lat1e7 = rawTo1e7(gps.location.rawLat());
+  f.lon1e7 = rawTo1e7(gps.location.rawLng());
+  f.hdop_x100 = gps.hdop.isValid() ? gps.hdop.value() : 9999;
+  f.sats = gps.satellites.isValid() ? gps.satellites.value() : 0;
+  f.courseValid = gps.course.isValid(); f.courseDeg = f.courseValid ? gps.course.deg() : 0;
+  f.speedValid = gps.speed.isValid();   f.speedMps = f.speedValid ? gps.speed.mps() : 0;
+  navFilter.update(f, now);
+  portENTER_CRITICAL(&navMux);
+  nav = navFilter.state();
+  portEXIT_CRITICAL(&navMux);
+}
 
-/* ------------ PACKET STRUCT (37 bytes) ------------- */
-#pragma pack(push,1)
-struct Pkt {
-  uint16_t src;
-  uint16_t seq;
+/* ------------ GPS HOT START (UBX aiding) ------------- */
+// Last fix lives in RTC memory (survives resets and deep sleep) and in NVS
+// (survives power cycles). Receiver aiding data (NEO-6 AID-EPH/AID-HUI,
+// M8 MGA-DBD) is polled periodically and replayed at boot, together with
+// an AID-INI / MGA-INI position and, when the RTC still holds it, time.
+const char* GPS_NVS_NS = "gps_aid";
+const uint32_t GPS_HINT_MAGIC     = 0x47505331;  // "GPS1"
+const uint32_t GPS_HINT_SAVE_MS   = 10UL * 60UL * 1000UL;
+const uint32_t GPS_AID_POLL_MS    = 30UL * 60UL * 1000UL;
+const uint32_t GPS_AID_COLLECT_MS = 3000;
+const uint32_t GPS_EPH_MAX_AGE_S  = 4UL * 3600UL;  // broadcast ephemeris validity
+const uint32_t GPS_COLD_POS_ACC_CM = 2000000;      // 20 km, unknown time since last fix
+const size_t   GPS_AID_MAX = 4096;
+const uint32_t GPS_UNIX_TO_GPS = 315964800UL - 18;  // epoch offset minus leap seconds
+const uint8_t  TTFF_BUCKETS = 7;
+const uint16_t TTFF_EDGES_S[TTFF_BUCKETS - 1] = {5, 10, 20, 30, 60, 120};
+
+struct GpsHint {
+  uint32_t magic;
   int32_t lat1e7;
   int32_t lon1e7;
-  uint8_t batt_pc;
-  uint8_t hops;
-  uint16_t user_id;
-  uint8_t  name_len;
-  uint8_t  name_utf8[12];
+  int32_t alt_cm;
+  uint32_t fixUnix;  // UTC seconds of the fix, 0 if the date was not valid
   uint16_t crc;
 };
-#pragma pack(pop)
-
-uint16_t crc16_ccitt(const uint8_t *data, size_t len) {
-  uint16_t crc = 0xFFFF;
-  for (size_t i=0; i<len; i++) {
-    crc ^= (uint16_t)data[i] << 8;
-    for (int j=0; j<8; j++)
-      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
-  }
-  return crc;
-}
-
-/* ------------ NEARBY BOATS CACHE ------------- */
-struct BoatEntry {
-  uint16_t boat_id;
-  uint16_t user_id;
-  String display_name;
-  double lat;
-  double lon;
-  uint8_t battery;
-  uint32_t last_seen_ms;
+
+RTC_DATA_ATTR GpsHint rtcHint;
+Preferences gpsPrefs;          // GPS task has its own handle, prefs belongs to pairing
+uint8_t gpsAid[GPS_AID_MAX];   // raw UBX frames, replayed verbatim
+size_t gpsAidLen = 0, gpsAidSent = 0;
+uint32_t gpsAidUnix = 0;       // when gpsAid was collected
+bool gpsAidCollecting = false;
+uint32_t gpsAidPollAt = 0, gpsAidCollectEnd = 0, gpsHintSavedAt = 0;
+bool gpsBootAided = false;
+uint32_t gpsTtffMs = 0;
+uint16_t gpsTtffHist[2][TTFF_BUCKETS];  // [unaided, aided]
+
+// What /gps shows, copied out by the GPS task whenever it changes
+struct GpsStats {
+  uint32_t ttffMs;
+  bool aided;
+  uint16_t aidBytes;
+  uint16_t ttffHist[2][TTFF_BUCKETS];
 };
+GpsStats gpsStatsPub;
+portMUX_TYPE gpsStatsMux = portMUX_INITIALIZER_UNLOCKED;
 
-std::vector<BoatEntry> nearbyBoats;
-const size_t MAX_NEARBY_BOATS = 30;
+void gpsPublishStats() {
+  portENTER_CRITICAL(&gpsStatsMux);
+  gpsStatsPub.ttffMs = gpsTtffMs;
+  gpsStatsPub.aided = gpsBootAided;
+  gpsStatsPub.aidBytes = gpsAidLen;
+  memcpy(gpsStatsPub.ttffHist, gpsTtffHist, sizeof(gpsTtffHist));
+  portEXIT_CRITICAL(&gpsStatsMux);
+}
 
-void updateNearbyCache(const Pkt* p) {
-  uint32_t now = millis();
-  bool found = false;
-  
-  // Convert name to String safely
-  char nameBuf[13];
-  memset(nameBuf, 0, 13);
-  int nlen = (p->name_len > 12) ? 12 : p->name_len;
-  memcpy(nameBuf, p->name_utf8, nlen);
-  String nameStr = String(nameBuf);
-
-  for (auto &b : nearbyBoats) {
-    if (b.boat_id == p->src) {
-      b.user_id = p->user_id;
-      b.display_name = nameStr;
-      b.lat = p->lat1e7 / 1e7;
-      b.lon = p->lon1e7 / 1e7;
-      b.battery = p->batt_pc;
-      b.last_seen_ms = now;
-      found = true;
-      break;
-    }
+uint16_t gpsHintCrc(const GpsHint &h) { return crc16_ccitt((const uint8_t*)&h, sizeof(GpsHint) - 2); }
+
+uint32_t gpsUnixNow() {
+  if (!gps.date.isValid() || !gps.time.isValid() || gps.date.year() < 2020) return 0;
+  // days_from_civil (Howard Hinnant)
+  int y = gps.date.year(), m = gps.date.month(), d = gps.date.day();
+  y -= m <= 2;
+  int era = y / 400, yoe = y - era * 400;
+  int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  uint32_t days = era * 146097 + doe - 719468;
+  return days * 86400UL + gps.time.hour() * 3600UL + gps.time.minute() * 60UL + gps.time.second();
+}
+
+void ubxSend(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len) {
+  uint8_t hdr[6] = {0xB5, 0x62, cls, id, (uint8_t)len, (uint8_t)(len >> 8)};
+  uint8_t a = 0, b = 0;
+  for (int i = 2; i < 6; i++) { a += hdr[i]; b += a; }
+  for (uint16_t i = 0; i < len; i++) { a += payload[i]; b += a; }
+  GPSSerial.write(hdr, 6);
+  if (len) GPSSerial.write(payload, len);
+  GPSSerial.write(a); GPSSerial.write(b);
+}
+
+static void putLE(uint8_t *p, uint32_t v, int n) { for (int i = 0; i < n; i++) p[i] = v >> (8 * i); }
+
+// Position (and time if the RTC kept it) for both NEO-6 (AID-INI) and M8
+// (MGA-INI); each receiver ignores the family it does not speak.
+void gpsInjectInit(const GpsHint &h, uint32_t posAccCm) {
+  time_t now = time(nullptr);
+  bool haveTime = now > 1600000000;
+  uint8_t ini[48] = {0};
+  putLE(ini + 0, h.lat1e7, 4); putLE(ini + 4, h.lon1e7, 4); putLE(ini + 8, h.alt_cm, 4);
+  putLE(ini + 12, posAccCm, 4);
+  uint32_t flags = 0x01 | 0x20;  // pos valid, lat/lon format
+  if (haveTime) {
+    uint32_t gpsSec = (uint32_t)now - GPS_UNIX_TO_GPS;
+    putLE(ini + 18, gpsSec / 604800, 2);
+    putLE(ini + 20, (gpsSec % 604800) * 1000, 4);
+    putLE(ini + 28, 2000, 4);  // tAccMs, RTC drift across a reset
+    flags |= 0x02;
   }
+  putLE(ini + 44, flags, 4);
+  ubxSend(0x0B, 0x01, ini, sizeof(ini));
 
-  if (!found) {
-    if (nearbyBoats.size() >= MAX_NEARBY_BOATS) {
-      // Remove oldest
-      auto oldest = nearbyBoats.begin();
-      for (auto it = nearbyBoats.begin(); it != nearbyBoats.end(); ++it) {
-        if (it->last_seen_ms < oldest->last_seen_ms) oldest = it;
-      }
-      nearbyBoats.erase(oldest);
+  uint8_t pos[20] = {0x01, 0x00};
+  putLE(pos + 4, h.lat1e7, 4); putLE(pos + 8, h.lon1e7, 4); putLE(pos + 12, h.alt_cm, 4);
+  putLE(pos + 16, posAccCm, 4);
+  ubxSend(0x13, 0x40, pos, sizeof(pos));
+  if (haveTime) {
+    struct tm t; gmtime_r(&now, &t);
+    uint8_t tu[24] = {0x10, 0x00, 0x00, (uint8_t)-128};
+    putLE(tu + 4, t.tm_year + 1900, 2);
+    tu[6] = t.tm_mon + 1; tu[7] = t.tm_mday; tu[8] = t.tm_hour; tu[9] = t.tm_min; tu[10] = t.tm_sec;
+    putLE(tu + 16, 2, 2);  // tAccS
+    ubxSend(0x13, 0x40, tu, sizeof(tu));
+  }
+}
+
+void gpsHotStart() {
+  GpsHint h;
+  time_t now = time(nullptr);
+  bool fromRtc = rtcHint.magic == GPS_HINT_MAGIC && rtcHint.crc == gpsHintCrc(rtcHint);
+  gpsPrefs.begin(GPS_NVS_NS, true);
+  if (fromRtc) h = rtcHint;
+  else if (gpsPrefs.getBytes("hint", &h, sizeof(h)) != sizeof(h) || h.magic != GPS_HINT_MAGIC || h.crc != gpsHintCrc(h)) h.magic = 0;
+  gpsPrefs.getBytes("ttff", gpsTtffHist, sizeof(gpsTtffHist));
+  gpsAidUnix = gpsPrefs.getUInt("aid_unix", 0);
+  gpsAidLen = gpsPrefs.getBytes("aid", gpsAid, sizeof(gpsAid));
+  gpsPrefs.end();
+
+  if (h.magic == GPS_HINT_MAGIC) {
+    uint32_t acc = GPS_COLD_POS_ACC_CM;
+    if (now > 1600000000 && h.fixUnix && (uint32_t)now >= h.fixUnix) {
+      uint32_t gone = (uint32_t)now - h.fixUnix;
+      if (gone < GPS_COLD_POS_ACC_CM / 1000) acc = 10000 + gone * 1000;  // 100 m + ~10 m/s of travel
     }
-    BoatEntry b;
-    b.boat_id = p->src;
-    b.user_id = p->user_id;
-    b.display_name = nameStr;
-    b.lat = p->lat1e7 / 1e7;
-    b.lon = p->lon1e7 / 1e7;
-    b.battery = p->batt_pc;
-    b.last_seen_ms = now;
-    nearbyBoats.push_back(b);
+    gpsInjectInit(h, acc);
+    gpsBootAided = true;
+    Serial.printf("[gps] hint from %s: %.5f,%.5f acc=%lum\n", fromRtc ? "rtc" : "nvs",
+                  h.lat1e7 / 1e7, h.lon1e7 / 1e7, (unsigned long)(acc / 100));
   }
+  // Ephemeris is only worth replaying inside its validity window; without a
+  // clock we cannot tell, so replay anyway and let the receiver judge.
+  if (gpsAidLen && now > 1600000000 && (uint32_t)now - gpsAidUnix > GPS_EPH_MAX_AGE_S) gpsAidLen = 0;
+  gpsAidSent = 0;
+  if (gpsAidLen) gpsBootAided = true;
+  gpsPublishStats();
 }
 
-/* ------------ LED MACHINE ------------- */
-enum LedState { LED_OFF, LED_GREEN_SOLID, LED_GREEN_BLINK, LED_RED_SOLID, LED_RED_BLINK, LED_BLUE_PAIRING, LED_BLUE_PAIRED };
-volatile LedState ledState = LED_OFF;
-uint32_t ledStamp = 0;
+// Trickle stored aiding frames into the UART without blocking the loop.
+void gpsAidPump() {
+  if (gpsAidCollecting || gpsAidSent >= gpsAidLen) return;
+  int room = GPSSerial.availableForWrite();
+  if (room <= 0) return;
+  size_t n = min((size_t)room, gpsAidLen - gpsAidSent);
+  GPSSerial.write(gpsAid + gpsAidSent, n);
+  gpsAidSent += n;
+}
+
+// Minimal UBX frame catcher for aiding poll responses; NMEA still goes to TinyGPS.
+uint8_t ubxBuf[4 + 200];   // class, id, len16, payload
+uint16_t ubxPos = 0, ubxLen = 0;
+uint8_t ubxState = 0, ubxCkA = 0, ubxCkB = 0;
 
-void ledPins(bool r, bool g, bool b) {
-  digitalWrite(PIN_RGB_R, r); digitalWrite(PIN_RGB_G, g); digitalWrite(PIN_RGB_B, b);
+void gpsAidStore(const uint8_t *frame, uint16_t len) {
+  uint8_t cls = frame[0], id = frame[1];
+  bool keep = (cls == 0x0B && id == 0x31 && len == 104)   // AID-EPH with data
+           || (cls == 0x0B && id == 0x02 && len == 72)    // AID-HUI
+           || (cls == 0x13 && id == 0x80);                // MGA-DBD
+  if (!keep || gpsAidLen + 8 + len > GPS_AID_MAX) return;
+  uint8_t *o = gpsAid + gpsAidLen;
+  o[0] = 0xB5; o[1] = 0x62;
+  memcpy(o + 2, frame, 4 + len);
+  uint8_t a = 0, b = 0;
+  for (uint16_t i = 0; i < 4 + len; i++) { a += frame[i]; b += a; }
+  o[6 + len] = a; o[7 + len] = b;
+  gpsAidLen += 8 + len;
 }
 
-void ledUpdate() {
-  uint32_t t = millis();
-  switch(ledState) {
-    case LED_GREEN_SOLID:  ledPins(0,1,0); break;
-    case LED_GREEN_BLINK:  ledPins(0, (t/400)%2==0, 0); break;
-    case LED_RED_SOLID:    ledPins(1,0,0); break;
-    case LED_RED_BLINK:    ledPins((t/500)%2==0,0,0); break;
-    case LED_BLUE_PAIRING: {
-      uint32_t c=t%900;
-      if (c<100) ledPins(0,0,1); else if (c<200) ledPins(0,0,0); else if (c<300) ledPins(0,0,1); else ledPins(0,0,0);
+void ubxFeed(uint8_t c) {
+  switch (ubxState) {
+    case 0: if (c == 0xB5) ubxState = 1; break;
+    case 1: ubxState = (c == 0x62) ? 2 : 0; ubxPos = 0; ubxCkA = ubxCkB = 0; break;
+    case 2:  // header
+    case 3:  // payload
+      ubxBuf[ubxPos++] = c; ubxCkA += c; ubxCkB += ubxCkA;
+      if (ubxState == 2 && ubxPos == 4) {
+        ubxLen = ubxBuf[2] | (ubxBuf[3] << 8);
+        ubxState = (ubxLen > sizeof(ubxBuf) - 4) ? 0 : (ubxLen ? 3 : 4);
+      } else if (ubxState == 3 && ubxPos == 4 + ubxLen) {
+        ubxState = 4;
+      }
+      break;
+    case 4: ubxState = (c == ubxCkA) ? 5 : 0; break;
+    case 5:
+      if (c == ubxCkB && gpsAidCollecting) gpsAidStore(ubxBuf, ubxLen);
+      ubxState = 0;
       break;
+  }
+}
+
+void gpsBootFixed(uint32_t now) {
+  gpsTtffMs = now;
+  uint16_t s = now / 1000;
+  uint8_t k = 0;
+  while (k < TTFF_BUCKETS - 1 && s >= TTFF_EDGES_S[k]) k++;
+  gpsTtffHist[gpsBootAided][k]++;
+  gpsPublishStats();
+  gpsAidPollAt = now + GPS_AID_POLL_MS / 6;  // let the receiver finish its own downloads first
+  gpsPrefs.begin(GPS_NVS_NS, false);
+  gpsPrefs.putBytes("ttff", gpsTtffHist, sizeof(gpsTtffHist));
+  gpsPrefs.end();
+  Serial.printf("[gps] TTFF %lu ms (%s)\n", (unsigned long)now, gpsBootAided ? "aided" : "cold");
+}
+
+// Call from loop(): saves hints, keeps the clock set and refreshes aiding.
+void gpsAidService(uint32_t now) {
+  gpsAidPump();
+  if (!nav.valid) return;
+  if (!gpsTtffMs) gpsBootFixed(now);
+
+  uint32_t unix = gpsUnixNow();
+  if (unix && labs((long)(time(nullptr) - (time_t)unix)) > 2) {
+    struct timeval tv = {(time_t)unix, 0};
+    settimeofday(&tv, nullptr);
+  }
+  rtcHint.magic = GPS_HINT_MAGIC;
+  rtcHint.lat1e7 = nav.lat1e7; rtcHint.lon1e7 = nav.lon1e7;
+  rtcHint.alt_cm = gps.altitude.isValid() ? gps.altitude.value() : 0;
+  rtcHint.fixUnix = unix;
+  rtcHint.crc = gpsHintCrc(rtcHint);
+  if (!gpsHintSavedAt || now - gpsHintSavedAt > GPS_HINT_SAVE_MS) {
+    gpsPrefs.begin(GPS_NVS_NS, false);
+    gpsPrefs.putBytes("hint", &rtcHint, sizeof(rtcHint));
+    gpsPrefs.end();
+    gpsHintSavedAt = now;
+  }
+
+  if (!gpsAidCollecting && gpsAidSent >= gpsAidLen && (long)(now - gpsAidPollAt) >= 0
+      && gps.satellites.value() >= 5) {
+    gpsAidLen = gpsAidSent = 0;
+    gpsAidCollecting = true;
+    gpsAidCollectEnd = now + GPS_AID_COLLECT_MS;
+    ubxSend(0x0B, 0x02, nullptr, 0);  // poll AID-HUI
+    ubxSend(0x0B, 0x31, nullptr, 0);  // poll AID-EPH, all SVs
+    ubxSend(0x13, 0x80, nullptr, 0);  // poll MGA-DBD
+  }
+  if (gpsAidCollecting && (long)(now - gpsAidCollectEnd) >= 0) {
+    gpsAidCollecting = false;
+    gpsAidPollAt = now + GPS_AID_POLL_MS;
+    if (gpsAidLen) {
+      gpsAidUnix = unix;
+      gpsPrefs.begin(GPS_NVS_NS, false);
+      gpsPrefs.putBytes("aid", gpsAid, gpsAidLen);
+      gpsPrefs.putUInt("aid_unix", gpsAidUnix);
+      gpsPrefs.end();
     }
-    case LED_BLUE_PAIRED: if (t - ledStamp < 3000) ledPins(0,0,1); break;
-    default: ledPins(0,0,0);
+    gpsAidSent = gpsAidLen;  // collected, nothing to replay
+    gpsPublishStats();
+  }
+}
+
+// NMEA bursts arrive once a second; the sleep planner wakes just before the
+// next one because the UART cannot receive in light sleep.
+const uint32_t GPS_BURST_GAP_MS = 200;   // idle this long means the burst ended
+volatile uint32_t gpsLastByteMs = 0, gpsBurstStartMs = 0;
+
+void gpsNoteBytes(uint32_t now) {
+  if (now - gpsLastByteMs > GPS_BURST_GAP_MS) gpsBurstStartMs = now;
+  gpsLastByteMs = now;
+}
+
+// GSV/GSA/GLL roughly triple the burst length at 9600 baud and the filter
+// does not use them; RMC, GGA and VTG stay on.
+void gpsTrimNmea() {
+  const uint8_t off[] = {0x01, 0x02, 0x03};  // GLL, GSA, GSV
+  for (uint8_t id : off) {
+    uint8_t msg[3] = {0xF0, id, 0};
+    ubxSend(0x06, 0x01, msg, sizeof(msg));
+  }
+}
+
+void handleGpsStats() {
+  portENTER_CRITICAL(&gpsStatsMux);
+  GpsStats g = gpsStatsPub;
+  portEXIT_CRITICAL(&gpsStatsMux);
+  String json = "{\"ttff_ms\":" + String(g.ttffMs);
+  json += ",\"aided\":" + String(g.aided ? "true" : "false");
+  json += ",\"aid_bytes\":" + String(g.aidBytes);
+  json += ",\"rejected\":" + String(navSnapshot().rejected);
+  json += ",\"ttff_edges_s\":[";
+  for (int k = 0; k < TTFF_BUCKETS - 1; k++) json += (k ? "," : "") + String(TTFF_EDGES_S[k]);
+  for (int a = 0; a < 2; a++) {
+    json += a ? "],\"ttff_aided\":[" : "],\"ttff_cold\":[";
+    for (int k = 0; k < TTFF_BUCKETS; k++) json += (k ? "," : "") + String(g.ttffHist[a][k]);
   }
+  json += "]}";
+  http.send(200, "application/json", json);
+}
+
+/* ------------ NEARBY BOATS CACHE (boat_nearby.h) ------------- */
+NearbyCache nearby;  // http task only
+
+/* ------------ LED MACHINE (patterns in boat_led.h) ------------- */
+volatile LedState ledState = LED_OFF;
+uint32_t ledStamp = 0;
+
+void ledUpdate() {
+  uint8_t rgb;
+  if (!ledPattern(ledState, millis(), ledStamp, rgb)) return;
+  digitalWrite(PIN_RGB_R, (rgb & LED_R) != 0); digitalWrite(PIN_RGB_G, (rgb & LED_G) != 0); digitalWrite(PIN_RGB_B, (rgb & LED_B) != 0);
 }
 
 void updateLedByComms() {
   if (!paired) return;
-  if (wanJoined) {
-    ledState = ((millis()-lastMeshHeardMs) < MESH_STALE_MS) ? LED_GREEN_SOLID : LED_GREEN_BLINK;
-  } else {
-    ledState = ((millis()-lastMeshHeardMs) < MESH_STALE_MS) ? LED_RED_BLINK : LED_RED_SOLID;
-  }
+  if (!energyTier().led) { ledState = LED_OFF; return; }
+  ledState = ledForComms(wanJoined, (millis()-lastMeshHeardMs) < MESH_STALE_MS);
 }
 
 /* ------------ BATTERY & NVS ------------ */
-float readBatteryVoltage() {
-  return (analogRead(PIN_BATT_ADC)/4095.0)*ADC_VREF*ADC_SCALE;
+uint16_t readBatteryMv() {
+  return battReadMv() * ADC_SCALE;
+}
+
+// True while a posted request is not yet reflected in energyPub
+bool energyReqPending() {
+  portENTER_CRITICAL(&energyMux);
+  bool p = energyReq.doneGen != energyReq.gen;
+  portEXIT_CRITICAL(&energyMux);
+  return p;
 }
-uint8_t batteryPercent(float v) {
-  if (v < 3.2) return 0; if (v > 4.15) return 100;
-  return (uint8_t)((v-3.2)/(4.15-3.2)*100);
+
+void energyService() {
+  portENTER_CRITICAL(&energyMux);
+  EnergyReq req = energyReq;
+  energyReq.seen = 0;
+  portEXIT_CRITICAL(&energyMux);
+  if (req.seen & 1) energy.setTarget(req.targetEndS);
+  if (req.seen & 2) energy.setCapacity(req.capacityMah);
+
+  uint8_t prev = energyTierNow;
+  uint8_t tier = energy.update(readBatteryMv(), millis() / 1000);
+  EnergyStatus st = energy.status();
+  portENTER_CRITICAL(&energyMux);
+  energyPub = st;
+  energyTierNow = tier;
+  energyReq.doneGen = req.gen;
+  portEXIT_CRITICAL(&energyMux);
+  if (tier != prev)
+    Serial.printf("[energy] %s -> %s (%s)\n", ENERGY_TIERS[prev].name, energyTier().name, st.reason);
 }
 
 const char* NVS_NS = "boat_cfg";
@@ -228,63 +551,176 @@ void clearPairing() {
 bool pairingAPon = false;
 uint32_t pairingAPOffAt = 0;
 
+struct PairReq {
+  char boatId[40];
+  uint16_t userId;       // 0 when the app leaves it out
+  char displayName[40];  // cut to 12 UTF-8 bytes on air by buildPkt()
+};
+
 void handlePair() {
-  if (!http.hasArg("plain")) { http.send(400); return; }
-  String body = http.arg("plain");
-  // Simple JSON parsing (robustness improved in real impl)
-  int bi = body.indexOf("\"boat_id\"");
-  int ui = body.indexOf("\"user_id\"");
-  int di = body.indexOf("\"display_name\"");
-  
-  if (bi < 0) { http.send(400,"application/json","{\"err\":\"missing boat_id\"}"); return; }
-  
-  // Extract values (simplified)
-  String bid = body.substring(body.indexOf('"', body.indexOf(':', bi))+1);
-  bid = bid.substring(0, bid.indexOf('"'));
-  
-  String ustr = body.substring(body.indexOf(':', ui)+1);
-  uint16_t uid = ustr.toInt();
-  
-  String dname = "";
-  if (di > 0) {
-    dname = body.substring(body.indexOf('"', body.indexOf(':', di))+1);
-    dname = dname.substring(0, dname.indexOf('"'));
+  size_t len;
+  const char *body = http.body(len);
+  PairReq req = {};
+  const JsonField fields[] = {
+    JSON_STR_FIELD("boat_id", req.boatId),
+    JSON_UINT_FIELD("user_id", req.userId),
+    JSON_STR_FIELD("display_name", req.displayName),
+  };
+  uint32_t seen;
+  int err = jsonBind(body, len, fields, 3, &seen);
+  if (err != JSON_OK) {
+    http.send(400, "application/json", String("{\"err\":\"") + jsonErrStr(err) + "\"}");
+    return;
   }
+  if (!(seen & 1) || !req.boatId[0]) { http.send(400,"application/json","{\"err\":\"missing boat_id\"}"); return; }
 
-  savePairing(bid, uid, dname);
+  savePairing(req.boatId, req.userId, req.displayName);
   http.send(200, "application/json", "{\"ok\":true}");
   ledState = LED_BLUE_PAIRED; ledStamp = millis();
 }
 
+
 void handleNearby() {
-  String json = "{\"boats\":[";
+  http.send(200, "application/json", nearby.json(millis(), navSnapshot()));
+}
+
+/* ------------ NEARBY STREAM (SSE) ------------- */
+// GET /nearby/stream: one event per cache change instead of re-polling
+// /nearby.
+//   event: boat      data: {"v":N,"boat":{...same object as /nearby...}}
+//   event: gone      data: {"v":N,"boat_id":"12"}
+//   event: snapshot  data: the /nearby body, replaces the app's whole list
+// Each event's SSE id is its version. Reconnecting with Last-Event-ID (or
+// ?since=N) replays the missed events from the cache ring, or sends a snapshot
+// if they are gone. A stream whose queue is full is left behind and caught
+// up later from the ring, so a slow phone never holds up the http task.
+const uint8_t  NEARBY_MAX_STREAMS = 4;
+const uint16_t NEARBY_STREAM_CAP  = NEARBY_JSON_MAX + 512;  // head, a worst-case snapshot and its SSE lines
+const uint32_t NEARBY_PING_MS     = 15000;
+
+struct NearbyStream {
+  uint32_t ticket;       // 0 = free
+  uint32_t ver;          // last version delivered
+  bool snap;             // owes a snapshot before any more events
+  uint32_t lastMs;
+};
+NearbyStream nearbyStreams[NEARBY_MAX_STREAMS];
+
+
+// Pushes what s is missing, oldest first, until its queue fills up
+void nearbyCatchUp(NearbyStream &s, uint32_t now) {
+  if (s.ver == nearby.version() && !s.snap) {
+    if (now - s.lastMs < NEARBY_PING_MS) return;
+    if (http.push(s.ticket, ": ping\n\n", 8) == BH_PUSH_GONE) s.ticket = 0;
+    else s.lastMs = now;
+    return;
+  }
+  NavState nav = navSnapshot();
+  while (s.snap || s.ver != nearby.version()) {
+    if (nearby.version() - s.ver > NEARBY_RING) s.snap = true;
+    String ev;
+    uint32_t next;
+    if (s.snap) {
+      next = nearby.version();
+      ev = "id: " + String(next) + "\nevent: snapshot\ndata: " + nearby.json(now, nav) + "\n\n";
+    } else {
+      next = s.ver + 1;
+      ev = nearbyEventText(nearby.event(next), now, nav);
+    }
+    int r = http.push(s.ticket, ev.c_str(), ev.length());
+    if (r == BH_PUSH_FULL) return;
+    if (r == BH_PUSH_GONE) { s.ticket = 0; return; }
+    s.ver = next;
+    s.snap = false;
+    s.lastMs = now;
+  }
+}
+
+void nearbyStreamService() {
   uint32_t now = millis();
-  for (size_t i=0; i<nearbyBoats.size(); i++) {
-    BoatEntry &b = nearbyBoats[i];
-    uint32_t age = (now - b.last_seen_ms) / 1000;
-    if (i > 0) json += ",";
-    json += "{";
-    json += "\"boat_id\":\"" + String(b.boat_id) + "\",";
-    json += "\"user_id\":" + String(b.user_id) + ",";
-    json += "\"display_name\":\"" + b.display_name + "\",";
-    json += "\"lat\":" + String(b.lat, 6) + ",";
-    json += "\"lon\":" + String(b.lon, 6) + ",";
-    json += "\"age_sec\":" + String(age) + ",";
-    json += "\"battery\":" + String(b.battery) + ",";
-    json += "\"speed_cms\":" + String(b.speed_cms) + ",";
-    json += "\"heading_cdeg\":" + String(b.hdg_cdeg);
-    json += "}";
+  for (auto &s : nearbyStreams) if (s.ticket) nearbyCatchUp(s, now);
+}
+
+void handleNearbyStream() {
+  NearbyStream *s = NULL;
+  for (auto &x : nearbyStreams)
+    if (!x.ticket || http.push(x.ticket, "", 0) == BH_PUSH_GONE) { s = &x; break; }
+  if (!s) { http.send(503, "application/json", "{\"err\":\"too many streams\"}"); return; }
+
+  String last = http.header("Last-Event-ID");
+  if (!last.length()) last = http.arg("since");
+  uint32_t since = strtoul(last.c_str(), NULL, 10);
+
+  uint32_t t = http.stream("text/event-stream", NEARBY_STREAM_CAP);
+  if (!t) return;
+  s->ticket = t;
+  uint32_t ver = nearby.version();
+  s->snap = !last.length() || since > ver || ver - since > NEARBY_RING;
+  s->ver = s->snap ? ver : since;
+  s->lastMs = millis();
+  http.push(t, "retry: 3000\n\n", 13);
+  nearbyCatchUp(*s, s->lastMs);
+}
+
+void handleStatus() {
+  EnergyStatus e = energySnapshot();
+  const EnergyTier &t = ENERGY_TIERS[e.tier];
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "{\"batt_mv\":%u,\"batt_pc\":%.1f,\"remaining_mah\":%lu,\"hours_left\":%.2f,"
+           "\"budget_ma\":%.1f,\"projected_h\":%.1f,\"corr\":%.2f,\"reason\":\"%s\","
+           "\"tier\":{\"name\":\"%s\",\"report_s\":%u,\"relay\":%s,\"dr\":%u,\"led\":%s,"
+           "\"listen\":%s,\"ma\":%u},\"wan\":%s,\"wan_session\":\"%s\",\"paired\":%s}",
+           e.cellMv, e.permille / 10.0, (unsigned long)e.remainingMah, e.hoursLeft, e.budgetMa,
+           e.projectedH, e.corr, e.reason ? e.reason : "", t.name, t.reportSec, t.relay ? "true" : "false",
+           t.dr, t.led ? "true" : "false", t.listen ? "true" : "false", t.mA,
+           wanJoined ? "true" : "false", lmicSessionSource(), paired ? "true" : "false");
+  http.send(200, "application/json", buf);
+}
+
+// {"target_h": 10, "capacity_mah": 2600}, either optional; target counts from now
+void handleEnergy() {
+  size_t len;
+  const char *body = http.body(len);
+  uint32_t targetH = 0, capacity = 0, seen = 0;
+  const JsonField fields[] = {
+    JSON_UINT_FIELD("target_h", targetH),
+    JSON_UINT_FIELD("capacity_mah", capacity),
+  };
+  int err = jsonBind(body, len, fields, 2, &seen);
+  if (err != JSON_OK || ((seen & 1) && (!targetH || targetH > 240)) || ((seen & 2) && (capacity < 100 || capacity > 60000))) {
+    http.send(400, "application/json", String("{\"err\":\"") + (err != JSON_OK ? jsonErrStr(err) : "range") + "\"}");
+    return;
   }
-  json += "]}";
-  http.send(200, "application/json", json);
+  portENTER_CRITICAL(&energyMux);
+  if (seen & 1) energyReq.targetEndS = millis() / 1000 + targetH * 3600;
+  if (seen & 2) energyReq.capacityMah = capacity;
+  energyReq.seen |= seen & 3;
+  energyReq.gen++;
+  portEXIT_CRITICAL(&energyMux);
+  // The ui task re-plans within a loop (20 ms); answer with the new plan
+  for (int i = 0; i < 10 && energyReqPending(); i++) vTaskDelay(pdMS_TO_TICKS(20));
+  handleStatus();
+}
+
+void handleMetrics() {
+  static char buf[2560];
+  profWriteJson(buf, sizeof(buf));
+  http.send(200, "application/json", buf);
+  if (http.arg("reset") == "1") profReset();
 }
 
 void startAP(bool rescue) {
   String ssid = rescue ? ("BOAT-" + boatId) : ("BOAT-PAIR-" + String((uint16_t)ESP.getEfuseMac(), HEX));
   WiFi.softAP(ssid.c_str(), rescue ? "findme-1234" : "pairme-1234");
   
-  http.on("/pair", HTTP_POST, handlePair);
-  http.on("/nearby", HTTP_GET, handleNearby); // NEW API
+  http.on("/pair", BH_POST, handlePair);
+  http.on("/nearby", BH_GET, handleNearby); // NEW API
+  http.on("/nearby/stream", BH_GET, handleNearbyStream);
+  http.on("/gps", BH_GET, handleGpsStats);
+  http.on("/metrics", BH_GET, handleMetrics);
+  http.on("/status", BH_GET, handleStatus);
+  http.on("/energy", BH_POST, handleEnergy);
   // ... other handlers ...
   http.begin();
   pairingAPon = true;
@@ -292,112 +728,384 @@ void startAP(bool rescue) {
 }
 
 /* ------------ RADIO & MESH ------------- */
-int utf8_truncate(const char *src, uint8_t *out, int maxBytes) {
-  int i=0; const unsigned char *s=(const unsigned char*)src;
-  while (*s && i<maxBytes) {
-    int len=1;
-    if ((*s & 0x80)==0) len=1; else if((*s&0xE0)==0xC0) len=2; else if((*s&0xF0)==0xE0) len=3; else if((*s&0xF8)==0xF0) len=4; else break;
-    if (i+len > maxBytes) break;
-    for (int k=0;k<len;k++) out[i++] = *s++;
-  }
-  return i;
-}
-
 void buildPkt(Pkt &p) {
-  p.src = boatId_u16; p.seq = ++seqno;
-  if (gps.location.isValid()) { p.lat1e7 = gps.location.lat()*1e7; p.lon1e7 = gps.location.lng()*1e7; }
-  p.spd_cms = gps.speed.mps()*100; p.hdg_cdeg = gps.course.deg()*100;
-  p.batt_pc = batteryPercent(readBatteryVoltage());
-  p.hops = 0; p.user_id = userId_u16;
-  memset(p.name_utf8, 0, 12);
-  p.name_len = utf8_truncate(displayName.c_str(), p.name_utf8, 12);
-  p.crc = 0; p.crc = crc16_ccitt((uint8_t*)&p, sizeof(Pkt)-2);
+  pktBuild(p, boatId_u16, (uint16_t)seq.next(), navSnapshot(), energySnapshot().permille / 10,
+           userId_u16, displayName.c_str());
 }
 
-bool meshInit() {
-  int st = lora.begin(MESH_FREQ_MHZ, 125.0, MESH_SF, 5, 0x34, MESH_TX_DBM);
-  lora.setCRC(true);
-  return st == RADIOLIB_ERR_NONE;
+// DIO0 (RxDone) raises mesh.rxFlag and wakes the radio task, awake or asleep.
+TaskHandle_t radioTaskH = NULL;
+
+void IRAM_ATTR onMeshDio0() {
+  mesh.rxFlag = true;
+  BaseType_t hp = pdFALSE;
+  if (radioTaskH) vTaskNotifyGiveFromISR(radioTaskH, &hp);
+  if (hp) portYIELD_FROM_ISR();
 }
 
 /* ------------ LORAWAN (Stubbed for brevity) ------------- */
 void os_getArtEui(u1_t *b){memcpy(b, APPEUI, 8);}
 void os_getDevEui(u1_t *b){memcpy(b, DEVEUI, 8);}
 void os_getDevKey(u1_t *b){memcpy(b, APPKEY, 16);}
-void onLmicEvent(ev_t ev) { if (ev==EV_JOINED) wanJoined=true; }
-void lorawanInit() { os_init(); LMIC_reset(); LMIC_startJoining(); }
-bool lorawanSend(const uint8_t *buf, uint8_t len) {
-  if (!wanJoined || (LMIC.opmode & OP_TXRXPEND)) return false;
-  LMIC_setTxData2(LORAWAN_FPORT, (xref2u1_t)buf, len, 0);
+uint8_t wanDrApplied = 0xFF;  // radio task; LMIC picks its own DR on join
+uint8_t wanRx[MAX_LEN_PAYLOAD];  // last downlink on DIGEST_FPORT, radio task
+uint8_t wanRxLen = 0;
+
+void onLmicEvent(ev_t ev) {
+  if (ev==EV_JOINED) { wanJoined=true; wanDrApplied=0xFF; LMIC_setAdrMode(0); lmicSessionSave(); }
+  if (ev==EV_TXCOMPLETE) lmicSessionTx();
+  if (ev==EV_TXCOMPLETE && LMIC.dataLen && (LMIC.txrxFlags & TXRX_PORT) && LMIC.frame[LMIC.dataBeg-1]==DIGEST_FPORT) {
+    memcpy(wanRx, LMIC.frame + LMIC.dataBeg, LMIC.dataLen); wanRxLen = LMIC.dataLen;
+  }
+  // Network no longer answers (e.g. it forgot a restored session): start over
+  if (ev==EV_LINK_DEAD) { wanJoined=false; lmicSessionForget(); LMIC_unjoinAndRejoin(); }
+  // One uplink at a time (lorawanSend refuses while one is queued or in
+  // flight); pendTxPort still names the frame that just completed
+  if (ev==EV_TXCOMPLETE && journalTxAddr && LMIC.pendTxPort==BACKLOG_FPORT) journal.markSent(journalTxAddr);
+  if (ev==EV_TXCOMPLETE || ev==EV_TXCANCELED || ev==EV_RESET || ev==EV_LINK_DEAD) journalTxAddr = 0;
+}
+void onEvent(ev_t ev) { onLmicEvent(ev); }
+void lorawanInit() {
+  os_init(); LMIC_reset();
+  if (lmicSessionRestore()) { wanJoined=true; LMIC_setAdrMode(0); LMIC_setLinkCheckMode(1); }
+  else LMIC_startJoining();
+  Serial.printf("[wan] session %s\n", lmicSessionSource());
+}
+bool lorawanSend(const uint8_t *buf, uint8_t len, uint8_t port = LORAWAN_FPORT) {
+  if (!wanJoined || (LMIC.opmode & (OP_TXDATA | OP_TXRXPEND))) return false;  // never replace a queued frame
+  LMIC_setTxData2(port, (xref2u1_t)buf, len, 0);
   return true;
 }
 
+/* ------------ JOURNAL (store-and-forward) ------------- */
+// Unsent blocks go out one per JOURNAL_DRAIN_MS, highest priority then oldest,
+// as [u16 src][body] on BACKLOG_FPORT. Without a join they go over the mesh
+// as a backlog frame, [BACKLOG_MAGIC][u16 src][body][crc16], which any joined
+// boat forwards unchanged minus magic and crc. Mesh has no acks, so a block
+// counts as sent after one mesh TX, and only while a neighbour was heard.
+// BACKLOG_MAGIC is in boat_mesh.h, which also decides what a receiver does.
+const uint32_t JOURNAL_DRAIN_MS = 15000;
+const uint32_t JOURNAL_MESH_PEER_MS = 120000;
+uint32_t journalLastDrainMs = 0;
+
+// Alert priority once the battery is into the reserve: those may be the last
+// positions the shore gets, so they drain ahead of the backlog. There is no
+// SOS trigger on this node yet; one would log with JOURNAL_PRIO_SOS.
+uint8_t journalPrio() {
+  EnergyStatus e = energySnapshot();
+  return e.cellMv && e.permille <= ENERGY_RESERVE_PM ? JOURNAL_PRIO_ALERT : JOURNAL_PRIO_NORMAL;
+}
+
+void journalLog(const Pkt &p, bool sent, uint8_t prio) {
+  uint32_t t = gpsUnixNow();
+  if (!t || (!p.lat1e7 && !p.lon1e7)) return;  // no time or no fix, nothing to replay
+  JournalRec r = {t, p.lat1e7, p.lon1e7, p.spd_cms, p.hdg_cdeg, p.batt_pc, prio};
+  journal.append(r, sent, millis());
+}
+
+void journalDrain(uint32_t now) {
+  if (journalTxAddr || now - journalLastDrainMs < JOURNAL_DRAIN_MS) return;
+  if ((long)(nextSendAtMs - now) < 2000) return;  // the live report goes first
+  bool mesh = !wanJoined && lastMeshHeardMs && now - lastMeshHeardMs < JOURNAL_MESH_PEER_MS;
+  if (!wanJoined && !mesh) return;
+
+  uint32_t addr; uint8_t body[JOURNAL_BODY_MAX], len, prio;
+  if (!journal.nextUnsent(addr, body, len, prio)) return;
+  journalLastDrainMs = now;
+
+  uint8_t f[1 + 2 + JOURNAL_BODY_MAX + 1 + 2];
+  f[0] = BACKLOG_MAGIC;
+  memcpy(f + 1, &boatId_u16, 2);
+  memcpy(f + 3, body, len);
+  size_t n = 3 + len;
+  if (wanJoined) {
+    PROF_SCOPE("radio.tx");
+    if (lorawanSend(f + 1, n - 1, BACKLOG_FPORT)) journalTxAddr = addr;
+    return;
+  }
+  if (n + 2 == sizeof(Pkt)) f[n++] = 0;  // never the length of a Pkt
+  uint16_t c = crc16_ccitt(f, n);
+  memcpy(f + n, &c, 2); n += 2;
+  PROF_SCOPE("radio.tx");
+  int st = meshTransmit(mesh, f, n);
+  if (st == RADIOLIB_ERR_NONE) journal.markSent(addr);
+}
+
+/* ------------ TASKS ------------- */
+// radio (core 1, highest): LMIC runloop, mesh RX/relay/report. Sole owner of the SX1276/SPI.
+// gps   (core 1):          UART drain, nav filter, hot-start bookkeeping.
+// http  (core 0):          WebServer + nearby cache, fed by meshRxQueue and cloudRxQueue.
+// ui    (core 0, lowest):  LED state machine and radio latency report.
+// nearbyBoats is only touched by the http task; nav goes through navSnapshot().
+const uint8_t MESH_RX_QUEUE_LEN = 16;
+const uint8_t MESH_TX_QUEUE_LEN = 8;
+const uint32_t RT_REPORT_MS = 60000;
+
+struct MeshTx {
+  Pkt pkt;
+  uint32_t dueMs;  // relay jitter, replaces the old blocking delay()
+};
+
+QueueHandle_t meshRxQueue;  // radio -> http, received packets for the cache
+QueueHandle_t meshTxQueue;  // -> radio, delayed mesh transmissions
+QueueHandle_t cloudRxQueue; // radio -> http, digest entries for the cache
+TaskHandle_t gpsTaskH, httpTaskH, uiTaskH;
+
+// Radio task timing, reset every RT_REPORT_MS by the ui task.
+volatile uint32_t rtMaxGapUs = 0, rtMaxBusyUs = 0, rtLateCount = 0, rtDropped = 0;
+
+/* Sleep planner. The radio task owns every deadline that matters (LMIC jobs,
+   reports, queued mesh TX) and knows about the others (LED edges, the next
+   GPS burst), so it decides when the whole chip can light-sleep. */
+const uint32_t SLEEP_MIN_MS      = 20;   // below this, wake-up cost outweighs the gain
+const uint32_t SLEEP_MAX_MS      = 10000;
+const uint32_t GPS_WAKE_LEAD_MS  = 30;   // be awake before the next NMEA burst
+
+// Power accounting, reset every RT_REPORT_MS by the ui task.
+volatile uint64_t pwrSleepUs = 0;
+volatile uint32_t pwrWakeTimer = 0, pwrWakeGpio = 0, pwrWakeUart = 0;
+int64_t pwrSinceUs = 0;
+
+static void sleepBound(uint32_t &ms, uint32_t now, uint32_t at) {
+  long d = (long)(at - now);
+  if (d < 0) d = 0;
+  if ((uint32_t)d < ms) ms = d;
+}
+
+uint32_t sleepPlanMs() {
+  if (!BOAT_LIGHT_SLEEP || pairingAPon) return 0;
+  if (mesh.rxFlag || (LMIC.opmode & (OP_TXRXPEND | OP_POLL))) return 0;
+  uint32_t now = millis();
+  if (now - gpsLastByteMs < GPS_BURST_GAP_MS) return 0;  // mid-burst, UART needs the clock
+
+  uint32_t ms = SLEEP_MAX_MS;
+  sleepBound(ms, now, nextSendAtMs);
+  MeshTx tx;
+  if (xQueuePeek(meshTxQueue, &tx, 0) == pdTRUE) sleepBound(ms, now, tx.dueMs);
+  uint32_t led = ledNextEdgeMs(ledState, now, ledStamp);
+  if (led) sleepBound(ms, now, led);
+  if (gpsBurstStartMs) {
+    uint32_t next = gpsBurstStartMs + 1000 * ((now - gpsBurstStartMs) / 1000 + 1);
+    sleepBound(ms, now, next - GPS_WAKE_LEAD_MS);
+  }
+  // LMIC has no "next deadline" call, only "anything due within t?", so halve down to it.
+  while (ms >= SLEEP_MIN_MS && os_queryTimeCriticalJobs(ms2osticks(ms))) ms /= 2;
+  return ms >= SLEEP_MIN_MS ? ms : 0;
+}
+
+void lightSleep(uint32_t ms) {
+  esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+  gpio_wakeup_enable((gpio_num_t)PIN_LORA_DIO0, GPIO_INTR_HIGH_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  uart_set_wakeup_threshold(UART_NUM_1, 3);  // first few bytes of the burst are lost
+  esp_sleep_enable_uart_wakeup(UART_NUM_1);
+
+  int64_t t0 = esp_timer_get_time();
+  esp_light_sleep_start();
+  pwrSleepUs += esp_timer_get_time() - t0;
+
+  switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_TIMER: pwrWakeTimer++; break;
+    case ESP_SLEEP_WAKEUP_GPIO:  pwrWakeGpio++;  mesh.rxFlag = true; break;
+    case ESP_SLEEP_WAKEUP_UART:  pwrWakeUart++;  gpsNoteBytes(millis()); break;
+    default: break;
+  }
+  // gpio_wakeup_enable() also made the pin's interrupt level-triggered; put
+  // back meshInit()'s RISING edge or onMeshDio0 fires until DIO0 is cleared.
+  gpio_wakeup_disable((gpio_num_t)PIN_LORA_DIO0);
+  gpio_set_intr_type((gpio_num_t)PIN_LORA_DIO0, GPIO_INTR_POSEDGE);
+  ledUpdate();  // an LED edge may be why we woke; the ui task runs late after sleep
+}
+
+// Positions in the digest are relative to our own, so it is decoded here
+// while the fix is current; the cache itself belongs to the http task.
+void digestReceive() {
+  DigestBoat d[DIGEST_MAX_BOATS];
+  NavState nav = navSnapshot();
+  uint8_t n = nav.valid ? digestDecode(wanRx, wanRxLen, nav.lat1e7, nav.lon1e7, d, DIGEST_MAX_BOATS) : 0;
+  wanRxLen = 0;
+  for (uint8_t i = 0; i < n; i++)
+    if (xQueueSend(cloudRxQueue, &d[i], 0) != pdTRUE) rtDropped++;
+}
+
+void radioTask(void *) {
+  int64_t last = esp_timer_get_time();
+  bool lmicWasBusy = false;
+  for (;;) {
+    int64_t t0 = esp_timer_get_time();
+    uint32_t gap = t0 - last;
+    if (gap > rtMaxGapUs) rtMaxGapUs = gap;
+    if (gap > 5000) rtLateCount++;
+
+    { PROF_SCOPE("radio.lmic"); os_runloop_once(); }
+    if (wanRxLen) digestReceive();
+    bool lmicBusy = LMIC.opmode & OP_TXRXPEND;
+    mesh.listen = energyTier().listen;  // off: the chip sleeps between reports
+    if (lmicWasBusy && !lmicBusy) meshRetune(mesh);
+    lmicWasBusy = lmicBusy;
+
+    uint8_t buf[128]; size_t bl;
+    if (!lmicBusy && mesh.rxFlag) {
+      PROF_SCOPE("radio.rx");
+      bl = meshReceive(mesh, buf, sizeof(buf));
+      MeshFrame kind = bl ? meshClassify(buf, bl) : MESH_FRAME_BAD;
+      if (kind == MESH_FRAME_BACKLOG) {
+        // Someone's journal backlog: pass it up if we have a gateway
+        lastMeshHeardMs = millis();
+        if (wanJoined) lorawanSend(buf + 1, bl - 3, BACKLOG_FPORT);
+      }
+      Pkt *rp=(Pkt*)buf;
+      if (kind == MESH_FRAME_PKT) {
+        lastMeshHeardMs=millis();
+
+        // 1. Update Cache for Mobile App (owned by the http task)
+        if (xQueueSend(meshRxQueue, rp, 0) != pdTRUE) rtDropped++;
+
+        // 2. Mesh Forwarding (Flood Fill), sent later from meshTxQueue
+        MeshTx tx;
+        if (energyTier().relay && meshRelay(*rp, tx.pkt)) {
+          tx.dueMs = millis() + random(MESH_RELAY_MIN_MS, MESH_RELAY_MAX_MS); // Jitter
+          if (xQueueSend(meshTxQueue, &tx, 0) != pdTRUE) rtDropped++;
+        }
+
+        // 3. Gateway Forwarding (Any-cast), a hop on so the backend can tell our own reports
+        Pkt up;
+        if (wanJoined && energyTier().relay && meshUplink(*rp, up)) lorawanSend((uint8_t*)&up, sizeof(up));
+      }
+    }
+
+    MeshTx tx;
+    if (!lmicBusy && xQueuePeek(meshTxQueue, &tx, 0) == pdTRUE && (long)(millis()-tx.dueMs)>=0) {
+      xQueueReceive(meshTxQueue, &tx, 0);
+      PROF_SCOPE("radio.tx");
+      meshSend(mesh, tx.pkt);
+    }
+
+    // Periodic Report: mesh always so others can see us, WAN as well if joined
+    if (!lmicBusy && (long)(millis()-nextSendAtMs)>=0) {
+      nextSendAtMs = millis() + energyTier().reportSec*1000UL + random(0,REPORT_JITTER_S*1000);
+      Pkt p; buildPkt(p);
+      PROF_SCOPE("radio.tx");
+      meshSend(mesh, p);
+      journalLog(p, wanJoined && lorawanSend((uint8_t*)&p, sizeof(p)), journalPrio());
+    }
+
+    if (!lmicBusy && wanJoined && energyTier().dr != wanDrApplied) {
+      wanDrApplied = energyTier().dr;
+      LMIC_setDrTxpow(wanDrApplied, 14);
+    }
+
+    if (!lmicBusy) { PROF_SCOPE("radio.journal"); journal.service(millis()); journalDrain(millis()); }
+
+    last = esp_timer_get_time();
+    uint32_t busy = last - t0;
+    if (busy > rtMaxBusyUs) rtMaxBusyUs = busy;
+
+    uint32_t sleepMs = sleepPlanMs();
+    if (sleepMs) {
+      lightSleep(sleepMs);
+      last = esp_timer_get_time();  // planned idle is not latency
+    } else {
+      ulTaskNotifyTake(pdTRUE, 1);  // DIO0 or the next tick, whichever first
+    }
+  }
+}
+
+void gpsTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));  // GPSSerial.onReceive() wakes us
+    if (GPSSerial.available()) gpsNoteBytes(millis());
+    {
+      PROF_SCOPE("gps.drain");
+      while(GPSSerial.available()) { uint8_t c = GPSSerial.read(); ubxFeed(c); gps.encode(c); }
+    }
+    if (gps.location.isUpdated()) { PROF_SCOPE("gps.nav"); navUpdate(millis()); }
+    { PROF_SCOPE("gps.aid"); gpsAidService(millis()); }
+  }
+}
+
+void httpTask(void *) {
+  Pkt p;
+  DigestBoat d;
+  for (;;) {
+    while (xQueueReceive(meshRxQueue, &p, 0) == pdTRUE) { PROF_SCOPE("http.cache"); nearby.update(p, millis()); }
+    while (xQueueReceive(cloudRxQueue, &d, 0) == pdTRUE) { PROF_SCOPE("http.cache"); nearby.updateCloud(d, boatId_u16, millis()); }
+    if (pairingAPon) { PROF_SCOPE("http.client"); http.handleClient(); }
+    if (pairingAPon) { PROF_SCOPE("http.stream"); nearbyStreamService(); }
+    vTaskDelay(pdMS_TO_TICKS(5));
+  }
+}
+
+void uiTask(void *) {
+  uint32_t lastReport = millis(), lastEnergy = millis();
+  for (;;) {
+    { PROF_SCOPE("ui.led"); updateLedByComms(); ledUpdate(); }
+    if (millis() - lastEnergy > ENERGY_PERIOD_MS || energyReqPending()) {
+      PROF_SCOPE("ui.energy"); energyService(); lastEnergy = millis();
+    }
+    if (millis() - lastReport > RT_REPORT_MS) {
+      profPrint(Serial);
+      Serial.printf("[rt] radio gap max %lu us, busy max %lu us, >5ms %lu, q drops %lu\n",
+                    (unsigned long)rtMaxGapUs, (unsigned long)rtMaxBusyUs,
+                    (unsigned long)rtLateCount, (unsigned long)rtDropped);
+      rtMaxGapUs = rtMaxBusyUs = rtLateCount = 0;
+      int64_t now = esp_timer_get_time();
+      Serial.printf("[pwr] light sleep %.1f%%, wakes timer %lu gpio %lu uart %lu\n",
+                    100.0 * pwrSleepUs / (now - pwrSinceUs), (unsigned long)pwrWakeTimer,
+                    (unsigned long)pwrWakeGpio, (unsigned long)pwrWakeUart);
+      pwrSleepUs = 0; pwrWakeTimer = pwrWakeGpio = pwrWakeUart = 0; pwrSinceUs = now;
+      EnergyStatus es = energySnapshot();
+      Serial.printf("[energy] %u mV %.1f%%, tier %s, budget %.1f mA, corr %.2f, lasts %.1f h\n",
+                    es.cellMv, es.permille / 10.0, ENERGY_TIERS[es.tier].name, es.budgetMa, es.corr, es.projectedH);
+      JournalStats js = journal.stats();
+      Serial.printf("[jrnl] blocks %lu unsent %lu dropped %lu torn %lu lost %lu, head %u/%u\n",
+                    (unsigned long)js.blocks, (unsigned long)js.unsent, (unsigned long)js.dropped,
+                    (unsigned long)js.torn, (unsigned long)js.lost, js.head, js.sectors);
+      lastReport = millis();
+    }
+    vTaskDelay(pdMS_TO_TICKS(20));
+  }
+}
+
 /* ------------ SETUP & LOOP ------------- */
 void setup() {
   Serial.begin(115200);
   pinMode(PIN_RGB_R,OUTPUT); pinMode(PIN_RGB_G,OUTPUT); pinMode(PIN_RGB_B,OUTPUT);
   pinMode(PIN_BTN,INPUT_PULLUP); pinMode(PIN_BUZZER,OUTPUT);
-  GPSSerial.begin(9600, SERIAL_8N1, PIN_GPS_RX, -1);
-  analogReadResolution(12);
+  if (BOAT_LIGHT_SLEEP) setCpuFrequencyMhz(80);  // plenty for this loop, ~40% less active current
+  GPSSerial.begin(9600, SERIAL_8N1, PIN_GPS_RX, PIN_GPS_TX);
+  GPSSerial.onReceive([]() { if (gpsTaskH) xTaskNotifyGive(gpsTaskH); });
+  battAdcInit(PIN_BATT_ADC);
+  energy.begin(ENERGY_CAPACITY_MAH, ENERGY_TARGET_H * 3600UL, 0);
+  energyService();  // first packet needs a battery value
   loadPairing();
+  seq.begin();
+  Serial.printf("[seq] boot epoch %lu\n", (unsigned long)seq.epoch());
+  gpsHotStart();
+  gpsTrimNmea();
+
+  meshRxQueue = xQueueCreate(MESH_RX_QUEUE_LEN, sizeof(Pkt));
+  meshTxQueue = xQueueCreate(MESH_TX_QUEUE_LEN, sizeof(MeshTx));
+  cloudRxQueue = xQueueCreate(DIGEST_MAX_BOATS, sizeof(DigestBoat));
 
   if (!paired) {
     startAP(false);
     ledState = LED_BLUE_PAIRING;
   } else {
     ledState = LED_BLUE_PAIRED; ledStamp = millis();
-    meshInit();
+    if (!journal.begin()) Serial.println("[jrnl] no journal partition, fixes are not kept");
+    meshInit(mesh, onMeshDio0);
     lorawanInit();
   }
   nextSendAtMs = millis() + REPORT_SEC*1000;
+
+  // Radios only start when paired at boot, so pairing (http) never races buildPkt (radio).
+  if (paired) xTaskCreatePinnedToCore(radioTask, "radio", 6144, NULL, 5, &radioTaskH, 1);
+  xTaskCreatePinnedToCore(gpsTask,  "gps",  4096, NULL, 3, &gpsTaskH,  1);
+  xTaskCreatePinnedToCore(httpTask, "http", 8192, NULL, 2, &httpTaskH, 0);
+  xTaskCreatePinnedToCore(uiTask,   "ui",   3072, NULL, 1, &uiTaskH,   0);
 }
 
 void loop() {
-  os_runloop_once();
-  while(GPSSerial.available()) gps.encode(GPSSerial.read());
-
-  if (pairingAPon) http.handleClient();
-
-  // Mesh Reception
-  uint8_t buf[128]; size_t bl=sizeof(buf);
-  if (lora.available() && lora.receive(buf, bl) == RADIOLIB_ERR_NONE && bl==sizeof(Pkt)) {
-    Pkt *rp=(Pkt*)buf;
-    uint16_t s=rp->crc; rp->crc=0;
-    if (s==crc16_ccitt((uint8_t*)rp, sizeof(Pkt)-2)) {
-      lastMeshHeardMs=millis();
-      
-      // 1. Update Cache for Mobile App
-      updateNearbyCache(rp);
-
-      // 2. Mesh Forwarding (Flood Fill)
-      if (rp->hops < 4) {
-        rp->hops++;
-        rp->crc = crc16_ccitt((uint8_t*)rp, sizeof(Pkt)-2); // Re-sign
-        delay(random(200,600)); // Jitter
-        lora.transmit((uint8_t*)rp, sizeof(Pkt));
-      }
-
-      // 3. Gateway Forwarding (Any-cast)
-      // If we have WAN, forward this packet to cloud!
-      if (wanJoined) {
-        lorawanSend((uint8_t*)rp, sizeof(Pkt));
-      }
-    }
-  }
-
-  // Periodic Report
-  if ((long)(millis()-nextSendAtMs)>=0) {
-    nextSendAtMs = millis() + REPORT_SEC*1000 + random(0,REPORT_JITTER_S*1000);
-    if (paired) {
-      Pkt p; memset(&p,0,sizeof(p)); buildPkt(p);
-      // If we have WAN, send there. Else mesh.
-      // Actually, send to mesh ALWAYS so others can see us
-      lora.transmit((uint8_t*)&p, sizeof(p));
-      
-      if (wanJoined) lorawanSend((uint8_t*)&p, sizeof(p));
-    }
-  }
-
-  updateLedByComms();
-  ledUpdate();
+  vTaskDelete(NULL);  // everything runs in the tasks above
 }
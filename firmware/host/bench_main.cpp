@@ -0,0 +1,42 @@
+/*
+  boatnode_bench - BoatBench cases under Google Benchmark
+
+    boatnode_bench --benchmark_format=json --benchmark_out=bench.json
+    BOAT_NMEA_LOG=ride.nmea boatnode_bench --benchmark_filter=nmea
+
+  Setup and teardown run outside the timed loop. Next to the usual times
+  every case reports "cycles" per iteration (the TSC on x86) and, where a
+  case handles a known number of bytes, bytes_per_second; the context
+  carries boat_fw (git describe at configure time) so runs from different
+  firmware versions can be told apart and compared with
+  tools/compare.py from Google Benchmark.
+*/
+#include <Arduino.h>
+#include <boat_bench.h>
+#include <benchmark/benchmark.h>
+
+static void runCase(benchmark::State &state, const BenchCase *bc) {
+  void *ctx = bc->setup(bc->arg);
+  if (!ctx) {
+    state.SkipWithError("setup failed");
+    return;
+  }
+  uint64_t c0 = benchCycles();
+  for (auto _ : state) bc->step(ctx);
+  uint64_t cyc = benchCycles() - c0;
+  state.counters["cycles"] = benchmark::Counter((double)cyc, benchmark::Counter::kAvgIterations);
+  if (bc->bytes) state.SetBytesProcessed((int64_t)state.iterations() * bc->bytes(ctx));
+  bc->teardown(ctx);
+}
+
+int main(int argc, char **argv) {
+  for (size_t i = 0; i < BENCH_CASE_COUNT; i++)
+    benchmark::RegisterBenchmark(BENCH_CASES[i].name, runCase, &BENCH_CASES[i]);
+  benchmark::AddCustomContext("boat_fw", BOAT_FW_VERSION);
+  benchmark::AddCustomContext("cycle_counter", benchCycleSource());
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
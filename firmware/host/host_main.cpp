@@ -0,0 +1,180 @@
+/*
+  boatnode_host - the firmware core on a PC
+
+  One node ("us") and N other boats share the shim radio. The boats drift
+  around a harbour and report every REPORT_SEC like BoatNode v2 does; we
+  filter our own synthetic GPS fixes through NavFilter, take their packets
+  through the same checks as the radio task (CRC, relay), keep them in the
+  NearbyCache and finally print what GET /nearby would answer, followed by
+  the BoatProf report for the probes below.
+
+    boatnode_host [-n boats] [-m minutes] [-s seed] [-q]
+
+  Time is simulated (hostClockManual), so -m 600 finishes in well under a
+  second. -q leaves out the /nearby body.
+*/
+#include <Arduino.h>
+#include <RadioLib.h>
+#include <boat_pkt.h>
+#include <boat_mesh.h>
+#include <boat_mesh_radio.h>
+#include <boat_nav.h>
+#include <boat_nearby.h>
+#include <boat_led.h>
+#include <boat_seq.h>
+#include <boat_prof.h>
+#include <getopt.h>
+#include <vector>
+#include <random>
+
+const uint16_t REPORT_SEC = 120;
+const uint16_t REPORT_JITTER_S = 20;
+const uint32_t MESH_STALE_MS = 10UL * 60UL * 1000UL;
+const int32_t HARBOUR_LAT = 95000000, HARBOUR_LON = 763000000;  // off Kochi
+
+struct Boat {
+  SX1276 *radio;
+  uint16_t id;
+  double lat, lon;       // degrees
+  double vn, ve;         // m/s
+  uint32_t nextMs;
+  uint16_t seq;
+};
+
+static SX1276 lora = new Module(5, 26, 14, 18);
+static MeshRadio mesh = {&lora, false, true};
+static void onDio0() { mesh.rxFlag = true; }
+
+int main(int argc, char **argv) {
+  int nBoats = 30, minutes = 60;
+  unsigned seed = 1;
+  bool quiet = false;
+  for (int c; (c = getopt(argc, argv, "n:m:s:q")) != -1;) {
+    switch (c) {
+      case 'n': nBoats = atoi(optarg); break;
+      case 'm': minutes = atoi(optarg); break;
+      case 's': seed = strtoul(optarg, NULL, 10); break;
+      case 'q': quiet = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-n boats] [-m minutes] [-s seed] [-q]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (nBoats < 0 || nBoats > 65000 || minutes <= 0) { fprintf(stderr, "bad arguments\n"); return 2; }
+
+  hostClockManual(1000000);
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uni(-1.0, 1.0);
+  std::normal_distribution<double> gpsNoise(0.0, 3.0);  // metres
+
+  meshInit(mesh, onDio0);
+
+  std::vector<Boat> boats(nBoats);
+  for (int i = 0; i < nBoats; i++) {
+    Boat &b = boats[i];
+    b.radio = new SX1276(new Module(5, 26, 14, 18));
+    b.radio->begin(MESH_FREQ_MHZ, 125.0, MESH_SF, 5, MESH_SYNC_WORD, MESH_TX_DBM);
+    b.id = 100 + i;
+    b.lat = HARBOUR_LAT / 1e7 + uni(rng) * 0.1;
+    b.lon = HARBOUR_LON / 1e7 + uni(rng) * 0.1;
+    b.vn = uni(rng) * 4; b.ve = uni(rng) * 4;
+    b.nextMs = millis() + (uint32_t)((uni(rng) + 1) * REPORT_SEC * 500);
+    b.seq = 0;
+  }
+
+  BoatSeq seq;
+  seq.begin();
+  NavFilter navFilter;
+  NearbyCache nearby;
+  LedState led = LED_OFF;
+  uint32_t ledChanges = 0, lastMeshMs = 0, relayed = 0, badCrc = 0, rx = 0;
+  double selfLat = HARBOUR_LAT / 1e7, selfLon = HARBOUR_LON / 1e7;
+  Pkt own;
+
+  uint32_t endMs = millis() + (uint32_t)minutes * 60000;
+  uint32_t nextFixMs = millis(), nextOwnMs = millis() + REPORT_SEC * 1000;
+  while ((int32_t)(millis() - endMs) < 0) {
+    uint32_t now = millis();
+
+    // Our GPS, 1 Hz, slow steady course with a few metres of noise
+    if ((int32_t)(now - nextFixMs) >= 0) {
+      nextFixMs += 1000;
+      selfLat += 1.5 / 111320.0;
+      selfLon += 1.0 / (111320.0 * cos(selfLat * DEG_TO_RAD));
+      NavFix f;
+      f.lat1e7 = (int32_t)((selfLat + gpsNoise(rng) / 111320.0) * 1e7);
+      f.lon1e7 = (int32_t)((selfLon + gpsNoise(rng) / 111320.0) * 1e7);
+      f.hdop_x100 = 120; f.sats = 9;
+      f.courseValid = false; f.courseDeg = 0;
+      f.speedValid = false; f.speedMps = 0;
+      PROF_SCOPE("nav.update");
+      navFilter.update(f, now);
+    }
+
+    for (Boat &b : boats) {
+      if ((int32_t)(now - b.nextMs) < 0) continue;
+      double dt = (REPORT_SEC + (b.nextMs % REPORT_JITTER_S));
+      b.lat += b.vn * dt / 111320.0;
+      b.lon += b.ve * dt / (111320.0 * cos(b.lat * DEG_TO_RAD));
+      b.nextMs = now + REPORT_SEC * 1000 + (uint32_t)((uni(rng) + 1) * REPORT_JITTER_S * 500);
+      NavState s = {};
+      s.valid = true;
+      s.lat1e7 = (int32_t)(b.lat * 1e7); s.lon1e7 = (int32_t)(b.lon * 1e7);
+      s.spd_cms = (uint16_t)(sqrt(b.vn * b.vn + b.ve * b.ve) * 100);
+      s.hdg_cdeg = (uint16_t)fmod(atan2(b.ve, b.vn) * RAD_TO_DEG * 100 + 36000, 36000);
+      char name[16];
+      snprintf(name, sizeof(name), "Boat %u", b.id);
+      Pkt p;
+      pktBuild(p, b.id, b.seq++, s, 80, b.id, name);
+      if (uni(rng) > 0.98) p.lat1e7 ^= 1;  // the odd corrupted frame
+      b.radio->transmit((uint8_t *)&p, sizeof(p));
+
+      // What the radio task does with it
+      if (mesh.rxFlag) {
+        rx++;
+        uint8_t buf[128];
+        size_t bl = meshReceive(mesh, buf, sizeof(buf));
+        if (!bl || meshClassify(buf, bl) != MESH_FRAME_PKT) { badCrc++; continue; }
+        Pkt in, fwd;
+        memcpy(&in, buf, sizeof(in));
+        lastMeshMs = now;
+        {
+          PROF_SCOPE("mesh.relay");
+          if (meshRelay(in, fwd)) relayed++;
+        }
+        PROF_SCOPE("http.cache");
+        nearby.update(in, now);
+      }
+    }
+
+    if ((int32_t)(now - nextOwnMs) >= 0) {
+      nextOwnMs += REPORT_SEC * 1000;
+      PROF_SCOPE("radio.tx");
+      pktBuild(own, 1, (uint16_t)seq.next(), navFilter.state(), 90, 1, "Host node");
+      meshSend(mesh, own);
+    }
+
+    LedState l = ledForComms(false, lastMeshMs && now - lastMeshMs < MESH_STALE_MS);
+    if (l != led) { led = l; ledChanges++; }
+
+    hostClockAdvanceUs(100000);
+  }
+
+  uint32_t now = millis();
+  String body;
+  {
+    PROF_SCOPE("http.nearby");
+    body = nearby.json(now, navFilter.state());
+  }
+  if (!quiet) Serial.println(body);
+  const NavState &nav = navFilter.state();
+  Serial.printf("[host] %d boats, %d min: rx %lu, bad crc %lu, relayed %lu, cached %u (v%lu), /nearby %u bytes\n",
+                nBoats, minutes, (unsigned long)rx, (unsigned long)badCrc, (unsigned long)relayed,
+                (unsigned)nearby.boats().size(), (unsigned long)nearby.version(), body.length());
+  Serial.printf("[host] nav %.6f,%.6f %u cm/s hdg %u, %lu rejected; led changes %lu; seq epoch %lu\n",
+                nav.lat1e7 / 1e7, nav.lon1e7 / 1e7, nav.spd_cms, nav.hdg_cdeg, (unsigned long)nav.rejected,
+                (unsigned long)ledChanges, (unsigned long)seq.epoch());
+  profPrint(Serial);
+  for (Boat &b : boats) delete b.radio;
+  return 0;
+}
@@ -0,0 +1,241 @@
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+/* ------------ time ------------- */
+static const auto hostEpoch = std::chrono::steady_clock::now();
+static thread_local bool clockManual = false;
+static thread_local uint64_t clockUs = 0;
+
+uint64_t hostClockUs() {
+  if (clockManual) return clockUs;
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - hostEpoch).count();
+}
+
+void hostClockManual(uint64_t startUs) {
+  clockManual = true;
+  clockUs = startUs;
+}
+
+void hostClockAdvanceUs(uint64_t us) { clockUs += us; }
+
+static thread_local uint32_t clockYieldUs = 0;
+void hostClockYieldUs(uint32_t us) { clockYieldUs = us; }
+
+static void (*pollFn)() = nullptr;
+static thread_local bool polling = false;
+
+void hostSetPoll(void (*fn)()) { pollFn = fn; }
+
+static void hostPoll() {
+  if (!pollFn || polling) return;
+  polling = true;
+  pollFn();
+  polling = false;
+}
+
+uint32_t millis() { hostPoll(); return (uint32_t)(hostClockUs() / 1000); }
+uint32_t micros() { hostPoll(); return (uint32_t)hostClockUs(); }
+
+void delayMicroseconds(uint32_t us) {
+  if (clockManual) clockUs += us;
+  else std::this_thread::sleep_for(std::chrono::microseconds(us));
+  hostPoll();
+}
+
+void delay(uint32_t ms) {
+  if (clockManual) clockUs += (uint64_t)ms * 1000;
+  else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  hostPoll();
+}
+
+void yield() {
+  if (clockManual) clockUs += clockYieldUs;
+  hostPoll();
+}
+
+/* ------------ random ------------- */
+static thread_local uint32_t rngState = 1;
+
+long random(long howbig) {
+  if (howbig <= 0) return 0;
+  rngState ^= rngState << 13; rngState ^= rngState >> 17; rngState ^= rngState << 5;  // xorshift32
+  return rngState % howbig;
+}
+
+long random(long howsmall, long howbig) {
+  return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) { rngState = seed ? (uint32_t)seed : 1; }
+
+/* ------------ GPIO ------------- */
+static uint8_t pinLevel[HOST_PINS];
+static void (*pinIsr[HOST_PINS])();
+static int pinIsrMode[HOST_PINS];
+static HostPinWatch pinWatchFn[HOST_PINS];
+static void *pinWatchCtx[HOST_PINS];
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= HOST_PINS || mode == OUTPUT || !pinWatchFn[pin]) return;
+  pinLevel[pin] = HIGH;  // released, e.g. the radio reset after LMIC's hal_pin_rst(2)
+  pinWatchFn[pin](pinWatchCtx[pin], pin, HIGH);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin >= HOST_PINS) return;
+  pinLevel[pin] = val ? HIGH : LOW;
+  if (pinWatchFn[pin]) pinWatchFn[pin](pinWatchCtx[pin], pin, pinLevel[pin]);
+}
+
+int digitalRead(uint8_t pin) {
+  hostPoll();
+  return pin < HOST_PINS ? pinLevel[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*fn)(), int mode) {
+  if (pin >= HOST_PINS) return;
+  pinIsr[pin] = fn;
+  pinIsrMode[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin) { if (pin < HOST_PINS) pinIsr[pin] = nullptr; }
+
+void hostPinDrive(uint8_t pin, uint8_t level) {
+  if (pin >= HOST_PINS) return;
+  uint8_t was = pinLevel[pin];
+  pinLevel[pin] = level ? HIGH : LOW;
+  if (!pinIsr[pin] || was == pinLevel[pin]) return;
+  int edge = pinLevel[pin] ? RISING : FALLING;
+  if (pinIsrMode[pin] & edge) pinIsr[pin]();
+}
+
+void hostPinWatch(uint8_t pin, HostPinWatch fn, void *ctx) {
+  if (pin >= HOST_PINS) return;
+  pinWatchFn[pin] = fn;
+  pinWatchCtx[pin] = ctx;
+}
+
+/* ------------ String ------------- */
+static std::string fmtInt(unsigned long long v, bool neg, unsigned char base) {
+  char buf[72];
+  char *p = buf + sizeof(buf);
+  *--p = 0;
+  if (base < 2 || base > 36) base = 10;
+  do {
+    int d = v % base;
+    *--p = d < 10 ? '0' + d : 'a' + d - 10;
+    v /= base;
+  } while (v);
+  if (neg) *--p = '-';
+  return p;
+}
+
+String::String(int v, unsigned char base) : String((long long)v, base) {}
+String::String(unsigned int v, unsigned char base) : String((unsigned long long)v, base) {}
+String::String(long v, unsigned char base) : String((long long)v, base) {}
+String::String(unsigned long v, unsigned char base) : String((unsigned long long)v, base) {}
+String::String(long long v, unsigned char base)
+  // Arduino prints negative numbers in other bases as two's complement
+  : std::string(base == DEC ? fmtInt(v < 0 ? -(unsigned long long)v : v, v < 0, base)
+                            : fmtInt((unsigned long)v, false, base)) {}
+String::String(unsigned long long v, unsigned char base) : std::string(fmtInt(v, false, base)) {}
+String::String(float v, unsigned int digits) : String((double)v, digits) {}
+
+String::String(double v, unsigned int digits) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", (int)digits, v);
+  assign(buf);
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  size_t i = find(c, from);
+  return i == npos ? -1 : (int)i;
+}
+
+int String::indexOf(const char *s, unsigned int from) const {
+  size_t i = find(s, from);
+  return i == npos ? -1 : (int)i;
+}
+
+String String::substring(unsigned int from) const {
+  return from >= size() ? String() : String(substr(from));
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) std::swap(from, to);
+  if (from >= size()) return String();
+  return String(substr(from, to - from));
+}
+
+/* ------------ Print / serial ------------- */
+size_t Print::write(const uint8_t *buf, size_t n) {
+  size_t w = 0;
+  while (n--) w += write(*buf++);
+  return w;
+}
+
+size_t Print::printf(const char *fmt, ...) {
+  char small[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(small, sizeof(small), fmt, ap);
+  va_end(ap);
+  if (n < 0) return 0;
+  if ((size_t)n < sizeof(small)) return write((const uint8_t *)small, n);
+  std::string big(n + 1, 0);
+  va_start(ap, fmt);
+  vsnprintf(&big[0], big.size(), fmt, ap);
+  va_end(ap);
+  return write((const uint8_t *)big.data(), n);
+}
+
+HardwareSerial Serial(0);
+
+size_t HardwareSerial::write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+size_t HardwareSerial::write(const uint8_t *buf, size_t n) { return fwrite(buf, 1, n, stdout); }
+
+int HardwareSerial::available() {
+  std::lock_guard<std::mutex> l(mu_);
+  return (int)(rx_.size() - rxPos_);
+}
+
+int HardwareSerial::read() {
+  std::lock_guard<std::mutex> l(mu_);
+  if (rxPos_ >= rx_.size()) return -1;
+  uint8_t c = rx_[rxPos_++];
+  if (rxPos_ == rx_.size()) { rx_.clear(); rxPos_ = 0; }
+  return c;
+}
+
+int HardwareSerial::peek() {
+  std::lock_guard<std::mutex> l(mu_);
+  return rxPos_ < rx_.size() ? (uint8_t)rx_[rxPos_] : -1;
+}
+
+void HardwareSerial::hostFeed(const uint8_t *buf, size_t n) {
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    rx_.append((const char *)buf, n);
+  }
+  if (onRx_) onRx_();
+}
+
+bool HardwareSerial::hostFeedFile(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) hostFeed(buf, n);
+  fclose(f);
+  return true;
+}
+
+/* ------------ ESP ------------- */
+EspClass ESP;
+
+uint32_t EspClass::getCycleCount() {
+  // Always real time: probes measure how long the host took, not simulated time
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - hostEpoch).count();
+}
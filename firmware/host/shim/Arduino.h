@@ -0,0 +1,216 @@
+/*
+  Host shim for the Arduino-ESP32 core - just enough of it for lib/ to build
+  and run on Linux (see firmware/CMakeLists.txt). Not a general port: only
+  what the libraries actually call is here, with the same signatures.
+
+  Time is the process' monotonic clock, or a simulated one per thread after
+  hostClockManual(), so a driver can run hours of node time in seconds and
+  several simulations side by side. ESP.getCycleCount() counts nanoseconds
+  and getCpuFreqMHz() says 1000, which keeps BoatProf's arithmetic right.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+#include <string>
+#include <mutex>
+
+// Arduino-style libraries (TinyGPSPlus) pick their includes by this
+#ifndef ARDUINO
+#define ARDUINO 10819
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PI         3.1415926535897932384626433832795
+#define HALF_PI    1.5707963267948966192313216916398
+#define TWO_PI     6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define sq(x)        ((x) * (x))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Per thread, so seeded runs side by side repeat
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define DEC 10
+#define HEX 16
+
+#define IRAM_ATTR
+#define PROGMEM
+
+/* ------------ time ------------- */
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// Host only. From here on this thread's millis()/micros() are simulated,
+// starting at startUs, and move only with hostClockAdvanceUs(), delay()
+// and, by hostClockYieldUs() each, yield() - so a driver's busy-wait for a
+// simulated chip still ends.
+void hostClockManual(uint64_t startUs = 0);
+void hostClockAdvanceUs(uint64_t us);
+void hostClockYieldUs(uint32_t us);
+uint64_t hostClockUs();
+
+// Host only: fn runs from millis(), micros(), delay(), yield() and
+// digitalRead(), which is where simulated peripherals catch up with the
+// clock and raise their interrupts. Never re-entered on a thread.
+void hostSetPoll(void (*fn)());
+
+/* ------------ GPIO (recorded, no hardware) ------------- */
+const uint8_t HOST_PINS = 40;
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*fn)(), int mode);
+void detachInterrupt(uint8_t pin);
+#define digitalPinToInterrupt(p) (p)
+// Handlers only run inside shim calls on the firmware's thread, so there is nothing to mask
+inline void interrupts() {}
+inline void noInterrupts() {}
+inline void tone(uint8_t pin, unsigned int freq, unsigned long ms = 0) {}
+inline void noTone(uint8_t pin) {}
+inline unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000) { return 0; }
+
+// Host only, for simulated peripherals: drive a pin the firmware reads
+// (edges run its attachInterrupt() handler), and hear about the pins the
+// firmware drives. A watched pin set to an input reads as released, HIGH.
+typedef void (*HostPinWatch)(void *ctx, uint8_t pin, uint8_t level);
+void hostPinDrive(uint8_t pin, uint8_t level);
+void hostPinWatch(uint8_t pin, HostPinWatch fn, void *ctx);
+
+/* ------------ String ------------- */
+class String : public std::string {
+public:
+  String() {}
+  String(const char *s) : std::string(s ? s : "") {}
+  String(const std::string &s) : std::string(s) {}
+  String(std::string &&s) : std::string(std::move(s)) {}
+  explicit String(char c) : std::string(1, c) {}
+  String(int v, unsigned char base = DEC);
+  String(unsigned int v, unsigned char base = DEC);
+  String(long v, unsigned char base = DEC);
+  String(unsigned long v, unsigned char base = DEC);
+  String(long long v, unsigned char base = DEC);
+  String(unsigned long long v, unsigned char base = DEC);
+  String(float v, unsigned int digits = 2);
+  String(double v, unsigned int digits = 2);
+
+  using std::string::operator+=;
+  unsigned int length() const { return (unsigned int)size(); }
+  bool reserve(unsigned int n) { std::string::reserve(n); return true; }
+  bool equals(const String &s) const { return *this == s; }
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const char *s, unsigned int from = 0) const;
+  String substring(unsigned int from) const;
+  String substring(unsigned int from, unsigned int to) const;
+  long toInt() const { return strtol(c_str(), NULL, 10); }
+  float toFloat() const { return strtof(c_str(), NULL); }
+  void remove(unsigned int i, unsigned int n = (unsigned int)-1) { erase(i, n); }
+};
+
+/* ------------ Print / serial ------------- */
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t n);
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write((const uint8_t *)s.data(), s.size()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(unsigned long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(double v, int digits = 2) { return print(String(v, (unsigned int)digits)); }
+  size_t println() { return write('\n'); }
+  template <typename T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+// UART. Output goes to stdout; input is whatever the host driver fed in,
+// e.g. a recorded NMEA log for GPSSerial.
+class HardwareSerial : public Stream {
+public:
+  explicit HardwareSerial(int uart) : uart_(uart) {}
+  void begin(unsigned long baud, uint32_t config = 0, int8_t rx = -1, int8_t tx = -1) { baud_ = baud; }
+  void end() {}
+  void onReceive(void (*fn)()) { onRx_ = fn; }
+  size_t setRxBufferSize(size_t n) { return n; }
+
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t n) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush() { fflush(stdout); }
+
+  // Host only: queue bytes for read(), as if they had arrived on RX
+  void hostFeed(const uint8_t *buf, size_t n);
+  bool hostFeedFile(const char *path);
+  unsigned long baud() const { return baud_; }
+
+private:
+  int uart_;
+  unsigned long baud_ = 0;
+  void (*onRx_)() = nullptr;
+  std::string rx_;
+  size_t rxPos_ = 0;
+  std::mutex mu_;
+};
+
+extern HardwareSerial Serial;
+
+#define SERIAL_8N1 0x800001c
+
+/* ------------ ESP / FreeRTOS bits used by the libraries ------------- */
+class EspClass {
+public:
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 1000; }
+  uint64_t getEfuseMac() { return 0x0000A1B2C3D4E5F6ULL; }
+  uint32_t getFreeHeap() { return 320 * 1024; }
+  void restart() { exit(0); }
+};
+extern EspClass ESP;
+
+// portMUX_TYPE is a spinlock on the ESP32; a recursive mutex is close enough here
+struct portMUX_TYPE { std::recursive_mutex m; };
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->m.lock()
+#define portEXIT_CRITICAL(mux) (mux)->m.unlock()
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
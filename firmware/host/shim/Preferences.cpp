@@ -0,0 +1,87 @@
+#include "Preferences.h"
+
+typedef std::map<std::string, std::map<std::string, std::vector<uint8_t>>> Store;
+
+static Store &store() {
+  static Store s;
+  return s;
+}
+static std::mutex storeMu;
+
+void hostPrefsWipe() {
+  std::lock_guard<std::mutex> l(storeMu);
+  store().clear();
+}
+
+bool Preferences::begin(const char *ns, bool readOnly) {
+  // NVS namespace names are at most 15 characters
+  if (!ns || !*ns || strlen(ns) > 15) return false;
+  ns_ = ns;
+  ro_ = readOnly;
+  open_ = true;
+  return true;
+}
+
+std::vector<uint8_t> *Preferences::find(const char *key) {
+  if (!open_) return nullptr;
+  auto n = store().find(ns_);
+  if (n == store().end()) return nullptr;
+  auto k = n->second.find(key);
+  return k == n->second.end() ? nullptr : &k->second;
+}
+
+size_t Preferences::putRaw(const char *key, const void *v, size_t n) {
+  if (!open_ || ro_ || strlen(key) > 15) return 0;
+  std::lock_guard<std::mutex> l(storeMu);
+  store()[ns_][key].assign((const uint8_t *)v, (const uint8_t *)v + n);
+  return n;
+}
+
+bool Preferences::getRaw(const char *key, void *v, size_t n) {
+  std::lock_guard<std::mutex> l(storeMu);
+  std::vector<uint8_t> *b = find(key);
+  if (!b || b->size() != n) return false;
+  memcpy(v, b->data(), n);
+  return true;
+}
+
+bool Preferences::clear() {
+  if (!open_ || ro_) return false;
+  std::lock_guard<std::mutex> l(storeMu);
+  store().erase(ns_);
+  return true;
+}
+
+bool Preferences::remove(const char *key) {
+  if (!open_ || ro_) return false;
+  std::lock_guard<std::mutex> l(storeMu);
+  auto n = store().find(ns_);
+  return n != store().end() && n->second.erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key) {
+  std::lock_guard<std::mutex> l(storeMu);
+  return find(key) != nullptr;
+}
+
+String Preferences::getString(const char *key, const String &def) {
+  std::lock_guard<std::mutex> l(storeMu);
+  std::vector<uint8_t> *b = find(key);
+  if (!b || b->empty()) return def;
+  return String(std::string((const char *)b->data(), b->size() - 1));
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  std::lock_guard<std::mutex> l(storeMu);
+  std::vector<uint8_t> *b = find(key);
+  return b ? b->size() : 0;
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t cap) {
+  std::lock_guard<std::mutex> l(storeMu);
+  std::vector<uint8_t> *b = find(key);
+  // Like NVS: a buffer that is too small gets nothing
+  if (!b || b->size() > cap) return 0;
+  memcpy(buf, b->data(), b->size());
+  return b->size();
+}
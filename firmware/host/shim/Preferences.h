@@ -0,0 +1,47 @@
+/*
+  Host shim for the ESP32 Preferences (NVS) library. One in-memory store per
+  process, shared by every Preferences object like the real NVS partition;
+  hostPrefsWipe() is a factory reset between simulated boots.
+*/
+#pragma once
+
+#include "Arduino.h"
+#include <map>
+#include <vector>
+
+class Preferences {
+public:
+  bool begin(const char *ns, bool readOnly = false);
+  void end() { open_ = false; }
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putBool(const char *key, bool v) { return putRaw(key, &v, 1); }
+  size_t putUChar(const char *key, uint8_t v) { return putRaw(key, &v, 1); }
+  size_t putUShort(const char *key, uint16_t v) { return putRaw(key, &v, 2); }
+  size_t putUInt(const char *key, uint32_t v) { return putRaw(key, &v, 4); }
+  size_t putULong(const char *key, uint32_t v) { return putRaw(key, &v, 4); }
+  size_t putString(const char *key, const char *v) { return putRaw(key, v, strlen(v) + 1); }
+  size_t putString(const char *key, const String &v) { return putString(key, v.c_str()); }
+  size_t putBytes(const char *key, const void *v, size_t n) { return putRaw(key, v, n); }
+
+  bool getBool(const char *key, bool def = false) { bool v = def; getRaw(key, &v, 1); return v; }
+  uint8_t getUChar(const char *key, uint8_t def = 0) { uint8_t v = def; getRaw(key, &v, 1); return v; }
+  uint16_t getUShort(const char *key, uint16_t def = 0) { uint16_t v = def; getRaw(key, &v, 2); return v; }
+  uint32_t getUInt(const char *key, uint32_t def = 0) { uint32_t v = def; getRaw(key, &v, 4); return v; }
+  uint32_t getULong(const char *key, uint32_t def = 0) { return getUInt(key, def); }
+  String getString(const char *key, const String &def = String());
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t cap);
+
+private:
+  size_t putRaw(const char *key, const void *v, size_t n);
+  bool getRaw(const char *key, void *v, size_t n);
+  std::vector<uint8_t> *find(const char *key);
+
+  std::string ns_;
+  bool open_ = false, ro_ = false;
+};
+
+void hostPrefsWipe();
@@ -0,0 +1,39 @@
+#include "SPI.h"
+
+SPIClass SPI;
+
+static HostSpiDevice *spiDev[HOST_PINS];
+static HostSpiDevice *spiSelected = nullptr;
+
+static void onChipSelect(void *ctx, uint8_t pin, uint8_t level) {
+  HostSpiDevice *dev = (HostSpiDevice *)ctx;
+  if (level == LOW) {
+    spiSelected = dev;
+    dev->select(true);
+  } else {
+    if (spiSelected == dev) spiSelected = nullptr;
+    dev->select(false);
+  }
+}
+
+void hostSpiAttach(uint8_t csPin, HostSpiDevice *dev) {
+  if (csPin >= HOST_PINS) return;
+  if (spiSelected && spiSelected == spiDev[csPin]) spiSelected = nullptr;
+  spiDev[csPin] = dev;
+  hostPinWatch(csPin, dev ? onChipSelect : nullptr, dev);
+}
+
+// Nothing selected reads as a floating MISO
+uint8_t SPIClass::transfer(uint8_t out) { return spiSelected ? spiSelected->transfer(out) : 0xFF; }
+
+void SPIClass::transfer(void *buf, size_t n) {
+  uint8_t *p = (uint8_t *)buf;
+  for (size_t i = 0; i < n; i++) p[i] = transfer(p[i]);
+}
+
+void SPIClass::transferBytes(const uint8_t *out, uint8_t *in, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint8_t b = transfer(out ? out[i] : 0xFF);
+    if (in) in[i] = b;
+  }
+}
@@ -0,0 +1,43 @@
+/*
+  Host shim for the Arduino SPI class. There is no bus: a transfer goes to
+  the simulated device whose chip select, registered with hostSpiAttach(),
+  the firmware has pulled low - e.g. a VirtualSX1276 (vsx1276.h).
+*/
+#pragma once
+
+#include "Arduino.h"
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x01
+#define SPI_MODE2 0x02
+#define SPI_MODE3 0x03
+
+class SPISettings {
+public:
+  SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = MSBFIRST, uint8_t mode = SPI_MODE0) {}
+};
+
+// Host only: what sits behind a chip select
+class HostSpiDevice {
+public:
+  virtual ~HostSpiDevice() {}
+  virtual void select(bool on) = 0;          // chip select edge, true = asserted (low)
+  virtual uint8_t transfer(uint8_t out) = 0; // one byte each way while selected
+};
+
+class SPIClass {
+public:
+  void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {}
+  void end() {}
+  void beginTransaction(SPISettings s) {}
+  void endTransaction() {}
+  void setFrequency(uint32_t hz) {}
+  uint8_t transfer(uint8_t out);
+  void transfer(void *buf, size_t n);        // in place, as the Arduino API does
+  void transferBytes(const uint8_t *out, uint8_t *in, size_t n);
+};
+
+extern SPIClass SPI;
+
+// Host only: dev answers while csPin is low; nullptr detaches
+void hostSpiAttach(uint8_t csPin, HostSpiDevice *dev);
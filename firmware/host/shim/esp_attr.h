@@ -0,0 +1,7 @@
+// Host shim: placement attributes mean nothing off the ESP32
+#pragma once
+
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
+#define DRAM_ATTR
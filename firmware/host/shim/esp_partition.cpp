@@ -0,0 +1,50 @@
+#include "esp_partition.h"
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+static std::vector<esp_partition_t *> parts;
+static bool failing;
+
+void hostPartitionFail(bool on) { failing = on; }
+
+const esp_partition_t *hostPartitionAdd(const char *label, esp_partition_subtype_t subtype, uint32_t size) {
+  esp_partition_t *p = (esp_partition_t *)calloc(1, sizeof(esp_partition_t));
+  p->type = ESP_PARTITION_TYPE_DATA;
+  p->subtype = subtype;
+  p->size = size;
+  strncpy(p->label, label, sizeof(p->label) - 1);
+  p->mem = (uint8_t *)malloc(size);
+  memset(p->mem, 0xFF, size);
+  parts.push_back(p);
+  return p;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+  for (esp_partition_t *p : parts)
+    if (p->type == type && p->subtype == subtype && (!label || !strcmp(label, p->label))) return p;
+  return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t off, void *dst, size_t n) {
+  if (!p || off + n > p->size) return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, p->mem + off, n);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t off, const void *src, size_t n) {
+  if (!p || off + n > p->size) return ESP_ERR_INVALID_SIZE;
+  if (failing) return ESP_FAIL;
+  const uint8_t *s = (const uint8_t *)src;
+  for (size_t i = 0; i < n; i++) p->mem[off + i] &= s[i];
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t off, size_t n) {
+  if (!p || off % 4096 || n % 4096) return ESP_ERR_INVALID_ARG;
+  if (off + n > p->size) return ESP_ERR_INVALID_SIZE;
+  if (failing) return ESP_FAIL;
+  memset(p->mem + off, 0xFF, n);
+  return ESP_OK;
+}
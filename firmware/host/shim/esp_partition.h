@@ -0,0 +1,38 @@
+/*
+  Host shim for esp_partition: partitions are RAM buffers registered with
+  hostPartitionAdd(). Writes AND into the buffer and erase sets 0xFF, as on
+  NOR flash, so journal code sees the same bit behaviour as on the chip.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef int esp_partition_subtype_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  uint8_t *mem;  // host only
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t off, void *dst, size_t n);
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t off, const void *src, size_t n);
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t off, size_t n);
+
+// Host only: an erased partition of size bytes (a multiple of 4096)
+const esp_partition_t *hostPartitionAdd(const char *label, esp_partition_subtype_t subtype, uint32_t size);
+// Host only: while set, every write and erase fails with ESP_FAIL (a worn or brown-out flash)
+void hostPartitionFail(bool on);
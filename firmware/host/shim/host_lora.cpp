@@ -0,0 +1,11 @@
+#include "host_lora.h"
+#include <math.h>
+
+uint32_t hostLoraTimeOnAirUs(size_t len, uint8_t sf, float bw, uint8_t cr, bool crc, uint16_t preamble) {
+  float ts = (float)(1UL << sf) / bw;  // ms
+  bool ldro = ts > 16.0f;
+  float num = 8.0f * len - 4.0f * sf + 28 + (crc ? 16 : 0);
+  float den = 4.0f * (sf - (ldro ? 2 : 0));
+  float payload = 8 + fmaxf(ceilf(num / den) * cr, 0);
+  return (uint32_t)((preamble + 4.25f + payload) * ts * 1000.0f);
+}
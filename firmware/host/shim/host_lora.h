@@ -0,0 +1,12 @@
+/*
+  LoRa arithmetic shared by the host radio models (radiolib/RadioLib.h,
+  vsx1276.h) and firmware/sim.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Semtech AN1200.13 time on air, explicit header, in us. cr is RadioLib's
+// 5..8 for 4/5..4/8; low data rate optimisation as the chip requires it.
+uint32_t hostLoraTimeOnAirUs(size_t len, uint8_t sf, float bw, uint8_t cr, bool crc, uint16_t preamble = 8);
@@ -0,0 +1,64 @@
+#include "RadioLib.h"
+#include <vector>
+#include <algorithm>
+
+static std::vector<SX1276 *> &radios() {
+  static std::vector<SX1276 *> r;
+  return r;
+}
+static std::recursive_mutex airMu;
+
+SX1276::SX1276(Module *mod) {
+  delete mod;  // only the pin numbers were in it
+  std::lock_guard<std::recursive_mutex> l(airMu);
+  radios().push_back(this);
+}
+
+SX1276::~SX1276() {
+  std::lock_guard<std::recursive_mutex> l(airMu);
+  auto &r = radios();
+  r.erase(std::remove(r.begin(), r.end(), this), r.end());
+}
+
+int16_t SX1276::begin(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t syncWord, int8_t power,
+                      uint16_t preambleLength, uint8_t gain) {
+  freq_ = freq; bw_ = bw; sf_ = sf; cr_ = cr; sync_ = syncWord; power_ = power;
+  rx_ = false;
+  return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1276::transmit(const uint8_t *data, size_t len, uint8_t addr) {
+  if (len > 255) return RADIOLIB_ERR_PACKET_TOO_LONG;
+  rx_ = false;
+  txCount_++;
+  std::lock_guard<std::recursive_mutex> l(airMu);
+  for (SX1276 *r : radios()) {
+    if (r == this || !r->rx_) continue;
+    if (r->freq_ != freq_ || r->sf_ != sf_ || r->bw_ != bw_ || r->sync_ != sync_) continue;
+    r->deliver(data, len);
+  }
+  return RADIOLIB_ERR_NONE;
+}
+
+void SX1276::deliver(const uint8_t *data, size_t len) {
+  memcpy(fifo_, data, len);
+  pktLen_ = len;
+  rxCount_++;
+  rx_ = false;  // single RX: the firmware re-arms with startReceive()
+  if (dio0_) dio0_();
+}
+
+int16_t SX1276::startReceive() {
+  rx_ = true;
+  return RADIOLIB_ERR_NONE;
+}
+
+int16_t SX1276::readData(uint8_t *data, size_t len) {
+  size_t n = len && len < pktLen_ ? len : pktLen_;
+  memcpy(data, fifo_, n);
+  return RADIOLIB_ERR_NONE;
+}
+
+uint32_t SX1276::getTimeOnAir(size_t len) {
+  return hostLoraTimeOnAirUs(len, sf_, bw_, cr_, crc_);
+}
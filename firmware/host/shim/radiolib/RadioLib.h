@@ -0,0 +1,69 @@
+/*
+  Host shim for the part of RadioLib's SX1276 the firmware uses. Every
+  SX1276 in the process shares one ideal channel: a transmit() reaches
+  each other radio that is receiving with the same frequency, spreading
+  factor, bandwidth and sync word, which then raises its DIO0 action as
+  RxDone would. No path loss, no collisions, no airtime - just enough to
+  run the mesh logic end to end on a PC. The chip itself at register
+  level is vsx1276.h; the real RadioLib is not built on the host.
+*/
+#pragma once
+
+#include "Arduino.h"
+#include "host_lora.h"
+
+#define RADIOLIB_ERR_NONE                0
+#define RADIOLIB_ERR_UNKNOWN            -1
+#define RADIOLIB_ERR_PACKET_TOO_LONG    -4
+#define RADIOLIB_ERR_RX_TIMEOUT         -6
+#define RADIOLIB_ERR_CRC_MISMATCH       -7
+
+class Module {
+public:
+  Module(int nss, int irq, int rst, int gpio = -1) : nss(nss), irq(irq), rst(rst), gpio(gpio) {}
+  int nss, irq, rst, gpio;
+};
+
+class SX1276 {
+public:
+  SX1276(Module *mod);
+  ~SX1276();
+
+  int16_t begin(float freq = 434.0, float bw = 125.0, uint8_t sf = 9, uint8_t cr = 7,
+                uint8_t syncWord = 0x12, int8_t power = 10, uint16_t preambleLength = 8, uint8_t gain = 0);
+  int16_t setFrequency(float freq) { freq_ = freq; return RADIOLIB_ERR_NONE; }
+  int16_t setBandwidth(float bw) { bw_ = bw; return RADIOLIB_ERR_NONE; }
+  int16_t setSpreadingFactor(uint8_t sf) { sf_ = sf; return RADIOLIB_ERR_NONE; }
+  int16_t setCodingRate(uint8_t cr) { cr_ = cr; return RADIOLIB_ERR_NONE; }
+  int16_t setSyncWord(uint8_t sw) { sync_ = sw; return RADIOLIB_ERR_NONE; }
+  int16_t setOutputPower(int8_t dbm) { power_ = dbm; return RADIOLIB_ERR_NONE; }
+  int16_t setCRC(bool on) { crc_ = on; return RADIOLIB_ERR_NONE; }
+  void setDio0Action(void (*fn)(), uint32_t dir) { dio0_ = fn; }
+  void clearDio0Action() { dio0_ = nullptr; }
+
+  int16_t transmit(const uint8_t *data, size_t len, uint8_t addr = 0);
+  int16_t startReceive();
+  int16_t standby() { rx_ = false; return RADIOLIB_ERR_NONE; }
+  int16_t sleep() { rx_ = false; return RADIOLIB_ERR_NONE; }
+  size_t getPacketLength(bool update = true) { return pktLen_; }
+  int16_t readData(uint8_t *data, size_t len);
+  float getRSSI() { return -90; }
+  float getSNR() { return 8; }
+  uint32_t getTimeOnAir(size_t len);  // hostLoraTimeOnAirUs() with these settings
+
+  // Host only
+  uint32_t hostTxCount() const { return txCount_; }
+  uint32_t hostRxCount() const { return rxCount_; }
+
+private:
+  void deliver(const uint8_t *data, size_t len);
+
+  float freq_ = 434.0, bw_ = 125.0;
+  uint8_t sf_ = 9, cr_ = 7, sync_ = 0x12;
+  int8_t power_ = 10;
+  bool crc_ = true, rx_ = false;
+  void (*dio0_)() = nullptr;
+  uint8_t fifo_[256];
+  size_t pktLen_ = 0;
+  uint32_t txCount_ = 0, rxCount_ = 0;
+};
@@ -0,0 +1,399 @@
+#include "vsx1276.h"
+#include "host_lora.h"
+#include <deque>
+#include <map>
+#include <algorithm>
+
+// Register addresses (LoRa page where it differs)
+enum : uint8_t {
+  REG_FIFO = 0x00, REG_OP_MODE = 0x01, REG_FRF_MSB = 0x06, REG_PA_CONFIG = 0x09,
+  REG_FIFO_ADDR_PTR = 0x0D, REG_FIFO_TX_BASE = 0x0E, REG_FIFO_RX_BASE = 0x0F,
+  REG_FIFO_RX_CURRENT = 0x10, REG_IRQ_MASK = 0x11, REG_IRQ_FLAGS = 0x12, REG_RX_NB_BYTES = 0x13,
+  REG_PKT_SNR = 0x19, REG_PKT_RSSI = 0x1A, REG_RSSI = 0x1B, REG_HOP_CHANNEL = 0x1C,
+  REG_MODEM_CONFIG1 = 0x1D, REG_MODEM_CONFIG2 = 0x1E, REG_SYMB_TIMEOUT_LSB = 0x1F,
+  REG_PREAMBLE_MSB = 0x20, REG_PREAMBLE_LSB = 0x21, REG_PAYLOAD_LENGTH = 0x22,
+  REG_FIFO_RX_BYTE = 0x25, REG_RSSI_WIDEBAND = 0x2C, REG_INVERT_IQ = 0x33, REG_SYNC_WORD = 0x39,
+  REG_DIO_MAPPING1 = 0x40, REG_VERSION = 0x42, REG_PA_DAC = 0x4D,
+  REG_IMAGE_CAL = 0x3B,  // FSK page
+};
+
+const uint8_t IMAGE_CAL_START = 0x40, IMAGE_CAL_RUNNING = 0x20;
+
+enum : uint8_t {
+  MODE_SLEEP = 0, MODE_STDBY = 1, MODE_FSTX = 2, MODE_TX = 3,
+  MODE_FSRX = 4, MODE_RXCONT = 5, MODE_RXSINGLE = 6, MODE_CAD = 7,
+};
+
+enum : uint8_t {
+  IRQ_RX_TIMEOUT = 0x80, IRQ_RX_DONE = 0x40, IRQ_CRC_ERROR = 0x20, IRQ_VALID_HEADER = 0x10,
+  IRQ_TX_DONE = 0x08, IRQ_CAD_DONE = 0x04, IRQ_FHSS = 0x02, IRQ_CAD_DETECTED = 0x01,
+};
+
+const float   NOISE_DBM     = -117;   // 125 kHz, NF 6 dB
+const uint32_t FRF_TOL      = 33;     // ~2 kHz in 61 Hz steps
+const uint8_t PREAMBLE_LOCK = 4;      // symbols of preamble the receiver needs
+const uint64_t KEEP_US      = 60000000;
+
+static const float BW_KHZ[10] = {7.8, 10.4, 15.6, 20.8, 31.25, 41.7, 62.5, 125, 250, 500};
+// SX1276 sensitivity at 125 kHz, SF6..SF12
+static const float SENS_125[7] = {-118, -123, -126, -129, -132, -134.5, -137};
+
+/* ------------ medium ------------- */
+struct VsxFrame {
+  int64_t id;
+  const VirtualSX1276 *from;
+  uint32_t frf;
+  uint8_t sf, bw, sync;
+  bool iqInv, crc;
+  uint16_t preamble;
+  float dbm;
+  uint64_t start, end;
+  bool aborted;
+  std::vector<uint8_t> data;
+};
+
+struct VsxAir {
+  std::vector<VirtualSX1276 *> chips;
+  std::deque<VsxFrame> frames;
+  int64_t nextId = 0;
+  std::map<uint32_t, float> loss;
+  bool trace = false;
+
+  VsxFrame *frame(int64_t id) {
+    if (frames.empty() || id < frames.front().id || id > frames.back().id) return nullptr;
+    return &frames[id - frames.front().id];
+  }
+
+  static uint32_t key(uint16_t a, uint16_t b) { return a < b ? (uint32_t)a << 16 | b : (uint32_t)b << 16 | a; }
+
+  static void poll() {
+    VsxAir &air = get();
+    uint64_t now = hostClockUs();
+    for (VirtualSX1276 *c : air.chips) c->service(now);
+    while (!air.frames.empty() && air.frames.front().end + KEEP_US < now) air.frames.pop_front();
+  }
+
+  static VsxAir &get() {
+    static VsxAir a;
+    return a;
+  }
+};
+
+void vsxLinkLoss(const VirtualSX1276 &a, const VirtualSX1276 &b, float db) {
+  VsxAir::get().loss[VsxAir::key(a.id(), b.id())] = db;
+}
+
+void vsxTrace(bool on) { VsxAir::get().trace = on; }
+
+/* ------------ chip ------------- */
+VirtualSX1276::VirtualSX1276(const VsxPins &pins) : pins_(pins) {
+  static uint16_t ids = 0;
+  id_ = ++ids;
+  rng_ = 0x9E3779B9u * id_;
+  reset();
+  VsxAir &air = VsxAir::get();
+  air.chips.push_back(this);
+  hostSetPoll(VsxAir::poll);
+  hostSpiAttach(pins_.nss, this);
+  if (pins_.rst != VSX_NO_PIN) hostPinWatch(pins_.rst, onReset, this);
+}
+
+VirtualSX1276::~VirtualSX1276() {
+  VsxAir &air = VsxAir::get();
+  air.chips.erase(std::remove(air.chips.begin(), air.chips.end(), this), air.chips.end());
+  for (VsxFrame &f : air.frames)
+    if (f.from == this) f.from = nullptr;
+  hostSpiAttach(pins_.nss, nullptr);
+  if (pins_.rst != VSX_NO_PIN) hostPinWatch(pins_.rst, nullptr, nullptr);
+}
+
+// Power-on values of the registers the drivers read back before writing
+void VirtualSX1276::reset() {
+  memset(regs_, 0, sizeof(regs_));
+  memset(fifo_, 0, sizeof(fifo_));
+  uint8_t *c = regs_[0], *l = regs_[1];
+  c[REG_OP_MODE] = 0x09;
+  c[0x06] = 0x6C; c[0x07] = 0x80; c[0x08] = 0x00;  // 434 MHz
+  c[REG_PA_CONFIG] = 0x4F; c[0x0A] = 0x09; c[0x0B] = 0x2B; c[0x0C] = 0x20;
+  c[REG_IMAGE_CAL] = 0x82;  // calibration not running
+  c[REG_VERSION] = 0x12; c[0x4B] = 0x09; c[REG_PA_DAC] = 0x84;
+  l[REG_FIFO_TX_BASE] = 0x80;
+  l[REG_MODEM_CONFIG1] = 0x72; l[REG_MODEM_CONFIG2] = 0x70; l[REG_SYMB_TIMEOUT_LSB] = 0x64;
+  l[REG_PREAMBLE_LSB] = 0x08; l[REG_PAYLOAD_LENGTH] = 0x01; l[0x23] = 0xFF;
+  l[0x26] = 0x04; l[0x31] = 0xC3; l[REG_INVERT_IQ] = 0x27; l[0x37] = 0x0A;
+  l[REG_SYNC_WORD] = 0x12; l[0x3B] = 0x1D;
+  if (txFrame_ >= 0) {
+    VsxFrame *f = VsxAir::get().frame(txFrame_);
+    if (f && f->end > hostClockUs()) { f->end = hostClockUs(); f->aborted = true; }
+  }
+  txFrame_ = lock_ = -1;
+  updateDio();
+}
+
+void VirtualSX1276::onReset(void *ctx, uint8_t pin, uint8_t level) {
+  if (level == LOW) ((VirtualSX1276 *)ctx)->reset();
+}
+
+// 0x0D..0x3F are paged: LoRa registers in LoRa mode unless AccessSharedReg
+uint8_t &VirtualSX1276::reg(uint8_t a) {
+  bool loraPage = a >= 0x0D && a <= 0x3F && loraMode() && !(regs_[0][REG_OP_MODE] & 0x40);
+  return regs_[loraPage ? 1 : 0][a];
+}
+
+void VirtualSX1276::select(bool on) {
+  sel_ = on;
+  first_ = on;
+  if (on) service(hostClockUs());
+}
+
+uint8_t VirtualSX1276::transfer(uint8_t out) {
+  if (!sel_) return 0xFF;
+  if (first_) {
+    first_ = false;
+    addr_ = out & 0x7F;
+    wr_ = out & 0x80;
+    return 0x00;
+  }
+  uint8_t a = addr_;
+  if (a != REG_FIFO) addr_ = (addr_ + 1) & 0x7F;
+  if (wr_) { write(a, out); return 0x00; }
+  return read(a);
+}
+
+void VirtualSX1276::write(uint8_t a, uint8_t v) {
+  if (a == REG_OP_MODE) { setOpMode(v, hostClockUs()); return; }
+  if (a == REG_VERSION) return;
+  if (a == REG_FIFO) {
+    if (loraMode() && mode() != MODE_SLEEP) fifo_[lora(REG_FIFO_ADDR_PTR)++] = v;
+    return;
+  }
+  if (a == REG_DIO_MAPPING1) { regs_[0][a] = v; updateDio(); return; }
+  uint8_t &r = reg(a);
+  if (&r == &regs_[0][REG_IMAGE_CAL]) { r = v & ~(IMAGE_CAL_START | IMAGE_CAL_RUNNING); return; }  // done at once
+  if (&r == &lora(a)) {
+    switch (a) {
+      case REG_IRQ_FLAGS: r &= ~v; updateDio(); return;
+      case REG_FIFO_RX_CURRENT: case REG_RX_NB_BYTES: case 0x14: case 0x15: case 0x16: case 0x17:
+      case 0x18: case REG_PKT_SNR: case REG_PKT_RSSI: case REG_RSSI: case REG_HOP_CHANNEL:
+      case REG_FIFO_RX_BYTE: case REG_RSSI_WIDEBAND:
+        return;  // read-only
+    }
+  }
+  r = v;
+}
+
+uint8_t VirtualSX1276::read(uint8_t a) {
+  if (a == REG_FIFO) return loraMode() ? fifo_[lora(REG_FIFO_ADDR_PTR)++] : 0;
+  uint8_t &r = reg(a);
+  if (&r == &lora(a)) {
+    if (a == REG_RSSI_WIDEBAND) {
+      rng_ = rng_ * 1664525u + 1013904223u;  // LMIC seeds its PRNG from this
+      return rng_ >> 24;
+    }
+    if (a == REG_RSSI) {
+      float dbm = NOISE_DBM - 3;
+      VsxFrame *f = lock_ >= 0 ? VsxAir::get().frame(lock_) : nullptr;
+      if (f && f->from) dbm = f->dbm - lossTo(f->from);
+      return (uint8_t)constrain(dbm + 157, 0, 255);
+    }
+  }
+  return r;
+}
+
+void VirtualSX1276::setOpMode(uint8_t v, uint64_t now) {
+  uint8_t old = regs_[0][REG_OP_MODE];
+  if ((old & 0x07) != MODE_SLEEP) v = (v & 0x7F) | (old & 0x80);  // LongRangeMode only in SLEEP
+  regs_[0][REG_OP_MODE] = v;
+  uint8_t was = old & 0x07, m = v & 0x07;
+  if (m == was || !loraMode()) return;
+
+  if (was == MODE_TX && txFrame_ >= 0) {
+    VsxFrame *f = VsxAir::get().frame(txFrame_);
+    if (f && f->end > now) { f->end = now; f->aborted = true; }
+    txFrame_ = -1;
+  }
+  lock_ = -1;
+  switch (m) {
+    case MODE_SLEEP:
+      memset(fifo_, 0, sizeof(fifo_));
+      break;
+    case MODE_TX:
+      startTx(now);
+      break;
+    case MODE_RXCONT:
+    case MODE_RXSINGLE: {
+      rxFrom_ = now;
+      if (was != MODE_RXCONT && was != MODE_RXSINGLE) rxWr_ = lora(REG_FIFO_RX_BASE);
+      uint32_t symbols = (lora(REG_MODEM_CONFIG2) & 0x03) << 8 | lora(REG_SYMB_TIMEOUT_LSB);
+      rxTimeout_ = now + (uint64_t)symbols * symbolUs();
+      break;
+    }
+    case MODE_CAD:
+      cadEnd_ = now + 2 * symbolUs();
+      break;
+  }
+}
+
+void VirtualSX1276::startTx(uint64_t now) {
+  VsxAir &air = VsxAir::get();
+  VsxFrame f;
+  f.id = air.nextId++;
+  f.from = this;
+  f.frf = frf();
+  f.sf = sf();
+  f.bw = lora(REG_MODEM_CONFIG1) >> 4;
+  f.sync = lora(REG_SYNC_WORD);
+  f.iqInv = !(lora(REG_INVERT_IQ) & 0x01);
+  f.crc = lora(REG_MODEM_CONFIG2) & 0x04;
+  f.preamble = lora(REG_PREAMBLE_MSB) << 8 | lora(REG_PREAMBLE_LSB);
+  f.dbm = txDbm();
+  uint8_t len = lora(REG_PAYLOAD_LENGTH), base = lora(REG_FIFO_TX_BASE);
+  for (uint8_t i = 0; i < len; i++) f.data.push_back(fifo_[(uint8_t)(base + i)]);
+  uint8_t cr = ((lora(REG_MODEM_CONFIG1) >> 1) & 0x07) + 4;
+  uint32_t air_us = hostLoraTimeOnAirUs(len, f.sf, bwKHz(), cr, f.crc, f.preamble);
+  f.start = now;
+  f.end = txEnd_ = now + air_us;
+  f.aborted = false;
+  txFrame_ = f.id;
+  txFrames_++;
+  txAirUs_ += air_us;
+  if (air.trace)
+    Serial.printf("[air] %llu us: chip %u, %.4f MHz SF%u BW%.0f sync 0x%02X%s, %u bytes, %lu us\n",
+                  (unsigned long long)now, id_, f.frf * 32e6 / (1 << 19) / 1e6, f.sf, bwKHz(), f.sync,
+                  f.iqInv ? " IQ inv" : "", len, (unsigned long)air_us);
+  air.frames.push_back(std::move(f));
+}
+
+void VirtualSX1276::service(uint64_t now) {
+  if (!loraMode()) return;
+  switch (mode()) {
+    case MODE_TX:
+      if (now < txEnd_) return;
+      txFrame_ = -1;
+      toStandby();
+      setFlags(IRQ_TX_DONE);
+      return;
+    case MODE_RXCONT:
+      while (receive(now)) {}
+      return;
+    case MODE_RXSINGLE:
+      if (receive(now)) { toStandby(); return; }
+      if (lock_ < 0 && now >= rxTimeout_) { toStandby(); setFlags(IRQ_RX_TIMEOUT); }
+      return;
+    case MODE_CAD: {
+      if (now < cadEnd_) return;
+      bool busy = false;
+      for (VsxFrame &f : VsxAir::get().frames)
+        if (f.from && f.from != this && f.start < cadEnd_ && f.end > cadEnd_ - 2 * symbolUs() &&
+            f.sf == sf() && f.frf + FRF_TOL >= frf() && f.frf <= frf() + FRF_TOL)
+          busy = true;
+      toStandby();
+      setFlags(IRQ_CAD_DONE | (busy ? IRQ_CAD_DETECTED : 0));
+      return;
+    }
+  }
+}
+
+// Locks onto the next frame it can hear and, once that is over, puts it in
+// the FIFO. True when a frame was delivered.
+bool VirtualSX1276::receive(uint64_t now) {
+  VsxAir &air = VsxAir::get();
+  uint32_t myFrf = frf();
+  uint8_t mySf = sf(), myBw = lora(REG_MODEM_CONFIG1) >> 4, mySync = lora(REG_SYNC_WORD);
+  bool myIq = lora(REG_INVERT_IQ) & 0x40;
+  float sens = SENS_125[constrain(mySf, 6, 12) - 6] + 10 * log10f(bwKHz() / 125);
+  auto sameChannel = [&](const VsxFrame &f) {
+    return f.sf == mySf && f.bw == myBw && f.frf + FRF_TOL >= myFrf && f.frf <= myFrf + FRF_TOL;
+  };
+
+  if (lock_ < 0) {
+    for (VsxFrame &f : air.frames) {
+      if (f.start > now) break;
+      if (!f.from || f.from == this || !sameChannel(f) || f.sync != mySync || f.iqInv != myIq) continue;
+      // Listening (again) by the time enough of the preamble is left?
+      uint16_t catchable = f.preamble > PREAMBLE_LOCK ? f.preamble - PREAMBLE_LOCK : 0;
+      if (rxFrom_ > f.start + (uint64_t)catchable * symbolUs()) continue;
+      if (f.dbm - lossTo(f.from) < sens) continue;
+      lock_ = f.id;
+      break;
+    }
+    if (lock_ < 0) return false;
+  }
+
+  VsxFrame *f = air.frame(lock_);
+  if (!f || !f->from) { lock_ = -1; return false; }
+  if (now < f->end) return false;
+
+  float rssi = f->dbm - lossTo(f->from);
+  bool bad = f->aborted;
+  for (VsxFrame &g : air.frames) {
+    if (&g == f || !g.from || g.from == this || g.start >= f->end || g.end <= f->start || !sameChannel(g)) continue;
+    if (g.dbm - lossTo(g.from) > rssi - VSX_CAPTURE_DB) bad = true;
+  }
+
+  uint8_t start = rxWr_;
+  for (size_t i = 0; i < f->data.size(); i++) {
+    uint8_t b = f->data[i];
+    if (bad && !f->crc && i % 7 == 3) b ^= 0x5A;  // nothing will tell the driver
+    fifo_[rxWr_++] = b;
+  }
+  lora(REG_FIFO_RX_CURRENT) = start;
+  lora(REG_FIFO_RX_BYTE) = rxWr_;
+  lora(REG_RX_NB_BYTES) = (uint8_t)f->data.size();
+  float snr = constrain(rssi - NOISE_DBM, -32, 31);
+  lora(REG_PKT_SNR) = (uint8_t)(int8_t)(snr * 4);
+  lora(REG_PKT_RSSI) = (uint8_t)constrain(rssi + 157 - (snr < 0 ? snr : 0), 0, 255);
+  lora(REG_HOP_CHANNEL) = f->crc ? 0x40 : 0x00;
+  rxFrom_ = f->end;
+  lock_ = -1;
+  rxFrames_++;
+  if (bad && f->crc) crcErrors_++;
+  setFlags(IRQ_VALID_HEADER | IRQ_RX_DONE | (bad && f->crc ? IRQ_CRC_ERROR : 0));
+  return true;
+}
+
+void VirtualSX1276::setFlags(uint8_t f) {
+  lora(REG_IRQ_FLAGS) |= f & ~lora(REG_IRQ_MASK);
+  updateDio();
+}
+
+void VirtualSX1276::updateDio() {
+  static const uint8_t DIO0[4] = {IRQ_RX_DONE, IRQ_TX_DONE, IRQ_CAD_DONE, 0};
+  static const uint8_t DIO1[4] = {IRQ_RX_TIMEOUT, IRQ_FHSS, IRQ_CAD_DETECTED, 0};
+  static const uint8_t DIO2[4] = {IRQ_FHSS, IRQ_FHSS, IRQ_FHSS, 0};
+  uint8_t map = regs_[0][REG_DIO_MAPPING1], flags = loraMode() ? lora(REG_IRQ_FLAGS) : 0;
+  const uint8_t pin[3] = {pins_.dio0, pins_.dio1, pins_.dio2};
+  const uint8_t src[3] = {DIO0[map >> 6], DIO1[(map >> 4) & 3], DIO2[(map >> 2) & 3]};
+  for (int i = 0; i < 3; i++) {
+    uint8_t level = (flags & src[i]) ? HIGH : LOW;
+    if (level == dioLevel_[i]) continue;
+    dioLevel_[i] = level;
+    if (pin[i] != VSX_NO_PIN) hostPinDrive(pin[i], level);
+  }
+}
+
+uint32_t VirtualSX1276::frf() const {
+  return (uint32_t)regs_[0][REG_FRF_MSB] << 16 | regs_[0][REG_FRF_MSB + 1] << 8 | regs_[0][REG_FRF_MSB + 2];
+}
+
+float VirtualSX1276::bwKHz() const {
+  uint8_t b = regs_[1][REG_MODEM_CONFIG1] >> 4;
+  return BW_KHZ[b < 10 ? b : 9];
+}
+
+uint32_t VirtualSX1276::symbolUs() const {
+  return (uint32_t)((1UL << constrain(sf(), 6, 12)) * 1000.0f / bwKHz());
+}
+
+float VirtualSX1276::txDbm() const {
+  uint8_t pa = regs_[0][REG_PA_CONFIG];
+  float out = pa & 0x0F;
+  if (pa & 0x80) return ((regs_[0][REG_PA_DAC] & 0x07) == 0x07 ? 5 : 2) + out;  // PA_BOOST
+  return 10.8f + 0.6f * ((pa >> 4) & 0x07) - (15 - out);                           // RFO
+}
+
+float VirtualSX1276::lossTo(const VirtualSX1276 *o) const {
+  auto &loss = VsxAir::get().loss;
+  auto it = loss.find(VsxAir::key(id_, o->id_));
+  return it == loss.end() ? VSX_DEFAULT_LOSS_DB : it->second;
+}
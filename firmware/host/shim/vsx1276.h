@@ -0,0 +1,112 @@
+/*
+  VirtualSX1276 - the SX1276 at register level, for drivers written to the datasheet
+
+  Answers SPI the way the chip does (address byte with bit 7 set for a
+  write, then data with auto-increment; address 0 is the FIFO at
+  RegFifoAddrPtr) and drives DIO0..DIO2 as RegDioMapping1 says, on the
+  shim's SPI and GPIO. It covers the registers and sequences RadioLib's
+  SX1276 driver and the MCCI LMIC hal use, and test_vsx1276 plays those
+  sequences at register level. Neither library is built against it here
+  (they are not vendored), so the real drivers on it remain untried.
+
+  LoRa mode is modelled: SLEEP (clears the FIFO), STDBY, FSTX/FSRX (as
+  STDBY), TX for PayloadLength bytes from FifoTxBaseAddr, RXCONTINUOUS,
+  RXSINGLE with its SymbTimeout window, and CAD; IrqFlags with
+  IrqFlagsMask and write-1-to-clear; RxNbBytes, FifoRxCurrentAddr and
+  FifoRxByteAddr; PktRssiValue / PktSnrValue; RegVersion 0x12. The mode
+  bit only changes in SLEEP. FSK mode keeps its own register page but
+  sends nothing; image calibration (RegImageCal, which LMIC starts at
+  reset) completes at once.
+
+  Every chip in the process is on one medium. A frame reaches a receiver
+  in RX on the same frequency (within 2 kHz), SF, bandwidth, sync word and
+  IQ polarity when it arrives above the SF's sensitivity after the link
+  loss, the receiver was listening before its preamble was over, and
+  nothing else on that channel came within VSX_CAPTURE_DB of it while it
+  was on air; a frame that fails the last test, or whose sender left TX
+  early, ends with PayloadCrcError. The receiver stays on the first frame
+  it locked onto: a stronger one starting later spoils it but is not
+  captured in its place.
+
+  Time is the shim's clock; chips catch up from its poll hook, i.e. on the
+  firmware's next millis(), micros(), delay(), yield() or digitalRead().
+  Run on the real clock, or on a manual one with hostClockYieldUs() set
+  so RadioLib's busy-waits move time on. One thread drives all chips.
+*/
+#pragma once
+
+#include "Arduino.h"
+#include "SPI.h"
+#include <vector>
+
+const float   VSX_DEFAULT_LOSS_DB = 100;   // 14 dBm out, -86 dBm in
+const float   VSX_CAPTURE_DB      = 6;
+const uint8_t VSX_NO_PIN          = 0xFF;
+
+struct VsxPins {
+  uint8_t nss, rst, dio0, dio1, dio2;
+};
+
+class VirtualSX1276 : public HostSpiDevice {
+public:
+  explicit VirtualSX1276(const VsxPins &pins);
+  ~VirtualSX1276();
+
+  void select(bool on) override;
+  uint8_t transfer(uint8_t out) override;
+
+  // Host only
+  uint16_t id() const { return id_; }
+  uint32_t txFrames() const { return txFrames_; }
+  uint64_t txAirUs() const { return txAirUs_; }
+  uint32_t rxFrames() const { return rxFrames_; }
+  uint32_t crcErrors() const { return crcErrors_; }
+  void service(uint64_t now);
+
+private:
+  friend struct VsxAir;
+  uint8_t &reg(uint8_t a);
+  uint8_t &lora(uint8_t a) { return regs_[1][a]; }
+  bool loraMode() const { return regs_[0][0x01] & 0x80; }
+  uint8_t mode() const { return regs_[0][0x01] & 0x07; }
+  void write(uint8_t a, uint8_t v);
+  uint8_t read(uint8_t a);
+  void setOpMode(uint8_t v, uint64_t now);
+  void toStandby() { regs_[0][0x01] = (regs_[0][0x01] & ~0x07) | 0x01; }
+  void reset();
+  void setFlags(uint8_t f);
+  void updateDio();
+  void startTx(uint64_t now);
+  bool receive(uint64_t now);
+  static void onReset(void *ctx, uint8_t pin, uint8_t level);
+
+  // Channel as the registers have it
+  uint32_t frf() const;
+  uint8_t sf() const { return regs_[1][0x1E] >> 4; }
+  float bwKHz() const;
+  uint32_t symbolUs() const;
+  float txDbm() const;
+  float lossTo(const VirtualSX1276 *o) const;
+
+  VsxPins pins_;
+  uint16_t id_;
+  uint8_t regs_[2][128];  // [0] FSK page and common registers, [1] LoRa page 0x0D..0x3F
+  uint8_t fifo_[256];
+  bool sel_ = false, first_ = false, wr_ = false;
+  uint8_t addr_ = 0;
+  uint8_t dioLevel_[3] = {LOW, LOW, LOW};
+
+  uint64_t txEnd_ = 0, rxFrom_ = 0, rxTimeout_ = 0, cadEnd_ = 0;
+  int64_t txFrame_ = -1, lock_ = -1;
+  uint8_t rxWr_ = 0;
+  uint32_t rng_;
+
+  uint32_t txFrames_ = 0, rxFrames_ = 0, crcErrors_ = 0;
+  uint64_t txAirUs_ = 0;
+};
+
+// Loss between two chips, both ways, in dB
+void vsxLinkLoss(const VirtualSX1276 &a, const VirtualSX1276 &b, float db);
+
+// Prints each frame put on the medium ("[air] ..."), e.g. to follow LMIC
+void vsxTrace(bool on);
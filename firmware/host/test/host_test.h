@@ -0,0 +1,26 @@
+/*
+  host_test - the few macros firmware/host/test uses
+
+  Each test_*.cpp is its own executable and ctest entry (CMakeLists.txt).
+  CHECK() reports the failing expression and carries on, so one run shows
+  every broken case; main() ends with TEST_END(), non-zero on any failure.
+*/
+#pragma once
+
+#include <stdio.h>
+
+static int testFailures = 0;
+
+#define CHECK(c) do { \
+    if (!(c)) { testFailures++; fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); } \
+  } while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long va_ = (long long)(a), vb_ = (long long)(b); \
+    if (va_ != vb_) { \
+      testFailures++; \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, va_, vb_); \
+    } \
+  } while (0)
+
+#define TEST_END() (testFailures ? (fprintf(stderr, "%d check(s) failed\n", testFailures), 1) : 0)
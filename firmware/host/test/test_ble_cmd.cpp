@@ -0,0 +1,45 @@
+// BLE binary commands: request checks and the response builder
+#include "host_test.h"
+#include <boat_ble_cmd.h>
+
+int main() {
+  const uint8_t ok[] = {BLE_CMD_MAGIC, 7, BC_JOURNEY, 1, 1, BC_QUERY, 1, BQ_CONFIG};
+  CHECK_EQ(bleCmdCheck(ok, sizeof(ok)), BLE_CMD_OK);
+  const uint8_t badLen[] = {BLE_CMD_MAGIC, 7, BC_USER_ID, 2, 1, 2};
+  CHECK_EQ(bleCmdCheck(badLen, sizeof(badLen)), BLE_CMD_ERR_LENGTH);
+  const uint8_t cut[] = {BLE_CMD_MAGIC, 7, BC_JOURNEY, 2, 1};
+  CHECK_EQ(bleCmdCheck(cut, sizeof(cut)), BLE_CMD_ERR_FORMAT);
+
+  // Everything fits: status as given, no flag
+  uint8_t out[16];
+  BleCmdResp r;
+  r.begin(out, sizeof(out), 7);
+  CHECK(r.putStr(BC_BOAT_ID, "1234"));
+  CHECK(r.putU32(BC_USER_ID, 42));
+  r.status(BLE_CMD_OK);
+  CHECK(!r.truncated());
+  CHECK_EQ(r.len(), 15);
+  CHECK_EQ(out[0], BLE_CMD_MAGIC);
+  CHECK_EQ(out[1], 7);
+  CHECK_EQ(out[2], BLE_CMD_OK);
+
+  // A TLV that does not fit is dropped and the phone is told, whichever
+  // comes last of the drop and status()
+  CHECK(!r.putStr(BC_NAME, "Sea Breeze"));
+  CHECK(r.truncated());
+  CHECK_EQ(r.len(), 15);
+  CHECK_EQ(out[2], BLE_CMD_OK | BLE_CMD_TRUNCATED);
+  r.status(BLE_CMD_OK);
+  CHECK_EQ(out[2], BLE_CMD_OK | BLE_CMD_TRUNCATED);
+
+  // A fresh response starts clean; smaller ones still fit after a drop
+  r.begin(out, 8, 8);
+  CHECK(!r.putU32(BC_USER_ID, 1));
+  CHECK(r.putU8(BC_SOS, 0));
+  r.status(BLE_CMD_ERR_RANGE);
+  CHECK_EQ(out[2], BLE_CMD_ERR_RANGE | BLE_CMD_TRUNCATED);
+  r.begin(out, 8, 9);
+  r.status(BLE_CMD_OK);
+  CHECK_EQ(out[2], BLE_CMD_OK);
+  return TEST_END();
+}
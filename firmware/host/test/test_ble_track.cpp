@@ -0,0 +1,110 @@
+// BLE track download: chunk packing, window, go-back-N, resume and small MTUs
+#include "host_test.h"
+#include <boat_ble_track.h>
+#include <vector>
+
+static std::vector<TrackPoint> store;
+
+static size_t readStore(uint32_t index, TrackPoint *out, size_t max) {
+  size_t n = 0;
+  for (; n < max && index + n < store.size(); n++) out[n] = store[index + n];
+  return n;
+}
+
+static uint32_t getVarint(const uint8_t *&p) {
+  uint32_t v = 0;
+  for (int s = 0;; s += 7) {
+    uint8_t b = *p++;
+    v |= (uint32_t)(b & 0x7F) << s;
+    if (!(b & 0x80)) return v;
+  }
+}
+
+static int32_t unzig(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+static uint32_t getU32(const uint8_t *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+
+// What the app does with one DATA packet: points appended at their offset
+static void decode(const uint8_t *b, size_t len, std::vector<TrackPoint> &got) {
+  uint32_t off = getU32(b + 1);
+  uint8_t n = b[5];
+  TrackPoint p;
+  memcpy(&p, b + 6, sizeof(p));
+  got.resize(off);
+  got.push_back(p);
+  const uint8_t *q = b + 6 + sizeof(p);
+  for (uint8_t i = 1; i < n; i++) {
+    p.t += unzig(getVarint(q));
+    p.lat1e7 += unzig(getVarint(q));
+    p.lon1e7 += unzig(getVarint(q));
+    p.spd_cms += unzig(getVarint(q));
+    p.hdg_cdeg += unzig(getVarint(q));
+    got.push_back(p);
+  }
+  CHECK(q == b + len);
+}
+
+int main() {
+  for (uint32_t i = 0; i < 1000; i++) {
+    TrackPoint p = {1700000000 + 5 * i, 95000000 + (int32_t)(i * 37) % 900, 763000000 - (int32_t)i * 11,
+                    (uint16_t)(200 + i % 50), (uint16_t)((i * 700) % 36000)};
+    store.push_back(p);
+  }
+
+  uint8_t buf[244];
+  std::vector<TrackPoint> got;
+  BleTrackXfer x;
+
+  // Points 100..899, 64-point window, 185-byte notifications; ack every packet
+  x.begin(100, 900, 0, 64, 0);
+  size_t n, packets = 0;
+  while ((n = x.next(buf, 185, readStore, 0))) {
+    if (buf[0] == TRK_END) break;
+    CHECK_EQ(buf[0], TRK_DATA);
+    CHECK(n <= 185);
+    decode(buf, n, got);
+    x.ack(got.size(), 0);
+    packets++;
+  }
+  CHECK_EQ(buf[0], TRK_END);
+  CHECK_EQ(getU32(buf + 1), 800);
+  CHECK(!x.active());
+  CHECK_EQ(got.size(), 800);
+  CHECK(!memcmp(got.data(), &store[100], 800 * sizeof(TrackPoint)));
+  CHECK(packets < 80);  // deltas, not 16-byte points
+
+  // Without acks the window stops it; after the timeout it goes back
+  x.begin(0, 1000, 0, 64, 0);
+  uint32_t sentTo = 0;
+  while ((n = x.next(buf, 185, readStore, 0))) sentTo = getU32(buf + 1) + buf[5];
+  CHECK_EQ(sentTo, 64);
+  x.ack(20, 100);
+  CHECK(x.next(buf, 185, readStore, 100) > 0);  // window moved
+  CHECK_EQ(x.next(buf, 185, readStore, 100 + TRK_ACK_TIMEOUT_MS + 1) > 0, 1);
+  CHECK_EQ(getU32(buf + 1), 20);
+  x.cancel();
+
+  // Resuming starts at the offset asked for
+  x.begin(0, 1000, 990, 64, 0);
+  n = x.next(buf, 185, readStore, 0);
+  CHECK_EQ(getU32(buf + 1), 990);
+  CHECK_EQ(buf[5], 10);
+  x.cancel();
+
+  // Default ATT MTU: 20 bytes is less than one point, so an error, not a stall
+  x.begin(0, 1000, 0, 64, 0);
+  n = x.next(buf, 20, readStore, 0);
+  CHECK_EQ(n, 2);
+  CHECK_EQ(buf[0], TRK_ERR);
+  CHECK_EQ(buf[1], TRK_ERR_MTU);
+  CHECK(!x.active());
+  x.begin(0, 1000, 0, 64, 0);
+  n = x.next(buf, TRK_MIN_CHUNK, readStore, 0);
+  CHECK_EQ(buf[0], TRK_DATA);
+  CHECK_EQ(buf[5], 1);
+
+  // An empty range ends at once
+  x.begin(500, 500, 0, 64, 0);
+  CHECK_EQ(x.next(buf, 185, readStore, 0), 5);
+  CHECK_EQ(buf[0], TRK_END);
+  return TEST_END();
+}
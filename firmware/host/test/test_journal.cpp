@@ -0,0 +1,153 @@
+// BoatJournal: append/drain round trip, priorities, flash write failures and reboots
+#include "host_test.h"
+#include <boat_journal.h>
+#include <esp_partition.h>
+
+static JournalRec rec(uint32_t t, int32_t dlat, uint8_t prio = JOURNAL_PRIO_NORMAL) {
+  JournalRec r = {};
+  r.t = 1700000000 + t;
+  r.lat1e7 = 95000000 + dlat;
+  r.lon1e7 = 763000000 - dlat / 2;
+  r.spd_cms = 250 + t % 7;
+  r.hdg_cdeg = (t * 100) % 36000;
+  r.batt_pc = 80;
+  r.prio = prio;
+  return r;
+}
+
+static bool same(const JournalRec &a, const JournalRec &b) {
+  return a.t == b.t && a.lat1e7 == b.lat1e7 && a.lon1e7 == b.lon1e7 && a.spd_cms == b.spd_cms &&
+         a.hdg_cdeg == b.hdg_cdeg && a.batt_pc == b.batt_pc;
+}
+
+// Drains every unsent block; returns the record count, out[] in drain order.
+static size_t drain(BoatJournal &j, JournalRec *out, size_t max, uint8_t *prios = nullptr) {
+  uint32_t addr;
+  uint8_t body[JOURNAL_BODY_MAX], len, prio;
+  size_t n = 0;
+  while (j.nextUnsent(addr, body, len, prio)) {
+    size_t k = journalDecode(body, len, out + n, max - n);
+    CHECK(k > 0);
+    for (size_t i = 0; prios && i < k; i++) prios[n + i] = prio;
+    n += k;
+    CHECK(j.markSent(addr));
+  }
+  return n;
+}
+
+int main() {
+  hostPartitionAdd("journal", JOURNAL_SUBTYPE, 8 * JOURNAL_SECTOR);
+  BoatJournal j;
+  CHECK(j.begin());
+  CHECK_EQ(j.stats().sectors, 8);
+
+  JournalRec out[128];
+  uint8_t prios[128];
+
+  // Round trip: deltas decode back to the exact records
+  for (uint32_t i = 0; i < 3; i++) j.append(rec(i * 5, i * 40), false, 0);
+  CHECK(j.flush());
+  CHECK_EQ(drain(j, out, 128), 3);
+  for (uint32_t i = 0; i < 3; i++) CHECK(same(out[i], rec(i * 5, i * 40)));
+  CHECK_EQ(j.stats().unsent, 0);
+
+  // Records already delivered live are kept but never drained
+  j.append(rec(20, 0), true, 0);
+  CHECK(j.flush());
+  CHECK_EQ(drain(j, out, 128), 0);
+
+  // An alert goes out first, in a block of its own priority
+  j.append(rec(30, 0), false, 0);
+  j.append(rec(35, 10, JOURNAL_PRIO_SOS), false, 0);
+  CHECK(j.flush());
+  CHECK_EQ(drain(j, out, 128, prios), 2);
+  CHECK(same(out[0], rec(35, 10)));
+  CHECK_EQ(prios[0], JOURNAL_PRIO_SOS);
+  CHECK(same(out[1], rec(30, 0)));
+  CHECK_EQ(prios[1], JOURNAL_PRIO_NORMAL);
+
+  // Flash failing: a record that needs a new block is lost, never put in the
+  // wrong block or delta-encoded against a point that was not stored
+  j.append(rec(40, 0), false, 0);
+  hostPartitionFail(true);
+  j.append(rec(45, 20, JOURNAL_PRIO_ALERT), false, 0);
+  CHECK_EQ(j.stats().lost, 1);
+  JournalRec sent[64];
+  size_t nsent = 0, tries = 0;
+  sent[nsent++] = rec(40, 0);
+  // Alternate long and short moves so some deltas fit after one did not
+  for (uint32_t i = 1; i <= 40; i++, tries++) {
+    JournalRec r = rec(40 + i * 5, (i % 2) ? i * 200000 : i * 200000 + 3);
+    uint32_t lost = j.stats().lost;
+    j.append(r, false, 0);
+    if (j.stats().lost == lost) sent[nsent++] = r;
+  }
+  CHECK(j.stats().lost > 1);
+  CHECK_EQ(nsent + j.stats().lost, tries + 2);
+  hostPartitionFail(false);
+  CHECK(j.flush());
+  size_t n = drain(j, out, 128, prios);
+  CHECK_EQ(n, nsent);
+  for (size_t i = 0; i < n; i++) {
+    CHECK(same(out[i], sent[i]));
+    CHECK_EQ(prios[i], JOURNAL_PRIO_NORMAL);
+  }
+
+  // And writes carry on normally afterwards
+  j.append(rec(400, 0), false, 0);
+  CHECK(j.flush());
+  CHECK_EQ(drain(j, out, 128), 1);
+  CHECK(same(out[0], rec(400, 0)));
+
+  // Reboot: a second BoatJournal on the same flash recovers what the first
+  // wrote, including which blocks went out, and skips a block the power
+  // cut before its commit byte
+  const esp_partition_t *rp = hostPartitionAdd("reboot", JOURNAL_SUBTYPE, 8 * JOURNAL_SECTOR);
+  uint32_t addr, addr2;
+  uint8_t body[JOURNAL_BODY_MAX], len, prio;
+  {
+    BoatJournal a;
+    CHECK(a.begin("reboot"));
+    for (uint32_t i = 0; i < 3; i++) {
+      a.append(rec(500 + i * 5, i * 10), false, 0);
+      CHECK(a.flush());
+    }
+    CHECK(a.nextUnsent(addr, body, len, prio));
+    CHECK(a.markSent(addr));
+    CHECK(a.nextUnsent(addr2, body, len, prio));
+  }
+  uint32_t addr3 = addr2 + 6 + len;  // block header, then the body
+  rp->mem[addr3 + 4] = 0xFF;         // never committed
+  {
+    BoatJournal b;
+    CHECK(b.begin("reboot"));
+    CHECK_EQ(b.stats().blocks, 2);
+    CHECK_EQ(b.stats().unsent, 1);
+    CHECK_EQ(b.stats().torn, 1);
+    CHECK(b.nextUnsent(addr, body, len, prio));
+    CHECK_EQ(addr, addr2);
+    CHECK_EQ(journalDecode(body, len, out, 128), 1);
+    CHECK(same(out[0], rec(505, 10)));
+    CHECK(b.markSent(addr));
+    // Appends go on in a fresh sector, not after the torn block
+    b.append(rec(600, 0), false, 0);
+    CHECK(b.flush());
+    CHECK(b.stats().head != addr3 / JOURNAL_SECTOR);
+    b.append(rec(605, 0), false, 0);
+    CHECK(b.flush());
+  }
+  // The last block's body no longer matches its CRC
+  {
+    BoatJournal c;
+    CHECK(c.begin("reboot"));
+    CHECK(c.nextUnsent(addr, body, len, prio));
+    rp->mem[addr + 6 + len + 6 + 1] ^= 0x01;
+  }
+  BoatJournal d;
+  CHECK(d.begin("reboot"));
+  CHECK_EQ(d.stats().torn, 2);
+  CHECK_EQ(d.stats().blocks, 3);
+  CHECK_EQ(drain(d, out, 128), 1);
+  CHECK(same(out[0], rec(600, 0)));
+  return TEST_END();
+}
@@ -0,0 +1,92 @@
+// jsonBind: binding, skipping, errors and the nesting cap
+#include "host_test.h"
+#include <boat_json.h>
+#include <string.h>
+#include <string>
+
+struct Req {
+  char boatId[8];
+  uint16_t userId;
+  int8_t tz;
+  float lat;
+  bool ok;
+};
+
+static int bind(const std::string &s, Req &r, uint32_t *seen) {
+  memset(&r, 0, sizeof(r));
+  const JsonField f[] = {
+    JSON_STR_FIELD("boat_id", r.boatId),
+    JSON_UINT_FIELD("user_id", r.userId),
+    JSON_INT_FIELD("tz", r.tz),
+    JSON_FLOAT_FIELD("lat", r.lat),
+    JSON_BOOL_FIELD("ok", r.ok),
+  };
+  return jsonBind(s.data(), s.size(), f, 5, seen);
+}
+
+// An unknown member nested depth levels deep, the outer object counting as 1
+static std::string nested(int depth) {
+  return "{\"x\":" + std::string(depth - 1, '[') + std::string(depth - 1, ']') + ",\"user_id\":5}";
+}
+
+int main() {
+  Req r;
+  uint32_t seen;
+  CHECK_EQ(bind("{\"boat_id\":\"b\\u00e9\",\"user_id\":65535,\"tz\":-5,\"lat\":9.5,\"ok\":true}", r, &seen), JSON_OK);
+  CHECK_EQ(seen, 0x1F);
+  CHECK(!strcmp(r.boatId, "b\xc3\xa9"));
+  CHECK_EQ(r.userId, 65535);
+  CHECK_EQ(r.tz, -5);
+  CHECK(r.lat > 9.49f && r.lat < 9.51f);
+  CHECK(r.ok);
+
+  // Absent keys are not seen; unknown ones, nested or not, are skipped
+  CHECK_EQ(bind(" { \"a\" : {\"b\":[1,\"]\",null]}, \"user_id\" : 1 } ", r, &seen), JSON_OK);
+  CHECK_EQ(seen, 0x2);
+  CHECK_EQ(bind("{}", r, &seen), JSON_OK);
+  CHECK_EQ(seen, 0);
+
+  CHECK_EQ(bind("{\"user_id\":65536}", r, &seen), JSON_ERR_RANGE);
+  CHECK_EQ(bind("{\"user_id\":-1}", r, &seen), JSON_ERR_RANGE);
+  CHECK_EQ(bind("{\"tz\":128}", r, &seen), JSON_ERR_RANGE);
+  CHECK_EQ(bind("{\"boat_id\":\"12345678\"}", r, &seen), JSON_ERR_RANGE);  // no room for the NUL
+  CHECK_EQ(bind("{\"user_id\":\"1\"}", r, &seen), JSON_ERR_TYPE);
+  CHECK_EQ(bind("{\"user_id\":1.5}", r, &seen), JSON_ERR_TYPE);
+  CHECK_EQ(bind("{\"user_id\":1", r, &seen), JSON_ERR_SYNTAX);
+  CHECK_EQ(bind("[1]", r, &seen), JSON_ERR_SYNTAX);
+  CHECK_EQ(bind("{\"boat_id\":\"a\nb\"}", r, &seen), JSON_ERR_SYNTAX);
+  CHECK_EQ(seen, 0);
+
+  // Nesting: JSON_MAX_DEPTH is fine, one more is refused without recursing
+  CHECK_EQ(bind(nested(JSON_MAX_DEPTH), r, &seen), JSON_OK);
+  CHECK_EQ(r.userId, 5);
+  CHECK_EQ(bind(nested(JSON_MAX_DEPTH + 1), r, &seen), JSON_ERR_SYNTAX);
+  std::string deep = "{\"x\":" + std::string(1500, '[');  // as much as fits in BH_RX_MAX
+  CHECK_EQ(bind(deep, r, &seen), JSON_ERR_SYNTAX);
+  std::string deepObj = "{\"x\":";
+  for (int i = 0; i < 300; i++) deepObj += "{\"y\":";
+  CHECK_EQ(bind(deepObj, r, &seen), JSON_ERR_SYNTAX);
+
+  // A nested object is handed back in place, for a second bind
+  std::string ev = "{\"deviceInfo\": {\"devEui\":\"0102\",\"tags\":{}} ,\"fPort\":10}";
+  struct { JsonSpan dev; uint8_t port; } e = {};
+  const JsonField ef[] = { JSON_OBJ_FIELD("deviceInfo", e.dev), JSON_UINT_FIELD("fPort", e.port) };
+  CHECK_EQ(jsonBind(ev.data(), ev.size(), ef, 2, &seen), JSON_OK);
+  CHECK_EQ(seen, 0x3);
+  CHECK(std::string(e.dev.p, e.dev.len) == "{\"devEui\":\"0102\",\"tags\":{}}");
+  char eui[8];
+  const JsonField df[] = { JSON_STR_FIELD("devEui", eui) };
+  CHECK_EQ(jsonBind(e.dev.p, e.dev.len, df, 1, &seen), JSON_OK);
+  CHECK(!strcmp(eui, "0102"));
+  ev = "{\"deviceInfo\":\"0102\"}";
+  CHECK_EQ(jsonBind(ev.data(), ev.size(), ef, 2, &seen), JSON_ERR_TYPE);
+  ev = "{\"deviceInfo\":{\"a\":1}";
+  CHECK_EQ(jsonBind(ev.data(), ev.size(), ef, 2, &seen), JSON_ERR_SYNTAX);
+
+  char esc[16];
+  CHECK(jsonEscape(esc, sizeof(esc), "a\"b\\\n"));
+  CHECK(!strcmp(esc, "a\\\"b\\\\\\n"));
+  CHECK(!jsonEscape(esc, 4, "abcd"));
+  CHECK(!strcmp(esc, "abc"));
+  return TEST_END();
+}
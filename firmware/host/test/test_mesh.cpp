@@ -0,0 +1,49 @@
+// Mesh frames: classification and the relay rule
+#include "host_test.h"
+#include <boat_mesh.h>
+
+int main() {
+  NavState none = {};
+  Pkt p, fwd;
+  pktBuild(p, 9, 100, none, 70, 9, "Relay");
+
+  CHECK(meshClassify((const uint8_t *)&p, sizeof(p)) == MESH_FRAME_PKT);
+  Pkt bad = p;
+  bad.seq++;
+  CHECK(meshClassify((const uint8_t *)&bad, sizeof(bad)) == MESH_FRAME_BAD);
+  CHECK(meshClassify((const uint8_t *)&p, sizeof(p) - 1) == MESH_FRAME_BAD);
+
+  // Each relay adds a hop and re-signs; none past MESH_MAX_HOPS
+  Pkt in = p;
+  for (uint8_t h = 0; h < MESH_MAX_HOPS; h++) {
+    CHECK(meshRelay(in, fwd));
+    CHECK_EQ(fwd.hops, h + 1);
+    CHECK(pktCheck(fwd));
+    CHECK_EQ(fwd.src, p.src);
+    CHECK_EQ(fwd.seq, p.seq);
+    in = fwd;
+  }
+  CHECK(!meshRelay(in, fwd));
+
+  // Uplinked copies are never hops 0, whatever the mesh did with them
+  CHECK(meshUplink(p, fwd));
+  CHECK_EQ(fwd.hops, 1);
+  CHECK(pktCheck(fwd));
+  CHECK(meshUplink(in, fwd));
+  CHECK_EQ(fwd.hops, MESH_MAX_HOPS + 1);
+  in.hops = 255;
+  CHECK(!meshUplink(in, fwd));
+
+  // Backlog: [magic][u16 src][body][crc16]
+  uint8_t b[16] = {BACKLOG_MAGIC, 9, 0, 1, 2, 3, 4, 5};
+  uint16_t c = crc16_ccitt(b, 8);
+  memcpy(b + 8, &c, 2);
+  CHECK(meshClassify(b, 10) == MESH_FRAME_BACKLOG);
+  b[4] ^= 1;
+  CHECK(meshClassify(b, 10) == MESH_FRAME_BAD);
+  b[4] ^= 1;
+  b[0] = 0;
+  CHECK(meshClassify(b, 10) == MESH_FRAME_BAD);
+  CHECK(meshClassify(b, 5) == MESH_FRAME_BAD);
+  return TEST_END();
+}
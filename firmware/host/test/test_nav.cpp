@@ -0,0 +1,70 @@
+// NavFilter: seeding, tracking a moving boat, gating and re-seeding
+#include "host_test.h"
+#include <boat_nav.h>
+#include <stdlib.h>
+
+const int32_t LAT0 = 95000000, LON0 = 763000000;  // off Kochi
+const int32_t DEG1E7_PER_M = 90;                   // a metre of latitude, near enough
+
+static NavFix at(int32_t lat, int32_t lon, uint16_t hdop = 100, uint8_t sats = 8) {
+  NavFix f = {};
+  f.lat1e7 = lat; f.lon1e7 = lon;
+  f.hdop_x100 = hdop; f.sats = sats;
+  return f;
+}
+
+int main() {
+  NavFilter nf;
+  CHECK(!nf.state().valid);
+
+  // Poor fixes never seed
+  CHECK(!nf.update(at(LAT0, LON0, 900), 0));
+  CHECK(!nf.update(at(LAT0, LON0, 100, 3), 0));
+  CHECK_EQ(nf.state().rejected, 2);
+  CHECK(!nf.state().valid);
+
+  // First good fix seeds on the spot
+  CHECK(nf.update(at(LAT0, LON0), 1000));
+  CHECK(nf.state().valid);
+  CHECK_EQ(nf.state().lat1e7, LAT0);
+  CHECK_EQ(nf.state().lon1e7, LON0);
+
+  // Due north at 2 m/s, a fix a second: speed and heading settle
+  uint32_t t = 1000;
+  int32_t lat = LAT0;
+  for (int i = 0; i < 60; i++) {
+    t += 1000;
+    lat += 2 * DEG1E7_PER_M;
+    CHECK(nf.update(at(lat, LON0), t));
+  }
+  const NavState &s = nf.state();
+  CHECK(abs((int)s.spd_cms - 200) < 20);
+  CHECK(s.hdg_cdeg < 300 || s.hdg_cdeg > 35700);
+  CHECK(abs(s.lat1e7 - lat) < 5 * DEG1E7_PER_M);
+  CHECK(abs(s.lon1e7 - LON0) < 5 * DEG1E7_PER_M);
+
+  // A 1 km jump is gated out and leaves the state alone
+  NavState before = s;
+  t += 1000;
+  CHECK(!nf.update(at(lat + 1000 * DEG1E7_PER_M, LON0), t));
+  CHECK_EQ(nf.state().lat1e7, before.lat1e7);
+  CHECK_EQ(nf.state().rejected, 3);
+
+  // ...and the next good fix predicts over the whole gap
+  t += 1000;
+  lat += 4 * DEG1E7_PER_M;
+  CHECK(nf.update(at(lat, LON0), t));
+
+  // NAV_MAX_REJECTS outliers in a row: the next fix re-seeds there
+  int32_t moved = lat + 3000 * DEG1E7_PER_M;
+  for (int i = 0; i < NAV_MAX_REJECTS; i++) CHECK(!nf.update(at(moved, LON0), t += 1000));
+  CHECK(nf.update(at(moved, LON0), t += 1000));
+  CHECK_EQ(nf.state().lat1e7, moved);
+
+  // So does a gap longer than NAV_MAX_DT_MS
+  int32_t far = moved + 20000 * DEG1E7_PER_M;
+  CHECK(nf.update(at(far, LON0), t += NAV_MAX_DT_MS + 1));
+  CHECK_EQ(nf.state().lat1e7, far);
+  CHECK_EQ(nf.state().spd_cms, 0);
+  return TEST_END();
+}
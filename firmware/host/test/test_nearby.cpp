@@ -0,0 +1,44 @@
+// NearbyCache: eviction, the event ring, and the JSON size bounds streams rely on
+#include "host_test.h"
+#include <boat_nearby.h>
+
+static Pkt worst(uint16_t src, uint32_t seq) {
+  Pkt p;
+  memset(&p, 0, sizeof(p));
+  p.src = src; p.seq = seq;
+  p.lat1e7 = INT32_MIN; p.lon1e7 = INT32_MIN;
+  p.spd_cms = 65535; p.hdg_cdeg = 65535;
+  p.batt_pc = 255; p.user_id = 65535;
+  p.name_len = 12;
+  memset(p.name_utf8, 0x01, 12);  // each one escapes to \u0001
+  pktSign(p);
+  return p;
+}
+
+int main() {
+  hostClockManual();
+  NavState nav = {};
+  nav.valid = true;
+  nav.lat1e7 = INT32_MAX; nav.lon1e7 = INT32_MAX;
+  nav.vn_cms = 3000; nav.ve_cms = -3000;
+
+  NearbyCache c;
+  for (uint16_t i = 0; i < MAX_NEARBY_BOATS + 5; i++) c.update(worst(60000 + i, i), 1000 + i);
+  CHECK_EQ(c.boats().size(), MAX_NEARBY_BOATS);
+  CHECK_EQ(c.boats()[0].boat_id, 60005);  // the first five went, oldest first
+  CHECK_EQ(c.version(), MAX_NEARBY_BOATS + 5 + 5);
+
+  // The last ring entries are the last update and the eviction before it
+  CHECK(!c.event(c.version()).gone);
+  CHECK_EQ(c.event(c.version()).b.boat_id, 60000 + MAX_NEARBY_BOATS + 4);
+  CHECK(c.event(c.version() - 1).gone);
+
+  uint32_t now = 4000000000u;
+  for (const BoatEntry &b : c.boats()) {
+    String j = nearbyBoatJson(b, now, nav);
+    CHECK(j.length() <= NEARBY_BOAT_JSON_MAX);
+  }
+  String all = c.json(now, nav);
+  CHECK(all.length() <= NEARBY_JSON_MAX);
+  return TEST_END();
+}
@@ -0,0 +1,54 @@
+// Pkt framing: sign/check, name truncation, pktBuild
+#include "host_test.h"
+#include <boat_pkt.h>
+
+static NavState fix(int32_t lat, int32_t lon) {
+  NavState n = {};
+  n.valid = true;
+  n.lat1e7 = lat; n.lon1e7 = lon;
+  n.spd_cms = 250; n.hdg_cdeg = 9000;
+  return n;
+}
+
+int main() {
+  // CRC16-CCITT (0xFFFF) check value
+  CHECK_EQ(crc16_ccitt((const uint8_t *)"123456789", 9), 0x29B1);
+
+  Pkt p;
+  pktBuild(p, 42, 7, fix(95000000, 763000000), 80, 3, "Kochi");
+  CHECK(pktCheck(p));
+  CHECK_EQ(p.src, 42);
+  CHECK_EQ(p.seq, 7);
+  CHECK_EQ(p.lat1e7, 95000000);
+  CHECK_EQ(p.lon1e7, 763000000);
+  CHECK_EQ(p.hops, 0);
+  CHECK_EQ(p.name_len, 5);
+  CHECK(!memcmp(p.name_utf8, "Kochi", 5));
+
+  // Every field is covered: flip each byte before the crc
+  for (size_t i = 0; i < sizeof(Pkt) - 2; i++) {
+    Pkt q = p;
+    ((uint8_t *)&q)[i] ^= 0x01;
+    CHECK(!pktCheck(q));
+    pktSign(q);
+    CHECK(pktCheck(q));
+  }
+
+  // No fix: position stays 0, the rest is still sent
+  NavState none = {};
+  pktBuild(p, 1, 2, none, 50, 1, "x");
+  CHECK(pktCheck(p));
+  CHECK_EQ(p.lat1e7, 0);
+  CHECK_EQ(p.lon1e7, 0);
+
+  // Names are cut on a character boundary and zero-padded
+  pktBuild(p, 1, 2, none, 50, 1, "\xe0\xb4\xae\xe0\xb5\x80\xe0\xb4\xa8\xe0\xb5\x8d\xe0\xb4\xaa");  // 5 x 3 bytes
+  CHECK_EQ(p.name_len, 12);
+  pktBuild(p, 1, 2, none, 50, 1, "abcdefghijk\xc3\xa9");  // 11 + 2 bytes
+  CHECK_EQ(p.name_len, 11);
+  CHECK_EQ(p.name_utf8[11], 0);
+  uint8_t out[4];
+  CHECK_EQ(utf8_truncate("\xf0\x9f\x9a\xa4z", out, 3), 0);
+  CHECK_EQ(utf8_truncate("\xff", out, 4), 0);  // not UTF-8
+  return TEST_END();
+}
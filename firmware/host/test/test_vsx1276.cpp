@@ -0,0 +1,217 @@
+// VirtualSX1276 at register level, over SPI with the sequences RadioLib and LMIC use
+#include "host_test.h"
+#include <vsx1276.h>
+#include <host_lora.h>
+
+struct Chip {
+  VsxPins pins;
+  VirtualSX1276 *vsx;
+};
+
+static uint32_t dio0Edges[2], dio1EdgesB;
+static void onDio0A() { dio0Edges[0]++; }
+static void onDio0B() { dio0Edges[1]++; }
+static void onDio1B() { dio1EdgesB++; }
+
+static void wr(const Chip &c, uint8_t a, uint8_t v) {
+  digitalWrite(c.pins.nss, LOW);
+  SPI.transfer(a | 0x80);
+  SPI.transfer(v);
+  digitalWrite(c.pins.nss, HIGH);
+}
+
+static uint8_t rd(const Chip &c, uint8_t a) {
+  digitalWrite(c.pins.nss, LOW);
+  SPI.transfer(a & 0x7F);
+  uint8_t v = SPI.transfer(0);
+  digitalWrite(c.pins.nss, HIGH);
+  return v;
+}
+
+static void setFrf(const Chip &c, float mhz) {
+  uint32_t frf = (uint32_t)(mhz * 1e6 / (32e6 / (1 << 19)) + 0.5);
+  wr(c, 0x06, frf >> 16); wr(c, 0x07, frf >> 8); wr(c, 0x08, frf);
+}
+
+// LoRa standby on the mesh channel: SF9, 125 kHz, CR 4/5, CRC on, sync 0x34
+static void loraInit(const Chip &c) {
+  wr(c, 0x01, 0x00);  // FSK sleep, then LoRa mode (only settable in sleep)
+  wr(c, 0x01, 0x80);
+  wr(c, 0x01, 0x81);
+  setFrf(c, 865.2);
+  wr(c, 0x09, 0x8F);  // PA_BOOST, 17 dBm
+  wr(c, 0x1D, 0x72);
+  wr(c, 0x1E, 0x94);
+  wr(c, 0x39, 0x34);
+  wr(c, 0x0E, 0x80); wr(c, 0x0F, 0x00);
+}
+
+static void send(const Chip &c, const uint8_t *d, uint8_t n) {
+  wr(c, 0x40, 0x40);  // DIO0 = TxDone
+  wr(c, 0x0D, 0x80);
+  for (uint8_t i = 0; i < n; i++) wr(c, 0x00, d[i]);
+  wr(c, 0x22, n);
+  wr(c, 0x01, 0x83);
+}
+
+static void listen(const Chip &c) {
+  wr(c, 0x40, 0x00);  // DIO0 = RxDone
+  wr(c, 0x12, 0xFF);
+  wr(c, 0x01, 0x85);
+}
+
+static void advance(uint64_t us) {
+  hostClockAdvanceUs(us);
+  millis();  // the poll hook lets the chips catch up
+}
+
+int main() {
+  hostClockManual(1000000);
+  Chip a = {{4, 6, 5, VSX_NO_PIN, VSX_NO_PIN}, nullptr};
+  Chip b = {{8, 10, 9, 11, VSX_NO_PIN}, nullptr};
+  Chip c = {{12, 14, 13, VSX_NO_PIN, VSX_NO_PIN}, nullptr};
+  for (Chip *k : {&a, &b, &c}) {
+    k->vsx = new VirtualSX1276(k->pins);
+    pinMode(k->pins.nss, OUTPUT);
+    digitalWrite(k->pins.nss, HIGH);
+  }
+  attachInterrupt(a.pins.dio0, onDio0A, RISING);
+  attachInterrupt(b.pins.dio0, onDio0B, RISING);
+  attachInterrupt(b.pins.dio1, onDio1B, RISING);
+
+  CHECK_EQ(rd(a, 0x42), 0x12);  // RegVersion, what RadioLib probes for
+  for (Chip *k : {&a, &b, &c}) loraInit(*k);
+  CHECK_EQ(rd(a, 0x01), 0x81);
+  CHECK_EQ(rd(a, 0x39), 0x34);
+
+  // A frame goes out for its time on air and lands in the receiver's FIFO
+  const uint8_t msg[] = "boat 7 at sea";
+  const uint8_t n = sizeof(msg);
+  uint32_t toa = hostLoraTimeOnAirUs(n, 9, 125, 5, true);
+  listen(b);
+  send(a, msg, n);
+  CHECK_EQ(rd(a, 0x01) & 0x07, 3);
+  advance(toa / 2);
+  CHECK_EQ(rd(a, 0x12), 0);
+  CHECK_EQ(dio0Edges[1], 0);
+  advance(toa / 2 + 1000);
+  CHECK_EQ(rd(a, 0x12) & 0x08, 0x08);  // TxDone
+  CHECK_EQ(rd(a, 0x01) & 0x07, 1);     // back in standby
+  CHECK_EQ(dio0Edges[0], 1);
+  CHECK_EQ(dio0Edges[1], 1);
+  CHECK_EQ(rd(b, 0x12), 0x50);         // ValidHeader | RxDone, no CRC error
+  CHECK_EQ(rd(b, 0x13), n);
+  wr(b, 0x0D, rd(b, 0x10));
+  bool same = true;
+  for (uint8_t i = 0; i < n; i++) same &= rd(b, 0x00) == msg[i];
+  CHECK(same);
+  wr(b, 0x12, 0xFF);                   // write-1-to-clear drops DIO0
+  CHECK_EQ(rd(b, 0x12), 0);
+  wr(a, 0x12, 0xFF);
+
+  // Another channel is not heard (drivers retune in standby, as here)
+  wr(b, 0x01, 0x81);
+  setFrf(b, 866.0);
+  listen(b);
+  send(a, msg, n);
+  advance(toa + 1000);
+  CHECK_EQ(rd(b, 0x12), 0);
+  CHECK_EQ(dio0Edges[1], 1);
+  wr(b, 0x01, 0x81);
+  setFrf(b, 865.2);
+  wr(a, 0x12, 0xFF);
+
+  // Two frames at the same strength overlap: the receiver flags a CRC error
+  listen(b);
+  send(a, msg, n);
+  advance(toa / 4);
+  send(c, msg, n);
+  advance(toa + 1000);
+  CHECK_EQ(rd(b, 0x12) & 0x60, 0x60);  // RxDone | PayloadCrcError
+  CHECK_EQ(b.vsx->crcErrors(), 1);
+  wr(a, 0x12, 0xFF); wr(c, 0x12, 0xFF);
+
+  // Below sensitivity nothing arrives at all
+  vsxLinkLoss(*a.vsx, *b.vsx, 160);
+  listen(b);
+  send(a, msg, n);
+  advance(toa + 1000);
+  CHECK_EQ(rd(b, 0x12), 0);
+  CHECK_EQ(a.vsx->txFrames(), 4);
+  CHECK_EQ(b.vsx->rxFrames(), 2);
+
+  // Unequal strengths: a frame VSX_CAPTURE_DB or more above the other
+  // survives the overlap...
+  wr(b, 0x01, 0x81);                   // listen afresh, past the frame it could not hear
+  vsxLinkLoss(*a.vsx, *b.vsx, 80);     // a 20 dB over c at b
+  listen(b);
+  send(a, msg, n);
+  advance(toa / 4);
+  send(c, msg, n);
+  advance(toa + 1000);
+  CHECK_EQ(rd(b, 0x12), 0x50);
+  wr(a, 0x12, 0xFF); wr(b, 0x12, 0xFF); wr(c, 0x12, 0xFF);
+  // ...while the weaker one is lost, and the receiver does not move over
+  listen(b);
+  send(c, msg, n);
+  advance(toa / 4);
+  send(a, msg, n);
+  advance(toa + 1000);
+  CHECK_EQ(rd(b, 0x12) & 0x60, 0x60);
+  CHECK_EQ(b.vsx->rxFrames(), 4);
+  CHECK_EQ(b.vsx->crcErrors(), 2);
+  wr(a, 0x12, 0xFF); wr(c, 0x12, 0xFF);
+
+  // RXSINGLE, as LMIC opens RX1/RX2: a frame inside the window is taken,
+  // then the chip is back in standby...
+  const uint32_t sym = (1 << 9) * 1000 / 125;
+  wr(b, 0x01, 0x81);
+  wr(b, 0x40, 0x00);                   // DIO0 = RxDone, DIO1 = RxTimeout
+  wr(b, 0x1F, 8);                      // SymbTimeout, 8 symbols
+  wr(b, 0x12, 0xFF);
+  wr(b, 0x01, 0x86);
+  send(a, msg, n);
+  advance(toa + 1000);
+  CHECK_EQ(rd(b, 0x12), 0x50);
+  CHECK_EQ(rd(b, 0x01) & 0x07, 1);
+  wr(a, 0x12, 0xFF); wr(b, 0x12, 0xFF);
+  // ...and with nothing on the air it gives up after SymbTimeout symbols
+  wr(b, 0x01, 0x86);
+  advance(7 * sym);
+  CHECK_EQ(rd(b, 0x12), 0);
+  CHECK_EQ(rd(b, 0x01) & 0x07, 6);
+  advance(2 * sym);
+  CHECK_EQ(rd(b, 0x12), 0x80);         // RxTimeout
+  CHECK_EQ(rd(b, 0x01) & 0x07, 1);
+  CHECK_EQ(dio1EdgesB, 1);
+  wr(b, 0x12, 0xFF);
+
+  // CAD: CadDone on DIO0, CadDetected only with a frame on the channel
+  wr(b, 0x40, 0x80);                   // DIO0 = CadDone
+  wr(b, 0x01, 0x87);
+  advance(3 * sym);
+  CHECK_EQ(rd(b, 0x12), 0x04);
+  CHECK_EQ(rd(b, 0x01) & 0x07, 1);
+  wr(b, 0x12, 0xFF);
+  send(a, msg, n);
+  advance(sym);
+  wr(b, 0x01, 0x87);
+  advance(3 * sym);
+  CHECK_EQ(rd(b, 0x12), 0x05);         // CadDone | CadDetected
+  advance(toa);
+  wr(a, 0x12, 0xFF); wr(b, 0x12, 0xFF);
+
+  // FSK page: image calibration the way LMIC runs it at reset, which
+  // leaves the LoRa page alone
+  wr(a, 0x01, 0x80);                   // LoRa sleep, FSK sleep, FSK standby
+  wr(a, 0x01, 0x00);
+  wr(a, 0x01, 0x01);
+  CHECK_EQ(rd(a, 0x39), 0x00);         // FSK page, not the LoRa sync word
+  wr(a, 0x3B, rd(a, 0x3B) | 0x40);     // ImageCalStart
+  CHECK_EQ(rd(a, 0x3B) & 0x60, 0);     // started and done, not running
+  wr(a, 0x01, 0x00);
+  wr(a, 0x01, 0x80);
+  wr(a, 0x01, 0x81);
+  CHECK_EQ(rd(a, 0x39), 0x34);
+  return TEST_END();
+}
@@ -0,0 +1,416 @@
+#include "boat_bench.h"
+#include <boat_pkt.h>
+#include <boat_nav.h>
+#include <boat_nearby.h>
+#include <boat_digest.h>
+#include <new>
+
+#if BOAT_BENCH_NMEA
+#include <TinyGPSPlus.h>
+#endif
+
+#if !defined(ARDUINO_ARCH_ESP32) && (defined(__x86_64__) || defined(__i386__))
+#define BENCH_TSC 1
+#include <x86intrin.h>
+#endif
+
+#ifdef ARDUINO_ARCH_ESP32
+const uint32_t BENCH_MAX_ARG = 200;   // 1000 boats of /nearby JSON do not fit the heap
+#else
+const uint32_t BENCH_MAX_ARG = 0xFFFFFFFF;
+#endif
+
+#if BENCH_TSC
+uint64_t benchCycles() { return __rdtsc(); }
+#else
+// CCOUNT (and the shim's ns count) is 32 bits, gone round every 18 s at
+// 240 MHz: the high word counts the wraps seen between calls, which is
+// exact while a timed run is shorter than one wrap.
+static uint64_t benchExtend(uint32_t now) {
+  static uint32_t last, high;
+  if (now < last) high++;
+  last = now;
+  return (uint64_t)high << 32 | now;
+}
+
+uint64_t benchCycles() { return benchExtend(ESP.getCycleCount()); }
+#endif
+
+const char *benchCycleSource() {
+#ifdef ARDUINO_ARCH_ESP32
+  return "ccount";
+#elif defined(__x86_64__) || defined(__i386__)
+  return "tsc";
+#else
+  return "ns";
+#endif
+}
+
+// Keeps results alive without the compiler seeing through them
+static volatile uint32_t benchSink;
+
+const int32_t BENCH_LAT = 95000000, BENCH_LON = 763000000;
+
+static NavState benchNav() {
+  NavState n = {};
+  n.valid = true;
+  n.lat1e7 = BENCH_LAT; n.lon1e7 = BENCH_LON;
+  n.vn_cms = 120; n.ve_cms = 80; n.spd_cms = 144; n.hdg_cdeg = 3369;
+  return n;
+}
+
+static void benchPkt(Pkt &p, uint16_t src, uint16_t seq) {
+  NavState n = benchNav();
+  n.lat1e7 += (int32_t)(src * 7919) % 400000;
+  n.lon1e7 += (int32_t)(src * 104729) % 400000;
+  char name[16];
+  snprintf(name, sizeof(name), "Boat %u", src);
+  pktBuild(p, src, seq, n, 80, src, name);
+}
+
+static void benchFree(void *ctx) { free(ctx); }
+
+/* ------------ crc16 / frames ------------- */
+struct PktCtx {
+  Pkt p;
+  uint16_t seq;
+};
+
+static void *pktSetup(uint32_t) {
+  PktCtx *c = (PktCtx *)calloc(1, sizeof(PktCtx));
+  benchPkt(c->p, 42, 0);
+  return c;
+}
+
+static void crcStep(void *ctx) {
+  PktCtx *c = (PktCtx *)ctx;
+  benchSink = crc16_ccitt((const uint8_t *)&c->p, sizeof(Pkt) - 2);
+}
+
+static void pktBuildStep(void *ctx) {
+  PktCtx *c = (PktCtx *)ctx;
+  pktBuild(c->p, 42, c->seq++, benchNav(), 80, 7, "Kadalamma");
+  benchSink = c->p.crc;
+}
+
+static void pktCheckStep(void *ctx) {
+  PktCtx *c = (PktCtx *)ctx;
+  benchSink = pktCheck(c->p);
+}
+
+static uint32_t pktBytes(void *) { return sizeof(Pkt); }
+
+struct DigestCtx {
+  DigestBoat boats[DIGEST_MAX_BOATS];
+  uint8_t buf[2 + DIGEST_MAX_BOATS * DIGEST_ENTRY_BYTES];
+  size_t len;
+};
+
+static void *digestSetup(uint32_t) {
+  DigestCtx *c = (DigestCtx *)calloc(1, sizeof(DigestCtx));
+  for (uint8_t i = 0; i < DIGEST_MAX_BOATS; i++)
+    c->boats[i] = {(uint16_t)(100 + i), BENCH_LAT + i * 30011, BENCH_LON - i * 27011, (uint16_t)(150 * i), (uint16_t)(7000 * i), i};
+  c->len = digestEncode(c->boats, DIGEST_MAX_BOATS, c->buf, sizeof(c->buf));
+  return c;
+}
+
+static void digestEncodeStep(void *ctx) {
+  DigestCtx *c = (DigestCtx *)ctx;
+  benchSink = digestEncode(c->boats, DIGEST_MAX_BOATS, c->buf, sizeof(c->buf));
+}
+
+static void digestDecodeStep(void *ctx) {
+  DigestCtx *c = (DigestCtx *)ctx;
+  DigestBoat out[DIGEST_MAX_BOATS];
+  benchSink = digestDecode(c->buf, c->len, BENCH_LAT, BENCH_LON, out, DIGEST_MAX_BOATS) + out[0].lat1e7;
+}
+
+static uint32_t digestBytes(void *ctx) { return ((DigestCtx *)ctx)->len; }
+
+/* ------------ utf8 ------------- */
+// ASCII, Malayalam (3-byte) and an emoji (4-byte) straddling the 12-byte cut
+static const char *const BENCH_NAMES[] = {"Kadalamma", "കടലമ്മ", "Ocean Star 🚤", "St. Antony II"};
+struct Utf8Ctx { uint32_t i; };
+
+static void *utf8Setup(uint32_t) { return calloc(1, sizeof(Utf8Ctx)); }
+
+static void utf8Step(void *ctx) {
+  Utf8Ctx *c = (Utf8Ctx *)ctx;
+  uint8_t out[12];
+  benchSink = utf8_truncate(BENCH_NAMES[c->i++ & 3], out, sizeof(out));
+}
+
+/* ------------ nearby cache ------------- */
+struct CacheCtx {
+  NearbyCache cache;
+  uint32_t n, i, now;
+  Pkt pkts[64];
+  String json;
+  CacheCtx(uint32_t n) : cache(n), n(n), i(0), now(1000) {}
+};
+
+static void *cacheSetup(uint32_t n) {
+  CacheCtx *c = new (std::nothrow) CacheCtx(n);
+  if (!c) return NULL;
+  Pkt p;
+  for (uint32_t k = 0; k < n; k++) {
+    benchPkt(p, k, 0);
+    c->cache.update(p, c->now++);
+  }
+  for (uint32_t k = 0; k < 64; k++) benchPkt(c->pkts[k], k, 1);
+  return c;
+}
+
+static void cacheTeardown(void *ctx) { delete (CacheCtx *)ctx; }
+
+// Boats already in the cache, spread over it
+static void cacheHitStep(void *ctx) {
+  CacheCtx *c = (CacheCtx *)ctx;
+  Pkt &p = c->pkts[c->i & 63];
+  p.src = (uint16_t)((c->i++ * 7) % c->n);
+  c->cache.update(p, c->now++);
+}
+
+// New boats only: every update evicts the oldest entry
+static void cacheEvictStep(void *ctx) {
+  CacheCtx *c = (CacheCtx *)ctx;
+  Pkt &p = c->pkts[c->i & 63];
+  p.src = (uint16_t)(c->n + c->i++ % 60000);
+  c->cache.update(p, c->now++);
+}
+
+static void cacheJsonStep(void *ctx) {
+  CacheCtx *c = (CacheCtx *)ctx;
+  c->json = c->cache.json(c->now, benchNav());
+  benchSink = c->json.length();
+}
+
+static uint32_t cacheJsonBytes(void *ctx) {
+  CacheCtx *c = (CacheCtx *)ctx;
+  if (!c->json.length()) cacheJsonStep(ctx);
+  return c->json.length();
+}
+
+// What a mesh frame costs from the sender's pktBuild() to the receiver's
+// cache: build, sign, CRC check, relay copy re-signed, cache update.
+static void pathStep(void *ctx) {
+  CacheCtx *c = (CacheCtx *)ctx;
+  uint16_t src = (uint16_t)((c->i * 7) % c->n);
+  Pkt p;
+  NavState n = benchNav();
+  n.lat1e7 += c->i & 0xFFF;
+  pktBuild(p, src, (uint16_t)c->i++, n, 80, src, "Kadalamma");
+  uint8_t air[sizeof(Pkt)];
+  memcpy(air, &p, sizeof(air));
+  const Pkt *rp = (const Pkt *)air;
+  if (!pktCheck(*rp)) return;
+  Pkt fwd = *rp;
+  fwd.hops++;
+  pktSign(fwd);
+  c->cache.update(*rp, c->now++);
+  benchSink = fwd.crc;
+}
+
+/* ------------ GPS ------------- */
+static uint8_t nmeaCsum(const char *s) {
+  uint8_t c = 0;
+  for (s++; *s && *s != '*'; s++) c ^= (uint8_t)*s;
+  return c;
+}
+
+// ddmm.mmmmm / dddmm.mmmmm
+static void nmeaCoord(char *out, size_t cap, double deg, int degDigits) {
+  uint32_t m1e5 = (uint32_t)lround(fabs(deg) * 60e5);
+  unsigned d = m1e5 / 6000000, m = m1e5 % 6000000;
+  snprintf(out, cap, "%0*u%02u.%05u", degDigits, d % 1000, m / 100000, m % 100000);
+}
+
+size_t benchNmeaSynth(char *out, size_t cap, uint32_t seconds) {
+  size_t len = 0;
+  double lat = BENCH_LAT / 1e7, lon = BENCH_LON / 1e7;
+  for (uint32_t t = 0; t < seconds; t++) {
+    lat += 1.2 / 111320.0;
+    lon += 0.8 / 111320.0;
+    char la[16], lo[16], s[128];
+    nmeaCoord(la, sizeof(la), lat, 2);
+    nmeaCoord(lo, sizeof(lo), lon, 3);
+    unsigned hh = 6 + t / 3600, mm = t / 60 % 60, ss = t % 60;
+    for (int k = 0; k < 2; k++) {
+      int n = k == 0
+        ? snprintf(s, sizeof(s), "$GPGGA,%02u%02u%02u.00,%s,N,%s,E,1,09,1.10,3.2,M,-94.1,M,,", hh, mm, ss, la, lo)
+        : snprintf(s, sizeof(s), "$GPRMC,%02u%02u%02u.00,A,%s,N,%s,E,2.80,33.7,181026,,,A", hh, mm, ss, la, lo);
+      n += snprintf(s + n, sizeof(s) - n, "*%02X\r\n", nmeaCsum(s));
+      if (len + n >= cap) return len;
+      memcpy(out + len, s, n);
+      len += n;
+    }
+  }
+  out[len] = 0;
+  return len;
+}
+
+struct NavCtx {
+  NavFilter filter;
+  NavFix fixes[120];
+  uint32_t i, now;
+};
+
+static void *navSetup(uint32_t) {
+  NavCtx *c = new NavCtx();
+  for (uint32_t k = 0; k < 120; k++) {
+    NavFix &f = c->fixes[k];
+    f.lat1e7 = BENCH_LAT + k * 108 + (int32_t)(k * 7919 % 41) - 20;
+    f.lon1e7 = BENCH_LON + k * 72 + (int32_t)(k * 104729 % 41) - 20;
+    f.hdop_x100 = 110; f.sats = 9;
+    f.courseValid = false; f.courseDeg = 0;
+    f.speedValid = false; f.speedMps = 0;
+  }
+  c->i = 0; c->now = 1000;
+  return c;
+}
+
+static void navStep(void *ctx) {
+  NavCtx *c = (NavCtx *)ctx;
+  NavFix f = c->fixes[c->i % 120];
+  f.lat1e7 += (c->i / 120) * 120 * 108;  // keep moving on, no jump at the wrap
+  f.lon1e7 += (c->i / 120) * 120 * 72;
+  c->i++;
+  c->now += 1000;
+  benchSink = c->filter.update(f, c->now);
+}
+
+static void navTeardown(void *ctx) { delete (NavCtx *)ctx; }
+
+#if BOAT_BENCH_NMEA
+struct NmeaCtx {
+  TinyGPSPlus gps;
+  NavFilter filter;
+  char *log;
+  size_t len;
+  uint32_t now;
+};
+
+static int32_t benchRaw1e7(const RawDegrees &r) {
+  int32_t v = (int32_t)r.deg * 10000000L + (int32_t)(r.billionths / 100);
+  return r.negative ? -v : v;
+}
+
+static void *nmeaSetup(uint32_t seconds) {
+  NmeaCtx *c = new NmeaCtx();
+  c->log = NULL;
+  c->len = 0;
+  c->now = 1000;
+#ifndef ARDUINO_ARCH_ESP32
+  const char *path = getenv("BOAT_NMEA_LOG");
+  FILE *f = path ? fopen(path, "rb") : NULL;
+  if (f) {
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    c->log = (char *)malloc(n + 1);
+    c->len = fread(c->log, 1, n, f);
+    c->log[c->len] = 0;
+    fclose(f);
+    return c;
+  }
+#endif
+  size_t cap = seconds * 160 + 1;
+  c->log = (char *)malloc(cap);
+  c->len = benchNmeaSynth(c->log, cap, seconds);
+  return c;
+}
+
+// The GPS task's work for the whole log: NMEA parse, then the filter per fix
+static void nmeaStep(void *ctx) {
+  NmeaCtx *c = (NmeaCtx *)ctx;
+  for (size_t i = 0; i < c->len; i++) {
+    if (!c->gps.encode(c->log[i]) || !c->gps.location.isUpdated()) continue;
+    NavFix f;
+    f.lat1e7 = benchRaw1e7(c->gps.location.rawLat());
+    f.lon1e7 = benchRaw1e7(c->gps.location.rawLng());
+    f.hdop_x100 = c->gps.hdop.isValid() ? c->gps.hdop.value() : 9999;
+    f.sats = c->gps.satellites.isValid() ? c->gps.satellites.value() : 0;
+    f.courseValid = c->gps.course.isValid(); f.courseDeg = f.courseValid ? c->gps.course.deg() : 0;
+    f.speedValid = c->gps.speed.isValid();   f.speedMps = f.speedValid ? c->gps.speed.mps() : 0;
+    c->now += 500;
+    c->filter.update(f, c->now);
+  }
+  benchSink = c->gps.passedChecksum();
+}
+
+static void nmeaTeardown(void *ctx) {
+  NmeaCtx *c = (NmeaCtx *)ctx;
+  free(c->log);
+  delete c;
+}
+
+static uint32_t nmeaBytes(void *ctx) { return ((NmeaCtx *)ctx)->len; }
+#endif
+
+#define BENCH_CACHE(kind, n, step, bytes) \
+  {"nearby/" kind "/" #n, n, cacheSetup, step, cacheTeardown, bytes}
+
+const BenchCase BENCH_CASES[] = {
+  {"crc16/pkt",      0, pktSetup,    crcStep,          benchFree, pktBytes},
+  {"pkt/build",      0, pktSetup,    pktBuildStep,     benchFree, pktBytes},
+  {"pkt/check",      0, pktSetup,    pktCheckStep,     benchFree, pktBytes},
+  {"digest/encode",  0, digestSetup, digestEncodeStep, benchFree, digestBytes},
+  {"digest/decode",  0, digestSetup, digestDecodeStep, benchFree, digestBytes},
+  {"utf8/truncate",  0, utf8Setup,   utf8Step,         benchFree, NULL},
+  BENCH_CACHE("update_hit", 30, cacheHitStep, NULL),
+  BENCH_CACHE("update_hit", 100, cacheHitStep, NULL),
+  BENCH_CACHE("update_hit", 1000, cacheHitStep, NULL),
+  BENCH_CACHE("update_evict", 30, cacheEvictStep, NULL),
+  BENCH_CACHE("update_evict", 100, cacheEvictStep, NULL),
+  BENCH_CACHE("update_evict", 1000, cacheEvictStep, NULL),
+  BENCH_CACHE("json", 30, cacheJsonStep, cacheJsonBytes),
+  BENCH_CACHE("json", 100, cacheJsonStep, cacheJsonBytes),
+  BENCH_CACHE("json", 1000, cacheJsonStep, cacheJsonBytes),
+  {"path/rx_to_cache/30",  30,  cacheSetup, pathStep, cacheTeardown, pktBytes},
+  {"path/rx_to_cache/200", 200, cacheSetup, pathStep, cacheTeardown, pktBytes},
+  {"nav/update",     0, navSetup,    navStep,          navTeardown, NULL},
+#if BOAT_BENCH_NMEA
+  {"nmea/parse/60s", 60, nmeaSetup,  nmeaStep,         nmeaTeardown, nmeaBytes},
+#endif
+};
+const size_t BENCH_CASE_COUNT = sizeof(BENCH_CASES) / sizeof(BENCH_CASES[0]);
+
+void benchRunJson(Print &out, uint32_t minMs, const char *filter) {
+  out.printf("{\n  \"context\": {\n    \"executable\": \"BoatBench\",\n    \"boat_fw\": \"%s\",\n"
+             "    \"cycle_counter\": \"%s\",\n    \"mhz_per_cpu\": %lu,\n    \"library_build_type\": \"release\"\n  },\n"
+             "  \"benchmarks\": [",
+             BOAT_FW_VERSION, benchCycleSource(), (unsigned long)ESP.getCpuFreqMHz());
+  bool first = true;
+  for (size_t k = 0; k < BENCH_CASE_COUNT; k++) {
+    const BenchCase &bc = BENCH_CASES[k];
+    if (filter && strncmp(bc.name, filter, strlen(filter))) continue;
+    if (bc.arg > BENCH_MAX_ARG) continue;
+    void *ctx = bc.setup(bc.arg);
+    if (!ctx) continue;
+
+    // Double the count until one run takes minMs, then report that run
+    bc.step(ctx);
+    uint32_t iters = 1, us;
+    uint64_t cyc;
+    for (;;) {
+      uint32_t t0 = micros();
+      uint64_t c0 = benchCycles();
+      for (uint32_t i = 0; i < iters; i++) bc.step(ctx);
+      cyc = benchCycles() - c0;
+      us = micros() - t0;
+      if (us >= minMs * 1000 || iters >= 0x40000000) break;
+      iters = us < 1000 ? iters * 8 : iters * 2;
+    }
+    double ns = us * 1000.0 / iters;
+    out.printf("%s\n    {\n      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"iteration\",\n"
+               "      \"iterations\": %lu,\n      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n"
+               "      \"time_unit\": \"ns\",\n      \"cycles\": %.1f",
+               first ? "" : ",", bc.name, bc.name, (unsigned long)iters, ns, ns, (double)cyc / iters);
+    if (bc.bytes) out.printf(",\n      \"bytes_per_second\": %.1f", bc.bytes(ctx) * 1e9 / ns);
+    out.print("\n    }");
+    first = false;
+    bc.teardown(ctx);
+    delay(1);  // let the idle task feed the watchdog between cases
+  }
+  out.println("\n  ]\n}");
+}
@@ -0,0 +1,55 @@
+/*
+  BoatBench - microbenchmarks of the packet hot path, same code on PC and ESP32
+
+  Every case is setup / step / teardown, where step is one iteration and
+  the only thing timed. The host runner (firmware/host/bench_main.cpp)
+  registers BENCH_CASES with Google Benchmark; the board runner
+  (firmware/test/BoatBenchDevice.cpp) calls benchRunJson(), which times
+  them with benchCycles() and writes the same JSON shape Google Benchmark
+  does with --benchmark_format=json. Both add a "cycles" value per
+  iteration - ESP.getCycleCount() on the board, the TSC on an x86 host -
+  and "boat_fw" (BOAT_FW_VERSION) in the context, so result files from
+  different firmware versions and from both targets can be diffed.
+
+  The nmea/parse case needs TinyGPSPlus (BOAT_BENCH_NMEA, on by default on
+  the board). It parses a synthetic 1 Hz GGA+RMC log, or on the host the
+  file named by BOAT_NMEA_LOG, which is how a recorded log is replayed.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef BOAT_FW_VERSION
+#define BOAT_FW_VERSION "dev"
+#endif
+
+#ifndef BOAT_BENCH_NMEA
+#ifdef ARDUINO_ARCH_ESP32
+#define BOAT_BENCH_NMEA 1
+#else
+#define BOAT_BENCH_NMEA 0
+#endif
+#endif
+
+struct BenchCase {
+  const char *name;
+  uint32_t arg;                       // e.g. cache size; part of the name already
+  void *(*setup)(uint32_t arg);
+  void (*step)(void *ctx);
+  void (*teardown)(void *ctx);
+  uint32_t (*bytes)(void *ctx);       // bytes handled per step, NULL if it does not apply
+};
+
+extern const BenchCase BENCH_CASES[];
+extern const size_t BENCH_CASE_COUNT;
+
+// Free-running cycle counter and what it counts ("ccount", "tsc", "ns")
+uint64_t benchCycles();
+const char *benchCycleSource();
+
+// Writes a 1 Hz GGA+RMC log of a boat under way; returns its length
+size_t benchNmeaSynth(char *out, size_t cap, uint32_t seconds);
+
+// Runs the cases whose name starts with filter (all for NULL), each for at
+// least minMs, and prints the JSON report.
+void benchRunJson(Print &out, uint32_t minMs, const char *filter = NULL);
@@ -0,0 +1,81 @@
+#include "boat_ble_cmd.h"
+
+bool BleTlvReader::next(BleTlv &t) {
+  if (bad_ || off_ >= n_) return false;
+  if (n_ - off_ < 2 || n_ - off_ - 2 < p_[off_ + 1]) {
+    bad_ = true;
+    return false;
+  }
+  t.type = p_[off_];
+  t.len = p_[off_ + 1];
+  t.v = p_ + off_ + 2;
+  off_ += 2 + t.len;
+  return true;
+}
+
+static bool lenOk(const BleTlv &t) {
+  switch (t.type) {
+    case BC_BOAT_ID: return t.len >= 1 && t.len <= 9;
+    case BC_NAME:    return t.len >= 1 && t.len <= 14;
+    case BC_USER_ID: return t.len == 4;
+    case BC_JOURNEY:
+    case BC_SOS:
+    case BC_QUERY:   return t.len == 1;
+    case BC_TUNE:    return t.len == 5;
+  }
+  return false;
+}
+
+uint8_t bleCmdCheck(const uint8_t *f, size_t n) {
+  if (n < 2 || n > BLE_CMD_MAX || f[0] != BLE_CMD_MAGIC) return BLE_CMD_ERR_FORMAT;
+  BleTlvReader rd(f + 2, n - 2);
+  BleTlv t;
+  while (rd.next(t)) {
+    switch (t.type) {
+      case BC_BOAT_ID: case BC_USER_ID: case BC_NAME: case BC_JOURNEY:
+      case BC_SOS: case BC_QUERY: case BC_TUNE:
+        break;
+      default:
+        return BLE_CMD_ERR_UNKNOWN;
+    }
+    if (!lenOk(t)) return BLE_CMD_ERR_LENGTH;
+    if ((t.type == BC_JOURNEY || t.type == BC_SOS) && t.v[0] > 1) return BLE_CMD_ERR_RANGE;
+    if (t.type == BC_TUNE && t.v[0] >= BT_COUNT) return BLE_CMD_ERR_RANGE;
+  }
+  return rd.bad() ? BLE_CMD_ERR_FORMAT : BLE_CMD_OK;
+}
+
+void BleCmdResp::begin(uint8_t *out, size_t cap, uint8_t req) {
+  out_ = out;
+  cap_ = cap;
+  len_ = cap >= 3 ? 3 : 0;
+  trunc_ = false;
+  if (len_) {
+    out[0] = BLE_CMD_MAGIC;
+    out[1] = req;
+    out[2] = BLE_CMD_OK;
+  }
+}
+
+bool BleCmdResp::put(uint8_t type, const void *v, uint8_t len) {
+  if (!len_ || len_ + 2 + len > cap_) {
+    trunc_ = true;
+    if (len_) out_[2] |= BLE_CMD_TRUNCATED;
+    return false;
+  }
+  out_[len_] = type;
+  out_[len_ + 1] = len;
+  memcpy(out_ + len_ + 2, v, len);
+  len_ += 2 + len;
+  return true;
+}
+
+bool BleCmdResp::putU32(uint8_t type, uint32_t v) {
+  uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+  return put(type, b, 4);
+}
+
+bool BleCmdResp::putStr(uint8_t type, const char *s) {
+  size_t n = strlen(s);
+  return put(type, s, n > 255 ? 255 : n);
+}
@@ -0,0 +1,115 @@
+/*
+  Binary BLE commands (CHAR_CMD_UUID write, CHAR_RESP_UUID notify)
+
+  Request (phone -> node), one write:
+
+    [0]    BLE_CMD_MAGIC
+    [1]    req   request id, echoed in the response
+    [2..]  TLVs  [u8 type][u8 len][len bytes], little-endian values
+
+  Response (node -> phone), one notification per request:
+
+    [0]    BLE_CMD_MAGIC
+    [1]    req
+    [2]    status  BleCmdStatus of the whole request, | BLE_CMD_TRUNCATED
+                   when answers were left out for want of room (MTU)
+    [3..]  TLVs    answers to BC_QUERY, same encoding
+
+  A request is checked as a whole before anything is applied, so a bad TLV
+  anywhere rejects all of it. The magic byte is outside ASCII, which keeps
+  the old text commands (SET:..., START_JOURNEY) distinguishable on the
+  same characteristic.
+
+  Nothing here allocates; bleCmdCheck() and BleTlvReader work on the bytes
+  the BLE stack hands the write callback.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+const uint8_t BLE_CMD_MAGIC = 0xB1;  // also the protocol version
+const size_t  BLE_CMD_MAX   = 96;    // request bytes, fits the command queue item
+
+enum BleCmdType : uint8_t {
+  BC_BOAT_ID    = 0x01,  // str, 1..9 bytes
+  BC_USER_ID    = 0x02,  // u32
+  BC_NAME       = 0x03,  // str, 1..14 bytes (UTF-8)
+  BC_JOURNEY    = 0x10,  // u8 0 = stop, 1 = start
+  BC_SOS        = 0x11,  // u8 0 = clear, 1 = raise
+  BC_QUERY      = 0x20,  // u8 BleCmdQuery
+  BC_TRACK_INFO = 0x21,  // response only: u32 points, u32 first_unix, u32 last_unix
+  BC_TUNE       = 0x30,  // u8 BleTune, u32 value; answered with the same TLV
+};
+
+enum BleCmdQuery : uint8_t {
+  BQ_CONFIG = 0,  // BOAT_ID, USER_ID, NAME
+  BQ_STATE  = 1,  // JOURNEY, SOS, every TUNE
+  BQ_TRACK  = 2,  // TRACK_INFO
+  BQ_NEARBY = 3,  // nearby-boat cache, nodes without one answer ERR_UNSUPPORTED
+};
+
+enum BleTune : uint8_t {
+  BT_TX_INTERVAL_S    = 0,
+  BT_SOS_INTERVAL_S   = 1,
+  BT_TRACK_INTERVAL_S = 2,
+  BT_STATUS_SAMPLE_MS = 3,
+  BT_COUNT
+};
+
+enum BleCmdStatus : uint8_t {
+  BLE_CMD_OK = 0,
+  BLE_CMD_ERR_FORMAT,       // bad magic or TLV framing
+  BLE_CMD_ERR_UNKNOWN,      // TLV type this firmware does not know
+  BLE_CMD_ERR_LENGTH,       // known type, wrong value length
+  BLE_CMD_ERR_RANGE,        // value outside what the node accepts
+  BLE_CMD_ERR_UNSUPPORTED,  // understood, but this node cannot do it
+  BLE_CMD_ERR_BUSY,         // command queue full, retry
+};
+
+const uint8_t BLE_CMD_TRUNCATED = 0x80;  // status flag: ask for fewer queries at a time
+
+struct BleTlv {
+  uint8_t type;
+  uint8_t len;
+  const uint8_t *v;
+};
+
+class BleTlvReader {
+public:
+  BleTlvReader(const uint8_t *p, size_t n) : p_(p), n_(n) {}
+  // false at the end, or on a truncated TLV (then bad() is true)
+  bool next(BleTlv &t);
+  bool bad() const { return bad_; }
+
+private:
+  const uint8_t *p_;
+  size_t n_;
+  size_t off_ = 0;
+  bool bad_ = false;
+};
+
+// Framing and per-type lengths of a whole request; BLE_CMD_OK or the first problem
+uint8_t bleCmdCheck(const uint8_t *f, size_t n);
+
+inline uint32_t bleGetU32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Response builder over a caller buffer; TLVs that would not fit are dropped,
+// truncated() turns true and BLE_CMD_TRUNCATED is set in the status byte.
+class BleCmdResp {
+public:
+  void begin(uint8_t *out, size_t cap, uint8_t req);
+  void status(uint8_t s) { if (len_) out_[2] = s | (trunc_ ? BLE_CMD_TRUNCATED : 0); }
+  bool put(uint8_t type, const void *v, uint8_t len);
+  bool putU8(uint8_t type, uint8_t v) { return put(type, &v, 1); }
+  bool putU32(uint8_t type, uint32_t v);
+  bool putStr(uint8_t type, const char *s);
+  size_t len() const { return len_; }
+  bool truncated() const { return trunc_; }
+
+private:
+  uint8_t *out_ = nullptr;
+  size_t cap_ = 0, len_ = 0;
+  bool trunc_ = false;
+};
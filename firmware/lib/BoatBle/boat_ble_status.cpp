@@ -0,0 +1,62 @@
+#include "boat_ble_status.h"
+
+void BleStatusBatch::setMtu(uint16_t mtu) {
+  int fit = ((int)mtu - 3 - 2) / (int)sizeof(BleStatusRec);  // ATT header, frame header
+  perFrame_ = fit < 1 ? 1 : fit > BLE_STATUS_MAX_RECS ? BLE_STATUS_MAX_RECS : fit;
+}
+
+void BleStatusBatch::reset() {
+  n_ = 0;
+  urgent_ = false;
+  haveLast_ = false;  // first sample after (re)connect always goes out
+}
+
+bool BleStatusBatch::offer(const BleStatusRec &r, uint32_t now) {
+  bool changed = !haveLast_;
+  if (haveLast_) {
+    changed = abs(r.lat1e7 - last_.lat1e7) >= BLE_STATUS_MOVE_1E7 ||
+              abs(r.lon1e7 - last_.lon1e7) >= BLE_STATUS_MOVE_1E7 ||
+              r.sats != last_.sats || r.batt_pc != last_.batt_pc || r.flags != last_.flags ||
+              now - lastMs_ >= BLE_STATUS_HEARTBEAT_MS;
+    if (r.flags != last_.flags) urgent_ = true;
+  } else {
+    urgent_ = true;
+  }
+  if (!changed) return false;
+
+  if (n_ == BLE_STATUS_MAX_RECS) {  // phone is not draining us, drop the oldest
+    memmove(recs_, recs_ + 1, sizeof(recs_[0]) * (n_ - 1));
+    memmove(atMs_, atMs_ + 1, sizeof(atMs_[0]) * (n_ - 1));
+    n_--;
+  }
+  recs_[n_] = r;
+  atMs_[n_] = now;
+  n_++;
+  last_ = r;
+  lastMs_ = now;
+  haveLast_ = true;
+  return true;
+}
+
+size_t BleStatusBatch::take(uint8_t *out, size_t cap, uint32_t now) {
+  if (!n_) return 0;
+  if (!urgent_ && n_ < perFrame_ && now - atMs_[0] < BLE_STATUS_MAX_HOLD_MS) return 0;
+
+  uint8_t k = n_ < perFrame_ ? n_ : perFrame_;
+  while (k && 2 + k * sizeof(BleStatusRec) > cap) k--;
+  if (!k) return 0;
+
+  out[0] = BLE_STATUS_VER;
+  out[1] = k;
+  for (uint8_t i = 0; i < k; i++) {
+    BleStatusRec r = recs_[i];
+    uint32_t age = (now - atMs_[i]) / 100;
+    r.age_ds = age > 0xFFFF ? 0xFFFF : age;
+    memcpy(out + 2 + i * sizeof(BleStatusRec), &r, sizeof(r));
+  }
+  memmove(recs_, recs_ + k, sizeof(recs_[0]) * (n_ - k));
+  memmove(atMs_, atMs_ + k, sizeof(atMs_[0]) * (n_ - k));
+  n_ -= k;
+  if (!n_) urgent_ = false;
+  return 2 + k * sizeof(BleStatusRec);
+}
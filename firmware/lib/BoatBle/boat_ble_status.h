@@ -0,0 +1,69 @@
+/*
+  Binary BLE status notifications (CHAR_DATA_UUID)
+
+  One notification is a frame:
+
+    [0]    ver   BLE_STATUS_VER
+    [1]    n     number of records that follow
+    [2..]  n x BleStatusRec, oldest first, little-endian
+
+  A record is 17 bytes, so even an un-negotiated 23-byte ATT MTU (20 bytes
+  of payload) carries one; at the 185-byte MTU we ask for, ten fit. A new
+  version may append fields to BleStatusRec; readers must check ver.
+
+  BleStatusBatch decides when to notify: a sample is only kept if it
+  differs from the last kept one (moved, sats/battery/flags changed) or a
+  heartbeat is due, and kept samples are sent together once the frame is
+  full, BLE_STATUS_MAX_HOLD_MS has passed, or a flag changed (that goes out
+  at once). A boat at anchor costs one notification per heartbeat.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+const uint8_t  BLE_STATUS_VER          = 1;
+const uint16_t BLE_STATUS_MTU          = 185;   // asked for with BLEDevice::setMTU()
+const uint32_t BLE_STATUS_HEARTBEAT_MS = 10000;
+const uint32_t BLE_STATUS_MAX_HOLD_MS  = 3000;
+const int32_t  BLE_STATUS_MOVE_1E7     = 20;    // ~2 m of latitude
+const uint8_t  BLE_STATUS_MAX_RECS     = 10;
+
+// flags
+const uint8_t BLE_ST_FIX     = 0x01;
+const uint8_t BLE_ST_JOURNEY = 0x02;
+const uint8_t BLE_ST_SOS     = 0x04;
+const uint8_t BLE_ST_LORA_SHIFT = 4;             // bits 4..6: BleLoraState
+const uint8_t BLE_ST_LORA_MASK  = 0x70;
+
+enum BleLoraState : uint8_t { BLE_LORA_IDLE = 0, BLE_LORA_JOINING, BLE_LORA_JOINED, BLE_LORA_SENT, BLE_LORA_JOIN_FAIL };
+
+struct __attribute__((packed)) BleStatusRec {
+  uint16_t age_ds;       // deciseconds between sampling and the notify; filled by take()
+  int32_t  lat1e7;
+  int32_t  lon1e7;
+  uint16_t spd_cms;
+  uint16_t hdg_cdeg;
+  uint8_t  sats;
+  uint8_t  batt_pc;
+  uint8_t  flags;
+};
+
+class BleStatusBatch {
+public:
+  void setMtu(uint16_t mtu);
+  // Returns true if the sample was kept for the next frame
+  bool offer(const BleStatusRec &r, uint32_t now);
+  // Writes a frame into out if one is due; returns its length or 0
+  size_t take(uint8_t *out, size_t cap, uint32_t now);
+  void reset();
+
+private:
+  BleStatusRec recs_[BLE_STATUS_MAX_RECS];
+  uint32_t atMs_[BLE_STATUS_MAX_RECS];
+  uint8_t n_ = 0;
+  uint8_t perFrame_ = 1;
+  bool urgent_ = false;
+  bool haveLast_ = false;
+  BleStatusRec last_;
+  uint32_t lastMs_ = 0;
+};
@@ -0,0 +1,106 @@
+#include "boat_ble_track.h"
+
+static size_t putVarint(uint8_t *out, size_t cap, uint32_t v) {
+  size_t n = 0;
+  do {
+    if (n == cap) return 0;
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    out[n++] = v ? b | 0x80 : b;
+  } while (v);
+  return n;
+}
+
+static uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static void putU32(uint8_t *p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+size_t trackPackChunk(uint8_t *out, size_t cap, uint32_t offset, const TrackPoint *pts, size_t n, size_t *used) {
+  *used = 0;
+  if (!n || cap < TRK_MIN_CHUNK) return 0;
+  out[0] = TRK_DATA;
+  putU32(out + 1, offset);
+  memcpy(out + 6, &pts[0], sizeof(TrackPoint));
+  size_t len = 6 + sizeof(TrackPoint);
+  size_t k = 1;
+  for (; k < n && k < 255; k++) {
+    const TrackPoint &a = pts[k - 1], &b = pts[k];
+    uint8_t tmp[25];
+    size_t m = 0, w;
+    int32_t d[5] = {
+      (int32_t)(b.t - a.t), b.lat1e7 - a.lat1e7, b.lon1e7 - a.lon1e7,
+      (int32_t)b.spd_cms - a.spd_cms, (int32_t)b.hdg_cdeg - a.hdg_cdeg,
+    };
+    for (int i = 0; i < 5; i++) {
+      w = putVarint(tmp + m, sizeof(tmp) - m, zigzag(d[i]));
+      m += w;
+    }
+    if (len + m > cap) break;
+    memcpy(out + len, tmp, m);
+    len += m;
+  }
+  out[5] = k;
+  *used = k;
+  return len;
+}
+
+void BleTrackXfer::begin(uint32_t first, uint32_t end, uint32_t resume, uint16_t window, uint32_t now) {
+  first_ = first;
+  total_ = end > first ? end - first : 0;
+  sent_ = acked_ = resume < total_ ? resume : total_;
+  window_ = window ? window : TRK_DEFAULT_WINDOW;
+  ackMs_ = now;
+  endSent_ = false;
+  active_ = true;
+}
+
+void BleTrackXfer::ack(uint32_t offset, uint32_t now) {
+  if (!active_ || offset <= acked_ || offset > sent_) return;
+  acked_ = offset;
+  ackMs_ = now;
+}
+
+size_t BleTrackXfer::next(uint8_t *out, size_t cap, TrackReadFn read, uint32_t now) {
+  if (!active_) return 0;
+
+  if (acked_ == total_) {
+    if (endSent_) return 0;
+    endSent_ = true;
+    active_ = false;
+    out[0] = TRK_END;
+    putU32(out + 1, total_);
+    return 5;
+  }
+
+  if (sent_ > acked_ && now - ackMs_ > TRK_ACK_TIMEOUT_MS) {
+    sent_ = acked_;  // go back to the last thing the phone confirmed
+    ackMs_ = now;
+  }
+  if (sent_ == total_ || sent_ - acked_ >= window_) return 0;
+  if (cap < TRK_MIN_CHUNK) {
+    active_ = false;
+    out[0] = TRK_ERR;
+    out[1] = TRK_ERR_MTU;
+    return 2;
+  }
+
+  TrackPoint pts[TRK_READ_BATCH];
+  uint32_t want = total_ - sent_;
+  if (want > TRK_READ_BATCH) want = TRK_READ_BATCH;
+  if (want > (uint32_t)(acked_ + window_ - sent_)) want = acked_ + window_ - sent_;
+  size_t got = read(first_ + sent_, pts, want);
+  if (!got) {
+    active_ = false;
+    out[0] = TRK_ERR;
+    out[1] = TRK_ERR_NO_DATA;
+    return 2;
+  }
+  size_t used;
+  size_t len = trackPackChunk(out, cap, sent_, pts, got, &used);
+  sent_ += used;
+  return len;
+}
@@ -0,0 +1,77 @@
+/*
+  BLE bulk track download (CHAR_TRACK_UUID: write + notify)
+
+  Phone -> node (write):
+    TRK_REQ     [0x01][u32 from_unix][u32 to_unix][u32 resume][u16 window]
+    TRK_ACK     [0x02][u32 offset]      everything below offset arrived
+    TRK_CANCEL  [0x03]
+
+  Node -> phone (notify):
+    TRK_DATA    [0x81][u32 offset][u8 n] point, then n-1 deltas
+    TRK_END     [0x82][u32 total]
+    TRK_ERR     [0x83][u8 code]
+
+  Offsets count points from the first one inside [from, to], so a phone that
+  lost the link asks again with resume = last acked offset. Each DATA packet
+  decodes on its own: the first point is absolute (16 bytes, TrackPoint
+  layout), the rest are zigzag varint deltas of t, lat, lon, speed and
+  heading (typically 6-8 bytes a point at a 5 s fix interval).
+
+  A DATA packet needs TRK_MIN_CHUNK bytes of notification payload (ATT MTU
+  25); a link below that (iOS, or Android when requestMtu() failed, both at
+  the default MTU 23) gets TRK_ERR_MTU rather than a transfer that never
+  moves.
+
+  Flow control is a sliding window of `window` points: the node keeps sending
+  back to back while fewer than that are unacked, and goes back to the last
+  ack if none arrives for TRK_ACK_TIMEOUT_MS (go-back-N, the phone drops
+  duplicates by offset).
+*/
+#pragma once
+
+#include <Arduino.h>
+
+struct __attribute__((packed)) TrackPoint {
+  uint32_t t;            // unix seconds (UTC)
+  int32_t lat1e7;
+  int32_t lon1e7;
+  uint16_t spd_cms;
+  uint16_t hdg_cdeg;
+};
+
+enum : uint8_t {
+  TRK_REQ = 0x01, TRK_ACK = 0x02, TRK_CANCEL = 0x03,
+  TRK_DATA = 0x81, TRK_END = 0x82, TRK_ERR = 0x83,
+};
+
+enum : uint8_t { TRK_ERR_BAD_REQ = 1, TRK_ERR_NO_DATA = 2, TRK_ERR_BUSY = 3, TRK_ERR_MTU = 4 };
+
+const uint16_t TRK_DEFAULT_WINDOW   = 512;
+const uint32_t TRK_ACK_TIMEOUT_MS   = 1500;
+const uint8_t  TRK_READ_BATCH       = 32;
+const uint8_t  TRK_MIN_CHUNK        = 6 + sizeof(TrackPoint);  // header and one absolute point
+
+// Reads up to max points starting at absolute index; returns how many it read.
+typedef size_t (*TrackReadFn)(uint32_t index, TrackPoint *out, size_t max);
+
+// One DATA packet from pts[0..n); returns bytes written, *used = points packed.
+size_t trackPackChunk(uint8_t *out, size_t cap, uint32_t offset, const TrackPoint *pts, size_t n, size_t *used);
+
+class BleTrackXfer {
+public:
+  // [first, end) are absolute point indexes in the store
+  void begin(uint32_t first, uint32_t end, uint32_t resume, uint16_t window, uint32_t now);
+  void ack(uint32_t offset, uint32_t now);
+  void cancel() { active_ = false; }
+  bool active() const { return active_; }
+  // Next notification if the window allows one; 0 when there is nothing to send now
+  size_t next(uint8_t *out, size_t cap, TrackReadFn read, uint32_t now);
+
+private:
+  bool active_ = false;
+  bool endSent_ = false;
+  uint32_t first_ = 0, total_ = 0;
+  uint32_t sent_ = 0, acked_ = 0;   // offsets
+  uint16_t window_ = TRK_DEFAULT_WINDOW;
+  uint32_t ackMs_ = 0;
+};
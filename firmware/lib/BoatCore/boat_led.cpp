@@ -0,0 +1,35 @@
+#include "boat_led.h"
+
+bool ledPattern(LedState s, uint32_t t, uint32_t stamp, uint8_t &rgb) {
+  switch(s) {
+    case LED_GREEN_SOLID:  rgb = LED_G; return true;
+    case LED_GREEN_BLINK:  rgb = (t/400)%2==0 ? LED_G : 0; return true;
+    case LED_RED_SOLID:    rgb = LED_R; return true;
+    case LED_RED_BLINK:    rgb = (t/500)%2==0 ? LED_R : 0; return true;
+    case LED_BLUE_PAIRING: {
+      uint32_t c=t%900;
+      rgb = (c<100 || (c>=200 && c<300)) ? LED_B : 0;
+      return true;
+    }
+    case LED_BLUE_PAIRED:
+      if (t - stamp >= LED_PAIRED_MS) return false;
+      rgb = LED_B;
+      return true;
+    default: rgb = 0; return true;
+  }
+}
+
+uint32_t ledNextEdgeMs(LedState s, uint32_t t, uint32_t stamp) {
+  switch(s) {
+    case LED_GREEN_BLINK:  return (t/400+1)*400;
+    case LED_RED_BLINK:    return (t/500+1)*500;
+    case LED_BLUE_PAIRING: return (t/100+1)*100;
+    case LED_BLUE_PAIRED:  return (t - stamp < LED_PAIRED_MS) ? stamp + LED_PAIRED_MS : 0;
+    default:               return 0;
+  }
+}
+
+LedState ledForComms(bool wanJoined, bool meshFresh) {
+  if (wanJoined) return meshFresh ? LED_GREEN_SOLID : LED_GREEN_BLINK;
+  return meshFresh ? LED_RED_BLINK : LED_RED_SOLID;
+}
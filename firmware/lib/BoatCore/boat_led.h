@@ -0,0 +1,25 @@
+/*
+  BoatLed - status LED patterns
+
+  Pure functions of the state, the time and the moment the state was
+  entered (stamp), so the node can sleep until ledNextEdgeMs() and the
+  patterns can be checked without a board. The caller drives the pins.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+enum LedState { LED_OFF, LED_GREEN_SOLID, LED_GREEN_BLINK, LED_RED_SOLID, LED_RED_BLINK, LED_BLUE_PAIRING, LED_BLUE_PAIRED };
+
+const uint32_t LED_PAIRED_MS = 3000;   // blue after a successful /pair
+
+enum : uint8_t { LED_R = 1, LED_G = 2, LED_B = 4 };
+
+// Pins for state s at time t as LED_R|LED_G|LED_B; false = leave them as they are
+bool ledPattern(LedState s, uint32_t t, uint32_t stamp, uint8_t &rgb);
+
+// Next millis() at which ledPattern() would change the pins, 0 if never.
+uint32_t ledNextEdgeMs(LedState s, uint32_t t, uint32_t stamp);
+
+// Green with a LoRaWAN join, red without; solid/blink says whether the mesh is heard
+LedState ledForComms(bool wanJoined, bool meshFresh);
@@ -0,0 +1,29 @@
+#include "boat_mesh.h"
+
+MeshFrame meshClassify(const uint8_t *buf, size_t len) {
+  if (len == sizeof(Pkt)) {
+    Pkt p;
+    memcpy(&p, buf, sizeof(p));
+    return pktCheck(p) ? MESH_FRAME_PKT : MESH_FRAME_BAD;
+  }
+  if (len <= 5 || buf[0] != BACKLOG_MAGIC) return MESH_FRAME_BAD;
+  uint16_t c;
+  memcpy(&c, buf + len - 2, 2);
+  return c == crc16_ccitt(buf, len - 2) ? MESH_FRAME_BACKLOG : MESH_FRAME_BAD;
+}
+
+bool meshRelay(const Pkt &in, Pkt &fwd) {
+  if (in.hops >= MESH_MAX_HOPS) return false;
+  fwd = in;
+  fwd.hops++;
+  pktSign(fwd);
+  return true;
+}
+
+bool meshUplink(const Pkt &in, Pkt &up) {
+  if (in.hops == 255) return false;
+  up = in;
+  up.hops++;
+  pktSign(up);
+  return true;
+}
@@ -0,0 +1,37 @@
+/*
+  BoatMesh - what a node does with a frame it heard on the mesh
+
+  The flood as BoatNode v2 runs it: every good Pkt goes to the nearby
+  cache and, while hops < MESH_MAX_HOPS and the energy tier relays, goes
+  out once more with hops + 1 after MESH_RELAY_MIN_MS..MESH_RELAY_MAX_MS of
+  random delay. There is no duplicate check, so a node relays every copy
+  it hears. Backlog frames from the journal drain,
+
+    [BACKLOG_MAGIC][u16 src][body][crc16]
+
+  are never relayed, only passed to LoRaWAN by a joined node.
+
+  No radio or RTOS calls in here, so firmware/sim runs this same code.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include "boat_pkt.h"
+
+const uint8_t  MESH_MAX_HOPS     = 4;
+const uint16_t MESH_RELAY_MIN_MS = 200;
+const uint16_t MESH_RELAY_MAX_MS = 600;
+const uint8_t  BACKLOG_MAGIC     = 0xB7;
+
+enum MeshFrame : uint8_t { MESH_FRAME_BAD, MESH_FRAME_PKT, MESH_FRAME_BACKLOG };
+
+// MESH_FRAME_PKT: buf holds a Pkt that passed pktCheck()
+MeshFrame meshClassify(const uint8_t *buf, size_t len);
+
+// The copy to relay for in, re-signed; false once in has used up its hops
+bool meshRelay(const Pkt &in, Pkt &fwd);
+
+// The copy a joined node uplinks for a Pkt it heard, one hop on and
+// re-signed, so that on LoRaWAN hops 0 is only ever the sender's own report
+// (boat_ingest answers those with a digest, boat_digest.h). false at 255.
+bool meshUplink(const Pkt &in, Pkt &up);
@@ -0,0 +1,129 @@
+#include "boat_nav.h"
+#include <math.h>
+#include <stdlib.h>
+
+// 1e-7 deg of latitude is 1.113195 cm
+static int32_t navDegToCm(int32_t d1e7) { return (int32_t)(((int64_t)d1e7 * 1113195) / 1000000); }
+static int32_t navCmToDeg(int32_t cm)   { return (int32_t)(((int64_t)cm * 1000000) / 1113195); }
+
+static uint32_t isqrt64(uint64_t v) {
+  uint64_t r = 0, bit = 1ULL << 62;
+  while (bit > v) bit >>= 2;
+  while (bit) {
+    if (v >= r + bit) { v -= r + bit; r = (r >> 1) + bit; } else r >>= 1;
+    bit >>= 2;
+  }
+  return (uint32_t)r;
+}
+
+static void navAxisSeed(NavAxis &a, int32_t z, int32_t v, int64_t r) {
+  a.x = z; a.v = v;
+  a.p00 = r; a.p01 = 0; a.p11 = 100L*100L;
+}
+
+static void navAxisPredict(NavAxis &a, uint32_t dt) {
+  a.x += (int32_t)(((int64_t)a.v * dt) / 1000);
+  // Discrete white-noise acceleration, scaled stepwise so int64 never overflows.
+  int64_t qa = NAV_ACCEL_VAR * dt / 1000;
+  int64_t qb = qa * dt / 1000, qc = qb * dt / 1000, qd = qc * dt / 1000;
+  a.p00 += (2 * a.p01 * dt) / 1000 + (a.p11 * dt / 1000) * dt / 1000 + qd / 4;
+  a.p01 += a.p11 * dt / 1000 + qc / 2;
+  a.p11 += qb;
+  if (a.p00 > 10000000000000LL) a.p00 = 10000000000000LL;
+}
+
+static void navAxisUpdate(NavAxis &a, int32_t z, int64_t r) {
+  int64_t y = (int64_t)z - a.x, s = a.p00 + r;
+  int64_t k0 = (a.p00 << 16) / s, k1 = (a.p01 << 16) / s;
+  a.x += (int32_t)((k0 * y) >> 16);
+  a.v += (int32_t)((k1 * y) >> 16);
+  a.p11 -= (k1 * a.p01) >> 16;
+  a.p01 -= (k0 * a.p01) >> 16;
+  a.p00 -= (k0 * a.p00) >> 16;
+}
+
+static bool navGate(const NavAxis &a, int32_t z, int64_t r) {
+  int64_t y = (int64_t)z - a.x;
+  if (y > 2000000 || y < -2000000) return false;  // >20 km jump, never plausible
+  return y * y <= NAV_GATE_SIGMA2 * (a.p00 + r);
+}
+
+void NavFilter::setOrigin(int32_t lat1e7, int32_t lon1e7) {
+  lat0_ = lat1e7; lon0_ = lon1e7;
+  cosQ15_ = (int32_t)(cosf(lat1e7 * 1e-7f * DEG_TO_RAD) * 32768.0f);
+  if (cosQ15_ < 64) cosQ15_ = 64;  // keep east/west finite near the poles
+}
+
+void NavFilter::toLocal(int32_t lat1e7, int32_t lon1e7, int32_t &n, int32_t &e) const {
+  n = navDegToCm(lat1e7 - lat0_);
+  e = (int32_t)(((int64_t)navDegToCm(lon1e7 - lon0_) * cosQ15_) >> 15);
+}
+
+void NavFilter::fromLocal(int32_t n, int32_t e, int32_t &lat1e7, int32_t &lon1e7) const {
+  lat1e7 = lat0_ + navCmToDeg(n);
+  lon1e7 = lon0_ + navCmToDeg((int32_t)(((int64_t)e << 15) / cosQ15_));
+}
+
+void NavFilter::publish() {
+  fromLocal(n_.x, e_.x, st_.lat1e7, st_.lon1e7);
+  uint32_t spd = isqrt64((int64_t)n_.v * n_.v + (int64_t)e_.v * e_.v);
+  st_.vn_cms = n_.v; st_.ve_cms = e_.v;
+  st_.spd_cms = spd > 65535 ? 65535 : spd;
+
+  int32_t course = (int32_t)(atan2f((float)e_.v, (float)n_.v) * RAD_TO_DEG * 100.0f);
+  if (course < 0) course += 36000;
+  if (st_.spd_cms >= NAV_HDG_MIN_SPD_CMS) {
+    st_.hdg_cdeg = course;
+  } else if (st_.spd_cms >= NAV_HDG_MIN_SPD_CMS / 4) {
+    // Slow drift: velocity direction is mostly noise, so ease toward it.
+    int32_t d = course - st_.hdg_cdeg;
+    if (d > 18000) d -= 36000; else if (d < -18000) d += 36000;
+    int32_t h = st_.hdg_cdeg + d / 8;
+    st_.hdg_cdeg = (h + 36000) % 36000;
+  }  // else hold the last heading
+}
+
+bool NavFilter::update(const NavFix &f, uint32_t now) {
+  if (f.hdop_x100 > NAV_MAX_HDOP_X100 || f.sats < NAV_MIN_SATS) { st_.rejected++; return false; }
+
+  int64_t sigma = (int64_t)NAV_UERE_CM * f.hdop_x100 / 100;
+  int64_t r = sigma * sigma;
+  uint32_t dt = now - st_.fixMs;
+
+  if (!st_.valid || dt > NAV_MAX_DT_MS || rejectRun_ >= NAV_MAX_REJECTS) {
+    setOrigin(f.lat1e7, f.lon1e7);
+    float crs = f.courseValid ? f.courseDeg * DEG_TO_RAD : 0;
+    int32_t spd = f.speedValid ? (int32_t)(f.speedMps * 100) : 0;
+    navAxisSeed(n_, 0, (int32_t)(spd * cosf(crs)), r);
+    navAxisSeed(e_, 0, (int32_t)(spd * sinf(crs)), r);
+    st_.hdg_cdeg = (uint16_t)(f.courseValid ? f.courseDeg * 100 : 0);
+    st_.valid = true; st_.fixMs = now; rejectRun_ = 0;
+    publish();
+    return true;
+  }
+
+  // Predict into copies: a rejected fix must leave the filter untouched so the
+  // next good fix predicts over the whole gap from fixMs.
+  NavAxis pn = n_, pe = e_;
+  navAxisPredict(pn, dt);
+  navAxisPredict(pe, dt);
+  int32_t zn, ze;
+  toLocal(f.lat1e7, f.lon1e7, zn, ze);
+  if (!navGate(pn, zn, r) || !navGate(pe, ze, r)) {
+    rejectRun_++; st_.rejected++;
+    return false;
+  }
+  navAxisUpdate(pn, zn, r);
+  navAxisUpdate(pe, ze, r);
+  n_ = pn; e_ = pe;
+  rejectRun_ = 0; st_.fixMs = now;
+
+  if (abs(n_.x) > NAV_REBASE_CM || abs(e_.x) > NAV_REBASE_CM) {
+    int32_t la, lo;
+    fromLocal(n_.x, e_.x, la, lo);
+    setOrigin(la, lo);
+    n_.x = 0; e_.x = 0;
+  }
+  publish();
+  return true;
+}
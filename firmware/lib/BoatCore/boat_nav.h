@@ -0,0 +1,78 @@
+/*
+  BoatNav - fixed-point Kalman filter on GPS fixes
+
+  Constant-velocity filter, one independent axis for north and east, on a
+  local plane anchored at an origin that follows the boat (moved every
+  NAV_REBASE_CM). Units: cm, cm/s, ms. Gains are Q16, so the filter runs
+  without an FPU in the loop and gives the same answers on any target.
+
+  NavFilter knows nothing about the GPS library: the caller turns a fix
+  into a NavFix. Fixes worse than NAV_MAX_HDOP_X100 or with fewer than
+  NAV_MIN_SATS are dropped, outliers beyond a 3-sigma gate are rejected,
+  and a run of NAV_MAX_REJECTS rejects or a gap over NAV_MAX_DT_MS
+  re-seeds from the next fix.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+const uint16_t NAV_MAX_HDOP_X100   = 500;      // fixes worse than HDOP 5.0 are dropped
+const uint8_t  NAV_MIN_SATS        = 4;
+const uint32_t NAV_UERE_CM         = 500;      // 1-sigma position error per unit HDOP
+const int64_t  NAV_ACCEL_VAR       = 50L*50L;  // process noise, (cm/s^2)^2
+const int64_t  NAV_GATE_SIGMA2     = 9;        // 3-sigma innovation gate
+const uint8_t  NAV_MAX_REJECTS     = 5;        // re-seed after this many outliers in a row
+const uint32_t NAV_MAX_DT_MS       = 30000;    // longer gaps re-seed instead of predicting
+const int32_t  NAV_REBASE_CM       = 500000;   // move the origin every 5 km
+const uint16_t NAV_HDG_MIN_SPD_CMS = 50;       // ~1 kn, below this heading is smoothed
+
+struct NavAxis {
+  int32_t x;    // cm from origin
+  int32_t v;    // cm/s
+  int64_t p00;  // cm^2
+  int64_t p01;  // cm^2/s
+  int64_t p11;  // (cm/s)^2
+};
+
+struct NavState {
+  bool valid;
+  int32_t lat1e7;
+  int32_t lon1e7;
+  int32_t vn_cms;
+  int32_t ve_cms;
+  uint16_t spd_cms;
+  uint16_t hdg_cdeg;
+  uint32_t fixMs;     // millis() of last accepted fix
+  uint32_t rejected;  // outliers dropped since boot
+};
+
+// One receiver fix; the course/speed fields only seed the filter
+struct NavFix {
+  int32_t lat1e7;
+  int32_t lon1e7;
+  uint16_t hdop_x100;   // 9999 when unknown
+  uint8_t sats;
+  bool courseValid;
+  float courseDeg;
+  bool speedValid;
+  float speedMps;
+};
+
+class NavFilter {
+public:
+  // Returns true when the fix was accepted and state() moved
+  bool update(const NavFix &f, uint32_t now);
+  const NavState &state() const { return st_; }
+
+private:
+  void setOrigin(int32_t lat1e7, int32_t lon1e7);
+  void toLocal(int32_t lat1e7, int32_t lon1e7, int32_t &n, int32_t &e) const;
+  void fromLocal(int32_t n, int32_t e, int32_t &lat1e7, int32_t &lon1e7) const;
+  void publish();
+
+  NavState st_ = {};
+  NavAxis n_ = {}, e_ = {};
+  int32_t lat0_ = 0, lon0_ = 0;  // origin, 1e-7 deg
+  int32_t cosQ15_ = 32768;       // cos(origin lat), Q15
+  uint8_t rejectRun_ = 0;
+};
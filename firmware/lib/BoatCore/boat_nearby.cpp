@@ -0,0 +1,146 @@
+#include "boat_nearby.h"
+#include <boat_json.h>
+#include <math.h>
+
+void NearbyCache::note(const BoatEntry &b, bool gone) {
+  ver_++;
+  NearbyEvt &e = ring_[ver_ % NEARBY_RING];
+  e.ver = ver_;
+  e.gone = gone;
+  e.b = b;
+}
+
+void NearbyCache::evictOldest() {
+  auto oldest = boats_.begin();
+  for (auto it = boats_.begin(); it != boats_.end(); ++it) {
+    if (it->last_seen_ms < oldest->last_seen_ms) oldest = it;
+  }
+  note(*oldest, true);
+  boats_.erase(oldest);
+}
+
+void NearbyCache::update(const Pkt &p, uint32_t now) {
+  // Convert name to String safely
+  char nameBuf[13];
+  memset(nameBuf, 0, 13);
+  int nlen = (p.name_len > 12) ? 12 : p.name_len;
+  memcpy(nameBuf, p.name_utf8, nlen);
+
+  BoatEntry *e = NULL;
+  for (auto &b : boats_) if (b.boat_id == p.src) { e = &b; break; }
+  if (!e) {
+    if (boats_.size() >= cap_) evictOldest();
+    boats_.push_back(BoatEntry());
+    e = &boats_.back();
+    e->boat_id = p.src;
+  }
+  e->user_id = p.user_id;
+  e->display_name = nameBuf;
+  e->lat = p.lat1e7 / 1e7;
+  e->lon = p.lon1e7 / 1e7;
+  e->speed_cms = p.spd_cms;
+  e->hdg_cdeg = p.hdg_cdeg;
+  e->battery = p.batt_pc;
+  e->last_seen_ms = now;
+  e->cloud = false;
+  note(*e, false);
+}
+
+void NearbyCache::updateCloud(const DigestBoat &d, uint16_t self, uint32_t now) {
+  uint32_t age = d.age_min * 60000UL;
+  uint32_t seen = age < now ? now - age : 0;
+  if (d.boat_id == self) return;
+
+  BoatEntry *e = NULL;
+  for (auto &b : boats_) if (b.boat_id == d.boat_id) { e = &b; break; }
+  if (e && (int32_t)(e->last_seen_ms - seen) >= 0) return;
+  if (!e) {
+    if (boats_.size() >= cap_) {
+      auto oldest = boats_.end();
+      for (auto it = boats_.begin(); it != boats_.end(); ++it)
+        if (it->cloud && (oldest == boats_.end() || it->last_seen_ms < oldest->last_seen_ms)) oldest = it;
+      if (oldest == boats_.end() || (int32_t)(oldest->last_seen_ms - seen) >= 0) return;
+      note(*oldest, true);
+      boats_.erase(oldest);
+    }
+    BoatEntry b;
+    b.boat_id = d.boat_id;
+    b.user_id = 0;
+    b.battery = 0;
+    boats_.push_back(b);
+    e = &boats_.back();
+  }
+  e->lat = d.lat1e7 / 1e7;
+  e->lon = d.lon1e7 / 1e7;
+  e->speed_cms = d.spd_cms;
+  e->hdg_cdeg = d.hdg_cdeg;
+  e->last_seen_ms = seen;
+  e->cloud = true;
+  note(*e, false);
+}
+
+bool nearbyCpa(const NavState &nav, const BoatEntry &b, uint32_t now, float &dist_m, float &cpa_m, float &tcpa_s) {
+  if (!nav.valid) return false;
+  float k = 111319.5f, coslat = cosf(nav.lat1e7 * 1e-7f * DEG_TO_RAD);
+  // Bring the boat forward to "now" along its last reported course.
+  float age = (now - b.last_seen_ms) / 1000.0f, hdg = b.hdg_cdeg / 100.0f * DEG_TO_RAD;
+  float bvn = b.speed_cms / 100.0f * cosf(hdg), bve = b.speed_cms / 100.0f * sinf(hdg);
+  float rn = (float)(b.lat - nav.lat1e7 * 1e-7) * k + bvn * age;
+  float re = (float)(b.lon - nav.lon1e7 * 1e-7) * k * coslat + bve * age;
+  float vn = bvn - nav.vn_cms / 100.0f, ve = bve - nav.ve_cms / 100.0f;
+  float v2 = vn*vn + ve*ve;
+  dist_m = sqrtf(rn*rn + re*re);
+  tcpa_s = (v2 > 1e-4f) ? -(rn*vn + re*ve) / v2 : 0;
+  if (tcpa_s < 0) tcpa_s = 0;
+  if (tcpa_s > CPA_HORIZON_S) tcpa_s = CPA_HORIZON_S;
+  float cn = rn + vn*tcpa_s, ce = re + ve*tcpa_s;
+  cpa_m = sqrtf(cn*cn + ce*ce);
+  return true;
+}
+
+String nearbyBoatJson(const BoatEntry &b, uint32_t now, const NavState &nav) {
+  uint32_t age = (now - b.last_seen_ms) / 1000;
+  float dist, cpa, tcpa;
+  String json = "{";
+  json += "\"boat_id\":\"" + String(b.boat_id) + "\",";
+  json += "\"user_id\":" + String(b.user_id) + ",";
+  char dn[64];
+  jsonEscape(dn, sizeof(dn), b.display_name.c_str());  // name bytes come off the air
+  json += "\"display_name\":\"" + String(dn) + "\",";
+  json += "\"lat\":" + String(b.lat, 6) + ",";
+  json += "\"lon\":" + String(b.lon, 6) + ",";
+  json += "\"age_sec\":" + String(age) + ",";
+  json += "\"battery\":" + String(b.battery) + ",";
+  json += "\"speed_cms\":" + String(b.speed_cms) + ",";
+  json += "\"heading_cdeg\":" + String(b.hdg_cdeg) + ",";
+  json += String("\"source\":\"") + (b.cloud ? "cloud" : "mesh") + "\"";
+  if (nearbyCpa(nav, b, now, dist, cpa, tcpa)) {
+    json += ",\"dist_m\":" + String((uint32_t)dist);
+    json += ",\"cpa_m\":" + String((uint32_t)cpa);
+    json += ",\"tcpa_sec\":" + String((uint32_t)tcpa);
+  }
+  return json + "}";
+}
+
+String NearbyCache::json(uint32_t now, const NavState &nav) const {
+  String json = "{\"v\":" + String(ver_) + ",\"boats\":[";
+  for (size_t i=0; i<boats_.size(); i++) {
+    if (i > 0) json += ",";
+    json += nearbyBoatJson(boats_[i], now, nav);
+  }
+  json += "]";
+  if (nav.valid) {
+    json += ",\"self\":{\"lat\":" + String(nav.lat1e7 / 1e7, 6);
+    json += ",\"lon\":" + String(nav.lon1e7 / 1e7, 6);
+    json += ",\"speed_cms\":" + String(nav.spd_cms);
+    json += ",\"heading_cdeg\":" + String(nav.hdg_cdeg) + "}";
+  }
+  return json + "}";
+}
+
+String nearbyEventText(const NearbyEvt &e, uint32_t now, const NavState &nav) {
+  String s = "id: " + String(e.ver) + (e.gone ? "\nevent: gone\ndata: " : "\nevent: boat\ndata: ");
+  if (e.gone) s += "{\"v\":" + String(e.ver) + ",\"boat_id\":\"" + String(e.b.boat_id) + "\"}";
+  else s += "{\"v\":" + String(e.ver) + ",\"boat\":" + nearbyBoatJson(e.b, now, nav) + "}";
+  return s + "\n\n";
+}
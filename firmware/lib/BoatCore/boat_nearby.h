@@ -0,0 +1,83 @@
+/*
+  BoatNearby - the nearby-boat cache behind GET /nearby and /nearby/stream
+
+  One entry per boat, filled from mesh Pkts (update()) and from backend
+  digests (updateCloud(), boat_digest.h). A full cache evicts the boat
+  heard from longest ago. Every change bumps version() and is kept in a
+  ring of NEARBY_RING events, so a stream that fell behind can replay what
+  it missed, or knows it needs a snapshot once event() has moved past it.
+
+  Not thread-safe: one task owns the cache (the http task on the node).
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+#include "boat_pkt.h"
+#include "boat_nav.h"
+#include <boat_digest.h>
+
+const size_t  MAX_NEARBY_BOATS = 30;
+const uint8_t NEARBY_RING      = 32;
+const float   CPA_HORIZON_S    = 3600;
+
+// Longest nearbyBoatJson() (301 bytes: escaped name cut at 63, every number
+// at its widest) and NearbyCache::json() of a full default-size cache, for
+// sizing buffers and stream caps; host/test/test_nearby.cpp holds them to it.
+const uint16_t NEARBY_BOAT_JSON_MAX = 320;
+const uint16_t NEARBY_JSON_MAX      = 128 + MAX_NEARBY_BOATS * (NEARBY_BOAT_JSON_MAX + 1);
+
+struct BoatEntry {
+  uint16_t boat_id;
+  uint16_t user_id;
+  String display_name;
+  double lat;
+  double lon;
+  uint16_t speed_cms;
+  uint16_t hdg_cdeg;
+  uint8_t battery;
+  uint32_t last_seen_ms;
+  bool cloud;            // from a backend digest, not heard on the mesh
+};
+
+struct NearbyEvt {
+  uint32_t ver;
+  bool gone;             // evicted; only b.boat_id is meaningful
+  BoatEntry b;
+};
+
+class NearbyCache {
+public:
+  explicit NearbyCache(size_t capacity = MAX_NEARBY_BOATS) : cap_(capacity) {}
+
+  void update(const Pkt &p, uint32_t now);
+  // A digest entry only fills gaps: it never replaces a fresher fix, and a
+  // full cache makes room for it only by evicting an older cloud entry.
+  void updateCloud(const DigestBoat &d, uint16_t self, uint32_t now);
+
+  const std::vector<BoatEntry> &boats() const { return boats_; }
+  uint32_t version() const { return ver_; }
+  // Event that produced version ver; valid while version() - ver < NEARBY_RING
+  const NearbyEvt &event(uint32_t ver) const { return ring_[ver % NEARBY_RING]; }
+
+  // Full /nearby body; v is the cache version it reflects (resume point for /nearby/stream)
+  String json(uint32_t now, const NavState &nav) const;
+
+private:
+  void note(const BoatEntry &b, bool gone);
+  void evictOldest();
+
+  size_t cap_;
+  std::vector<BoatEntry> boats_;
+  uint32_t ver_ = 0;
+  NearbyEvt ring_[NEARBY_RING];
+};
+
+// Closest point of approach between our filtered track and a cached boat,
+// both extrapolated at constant velocity. Returns false without a nav fix.
+bool nearbyCpa(const NavState &nav, const BoatEntry &b, uint32_t now, float &dist_m, float &cpa_m, float &tcpa_s);
+
+String nearbyBoatJson(const BoatEntry &b, uint32_t now, const NavState &nav);
+
+// One SSE event (id, event, data) for a ring entry
+String nearbyEventText(const NearbyEvt &e, uint32_t now, const NavState &nav);
@@ -0,0 +1,42 @@
+#include "boat_pkt.h"
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i=0; i<len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int j=0; j<8; j++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  return crc;
+}
+
+int utf8_truncate(const char *src, uint8_t *out, int maxBytes) {
+  int i=0; const unsigned char *s=(const unsigned char*)src;
+  while (*s && i<maxBytes) {
+    int len=1;
+    if ((*s & 0x80)==0) len=1; else if((*s&0xE0)==0xC0) len=2; else if((*s&0xF0)==0xE0) len=3; else if((*s&0xF8)==0xF0) len=4; else break;
+    if (i+len > maxBytes) break;
+    for (int k=0;k<len;k++) out[i++] = *s++;
+  }
+  return i;
+}
+
+void pktSign(Pkt &p) {
+  p.crc = crc16_ccitt((const uint8_t*)&p, sizeof(Pkt)-2);
+}
+
+bool pktCheck(const Pkt &p) {
+  return p.crc == crc16_ccitt((const uint8_t*)&p, sizeof(Pkt)-2);
+}
+
+void pktBuild(Pkt &p, uint16_t src, uint16_t seq, const NavState &nav, uint8_t battPc,
+              uint16_t userId, const char *name) {
+  memset(&p, 0, sizeof(p));
+  p.src = src; p.seq = seq;
+  if (nav.valid) { p.lat1e7 = nav.lat1e7; p.lon1e7 = nav.lon1e7; }
+  p.spd_cms = nav.spd_cms; p.hdg_cdeg = nav.hdg_cdeg;
+  p.batt_pc = battPc;
+  p.hops = 0; p.user_id = userId;
+  p.name_len = utf8_truncate(name, p.name_utf8, 12);
+  pktSign(p);
+}
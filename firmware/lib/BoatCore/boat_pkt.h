@@ -0,0 +1,43 @@
+/*
+  BoatPkt - the 35-byte position frame, on the mesh and on LORAWAN_FPORT
+
+  Little-endian, packed, CRC16-CCITT (init 0xFFFF) over everything before
+  the crc field. hops is the only field a relay changes, so a relay
+  re-signs with pktSign(). name_utf8 holds name_len bytes of UTF-8, cut on
+  a character boundary by utf8_truncate() and zero-padded.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include "boat_nav.h"
+
+#pragma pack(push,1)
+struct Pkt {
+  uint16_t src;
+  uint16_t seq;
+  int32_t lat1e7;
+  int32_t lon1e7;
+  uint16_t spd_cms;
+  uint16_t hdg_cdeg;
+  uint8_t batt_pc;
+  uint8_t hops;
+  uint16_t user_id;
+  uint8_t  name_len;
+  uint8_t  name_utf8[12];
+  uint16_t crc;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(Pkt) == 35, "Pkt is a wire format");
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len);
+
+// Copies whole UTF-8 characters of src while they fit in maxBytes; returns bytes written
+int utf8_truncate(const char *src, uint8_t *out, int maxBytes);
+
+void pktSign(Pkt &p);
+bool pktCheck(const Pkt &p);
+
+// Own report from the current nav state; lat/lon stay 0 without a fix
+void pktBuild(Pkt &p, uint16_t src, uint16_t seq, const NavState &nav, uint8_t battPc,
+              uint16_t userId, const char *name);
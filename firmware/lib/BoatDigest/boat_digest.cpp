@@ -0,0 +1,59 @@
+#include "boat_digest.h"
+
+static int32_t gridOf(int32_t v1e7) {
+  // floor division, so negative coordinates step the same way as positive
+  return v1e7 >= 0 ? v1e7 / DIGEST_POS_UNIT_1E7 : -((-v1e7 + DIGEST_POS_UNIT_1E7 - 1) / DIGEST_POS_UNIT_1E7);
+}
+
+// Grid value whose low 16 bits are lo, nearest to the reference
+static int32_t unwrap(uint16_t lo, int32_t ref1e7) {
+  int32_t ref = gridOf(ref1e7);
+  int16_t d = (int16_t)(uint16_t)(lo - (uint16_t)ref);
+  return (ref + d) * DIGEST_POS_UNIT_1E7;
+}
+
+static void putU16(uint8_t *p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static uint16_t getU16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+size_t digestEncode(const DigestBoat *boats, uint8_t n, uint8_t *out, size_t cap) {
+  if (n > DIGEST_MAX_BOATS) n = DIGEST_MAX_BOATS;
+  size_t len = 2 + (size_t)n * DIGEST_ENTRY_BYTES;
+  if (cap < len) return 0;
+  out[0] = DIGEST_VERSION;
+  out[1] = n;
+  uint8_t *p = out + 2;
+  for (uint8_t i = 0; i < n; i++, p += DIGEST_ENTRY_BYTES) {
+    const DigestBoat &b = boats[i];
+    uint32_t spd = (b.spd_cms + DIGEST_SPD_UNIT_CMS / 2) / DIGEST_SPD_UNIT_CMS;
+    putU16(p, b.boat_id);
+    putU16(p + 2, (uint16_t)gridOf(b.lat1e7));
+    putU16(p + 4, (uint16_t)gridOf(b.lon1e7));
+    p[6] = spd > 255 ? 255 : spd;
+    p[7] = ((uint32_t)(b.hdg_cdeg % 36000) * 256 + 18000) / 36000;
+    p[8] = b.age_min > 255 ? 255 : b.age_min;
+  }
+  return len;
+}
+
+uint8_t digestDecode(const uint8_t *buf, size_t len, int32_t selfLat1e7, int32_t selfLon1e7,
+                     DigestBoat *out, uint8_t max) {
+  if (len < 2 || buf[0] != DIGEST_VERSION) return 0;
+  uint8_t n = buf[1];
+  if (len != 2 + (size_t)n * DIGEST_ENTRY_BYTES) return 0;
+  if (n > max) n = max;
+  const uint8_t *p = buf + 2;
+  for (uint8_t i = 0; i < n; i++, p += DIGEST_ENTRY_BYTES) {
+    DigestBoat &b = out[i];
+    b.boat_id = getU16(p);
+    b.lat1e7 = unwrap(getU16(p + 2), selfLat1e7);
+    b.lon1e7 = unwrap(getU16(p + 4), selfLon1e7);
+    b.spd_cms = p[6] * DIGEST_SPD_UNIT_CMS;
+    b.hdg_cdeg = (uint32_t)p[7] * 36000 / 256;
+    b.age_min = p[8];
+  }
+  return n;
+}
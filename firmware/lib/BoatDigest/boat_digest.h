@@ -0,0 +1,55 @@
+/*
+  BoatDigest - nearest boats as seen by the backend, sent as a LoRaWAN downlink
+
+  A joined boat with no mesh neighbours still gets a picture of who is
+  around: the backend answers its own reports on DIGEST_FPORT with the
+  nearest boats it knows of (get_nearby_digest() in supabase_schema-v10.sql
+  builds exactly these bytes, boat_ingest queues them through ChirpStack).
+
+    [0]  DIGEST_VERSION
+    [1]  n                       boats that follow, at most DIGEST_MAX_BOATS
+    [2..] n x 9 bytes:
+      [0..1] boat_id             u16, the mesh Pkt.src of that boat
+      [2..3] lat                 u16, position in DIGEST_POS_UNIT_1E7 steps,
+      [4..5] lon                 u16  modulo 2^16
+      [6]    speed               DIGEST_SPD_UNIT_CMS steps, 255 = that or faster
+      [7]    heading             1/256 turns
+      [8]    age                 minutes since the backend heard it, 255 = older
+
+  Positions carry only the low 16 bits of the absolute grid value, i.e. a
+  delta against any nearby reference: the node puts back the high bits from
+  its own fix, picking the value closest to it. That is exact while the
+  other boat is within half a wrap (about 0.65 deg, 72 km north-south)
+  of where the node is *now*, so a downlink answering an older uplink
+  still decodes after the node has moved. Boats the backend selects lie
+  within 50 km, well inside that.
+
+  Five boats is 47 bytes, under the 51-byte limit of IN865 DR0-DR2, so the
+  digest fits any RX window.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+const uint8_t  DIGEST_VERSION      = 0xD1;
+const uint8_t  DIGEST_MAX_BOATS    = 5;
+const uint8_t  DIGEST_ENTRY_BYTES  = 9;
+const int32_t  DIGEST_POS_UNIT_1E7 = 200;   // 2e-5 deg, ~2.2 m
+const uint16_t DIGEST_SPD_UNIT_CMS = 25;
+
+struct DigestBoat {
+  uint16_t boat_id;
+  int32_t lat1e7;
+  int32_t lon1e7;
+  uint16_t spd_cms;
+  uint16_t hdg_cdeg;
+  uint16_t age_min;
+};
+
+// Returns bytes written to out (2 + n * DIGEST_ENTRY_BYTES), 0 if cap is too small.
+size_t digestEncode(const DigestBoat *boats, uint8_t n, uint8_t *out, size_t cap);
+
+// Restores boats against the receiver's own position; returns the count,
+// 0 on a wrong version or a length that does not match n.
+uint8_t digestDecode(const uint8_t *buf, size_t len, int32_t selfLat1e7, int32_t selfLon1e7,
+                     DigestBoat *out, uint8_t max);
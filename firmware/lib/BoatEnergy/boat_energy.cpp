@@ -0,0 +1,111 @@
+#include "boat_energy.h"
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+
+const EnergyTier ENERGY_TIERS[ENERGY_TIER_COUNT] = {
+  // name       report relay DR  led    listen  mA
+  {"normal",     120,  true,  2, true,  true,   62},
+  {"saver",      300,  true,  3, false, true,   56},
+  {"low",        600,  false, 4, false, true,   55},
+  {"critical",  1800,  false, 5, false, false,  45},  // mesh RX off: deaf between reports
+};
+
+/* ------------ ADC ------------- */
+static esp_adc_cal_characteristics_t adcChars;
+static adc1_channel_t adcCh = ADC1_CHANNEL_6;
+
+void battAdcInit(uint8_t gpio) {
+  adcCh = (adc1_channel_t)digitalPinToAnalogChannel(gpio);
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  adc1_config_channel_atten(adcCh, ADC_ATTEN_DB_11);
+  esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &adcChars);
+}
+
+uint16_t battReadMv(uint8_t samples) {
+  if (samples < 3) samples = 3;
+  uint32_t sum = 0;
+  int lo = 4095, hi = 0;
+  for (uint8_t i = 0; i < samples; i++) {
+    int raw = adc1_get_raw(adcCh);
+    sum += raw;
+    if (raw < lo) lo = raw;
+    if (raw > hi) hi = raw;
+  }
+  uint32_t avg = (sum - lo - hi + (samples - 2) / 2) / (samples - 2);
+  return esp_adc_cal_raw_to_voltage(avg, &adcChars);
+}
+
+/* ------------ LIPO CURVE ------------- */
+// Resting voltage at 0%, 5%, ... 100%
+static const uint16_t LIPO_MV[21] = {
+  3270, 3610, 3690, 3710, 3730, 3750, 3770, 3790, 3800, 3820,
+  3840, 3850, 3870, 3910, 3950, 3980, 4020, 4080, 4110, 4150, 4200,
+};
+
+uint16_t lipoPermille(uint16_t mv) {
+  if (mv <= LIPO_MV[0]) return 0;
+  if (mv >= LIPO_MV[20]) return 1000;
+  uint8_t i = 1;
+  while (mv > LIPO_MV[i]) i++;
+  return (i - 1) * 50 + (uint32_t)(mv - LIPO_MV[i - 1]) * 50 / (LIPO_MV[i] - LIPO_MV[i - 1]);
+}
+
+/* ------------ PLANNER ------------- */
+void EnergyPlanner::begin(uint16_t capacityMah, uint32_t targetEndS, uint32_t nowS) {
+  capacity_ = capacityMah;
+  targetEnd_ = targetEndS;
+  lastS_ = winStartS_ = nowS;
+  winStartPm_ = 0;
+  winExpectMah_ = 0;
+  memset(&st_, 0, sizeof(st_));
+  st_.corr = 1.0;
+  st_.reason = "start";
+}
+
+uint8_t EnergyPlanner::update(uint16_t cellMv, uint32_t nowS) {
+  uint16_t pm = lipoPermille(cellMv);
+  float dtH = (nowS - lastS_) / 3600.0;
+  lastS_ = nowS;
+
+  // Learn the real draw: compare what the battery lost with what the tiers predicted
+  winExpectMah_ += ENERGY_TIERS[st_.tier].mA * dtH;
+  if (!winStartPm_ || pm > winStartPm_ + 10) {  // first reading, or charging
+    winStartS_ = nowS;
+    winStartPm_ = pm;
+    winExpectMah_ = 0;
+  } else if (nowS - winStartS_ >= ENERGY_LEARN_S && winStartPm_ - pm >= 5 && winExpectMah_ > 0) {
+    float seen = (winStartPm_ - pm) / 1000.0 * capacity_;
+    float c = 0.7 * st_.corr + 0.3 * (seen / winExpectMah_);
+    st_.corr = c < 0.5 ? 0.5 : c > 2.0 ? 2.0 : c;
+    winStartS_ = nowS;
+    winStartPm_ = pm;
+    winExpectMah_ = 0;
+  }
+
+  st_.cellMv = cellMv;
+  st_.permille = pm;
+  uint32_t usable = pm > ENERGY_RESERVE_PM ? pm - ENERGY_RESERVE_PM : 0;
+  st_.remainingMah = (uint32_t)usable * capacity_ / 1000;
+  st_.hoursLeft = targetEnd_ > nowS ? (targetEnd_ - nowS) / 3600.0 : 0;
+
+  uint8_t want;
+  if (st_.hoursLeft <= 0) {
+    want = 0;  // past the target, nothing left to save for
+    st_.budgetMa = 0;
+    st_.reason = "target reached";
+  } else {
+    st_.budgetMa = st_.remainingMah / (st_.hoursLeft < 0.25 ? 0.25 : st_.hoursLeft);
+    want = ENERGY_TIER_COUNT - 1;
+    for (uint8_t i = 0; i < ENERGY_TIER_COUNT; i++) {
+      float need = ENERGY_TIERS[i].mA * st_.corr;
+      if (i < st_.tier) need /= ENERGY_UP_MARGIN;  // stepping up wants headroom
+      if (need <= st_.budgetMa) { want = i; break; }
+    }
+    st_.reason = want == 0 ? "on budget" : want == ENERGY_TIER_COUNT - 1 &&
+                 ENERGY_TIERS[want].mA * st_.corr > st_.budgetMa ? "short of target" : "saving";
+  }
+  st_.tier = want;
+  float draw = ENERGY_TIERS[want].mA * st_.corr;
+  st_.projectedH = draw > 0 ? st_.remainingMah / draw : 0;
+  return want;
+}
@@ -0,0 +1,78 @@
+/*
+  BoatEnergy - calibrated battery reading and an energy-budget planner
+
+  battReadMv() oversamples ADC1 and converts through the eFuse calibration
+  (esp_adc_cal), dropping the highest and lowest sample, so one reading is
+  good to ~10 mV instead of jumping by 50-100 mV. lipoPermille() maps a
+  resting cell voltage to state of charge along a typical LiPo discharge
+  curve; the load here (~50 mA) sags the cell by well under the table step.
+
+  EnergyPlanner picks one of ENERGY_TIERS so the charge left lasts until the
+  target time: budget = usable mAh / hours left, and the best tier whose
+  estimated draw fits the budget wins. Tier currents are bench estimates;
+  the planner scales them by what the battery actually lost over each
+  ENERGY_LEARN_S window (corr), so a worn cell or a busy mesh moves it down
+  a tier on its own. Moving up needs ENERGY_UP_MARGIN headroom, which keeps
+  it from flapping at a boundary.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+struct EnergyTier {
+  const char *name;
+  uint16_t reportSec;   // own position report interval
+  bool relay;           // forward other boats' mesh packets
+  uint8_t dr;           // LoRaWAN data rate (IN865: DR2 = SF10 ... DR5 = SF7)
+  bool led;             // status LED in use
+  bool listen;          // mesh receiver on between reports
+  uint16_t mA;          // estimated average draw, GPS included
+};
+
+const uint8_t ENERGY_TIER_COUNT = 4;
+extern const EnergyTier ENERGY_TIERS[ENERGY_TIER_COUNT];   // best first
+
+const uint32_t ENERGY_LEARN_S   = 1800;
+const uint16_t ENERGY_RESERVE_PM = 50;    // keep 5% back for the ride home
+const float    ENERGY_UP_MARGIN  = 0.85;
+
+// Battery ADC on ADC1 (GPIO 32-39). Returns the pin voltage in mV.
+void battAdcInit(uint8_t gpio);
+uint16_t battReadMv(uint8_t samples = 64);
+
+// State of charge in 0.1% from a resting cell voltage
+uint16_t lipoPermille(uint16_t cellMv);
+
+struct EnergyStatus {
+  uint16_t cellMv;
+  uint16_t permille;
+  uint8_t tier;
+  uint32_t remainingMah;
+  float hoursLeft;      // until the target
+  float budgetMa;       // what we may draw on average to make it
+  float projectedH;     // how long the charge lasts in the current tier
+  float corr;           // measured / estimated draw
+  const char *reason;
+};
+
+class EnergyPlanner {
+public:
+  void begin(uint16_t capacityMah, uint32_t targetEndS, uint32_t nowS);
+  void setTarget(uint32_t targetEndS) { targetEnd_ = targetEndS; }
+  void setCapacity(uint16_t mah) { capacity_ = mah; }
+  uint32_t targetEnd() const { return targetEnd_; }
+  // Call every few tens of seconds with a fresh reading; returns the tier
+  uint8_t update(uint16_t cellMv, uint32_t nowS);
+  const EnergyStatus &status() const { return st_; }
+  const EnergyTier &tier() const { return ENERGY_TIERS[st_.tier]; }
+
+private:
+  uint16_t capacity_ = 2000;
+  uint32_t targetEnd_ = 0;
+  uint32_t lastS_ = 0;
+  // learning window
+  uint32_t winStartS_ = 0;
+  uint16_t winStartPm_ = 0;
+  float winExpectMah_ = 0;
+  EnergyStatus st_ = {};
+};
@@ -0,0 +1,434 @@
+#include "boat_http.h"
+#include <AsyncTCP.h>
+
+enum { BH_FREE = 0, BH_RX, BH_READY, BH_DEFERRED, BH_TX, BH_STREAM };
+
+struct Guard {
+  SemaphoreHandle_t m;
+  explicit Guard(SemaphoreHandle_t m) : m(m) { xSemaphoreTakeRecursive(m, portMAX_DELAY); }
+  ~Guard() { xSemaphoreGiveRecursive(m); }
+};
+
+static const char *reason(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 202: return "Accepted";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 503: return "Service Unavailable";
+    default:  return code < 400 ? "OK" : "Internal Server Error";
+  }
+}
+
+static int hexVal(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// In place: "+" -> " ", "%41" -> "A"
+static void urlDecode(char *s) {
+  char *o = s;
+  for (; *s; s++) {
+    if (*s == '+') { *o++ = ' '; continue; }
+    if (*s == '%' && hexVal(s[1]) >= 0 && hexVal(s[2]) >= 0) {
+      *o++ = (char)(hexVal(s[1]) * 16 + hexVal(s[2]));
+      s += 2;
+      continue;
+    }
+    *o++ = *s;
+  }
+  *o = 0;
+}
+
+// Case-insensitive header lookup in the raw (not yet split) header block
+static const char *findHeader(const char *hdr, const char *end, const char *name) {
+  size_t n = strlen(name);
+  for (const char *p = hdr; p && p + n < end; ) {
+    if (strncasecmp(p, name, n) == 0 && p[n] == ':') {
+      p += n + 1;
+      while (*p == ' ') p++;
+      return p;
+    }
+    p = (const char *)memchr(p, '\n', end - p);
+    if (p) p++;
+  }
+  return NULL;
+}
+
+BoatHttp::BoatHttp(uint16_t port)
+  : port_(port), server_(NULL), lock_(xSemaphoreCreateRecursiveMutex()), routeCount_(0), cur_(0), answered_(false) {
+  for (auto &k : conns_) { k.c = NULL; k.state = BH_FREE; k.gen = 0; }
+}
+
+void BoatHttp::on(const char *path, BoatHttpMethod method, BoatHttpHandler fn) {
+  Guard g(lock_);
+  for (uint8_t i = 0; i < routeCount_; i++)
+    if (routes_[i].method == method && strcmp(routes_[i].path, path) == 0) { routes_[i].fn = fn; return; }
+  if (routeCount_ < BH_MAX_ROUTES) routes_[routeCount_++] = { path, method, fn };
+}
+
+void BoatHttp::begin() {
+  if (!server_) {
+    server_ = new AsyncServer(port_);
+    server_->onClient([](void *s, AsyncClient *c) { ((BoatHttp *)s)->onConnect(c); }, this);
+  }
+  server_->setNoDelay(true);
+  server_->begin();
+}
+
+void BoatHttp::stop() {
+  Guard g(lock_);
+  if (server_) server_->end();
+  for (auto &k : conns_) {
+    if (k.state == BH_FREE) continue;
+    k.state = BH_FREE;
+    k.gen++;
+    k.tx = String();
+    if (k.c) k.c->close(true);  // onDisconnect() deletes it
+  }
+}
+
+/* ------------ async_tcp task side ------------- */
+void BoatHttp::onConnect(AsyncClient *c) {
+  Guard g(lock_);
+  BoatHttpConn *k = NULL;
+  for (auto &s : conns_) if (s.state == BH_FREE && !s.c) { k = &s; break; }
+  if (!k) {
+    static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    c->onDisconnect([](void *, AsyncClient *c) { delete c; }, NULL);
+    c->write(busy, sizeof(busy) - 1);
+    c->close();
+    return;
+  }
+  k->srv = this;
+  k->c = c;
+  k->state = BH_RX;
+  k->rxLen = k->reqLen = 0;
+  k->tx = String();
+  k->txOff = 0;
+  k->txCap = 0;
+  c->setNoDelay(true);
+  c->setRxTimeout(BH_KEEPALIVE_S);
+  c->onData([](void *a, AsyncClient *, void *d, size_t n) {
+    auto *k = (BoatHttpConn *)a;
+    k->srv->onData(k, (const uint8_t *)d, n);
+  }, k);
+  c->onAck([](void *a, AsyncClient *, size_t, uint32_t) {
+    auto *k = (BoatHttpConn *)a;
+    k->srv->onAck(k);
+  }, k);
+  c->onTimeout([](void *a, AsyncClient *, uint32_t) {
+    auto *k = (BoatHttpConn *)a;
+    k->srv->onTimeout(k);
+  }, k);
+  c->onDisconnect([](void *a, AsyncClient *c) {
+    auto *k = (BoatHttpConn *)a;
+    k->srv->onDisconnect(k, c);
+  }, k);
+}
+
+void BoatHttp::onData(BoatHttpConn *k, const uint8_t *data, size_t len) {
+  Guard g(lock_);
+  if (k->state == BH_FREE || k->state == BH_STREAM) return;
+  if (k->rxLen + len > BH_RX_MAX) {
+    k->keepAlive = false;
+    if (k->state == BH_RX) respond(k, 413, NULL, String());
+    else k->c->close();
+    return;
+  }
+  memcpy(k->rx + k->rxLen, data, len);
+  k->rxLen += len;
+  k->rx[k->rxLen] = 0;
+  if (k->state == BH_RX) parse(k);   // otherwise it is a pipelined request, parsed after the reply
+}
+
+void BoatHttp::onAck(BoatHttpConn *k) {
+  Guard g(lock_);
+  if (k->state == BH_TX || k->state == BH_STREAM) pump(k);
+}
+
+void BoatHttp::onTimeout(BoatHttpConn *k) {
+  Guard g(lock_);
+  // Only idle keep-alive connections time out; parked ones belong to the sketch
+  if (k->state == BH_RX && k->c) k->c->close();
+}
+
+void BoatHttp::onDisconnect(BoatHttpConn *k, AsyncClient *c) {
+  {
+    Guard g(lock_);
+    if (k->c == c) {
+      if (k->state != BH_FREE) k->gen++;
+      k->state = BH_FREE;
+      k->c = NULL;
+      k->tx = String();
+    }
+  }
+  delete c;
+}
+
+// Called with rx[] holding at least a partial request and state == BH_RX
+void BoatHttp::parse(BoatHttpConn *k) {
+  char *hdrEnd = strstr(k->rx, "\r\n\r\n");
+  if (!hdrEnd) return;
+  char *bodyStart = hdrEnd + 4;
+
+  const char *cl = findHeader(k->rx, hdrEnd, "Content-Length");
+  // strtoul saturates; check the length alone first so the sum cannot wrap
+  unsigned long bodyLen = cl ? strtoul(cl, NULL, 10) : 0;
+  if (bodyLen > BH_RX_MAX) { k->keepAlive = false; respond(k, 413, NULL, String()); return; }
+  size_t total = (size_t)(bodyStart - k->rx) + bodyLen;
+  if (total > BH_RX_MAX) { k->keepAlive = false; respond(k, 413, NULL, String()); return; }
+  if (k->rxLen < total) return;
+
+  const char *conn = findHeader(k->rx, hdrEnd, "Connection");
+  bool closeHdr = conn && strncasecmp(conn, "close", 5) == 0;
+  bool aliveHdr = conn && strncasecmp(conn, "keep-alive", 10) == 0;
+
+  // Request line, split in place: METHOD SP path[?query] SP version
+  char *eol = strstr(k->rx, "\r\n");
+  *eol = 0;
+  k->hdr = eol + 2;
+  k->hdrLen = hdrEnd + 2 - k->hdr;
+  char *sp1 = strchr(k->rx, ' ');
+  char *sp2 = sp1 ? strchr(sp1 + 1, ' ') : NULL;
+  if (!sp1 || !sp2) { k->keepAlive = false; respond(k, 400, NULL, String()); return; }
+  *sp1 = 0; *sp2 = 0;
+  k->keepAlive = !strcmp(sp2 + 1, "HTTP/1.1") ? !closeHdr : aliveHdr;
+  k->method = !strcmp(k->rx, "GET") ? BH_GET : !strcmp(k->rx, "POST") ? BH_POST : BH_OTHER;
+  k->path = sp1 + 1;
+
+  k->argc = 0;
+  char *q = strchr(k->path, '?');
+  if (q) {
+    *q++ = 0;
+    while (q && *q && k->argc < BH_MAX_ARGS) {
+      char *amp = strchr(q, '&');
+      if (amp) *amp = 0;
+      char *eq = strchr(q, '=');
+      if (eq) *eq = 0;
+      urlDecode(q);
+      if (eq) urlDecode(eq + 1);
+      k->argk[k->argc] = q;
+      k->argv[k->argc] = eq ? eq + 1 : (char *)"";
+      k->argc++;
+      q = amp ? amp + 1 : NULL;
+    }
+  }
+  urlDecode(k->path);
+
+  k->body = bodyStart;
+  k->bodyLen = bodyLen;
+  k->reqLen = total;
+  k->state = BH_READY;
+}
+
+void BoatHttp::respond(BoatHttpConn *k, int code, const char *type, const String &body) {
+  char head[160];
+  int n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\n", code, reason(code));
+  if (type && *type) n += snprintf(head + n, sizeof(head) - n, "Content-Type: %s\r\n", type);
+  snprintf(head + n, sizeof(head) - n, "Content-Length: %u\r\nConnection: %s\r\n\r\n",
+           body.length(), k->keepAlive ? "keep-alive" : "close");
+  k->tx.reserve(strlen(head) + body.length());
+  k->tx = head;
+  k->tx += body;
+  k->txOff = 0;
+  k->state = BH_TX;
+  pump(k);
+}
+
+// Hands lwIP as much of tx as its send buffer takes; onAck() continues
+void BoatHttp::pump(BoatHttpConn *k) {
+  if (!k->c) return;
+  size_t left = k->tx.length() - k->txOff;
+  while (left) {
+    size_t n = min(left, k->c->space());
+    if (!n) break;
+    k->c->add(k->tx.c_str() + k->txOff, n);
+    k->txOff += n;
+    left -= n;
+  }
+  k->c->send();
+  if (left) return;
+  if (k->state == BH_STREAM) { k->tx = ""; k->txOff = 0; }  // keeps the buffer
+  else finish(k);
+}
+
+void BoatHttp::finish(BoatHttpConn *k) {
+  k->tx = String();
+  if (!k->keepAlive) { k->c->close(); return; }
+  uint16_t rest = k->rxLen - k->reqLen;
+  memmove(k->rx, k->rx + k->reqLen, rest);
+  k->rxLen = rest;
+  k->reqLen = 0;
+  k->rx[rest] = 0;
+  k->state = BH_RX;
+  if (rest) parse(k);
+}
+
+/* ------------ owning task side ------------- */
+// Moves a pointer into k.rx over to r.buf; others (the "" of a bare arg) stay
+static char *rebase(char *p, const BoatHttpConn &k, BoatHttpReq &r) {
+  return p >= k.rx && p <= k.rx + BH_RX_MAX ? r.buf + (p - k.rx) : p;
+}
+
+void BoatHttp::handleClient() {
+  for (uint8_t i = 0; i < BH_MAX_CONN; i++) {
+    BoatHttpHandler fn = NULL;
+    bool pathHit = false;
+    {
+      Guard g(lock_);
+      BoatHttpConn &k = conns_[i];
+      if (k.state != BH_READY) continue;
+      memcpy(req_.buf, k.rx, k.reqLen);
+      req_.buf[k.reqLen] = 0;
+      req_.method = k.method;
+      req_.path = rebase(k.path, k, req_);
+      req_.hdr = rebase(k.hdr, k, req_);
+      req_.hdrLen = k.hdrLen;
+      req_.body = rebase(k.body, k, req_);
+      req_.bodyLen = k.bodyLen;
+      req_.argc = k.argc;
+      for (uint8_t a = 0; a < k.argc; a++) {
+        req_.argk[a] = rebase(k.argk[a], k, req_);
+        req_.argv[a] = rebase(k.argv[a], k, req_);
+      }
+      for (uint8_t r = 0; r < routeCount_ && !fn; r++) {
+        if (strcmp(routes_[r].path, req_.path) != 0) continue;
+        pathHit = true;
+        if (routes_[r].method == BH_ANY || routes_[r].method == req_.method) fn = routes_[r].fn;
+      }
+      cur_ = ticketOf(&k);
+      answered_ = false;
+    }
+    if (fn) fn();
+    else send(pathHit ? 405 : 404);
+    if (!answered_) send(500);  // handler forgot to answer
+    cur_ = 0;
+  }
+}
+
+BoatHttpMethod BoatHttp::method() const {
+  return cur_ ? req_.method : BH_OTHER;
+}
+
+bool BoatHttp::hasArg(const char *name) const {
+  if (!cur_) return false;
+  if (!strcmp(name, "plain")) return req_.bodyLen > 0;
+  for (uint8_t i = 0; i < req_.argc; i++) if (!strcmp(req_.argk[i], name)) return true;
+  return false;
+}
+
+String BoatHttp::arg(const char *name) const {
+  if (!cur_) return String();
+  if (!strcmp(name, "plain")) return String(req_.body);  // the copy ends with the body
+  for (uint8_t i = 0; i < req_.argc; i++) if (!strcmp(req_.argk[i], name)) return String(req_.argv[i]);
+  return String();
+}
+
+String BoatHttp::header(const char *name) const {
+  if (!cur_) return String();
+  const char *v = findHeader(req_.hdr, req_.hdr + req_.hdrLen, name);
+  if (!v) return String();
+  String s;
+  while (*v != '\r' && *v != '\n') s += *v++;
+  return s;
+}
+
+const char *BoatHttp::body(size_t &len) const {
+  len = cur_ ? req_.bodyLen : 0;
+  return cur_ ? req_.body : "";
+}
+
+// The phone may have gone, and its slot been reused, while the handler ran
+void BoatHttp::send(int code, const char *type, const String &body) {
+  if (!cur_ || answered_) return;
+  Guard g(lock_);
+  answered_ = true;
+  BoatHttpConn *k = fromTicket(cur_, BH_READY);
+  if (k) respond(k, code, type, body);
+}
+
+// A ticket for a phone that has gone already is fine: reply() says false
+uint32_t BoatHttp::defer() {
+  if (!cur_ || answered_) return 0;
+  Guard g(lock_);
+  answered_ = true;
+  BoatHttpConn *k = fromTicket(cur_, BH_READY);
+  if (k) k->state = BH_DEFERRED;
+  return cur_;
+}
+
+uint32_t BoatHttp::stream(const char *type, uint16_t cap) {
+  if (!cur_ || answered_) return 0;
+  Guard g(lock_);
+  answered_ = true;
+  BoatHttpConn *k = fromTicket(cur_, BH_READY);
+  if (!k) return 0;
+  char head[160];
+  snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: %s\r\n"
+           "Cache-Control: no-cache\r\nConnection: close\r\n\r\n", type);
+  k->tx = head;
+  k->txOff = 0;
+  k->txCap = cap;
+  k->keepAlive = false;
+  k->state = BH_STREAM;
+  k->c->setRxTimeout(0);
+  pump(k);
+  return cur_;
+}
+
+int BoatHttp::push(uint32_t ticket, const char *data, size_t len) {
+  Guard g(lock_);
+  BoatHttpConn *k = fromTicket(ticket, BH_STREAM);
+  if (!k) return BH_PUSH_GONE;
+  if (k->tx.length() - k->txOff + len > k->txCap) return BH_PUSH_FULL;
+  if (k->txOff) { k->tx.remove(0, k->txOff); k->txOff = 0; }
+  k->tx.concat(data, len);
+  pump(k);
+  return BH_PUSH_OK;
+}
+
+void BoatHttp::close(uint32_t ticket) {
+  Guard g(lock_);
+  BoatHttpConn *k = fromTicket(ticket, BH_STREAM);
+  if (!k) k = fromTicket(ticket, BH_DEFERRED);
+  if (k) k->c->close();
+}
+
+uint32_t BoatHttp::ticketOf(BoatHttpConn *k) {
+  return ((uint32_t)k->gen << 8) | (uint32_t)(k - conns_ + 1);
+}
+
+BoatHttpConn *BoatHttp::fromTicket(uint32_t ticket, uint8_t state) {
+  uint8_t i = ticket & 0xff;
+  if (!i || i > BH_MAX_CONN) return NULL;
+  BoatHttpConn *k = &conns_[i - 1];
+  if (k->gen != (uint16_t)(ticket >> 8) || k->state != state || !k->c) return NULL;
+  return k;
+}
+
+bool BoatHttp::reply(uint32_t ticket, int code, const char *type, const String &body) {
+  Guard g(lock_);
+  BoatHttpConn *k = fromTicket(ticket, BH_DEFERRED);
+  if (!k) return false;
+  respond(k, code, type, body);
+  return true;
+}
+
+bool BoatHttp::pending(uint32_t ticket) {
+  Guard g(lock_);
+  return fromTicket(ticket, BH_DEFERRED) != NULL;
+}
+
+uint8_t BoatHttp::connections() {
+  Guard g(lock_);
+  uint8_t n = 0;
+  for (auto &k : conns_) if (k.state != BH_FREE) n++;
+  return n;
+}
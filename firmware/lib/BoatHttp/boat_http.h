@@ -0,0 +1,137 @@
+/*
+  BoatHttp - small event-driven HTTP/1.1 server for the pairing/rescue APs
+
+  Sockets live on AsyncTCP (lwIP raw API): accepting, reading, parsing and
+  writing all happen in the async_tcp task, several phones at once, with
+  keep-alive. Handlers do NOT run there. A parsed request waits in its
+  connection slot until the owning task calls handleClient(), which copies
+  it out and runs its handler with the lock released, so a slow handler
+  (NVS writes in /pair) never holds up lwIP's callbacks, and returns without
+  touching a socket: handlers keep the same single-threaded view of the
+  sketch they always had.
+
+  The calls mirror the Arduino WebServer ones (on/arg/hasArg/send, body in
+  arg("plain")) so sketches switch over without rewriting handlers. A
+  handler that cannot answer yet calls defer() and later reply(ticket, ...)
+  from any point in the same task; the connection stays open meanwhile.
+  stream() turns the request into an open-ended response (SSE) that the
+  sketch feeds with push(); each stream has a byte cap on what may sit
+  unsent, so a phone that stops reading costs a bounded amount of RAM and
+  push() says FULL instead of blocking.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+class AsyncClient;
+class AsyncServer;
+class BoatHttp;
+
+enum BoatHttpMethod : uint8_t { BH_ANY = 0, BH_GET, BH_POST, BH_OTHER };
+
+const uint8_t  BH_MAX_CONN     = 6;
+const uint16_t BH_RX_MAX       = 1536;  // request line + headers + body
+const uint8_t  BH_MAX_ARGS     = 8;
+const uint8_t  BH_MAX_ROUTES   = 12;
+const uint8_t  BH_KEEPALIVE_S  = 15;    // idle keep-alive connections are closed after this
+
+enum { BH_PUSH_OK = 0, BH_PUSH_FULL = -1, BH_PUSH_GONE = -2 };
+
+typedef void (*BoatHttpHandler)();
+
+struct BoatHttpConn {
+  BoatHttp *srv;
+  AsyncClient *c;
+  uint8_t state;            // BH_FREE / BH_RX / BH_READY / BH_DEFERRED / BH_TX / BH_STREAM (boat_http.cpp)
+  uint16_t gen;             // bumped on every reuse, part of the defer ticket
+  bool keepAlive;
+  BoatHttpMethod method;
+  uint16_t rxLen;
+  uint16_t reqLen;          // bytes of rx[] the current request occupies
+  char *path;
+  char *hdr;                // header lines, still raw
+  uint16_t hdrLen;
+  char *body;
+  uint16_t bodyLen;
+  uint8_t argc;
+  char *argk[BH_MAX_ARGS];
+  char *argv[BH_MAX_ARGS];
+  String tx;
+  size_t txOff;
+  uint16_t txCap;           // streams: max unsent bytes, 0 for plain responses
+  char rx[BH_RX_MAX + 1];
+};
+
+// The request a handler sees: handleClient()'s copy, the slot may be reused meanwhile
+struct BoatHttpReq {
+  BoatHttpMethod method;
+  char *path;
+  char *hdr;
+  uint16_t hdrLen;
+  char *body;
+  uint16_t bodyLen;
+  uint8_t argc;
+  char *argk[BH_MAX_ARGS];
+  char *argv[BH_MAX_ARGS];
+  char buf[BH_RX_MAX + 1];
+};
+
+struct BoatHttpRoute {
+  const char *path;
+  BoatHttpMethod method;
+  BoatHttpHandler fn;
+};
+
+class BoatHttp {
+public:
+  explicit BoatHttp(uint16_t port);
+
+  void on(const char *path, BoatHttpMethod method, BoatHttpHandler fn);
+  void begin();
+  void stop();
+  void handleClient();      // runs handlers for parsed requests; never waits on a socket
+
+  // Valid inside a handler
+  BoatHttpMethod method() const;
+  bool hasArg(const char *name) const;
+  String arg(const char *name) const;
+  String header(const char *name) const;
+  const char *body(size_t &len) const;  // raw request body in place, not NUL-terminated
+  void send(int code, const char *type = NULL, const String &body = String());
+  uint32_t defer();         // 0 if there is no current request
+  uint32_t stream(const char *type, uint16_t cap);  // 200 with no length, body via push(); cap counts the head too
+
+  // Answer a deferred request. False if the phone has gone away meanwhile.
+  bool reply(uint32_t ticket, int code, const char *type, const String &body);
+  bool pending(uint32_t ticket);
+  int push(uint32_t ticket, const char *data, size_t len);  // BH_PUSH_*
+  void close(uint32_t ticket);
+  uint8_t connections();
+
+  // AsyncTCP callbacks, public only so the C trampolines can reach them
+  void onConnect(AsyncClient *c);
+  void onData(BoatHttpConn *k, const uint8_t *data, size_t len);
+  void onAck(BoatHttpConn *k);
+  void onTimeout(BoatHttpConn *k);
+  void onDisconnect(BoatHttpConn *k, AsyncClient *c);
+
+private:
+  uint16_t port_;
+  AsyncServer *server_;
+  SemaphoreHandle_t lock_;
+  BoatHttpConn conns_[BH_MAX_CONN];
+  BoatHttpRoute routes_[BH_MAX_ROUTES];
+  uint8_t routeCount_;
+  BoatHttpReq req_;         // request being handled by handleClient()
+  uint32_t cur_;            // its slot's ticket, 0 outside a handler
+  bool answered_;           // cur_ got send(), defer() or stream()
+
+  void parse(BoatHttpConn *k);
+  void respond(BoatHttpConn *k, int code, const char *type, const String &body);
+  void pump(BoatHttpConn *k);
+  void finish(BoatHttpConn *k);
+  BoatHttpConn *fromTicket(uint32_t ticket, uint8_t state);
+  uint32_t ticketOf(BoatHttpConn *k);
+};
@@ -0,0 +1,300 @@
+#include "boat_journal.h"
+#include <esp_partition.h>
+
+#define PART ((const esp_partition_t *)part_)
+
+static const uint32_t HDR = 6;        // block header
+static const uint32_t SECT_HDR = 16;  // sector header
+static const uint8_t  ABS = 17;       // absolute record in a body
+
+static uint16_t crc16(uint16_t crc, const uint8_t *d, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    crc ^= (uint16_t)d[i] << 8;
+    for (int j = 0; j < 8; j++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  return crc;
+}
+
+static uint16_t blockCrc(const uint8_t *h, const uint8_t *body) {
+  return crc16(crc16(0xFFFF, h, 2), body, h[0]);
+}
+
+/* ------------ BODY CODEC ------------- */
+static size_t putVarint(uint8_t *out, uint32_t v) {
+  size_t n = 0;
+  do {
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    out[n++] = v ? b | 0x80 : b;
+  } while (v);
+  return n;
+}
+
+static bool getVarint(const uint8_t *&p, const uint8_t *end, uint32_t &v) {
+  v = 0;
+  for (int shift = 0; p < end && shift < 35; shift += 7) {
+    uint8_t b = *p++;
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+static void putAbs(uint8_t *p, const JournalRec &r) {
+  memcpy(p, &r.t, 4);
+  memcpy(p + 4, &r.lat1e7, 4);
+  memcpy(p + 8, &r.lon1e7, 4);
+  memcpy(p + 12, &r.spd_cms, 2);
+  memcpy(p + 14, &r.hdg_cdeg, 2);
+  p[16] = r.batt_pc;
+}
+
+static size_t putDelta(uint8_t *out, const JournalRec &a, const JournalRec &b) {
+  size_t m = 0;
+  m += putVarint(out + m, zigzag((int32_t)(b.t - a.t)));
+  m += putVarint(out + m, zigzag(b.lat1e7 - a.lat1e7));
+  m += putVarint(out + m, zigzag(b.lon1e7 - a.lon1e7));
+  m += putVarint(out + m, zigzag((int32_t)b.spd_cms - a.spd_cms));
+  m += putVarint(out + m, zigzag((int32_t)b.hdg_cdeg - a.hdg_cdeg));
+  m += putVarint(out + m, zigzag((int32_t)b.batt_pc - a.batt_pc));
+  return m;
+}
+
+size_t journalDecode(const uint8_t *body, size_t len, JournalRec *out, size_t max) {
+  if (len < 1 + ABS || !body[0] || body[0] > max) return 0;
+  size_t n = body[0];
+  JournalRec r;
+  memcpy(&r.t, body + 1, 4);
+  memcpy(&r.lat1e7, body + 5, 4);
+  memcpy(&r.lon1e7, body + 9, 4);
+  memcpy(&r.spd_cms, body + 13, 2);
+  memcpy(&r.hdg_cdeg, body + 15, 2);
+  r.batt_pc = body[17];
+  r.prio = 0;
+  out[0] = r;
+  const uint8_t *p = body + 1 + ABS, *end = body + len;
+  for (size_t i = 1; i < n; i++) {
+    uint32_t d[6];
+    for (int k = 0; k < 6; k++)
+      if (!getVarint(p, end, d[k])) return 0;
+    r.t += unzigzag(d[0]);
+    r.lat1e7 += unzigzag(d[1]);
+    r.lon1e7 += unzigzag(d[2]);
+    r.spd_cms += unzigzag(d[3]);
+    r.hdg_cdeg += unzigzag(d[4]);
+    r.batt_pc += unzigzag(d[5]);
+    out[i] = r;
+  }
+  return n;
+}
+
+/* ------------ FLASH ------------- */
+bool BoatJournal::readHdr(uint32_t off, uint8_t *h) {
+  return esp_partition_read(PART, off, h, HDR) == ESP_OK;
+}
+
+// Counts the blocks of sector s; for the head also finds the write offset.
+// Returns false if the sector ends in a torn block.
+bool BoatJournal::scanSector(uint16_t s, bool findEnd) {
+  uint32_t base = (uint32_t)s * JOURNAL_SECTOR, off = SECT_HDR;
+  unsent_[s] = blk_[s] = topPrio_[s] = 0;
+  while (off + HDR <= JOURNAL_SECTOR) {
+    uint8_t h[HDR], body[JOURNAL_BODY_MAX];
+    if (!readHdr(base + off, h)) break;
+    if (h[0] == 0xFF) break;  // free space
+    if (!h[0] || h[0] > JOURNAL_BODY_MAX || off + HDR + h[0] > JOURNAL_SECTOR || h[4] != 0x00 ||
+        esp_partition_read(PART, base + off + HDR, body, h[0]) != ESP_OK ||
+        blockCrc(h, body) != (h[2] | h[3] << 8)) {
+      torn_++;
+      if (findEnd) wr_ = JOURNAL_SECTOR;
+      return false;
+    }
+    blk_[s]++;
+    if (h[5] == 0xFF) {
+      unsent_[s]++;
+      if (h[1] > topPrio_[s]) topPrio_[s] = h[1];
+    }
+    off += HDR + h[0];
+  }
+  if (findEnd) wr_ = off;
+  return true;
+}
+
+bool BoatJournal::begin(const char *label) {
+  const esp_partition_t *p = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                      (esp_partition_subtype_t)JOURNAL_SUBTYPE, label);
+  if (!p) return false;
+  part_ = p;
+  nSect_ = p->size / JOURNAL_SECTOR;
+  if (nSect_ > JOURNAL_MAX_SECTORS) nSect_ = JOURNAL_MAX_SECTORS;
+  if (nSect_ < 2) { part_ = nullptr; return false; }
+
+  haveHead_ = false;
+  headSeq_ = 0;
+  for (uint16_t s = 0; s < nSect_; s++) {
+    uint32_t h[2];
+    seq_[s] = 0;
+    if (esp_partition_read(p, (uint32_t)s * JOURNAL_SECTOR, h, sizeof(h)) == ESP_OK &&
+        h[0] == JOURNAL_MAGIC && h[1] != 0xFFFFFFFF && h[1] != 0)
+      seq_[s] = h[1];
+    if (seq_[s] > headSeq_) { headSeq_ = seq_[s]; head_ = s; haveHead_ = true; }
+  }
+  for (uint16_t s = 0; s < nSect_; s++) {
+    if (seq_[s]) scanSector(s, haveHead_ && s == head_);
+    else unsent_[s] = blk_[s] = topPrio_[s] = 0;
+  }
+  pendLen_ = 0;
+  return true;
+}
+
+bool BoatJournal::openSector(uint16_t s) {
+  if (seq_[s]) dropped_ += unsent_[s];  // ring wrapped onto the tail
+  uint32_t base = (uint32_t)s * JOURNAL_SECTOR;
+  if (esp_partition_erase_range(PART, base, JOURNAL_SECTOR) != ESP_OK) return false;
+  uint32_t h[2] = {JOURNAL_MAGIC, headSeq_ + 1};
+  if (esp_partition_write(PART, base, h, sizeof(h)) != ESP_OK) return false;
+  headSeq_++;
+  seq_[s] = headSeq_;
+  unsent_[s] = blk_[s] = topPrio_[s] = 0;
+  head_ = s;
+  wr_ = SECT_HDR;
+  haveHead_ = true;
+  return true;
+}
+
+bool BoatJournal::flush() {
+  if (!part_ || !pendLen_) return true;
+  uint32_t need = HDR + pendLen_;
+  if (!haveHead_ || wr_ + need > JOURNAL_SECTOR) {
+    if (!openSector(haveHead_ ? (head_ + 1) % nSect_ : 0)) return false;
+  }
+
+  uint8_t blk[HDR + JOURNAL_BODY_MAX];
+  blk[0] = pendLen_;
+  blk[1] = pendPrio_;
+  uint16_t c = blockCrc(blk, pend_);
+  blk[2] = c;
+  blk[3] = c >> 8;
+  blk[4] = blk[5] = 0xFF;
+  memcpy(blk + HDR, pend_, pendLen_);
+  uint32_t at = (uint32_t)head_ * JOURNAL_SECTOR + wr_;
+  wr_ += need;
+  uint8_t commit[2] = {0x00, (uint8_t)(pendSent_ ? 0x00 : 0xFF)};
+  if (esp_partition_write(PART, at, blk, need) != ESP_OK ||
+      esp_partition_write(PART, at + 4, commit, 2) != ESP_OK) {
+    wr_ = JOURNAL_SECTOR;  // the scan stops at the bad block, so nothing may follow it
+    return false;
+  }
+
+  blk_[head_]++;
+  if (!pendSent_) {
+    unsent_[head_]++;
+    if (pendPrio_ > topPrio_[head_]) topPrio_[head_] = pendPrio_;
+  }
+  pendLen_ = 0;
+  return true;
+}
+
+void BoatJournal::append(const JournalRec &r, bool sent, uint32_t now) {
+  if (!part_) return;
+  bool fresh = !pendLen_ || r.prio != pendPrio_ || sent != pendSent_ || pend_[0] == 255;
+
+  if (!fresh) {
+    uint8_t d[30];
+    size_t m = putDelta(d, last_, r);
+    if (pendLen_ + m <= JOURNAL_BODY_MAX) {
+      memcpy(pend_ + pendLen_, d, m);
+      pendLen_ += m;
+      pend_[0]++;
+    } else {
+      fresh = true;
+    }
+  }
+  if (fresh) {
+    // A failed write keeps the pending block, whose deltas run from last_,
+    // so r is lost rather than encoded against a point that is not stored
+    if (!flush()) { lost_++; return; }
+    pend_[0] = 1;
+    putAbs(pend_ + 1, r);
+    pendLen_ = 1 + ABS;
+    pendPrio_ = r.prio;
+    pendSent_ = sent;
+    pendSince_ = now;
+  }
+  last_ = r;
+  if (r.prio > JOURNAL_PRIO_NORMAL) flush();  // alerts go out with the next drain
+}
+
+void BoatJournal::service(uint32_t now) {
+  if (pendLen_ && now - pendSince_ >= JOURNAL_FLUSH_MS) flush();
+}
+
+bool BoatJournal::nextUnsent(uint32_t &addr, uint8_t *body, uint8_t &len, uint8_t &prio) {
+  if (!part_) return false;
+  for (uint16_t tries = 0; tries < nSect_; tries++) {
+    int best = -1;
+    for (uint16_t s = 0; s < nSect_; s++) {
+      if (!seq_[s] || !unsent_[s]) continue;
+      if (best < 0 || topPrio_[s] > topPrio_[best] ||
+          (topPrio_[s] == topPrio_[best] && seq_[s] < seq_[best]))
+        best = s;
+    }
+    if (best < 0) return false;
+
+    uint32_t base = (uint32_t)best * JOURNAL_SECTOR, off = SECT_HDR;
+    uint8_t want = topPrio_[best], seen = 0;
+    uint16_t left = 0;
+    while (off + HDR <= JOURNAL_SECTOR) {
+      uint8_t h[HDR];
+      if (!readHdr(base + off, h) || h[0] == 0xFF || !h[0] || h[0] > JOURNAL_BODY_MAX || h[4] != 0x00) break;
+      if (h[5] == 0xFF) {
+        left++;
+        if (h[1] > seen) seen = h[1];
+        if (h[1] == want && esp_partition_read(PART, base + off + HDR, body, h[0]) == ESP_OK &&
+            blockCrc(h, body) == (h[2] | h[3] << 8)) {
+          addr = base + off;
+          len = h[0];
+          prio = h[1];
+          return true;
+        }
+      }
+      off += HDR + h[0];
+    }
+    // Counters were stale (priority blocks already sent); fix and pick again
+    unsent_[best] = left;
+    topPrio_[best] = left ? seen : 0;
+    if (left && seen == want) unsent_[best] = 0;  // unreadable, give up on the sector
+  }
+  return false;
+}
+
+bool BoatJournal::markSent(uint32_t addr) {
+  if (!part_) return false;
+  uint8_t h[HDR];
+  if (!readHdr(addr, h) || h[5] != 0xFF) return false;
+  uint8_t z = 0x00;
+  if (esp_partition_write(PART, addr + 5, &z, 1) != ESP_OK) return false;
+  uint16_t s = addr / JOURNAL_SECTOR;
+  if (unsent_[s]) unsent_[s]--;
+  if (!unsent_[s]) topPrio_[s] = 0;
+  return true;
+}
+
+JournalStats BoatJournal::stats() const {
+  JournalStats st;
+  memset(&st, 0, sizeof(st));
+  for (uint16_t s = 0; s < nSect_; s++) {
+    if (!seq_[s]) continue;
+    st.blocks += blk_[s];
+    st.unsent += unsent_[s];
+  }
+  st.dropped = dropped_;
+  st.torn = torn_;
+  st.lost = lost_;
+  st.sectors = nSect_;
+  st.head = head_;
+  return st;
+}
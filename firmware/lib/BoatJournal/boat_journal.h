@@ -0,0 +1,113 @@
+/*
+  BoatJournal - append-only fix log in a raw flash partition
+
+  The partition (label "journal", see partitions.csv) is a ring of 4 KB
+  sectors written strictly in order, so every sector is erased once per lap
+  and wear is even without a translation layer. Each sector starts with
+
+    [u32 JOURNAL_MAGIC][u32 seq][8 x 0xFF]
+
+  where seq grows by one per sector written; the highest seq is the head,
+  the lowest the tail. Blocks follow back to back:
+
+    [0]    len     body bytes (0xFF: free space, end of the sector)
+    [1]    prio    every record in a block has the same priority
+    [2..3] crc     CRC16-CCITT over len, prio and body
+    [4]    commit  0x00 once the block is complete
+    [5]    sent    0xFF unsent, 0x00 delivered (cleared in place, no erase)
+    [6..]  body
+
+  A block is written with commit left erased and committed with a second
+  one-byte write, so power loss mid-write leaves a block that fails the
+  commit/CRC check and is skipped; appends then resume in a fresh sector.
+
+  A body is what goes over the air (journalDecode() reads it back):
+
+    [u8 n][JournalRec abs, 17 bytes w/o prio][n-1 x delta]
+
+  with deltas as zigzag varints of t, lat, lon, speed, heading and battery.
+  JOURNAL_BODY_MAX keeps [u16 src][body] inside the 51-byte LoRaWAN payload
+  of the slowest IN865 data rates.
+
+  Records are collected in RAM and written as a block when the body is
+  full, the priority or delivered state changes, a priority record arrives,
+  or JOURNAL_FLUSH_MS passes; that window is what a power cut can lose.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+const uint32_t JOURNAL_MAGIC       = 0x314E4A42;  // "BJN1"
+const uint32_t JOURNAL_SECTOR      = 4096;
+const uint16_t JOURNAL_MAX_SECTORS = 224;         // the 0xE0000 journal in partitions.csv; begin() uses no more
+const uint8_t  JOURNAL_BODY_MAX    = 48;
+const uint32_t JOURNAL_FLUSH_MS    = 60000;
+const uint8_t  JOURNAL_SUBTYPE     = 0x40;        // data partition subtype in partitions.csv
+
+enum : uint8_t { JOURNAL_PRIO_NORMAL = 0, JOURNAL_PRIO_ALERT = 1, JOURNAL_PRIO_SOS = 2 };
+
+struct JournalRec {
+  uint32_t t;        // unix seconds
+  int32_t lat1e7;
+  int32_t lon1e7;
+  uint16_t spd_cms;
+  uint16_t hdg_cdeg;
+  uint8_t batt_pc;
+  uint8_t prio;
+};
+
+struct JournalStats {
+  uint32_t blocks, unsent;
+  uint32_t dropped;    // unsent blocks overwritten when the ring wrapped
+  uint32_t torn;       // blocks that failed commit/CRC at boot
+  uint32_t lost;       // records never buffered because a flash write failed
+  uint16_t sectors, head;
+};
+
+// Decodes a body into out[0..max); returns the record count, 0 if malformed.
+// prio is not in the body, callers fill it from the block.
+size_t journalDecode(const uint8_t *body, size_t len, JournalRec *out, size_t max);
+
+class BoatJournal {
+public:
+  bool begin(const char *label = "journal");
+  bool ready() const { return part_ != nullptr; }
+
+  // sent = already delivered live; such records are kept for the track only.
+  void append(const JournalRec &r, bool sent, uint32_t now);
+  void service(uint32_t now);   // time-based flush
+  bool flush();
+
+  // Oldest block of the highest priority that is still unsent. addr is what
+  // markSent() takes; body is ready to send.
+  bool nextUnsent(uint32_t &addr, uint8_t *body, uint8_t &len, uint8_t &prio);
+  bool markSent(uint32_t addr);
+
+  JournalStats stats() const;
+
+private:
+  bool openSector(uint16_t s);
+  bool scanSector(uint16_t s, bool findEnd);
+  bool readHdr(uint32_t off, uint8_t *h);
+
+  const void *part_ = nullptr;   // esp_partition_t
+  uint16_t nSect_ = 0;
+  uint16_t head_ = 0;
+  uint32_t headSeq_ = 0;
+  uint32_t wr_ = 0;              // next free offset in the head sector
+  bool haveHead_ = false;
+
+  uint32_t seq_[JOURNAL_MAX_SECTORS];     // 0 = erased
+  uint16_t unsent_[JOURNAL_MAX_SECTORS];
+  uint16_t blk_[JOURNAL_MAX_SECTORS];
+  uint8_t topPrio_[JOURNAL_MAX_SECTORS];  // highest prio among unsent blocks
+
+  uint32_t dropped_ = 0, torn_ = 0, lost_ = 0;
+
+  // Block being built
+  uint8_t pend_[JOURNAL_BODY_MAX];
+  uint8_t pendLen_ = 0, pendPrio_ = 0;
+  bool pendSent_ = false;
+  uint32_t pendSince_ = 0;
+  JournalRec last_;
+};
@@ -0,0 +1,259 @@
+#include "boat_json.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct JsonIn {
+  const char *p;
+  const char *end;
+};
+
+static void skipWs(JsonIn &in) {
+  while (in.p < in.end && (*in.p == ' ' || *in.p == '\t' || *in.p == '\n' || *in.p == '\r')) in.p++;
+}
+
+static bool eat(JsonIn &in, char c) {
+  skipWs(in);
+  if (in.p < in.end && *in.p == c) { in.p++; return true; }
+  return false;
+}
+
+static int hex4(const char *p) {
+  int v = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = p[i];
+    v <<= 4;
+    if (c >= '0' && c <= '9') v |= c - '0';
+    else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+    else return -1;
+  }
+  return v;
+}
+
+// Decodes the string at in.p (just past the opening quote) into out[cap].
+// out == NULL just skips it. Returns the decoded length, or an error.
+static int readStr(JsonIn &in, char *out, size_t cap) {
+  size_t n = 0;
+  bool fits = true;
+  while (in.p < in.end) {
+    char c = *in.p++;
+    uint32_t cp;
+    if (c == '"') {
+      if (out) { if (!fits) return JSON_ERR_RANGE; out[n] = 0; }
+      return (int)n;
+    }
+    if ((uint8_t)c < 0x20) return JSON_ERR_SYNTAX;
+    if (c != '\\') {
+      if (out) { if (n + 1 < cap) out[n] = c; else fits = false; }
+      n++;
+      continue;
+    }
+    if (in.p >= in.end) return JSON_ERR_SYNTAX;
+    c = *in.p++;
+    switch (c) {
+      case '"': case '\\': case '/': cp = c; break;
+      case 'b': cp = '\b'; break;
+      case 'f': cp = '\f'; break;
+      case 'n': cp = '\n'; break;
+      case 'r': cp = '\r'; break;
+      case 't': cp = '\t'; break;
+      case 'u': {
+        if (in.end - in.p < 4) return JSON_ERR_SYNTAX;
+        int h = hex4(in.p);
+        if (h < 0) return JSON_ERR_SYNTAX;
+        in.p += 4;
+        cp = h;
+        if (cp >= 0xD800 && cp < 0xDC00 && in.end - in.p >= 6 && in.p[0] == '\\' && in.p[1] == 'u') {
+          int lo = hex4(in.p + 2);
+          if (lo >= 0xDC00 && lo < 0xE000) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            in.p += 6;
+          }
+        }
+        break;
+      }
+      default: return JSON_ERR_SYNTAX;
+    }
+    uint8_t u[4];
+    uint8_t ul;
+    if (cp < 0x80) { u[0] = cp; ul = 1; }
+    else if (cp < 0x800) { u[0] = 0xC0 | (cp >> 6); u[1] = 0x80 | (cp & 0x3F); ul = 2; }
+    else if (cp < 0x10000) { u[0] = 0xE0 | (cp >> 12); u[1] = 0x80 | ((cp >> 6) & 0x3F); u[2] = 0x80 | (cp & 0x3F); ul = 3; }
+    else { u[0] = 0xF0 | (cp >> 18); u[1] = 0x80 | ((cp >> 12) & 0x3F); u[2] = 0x80 | ((cp >> 6) & 0x3F); u[3] = 0x80 | (cp & 0x3F); ul = 4; }
+    for (uint8_t i = 0; i < ul; i++) {
+      if (out) { if (n + 1 < cap) out[n] = u[i]; else fits = false; }
+      n++;
+    }
+  }
+  return JSON_ERR_SYNTAX;
+}
+
+static bool isNumChar(char c) {
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static bool literal(JsonIn &in, const char *word) {
+  size_t n = strlen(word);
+  if ((size_t)(in.end - in.p) < n || memcmp(in.p, word, n) != 0) return false;
+  in.p += n;
+  return true;
+}
+
+// Skips one value of any kind, nested containers included, at most
+// JSON_MAX_DEPTH deep: the bodies come from anyone on the pairing AP and
+// each level is a stack frame on the http or BLE task.
+static int skipValue(JsonIn &in, uint8_t depth) {
+  skipWs(in);
+  if (in.p >= in.end) return JSON_ERR_SYNTAX;
+  char c = *in.p;
+  if (c == '"') { in.p++; int r = readStr(in, NULL, 0); return r < 0 ? r : JSON_OK; }
+  if (c == '{' || c == '[') {
+    if (depth >= JSON_MAX_DEPTH) return JSON_ERR_SYNTAX;
+    in.p++;
+    char close = c == '{' ? '}' : ']';
+    if (eat(in, close)) return JSON_OK;
+    do {
+      if (close == '}') {
+        if (!eat(in, '"')) return JSON_ERR_SYNTAX;
+        int r = readStr(in, NULL, 0);
+        if (r < 0) return r;
+        if (!eat(in, ':')) return JSON_ERR_SYNTAX;
+      }
+      int r = skipValue(in, depth + 1);
+      if (r < 0) return r;
+    } while (eat(in, ','));
+    return eat(in, close) ? JSON_OK : JSON_ERR_SYNTAX;
+  }
+  if (literal(in, "true") || literal(in, "false") || literal(in, "null")) return JSON_OK;
+  const char *s = in.p;
+  while (in.p < in.end && isNumChar(*in.p)) in.p++;
+  return in.p > s ? JSON_OK : JSON_ERR_SYNTAX;
+}
+
+static int storeNumber(JsonIn &in, const JsonField &f) {
+  char num[32];
+  size_t n = 0;
+  while (in.p < in.end && isNumChar(*in.p) && n < sizeof(num) - 1) num[n++] = *in.p++;
+  num[n] = 0;
+  if (!n || (in.p < in.end && isNumChar(*in.p))) return JSON_ERR_SYNTAX;
+  char *e;
+  if (f.type == JSON_FLOAT) {
+    double d = strtod(num, &e);
+    if (*e) return JSON_ERR_SYNTAX;
+    if (f.size == sizeof(double)) *(double *)f.dst = d;
+    else *(float *)f.dst = (float)d;
+    return JSON_OK;
+  }
+  if (strpbrk(num, ".eE")) return JSON_ERR_TYPE;
+  if (f.type == JSON_UINT) {
+    if (num[0] == '-') return JSON_ERR_RANGE;
+    unsigned long long v = strtoull(num, &e, 10);
+    if (*e) return JSON_ERR_SYNTAX;
+    if (f.size < 8 && v >> (f.size * 8)) return JSON_ERR_RANGE;
+    switch (f.size) {
+      case 1: *(uint8_t *)f.dst = v; break;
+      case 2: *(uint16_t *)f.dst = v; break;
+      case 4: *(uint32_t *)f.dst = v; break;
+      default: *(uint64_t *)f.dst = v; break;
+    }
+    return JSON_OK;
+  }
+  long long v = strtoll(num, &e, 10);
+  if (*e) return JSON_ERR_SYNTAX;
+  if (f.size < 8) {
+    long long lim = 1LL << (f.size * 8 - 1);
+    if (v < -lim || v >= lim) return JSON_ERR_RANGE;
+  }
+  switch (f.size) {
+    case 1: *(int8_t *)f.dst = v; break;
+    case 2: *(int16_t *)f.dst = v; break;
+    case 4: *(int32_t *)f.dst = v; break;
+    default: *(int64_t *)f.dst = v; break;
+  }
+  return JSON_OK;
+}
+
+static int storeValue(JsonIn &in, const JsonField &f) {
+  skipWs(in);
+  if (in.p >= in.end) return JSON_ERR_SYNTAX;
+  char c = *in.p;
+  switch (f.type) {
+    case JSON_STR:
+      if (c != '"') return JSON_ERR_TYPE;
+      in.p++;
+      {
+        int r = readStr(in, (char *)f.dst, f.size);
+        return r < 0 ? r : JSON_OK;
+      }
+    case JSON_BOOL:
+      if (literal(in, "true")) { *(bool *)f.dst = true; return JSON_OK; }
+      if (literal(in, "false")) { *(bool *)f.dst = false; return JSON_OK; }
+      return JSON_ERR_TYPE;
+    case JSON_OBJ: {
+      if (c != '{') return JSON_ERR_TYPE;
+      const char *s = in.p;
+      int r = skipValue(in, 1);
+      if (r < 0) return r;
+      *(JsonSpan *)f.dst = { s, (size_t)(in.p - s) };
+      return JSON_OK;
+    }
+    default:
+      if (!isNumChar(c)) return JSON_ERR_TYPE;
+      return storeNumber(in, f);
+  }
+}
+
+int jsonBind(const char *buf, size_t len, const JsonField *fields, uint8_t n, uint32_t *seen) {
+  JsonIn in = { buf, buf + len };
+  uint32_t got = 0;
+  if (seen) *seen = 0;
+  if (!eat(in, '{')) return JSON_ERR_SYNTAX;
+  if (!eat(in, '}')) {
+    do {
+      if (!eat(in, '"')) return JSON_ERR_SYNTAX;
+      char key[32];
+      int kl = readStr(in, key, sizeof(key));
+      if (kl == JSON_ERR_RANGE) key[0] = 0;   // longer than any field name: unknown
+      else if (kl < 0) return kl;
+      if (!eat(in, ':')) return JSON_ERR_SYNTAX;
+
+      int i = -1;
+      if (key[0] && strlen(key) == (size_t)kl)
+        for (uint8_t k = 0; k < n && k < 32; k++) if (!strcmp(fields[k].key, key)) { i = k; break; }
+
+      int r = i < 0 ? skipValue(in, 1) : storeValue(in, fields[i]);
+      if (r < 0) return r;
+      if (i >= 0) got |= 1UL << i;
+    } while (eat(in, ','));
+    if (!eat(in, '}')) return JSON_ERR_SYNTAX;
+  }
+  if (seen) *seen = got;
+  return JSON_OK;
+}
+
+bool jsonEscape(char *out, size_t cap, const char *s) {
+  static const char hex[] = "0123456789abcdef";
+  size_t n = 0;
+  if (!cap) return false;
+  for (; *s; s++) {
+    uint8_t c = *s;
+    char e = c == '"' ? '"' : c == '\\' ? '\\' : c == '\n' ? 'n' : c == '\r' ? 'r' : c == '\t' ? 't' : 0;
+    size_t need = e ? 2 : c < 0x20 ? 6 : 1;
+    if (n + need >= cap) { out[n] = 0; return false; }
+    if (e) { out[n++] = '\\'; out[n++] = e; }
+    else if (c < 0x20) { memcpy(out + n, "\\u00", 4); out[n + 4] = hex[c >> 4]; out[n + 5] = hex[c & 15]; n += 6; }
+    else out[n++] = c;
+  }
+  out[n] = 0;
+  return true;
+}
+
+const char *jsonErrStr(int err) {
+  switch (err) {
+    case JSON_OK: return "ok";
+    case JSON_ERR_SYNTAX: return "bad json";
+    case JSON_ERR_TYPE: return "wrong type";
+    case JSON_ERR_RANGE: return "out of range";
+    default: return "error";
+  }
+}
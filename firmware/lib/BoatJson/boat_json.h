@@ -0,0 +1,70 @@
+/*
+  BoatJson - allocation-free JSON for request bodies and BLE commands
+
+  jsonBind() walks one flat JSON object and writes the members it knows
+  straight into caller-owned storage, described by a JsonField table:
+
+    struct { char boatId[40]; uint16_t userId; } req = {};
+    const JsonField f[] = {
+      JSON_STR_FIELD("boat_id", req.boatId),
+      JSON_UINT_FIELD("user_id", req.userId),
+    };
+    uint32_t seen;
+    if (jsonBind(body, len, f, 2, &seen) == JSON_OK && (seen & 1)) ...
+
+  Bit i of `seen` is set when f[i] was present and stored, so absent keys
+  are distinguishable from zero values. Unknown members (nested objects and
+  arrays included, JSON_MAX_DEPTH levels at most) are skipped, whitespace
+  and escapes (\uXXXX to UTF-8, surrogate pairs too) are handled, integers
+  are range-checked against the destination width and strings that do not
+  fit are an error, never silently truncated. The input does not need a
+  NUL and is only read. On error the destinations may be partly written,
+  so bind into a scratch struct and copy it over only on JSON_OK.
+
+  JSON_OBJ_FIELD takes a nested object as a JsonSpan, its extent in the
+  input, so a second jsonBind() can read the members it needs.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum JsonType : uint8_t { JSON_STR, JSON_INT, JSON_UINT, JSON_FLOAT, JSON_BOOL, JSON_OBJ };
+
+enum {
+  JSON_OK = 0,
+  JSON_ERR_SYNTAX = -1,   // not a JSON object, or truncated
+  JSON_ERR_TYPE = -2,     // a known key holds the wrong kind of value
+  JSON_ERR_RANGE = -3,    // number out of range / string longer than its buffer
+};
+
+const uint8_t JSON_MAX_DEPTH = 16;  // the outer object counts as 1; deeper is JSON_ERR_SYNTAX
+
+// An object value in place, braces included; points into the input
+struct JsonSpan {
+  const char *p;
+  size_t len;
+};
+
+struct JsonField {
+  const char *key;
+  JsonType type;
+  void *dst;
+  uint8_t size;           // sizeof(*dst): string capacity incl. NUL, 1/2/4 for ints, 4/8 for floats, JsonSpan
+};
+
+#define JSON_STR_FIELD(k, v)   { k, JSON_STR, (void *)(v), (uint8_t)sizeof(v) }
+#define JSON_INT_FIELD(k, v)   { k, JSON_INT, (void *)&(v), (uint8_t)sizeof(v) }
+#define JSON_UINT_FIELD(k, v)  { k, JSON_UINT, (void *)&(v), (uint8_t)sizeof(v) }
+#define JSON_FLOAT_FIELD(k, v) { k, JSON_FLOAT, (void *)&(v), (uint8_t)sizeof(v) }
+#define JSON_BOOL_FIELD(k, v)  { k, JSON_BOOL, (void *)&(v), (uint8_t)sizeof(v) }
+#define JSON_OBJ_FIELD(k, v)   { k, JSON_OBJ, (void *)&(v), (uint8_t)sizeof(v) }
+
+// At most 32 fields per table (one bit each in *seen).
+int jsonBind(const char *in, size_t len, const JsonField *fields, uint8_t n, uint32_t *seen);
+
+const char *jsonErrStr(int err);
+
+// Writes s as a JSON string body (no quotes) into out[cap], always
+// NUL-terminated. Returns false if it had to stop short.
+bool jsonEscape(char *out, size_t cap, const char *s);
@@ -0,0 +1,138 @@
+#include "boat_lmic_session.h"
+#include <Preferences.h>
+#include <esp_attr.h>
+#include <stddef.h>
+
+extern "C" {
+  #include <lmic.h>
+}
+
+static const uint32_t SESS_MAGIC = 0x31534D4C;  // "LMS1"
+static const char *NVS_NS = "lmic_sess";
+
+struct LmicSession {
+  uint32_t magic;
+  uint32_t netid;
+  uint32_t devaddr;
+  uint8_t nwkKey[16];
+  uint8_t artKey[16];
+  uint32_t seqnoUp;
+  uint32_t seqnoDn;
+  uint8_t datarate;
+  int8_t adrTxPow;
+  uint8_t rx1DrOffset;
+  uint8_t dn2Dr;
+  uint32_t dn2Freq;
+  uint8_t rxDelay;
+#if CFG_LMIC_EU_like
+  uint32_t channelFreq[MAX_CHANNELS];
+  uint16_t channelDrMap[MAX_CHANNELS];
+  uint16_t channelMap;
+#endif
+  uint16_t crc;
+};
+
+static RTC_NOINIT_ATTR LmicSession rtcSess;
+static uint32_t nvsMark = 0;
+static const char *source = "none";
+
+static uint16_t sessCrc(const LmicSession &s) {
+  const uint8_t *d = (const uint8_t *)&s;
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < offsetof(LmicSession, crc); i++) {
+    crc ^= (uint16_t)d[i] << 8;
+    for (int j = 0; j < 8; j++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  return crc;
+}
+
+static bool valid(const LmicSession &s) {
+  return s.magic == SESS_MAGIC && s.devaddr && s.crc == sessCrc(s);
+}
+
+static void capture(LmicSession &s) {
+  memset(&s, 0, sizeof(s));
+  s.magic = SESS_MAGIC;
+  LMIC_getSessionKeys(&s.netid, &s.devaddr, s.nwkKey, s.artKey);
+  s.seqnoUp = LMIC.seqnoUp;
+  s.seqnoDn = LMIC.seqnoDn;
+  s.datarate = LMIC.datarate;
+  s.adrTxPow = LMIC.adrTxPow;
+  s.rx1DrOffset = LMIC.rx1DrOffset;
+  s.dn2Dr = LMIC.dn2Dr;
+  s.dn2Freq = LMIC.dn2Freq;
+  s.rxDelay = LMIC.rxDelay;
+#if CFG_LMIC_EU_like
+  memcpy(s.channelFreq, LMIC.channelFreq, sizeof(s.channelFreq));
+  memcpy(s.channelDrMap, LMIC.channelDrMap, sizeof(s.channelDrMap));
+  s.channelMap = LMIC.channelMap;
+#endif
+  s.crc = sessCrc(s);
+}
+
+static void apply(const LmicSession &s) {
+  LMIC_setSession(s.netid, s.devaddr, (xref2u1_t)s.nwkKey, (xref2u1_t)s.artKey);
+  // setSession resets counters and channels, so these go after it
+#if CFG_LMIC_EU_like
+  memcpy(LMIC.channelFreq, s.channelFreq, sizeof(s.channelFreq));
+  memcpy(LMIC.channelDrMap, s.channelDrMap, sizeof(s.channelDrMap));
+  LMIC.channelMap = s.channelMap;
+#endif
+  LMIC.rx1DrOffset = s.rx1DrOffset;
+  LMIC.dn2Dr = s.dn2Dr;
+  LMIC.dn2Freq = s.dn2Freq;
+  LMIC.rxDelay = s.rxDelay;
+  LMIC_setDrTxpow(s.datarate, s.adrTxPow);
+  LMIC_setSeqnoUp(s.seqnoUp);
+  LMIC.seqnoDn = s.seqnoDn;
+}
+
+static void nvsWrite(LmicSession s) {
+  nvsMark = s.seqnoUp + LMIC_SESSION_FCNT_RESERVE;
+  s.seqnoUp = nvsMark;  // what a restore from flash resumes at
+  s.crc = sessCrc(s);
+  Preferences p;
+  if (!p.begin(NVS_NS, false)) return;
+  p.putBytes("s", &s, sizeof(s));
+  p.end();
+}
+
+bool lmicSessionRestore() {
+  LmicSession s;
+  if (valid(rtcSess)) {
+    s = rtcSess;
+    source = "rtc";
+  } else {
+    Preferences p;
+    bool ok = p.begin(NVS_NS, true) && p.getBytes("s", &s, sizeof(s)) == sizeof(s) && valid(s);
+    p.end();
+    if (!ok) { source = "none"; return false; }
+    source = "nvs";
+  }
+  apply(s);
+  // Everything up to the mark may have been used before a power cut; move it on now
+  nvsWrite(s);
+  capture(rtcSess);
+  return true;
+}
+
+void lmicSessionSave() {
+  capture(rtcSess);
+  nvsWrite(rtcSess);
+}
+
+void lmicSessionTx() {
+  if (!LMIC.devaddr) return;
+  capture(rtcSess);
+  if (LMIC.seqnoUp >= nvsMark) nvsWrite(rtcSess);
+}
+
+void lmicSessionForget() {
+  memset(&rtcSess, 0, sizeof(rtcSess));
+  nvsMark = 0;
+  Preferences p;
+  if (p.begin(NVS_NS, false)) { p.clear(); p.end(); }
+  source = "none";
+}
+
+const char *lmicSessionSource() { return source; }
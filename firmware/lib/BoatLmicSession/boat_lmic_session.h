@@ -0,0 +1,37 @@
+/*
+  BoatLmicSession - keep the LoRaWAN session across reboots
+
+  After EV_JOINED the session (DevAddr, NwkSKey/AppSKey, frame counters,
+  RX2/ADR settings and the channel plan) is saved twice:
+
+    - RTC memory (RTC_NOINIT_ATTR): refreshed after every uplink, exact
+      counters, survives esp_restart(), watchdog and brownout resets.
+    - NVS: written at join and whenever FCntUp reaches the reserved mark,
+      which is then moved LMIC_SESSION_FCNT_RESERVE ahead. Survives power
+      loss; on restore FCntUp resumes at the mark, so a counter is never
+      reused (the network would drop the frame), at one flash write per
+      LMIC_SESSION_FCNT_RESERVE uplinks.
+
+  Boot:   os_init(); LMIC_reset(); (region setup);
+          if (lmicSessionRestore()) LMIC_setLinkCheckMode(1); else LMIC_startJoining();
+  Events: EV_JOINED -> lmicSessionSave(); EV_TXCOMPLETE -> lmicSessionTx();
+          EV_LINK_DEAD -> lmicSessionForget() and LMIC_unjoinAndRejoin().
+
+  A restored session is only as good as the network's memory of it; if the
+  server was reset the node will not hear downlinks, which is what the
+  forget/rejoin path is for. Restoring sets the session as ABP would, with
+  link checks off, so turn them back on or EV_LINK_DEAD never comes.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+const uint16_t LMIC_SESSION_FCNT_RESERVE = 64;
+
+// true if a saved session was loaded into LMIC; the caller skips the join
+bool lmicSessionRestore();
+void lmicSessionSave();
+void lmicSessionTx();
+void lmicSessionForget();
+// Where the last restore came from: "rtc", "nvs" or "none"
+const char *lmicSessionSource();
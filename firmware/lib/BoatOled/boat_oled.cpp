@@ -0,0 +1,55 @@
+#include "boat_oled.h"
+
+void OledDiff::begin(TwoWire &w, uint8_t addr, const uint8_t *fb, uint16_t width, uint8_t pages) {
+  w_ = &w;
+  addr_ = addr;
+  fb_ = fb;
+  width_ = width;
+  pages_ = (uint32_t)width * pages > OLED_MAX_BYTES ? OLED_MAX_BYTES / width : pages;
+  full_ = true;
+}
+
+size_t OledDiff::cmd(const uint8_t *c, size_t n) {
+  w_->beginTransmission(addr_);
+  w_->write((uint8_t)0x00);  // Co = 0, D/C = 0: command stream
+  w_->write(c, n);
+  w_->endTransmission();
+  return n + 2;              // + address and control byte
+}
+
+size_t OledDiff::data(const uint8_t *d, size_t n) {
+  size_t bytes = 0;
+  for (size_t off = 0; off < n; off += OLED_CHUNK) {
+    size_t k = n - off < OLED_CHUNK ? n - off : OLED_CHUNK;
+    w_->beginTransmission(addr_);
+    w_->write((uint8_t)0x40);  // D/C = 1: data stream
+    w_->write(d + off, k);
+    w_->endTransmission();
+    bytes += k + 2;
+  }
+  return bytes;
+}
+
+size_t OledDiff::push() {
+  if (!w_ || !fb_) return 0;
+  size_t bytes = 0;
+  for (uint8_t p = 0; p < pages_; p++) {
+    const uint8_t *row = fb_ + p * width_;
+    uint8_t *old = shadow_ + p * width_;
+    int c0 = 0, c1 = width_ - 1;
+    if (!full_) {
+      while (c0 < width_ && row[c0] == old[c0]) c0++;
+      if (c0 == width_) continue;
+      while (row[c1] == old[c1]) c1--;
+    }
+    const uint8_t win[] = {0x21, (uint8_t)c0, (uint8_t)c1, 0x22, p, p};  // column, page address
+    bytes += cmd(win, sizeof(win));
+    bytes += data(row + c0, c1 - c0 + 1);
+    memcpy(old + c0, row + c0, c1 - c0 + 1);
+  }
+  full_ = false;
+  if (bytes) stats_.frames++;
+  else stats_.skipped++;
+  stats_.bytes += bytes;
+  return bytes;
+}
@@ -0,0 +1,50 @@
+/*
+  BoatOled - push only what changed in an SSD1306 frame
+
+  Adafruit_SSD1306::display() sends the whole 1 KB buffer every time. OledDiff
+  keeps a copy of what the panel already shows and, per 8-pixel page, sends
+  just the span from the first to the last changed column (column/page
+  address window, then the bytes). A frame with no change costs nothing on
+  the bus, a changed status line one page.
+
+  Draw with the Adafruit GFX calls as before, then call push() instead of
+  display(). The panel must be in horizontal addressing mode, which
+  Adafruit_SSD1306::begin() sets. Only the task calling push() may use the
+  I2C bus while it runs.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+const uint16_t OLED_MAX_BYTES = 128 * 64 / 8;
+const uint8_t  OLED_CHUNK     = 64;   // data bytes per I2C transaction, ESP32 Wire buffer is 128
+
+struct OledStats {
+  uint32_t frames;    // push() calls that sent something
+  uint32_t skipped;   // push() calls with nothing to send
+  uint32_t bytes;     // on the bus, commands included
+};
+
+class OledDiff {
+public:
+  void begin(TwoWire &w, uint8_t addr, const uint8_t *fb, uint16_t width = 128, uint8_t pages = 8);
+  // Sends the changes; returns bytes written to the bus, 0 if nothing changed
+  size_t push();
+  void invalidate() { full_ = true; }   // next push() sends everything (panel reset, contrast, ...)
+  OledStats stats() const { return stats_; }
+  void resetStats() { memset(&stats_, 0, sizeof(stats_)); }
+
+private:
+  size_t cmd(const uint8_t *c, size_t n);
+  size_t data(const uint8_t *d, size_t n);
+
+  TwoWire *w_ = nullptr;
+  uint8_t addr_ = 0x3C;
+  const uint8_t *fb_ = nullptr;
+  uint16_t width_ = 128;
+  uint8_t pages_ = 8;
+  bool full_ = true;
+  uint8_t shadow_[OLED_MAX_BYTES];
+  OledStats stats_ = {};
+};
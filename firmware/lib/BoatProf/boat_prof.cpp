@@ -0,0 +1,139 @@
+#include "boat_prof.h"
+
+#if BOAT_PROF
+
+ProfSection profSections[PROF_MAX_SECTIONS];
+uint8_t profSectionCount = 0;
+static portMUX_TYPE profMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Same name from several call sites shares one section. Past
+// PROF_MAX_SECTIONS everything lands in the last slot rather than failing.
+uint8_t profRegister(const char *name) {
+  portENTER_CRITICAL(&profMux);
+  uint8_t i = 0;
+  while (i < profSectionCount && strcmp(profSections[i].name, name) != 0) i++;
+  if (i == profSectionCount && i < PROF_MAX_SECTIONS) {
+    memset(&profSections[i], 0, sizeof(ProfSection));
+    profSections[i].name = name;
+    profSectionCount++;
+  }
+  portEXIT_CRITICAL(&profMux);
+  return i < PROF_MAX_SECTIONS ? i : PROF_MAX_SECTIONS - 1;
+}
+
+void profRecord(uint8_t id, uint32_t cycles, const char *site) {
+  uint32_t us = cycles / ESP.getCpuFreqMHz();
+  uint8_t k = us ? 32 - __builtin_clz(us) : 0;
+  if (k >= PROF_BUCKETS) k = PROF_BUCKETS - 1;
+  portENTER_CRITICAL(&profMux);
+  ProfSection &s = profSections[id];
+  s.count++;
+  s.hist[k]++;
+  if (us > s.maxUs) { s.maxUs = us; s.maxSite = site; s.maxAtMs = millis(); }
+  portEXIT_CRITICAL(&profMux);
+}
+
+void profReset() {
+  portENTER_CRITICAL(&profMux);
+  for (uint8_t i = 0; i < profSectionCount; i++) {
+    const char *name = profSections[i].name;
+    memset(&profSections[i], 0, sizeof(ProfSection));
+    profSections[i].name = name;
+  }
+  portEXIT_CRITICAL(&profMux);
+}
+
+static const ProfSection *profWorst() {
+  const ProfSection *w = NULL;
+  for (uint8_t i = 0; i < profSectionCount; i++)
+    if (!w || profSections[i].maxUs > w->maxUs) w = &profSections[i];
+  return w;
+}
+
+// Copy under the lock so a report is consistent; printing happens outside it.
+static uint8_t profCopy(ProfSection *out) {
+  portENTER_CRITICAL(&profMux);
+  uint8_t n = profSectionCount;
+  memcpy(out, profSections, n * sizeof(ProfSection));
+  portEXIT_CRITICAL(&profMux);
+  return n;
+}
+
+void profPrint(Print &out) {
+  static ProfSection snap[PROF_MAX_SECTIONS];
+  uint8_t n = profCopy(snap);
+  out.println("[prof] section        count     max_us  site / log2 histogram");
+  for (uint8_t i = 0; i < n; i++) {
+    const ProfSection &s = snap[i];
+    out.printf("[prof] %-14s %8lu %10lu  %s\n[prof]   ", s.name, (unsigned long)s.count,
+               (unsigned long)s.maxUs, s.maxSite ? s.maxSite : "-");
+    for (uint8_t k = 0; k < PROF_BUCKETS; k++) out.printf("%lu ", (unsigned long)s.hist[k]);
+    out.println();
+  }
+  const ProfSection *w = profWorst();
+  if (w && w->maxUs)
+    out.printf("[prof] worst: %s %lu us at %s (t=%lu ms)\n", w->name, (unsigned long)w->maxUs,
+               w->maxSite, (unsigned long)w->maxAtMs);
+}
+
+size_t profWriteJson(char *out, size_t cap) {
+  static ProfSection snap[PROF_MAX_SECTIONS];
+  uint8_t n = profCopy(snap);
+  size_t len = 0;
+  #define PROF_PUT(...) do { \
+    int r = snprintf(out + len, len < cap ? cap - len : 0, __VA_ARGS__); \
+    if (r > 0) len += r; } while (0)
+  PROF_PUT("{\"bucket\":\"log2_us\",\"sections\":[");
+  const ProfSection *w = NULL;
+  for (uint8_t i = 0; i < n; i++) {
+    const ProfSection &s = snap[i];
+    if (!w || s.maxUs > w->maxUs) w = &s;
+    PROF_PUT("%s{\"name\":\"%s\",\"count\":%lu,\"max_us\":%lu,\"max_site\":\"%s\",\"max_at_ms\":%lu,\"hist\":[",
+             i ? "," : "", s.name, (unsigned long)s.count, (unsigned long)s.maxUs,
+             s.maxSite ? s.maxSite : "", (unsigned long)s.maxAtMs);
+    for (uint8_t k = 0; k < PROF_BUCKETS; k++) PROF_PUT("%s%lu", k ? "," : "", (unsigned long)s.hist[k]);
+    PROF_PUT("]}");
+  }
+  PROF_PUT("]");
+  if (w) PROF_PUT(",\"worst\":{\"name\":\"%s\",\"max_us\":%lu,\"site\":\"%s\"}", w->name,
+                  (unsigned long)w->maxUs, w->maxSite ? w->maxSite : "");
+  PROF_PUT("}");
+  #undef PROF_PUT
+  if (len >= cap && cap) out[cap - 1] = 0;  // truncated, still NUL-terminated
+  return len < cap ? len : cap;
+}
+
+/* Compact little-endian form for a BLE read (fits a 512-byte attribute):
+   [ver][n] then per section: [nameLen][name][count u32][maxUs u32]
+   [first bucket][bucket count][u16 saturated counts...], trailing zero
+   buckets dropped. Sections that do not fit are left out. */
+size_t profPack(uint8_t *out, size_t cap) {
+  static ProfSection snap[PROF_MAX_SECTIONS];
+  uint8_t n = profCopy(snap);
+  if (cap < 2) return 0;
+  size_t len = 2;
+  out[0] = PROF_PACK_VERSION; out[1] = 0;
+  for (uint8_t i = 0; i < n; i++) {
+    const ProfSection &s = snap[i];
+    uint8_t first = 0, last = PROF_BUCKETS;
+    while (first < PROF_BUCKETS && !s.hist[first]) first++;
+    while (last > first && !s.hist[last - 1]) last--;
+    uint8_t nameLen = strlen(s.name);
+    size_t need = 1 + nameLen + 8 + 2 + 2 * (last - first);
+    if (len + need > cap) break;
+    out[len++] = nameLen;
+    memcpy(out + len, s.name, nameLen); len += nameLen;
+    memcpy(out + len, &s.count, 4); len += 4;
+    memcpy(out + len, &s.maxUs, 4); len += 4;
+    out[len++] = first;
+    out[len++] = last - first;
+    for (uint8_t k = first; k < last; k++) {
+      uint16_t c = s.hist[k] > 0xFFFF ? 0xFFFF : s.hist[k];
+      memcpy(out + len, &c, 2); len += 2;
+    }
+    out[1]++;
+  }
+  return len;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+  BoatProf - loop/task latency probes
+
+  Each PROF_SCOPE("name") times the rest of its block with ESP.getCycleCount()
+  and adds the result to a per-name log2 histogram (bucket k holds
+  [2^(k-1), 2^k) us, bucket 0 is < 1 us). Every section also keeps its worst
+  sample and the file:line that produced it, so one name can be used from
+  several call sites (e.g. "radio.tx" for relays and reports) and the report
+  still says which one stalled.
+
+  Read out with profPrint() (serial), profWriteJson() (/metrics) or
+  profPack() (BLE). Build with -D BOAT_PROF=0 and every probe compiles away.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef BOAT_PROF
+#define BOAT_PROF 1
+#endif
+
+const uint8_t PROF_BUCKETS = 20;       // last bucket is >= 2^18 us (~262 ms)
+const uint8_t PROF_MAX_SECTIONS = 16;
+const uint8_t PROF_PACK_VERSION = 1;
+
+struct ProfSection {
+  const char *name;
+  uint32_t count;
+  uint32_t maxUs;
+  const char *maxSite;   // file:line of the worst sample
+  uint32_t maxAtMs;      // millis() when it happened
+  uint32_t hist[PROF_BUCKETS];
+};
+
+#if BOAT_PROF
+
+uint8_t profRegister(const char *name);
+void profRecord(uint8_t id, uint32_t cycles, const char *site);
+void profReset();
+void profPrint(Print &out);
+size_t profWriteJson(char *out, size_t cap);
+size_t profPack(uint8_t *out, size_t cap);
+
+class ProfScope {
+public:
+  ProfScope(uint8_t id, const char *site) : id_(id), site_(site), t0_(ESP.getCycleCount()) {}
+  ~ProfScope() { profRecord(id_, ESP.getCycleCount() - t0_, site_); }
+private:
+  uint8_t id_;
+  const char *site_;
+  uint32_t t0_;
+};
+
+#define PROF_CAT2(a, b) a##b
+#define PROF_CAT(a, b) PROF_CAT2(a, b)
+#define PROF_STR2(x) #x
+#define PROF_STR(x) PROF_STR2(x)
+#define PROF_SCOPE(name) \
+  static const uint8_t PROF_CAT(profId_, __LINE__) = profRegister(name); \
+  ProfScope PROF_CAT(profScope_, __LINE__)(PROF_CAT(profId_, __LINE__), __FILE__ ":" PROF_STR(__LINE__))
+
+#else
+
+inline void profReset() {}
+inline void profPrint(Print &) {}
+inline size_t profWriteJson(char *out, size_t cap) { return cap ? (out[0] = 0) : 0; }
+inline size_t profPack(uint8_t *, size_t) { return 0; }
+#define PROF_SCOPE(name) do {} while (0)
+
+#endif
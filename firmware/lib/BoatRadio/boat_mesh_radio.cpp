@@ -0,0 +1,45 @@
+#include "boat_mesh_radio.h"
+
+void meshListen(MeshRadio &m) {
+  m.rxFlag = false;
+  if (!m.listen) { m.lora->sleep(); return; }  // back on with the next send
+  m.lora->startReceive();
+}
+
+bool meshInit(MeshRadio &m, void (*dio0)()) {
+  int st = m.lora->begin(MESH_FREQ_MHZ, 125.0, MESH_SF, 5, MESH_SYNC_WORD, MESH_TX_DBM);
+  m.lora->setCRC(true);
+  m.lora->setDio0Action(dio0, RISING);
+  meshListen(m);
+  return st == RADIOLIB_ERR_NONE;
+}
+
+// LMIC reprograms the shared SX1276 for every uplink and RX window
+void meshRetune(MeshRadio &m) {
+  m.lora->setFrequency(MESH_FREQ_MHZ);
+  m.lora->setBandwidth(125.0);
+  m.lora->setSpreadingFactor(MESH_SF);
+  m.lora->setCodingRate(5);
+  m.lora->setSyncWord(MESH_SYNC_WORD);
+  m.lora->setOutputPower(MESH_TX_DBM);
+  m.lora->setCRC(true);
+  meshListen(m);
+}
+
+int meshTransmit(MeshRadio &m, const uint8_t *buf, size_t len) {
+  int st = m.lora->transmit((uint8_t *)buf, len);
+  meshListen(m);
+  return st;
+}
+
+bool meshSend(MeshRadio &m, const Pkt &p) {
+  return meshTransmit(m, (const uint8_t *)&p, sizeof(Pkt)) == RADIOLIB_ERR_NONE;
+}
+
+size_t meshReceive(MeshRadio &m, uint8_t *buf, size_t cap) {
+  m.rxFlag = false;
+  size_t len = m.lora->getPacketLength();
+  bool got = len && len <= cap && m.lora->readData(buf, len) == RADIOLIB_ERR_NONE;
+  meshListen(m);
+  return got ? len : 0;
+}
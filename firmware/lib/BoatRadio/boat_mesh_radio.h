@@ -0,0 +1,40 @@
+/*
+  BoatRadio - the mesh channel on the SX1276, through RadioLib
+
+  BoatNode v2 shares its one SX1276 between the mesh (RadioLib) and
+  LoRaWAN (LMIC). meshInit() sets the chip up for the mesh channel, and
+  meshRetune() puts those settings back after every LMIC transaction.
+  Between sends the receiver stays on, or the chip sleeps while
+  listen is false (EnergyTier::listen).
+
+  The owner's DIO0 handler raises rxFlag. meshReceive() reads that frame
+  and goes back to listening. Nothing here touches the RTOS, so the host
+  build links it against the RadioLib stand-in in host/shim/radiolib.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <RadioLib.h>
+#include "boat_pkt.h"
+
+const float   MESH_FREQ_MHZ  = 865.2;
+const uint8_t MESH_SF        = 9;
+const int8_t  MESH_TX_DBM    = 14;
+const uint8_t MESH_SYNC_WORD = 0x34;
+
+struct MeshRadio {
+  SX1276 *lora;
+  volatile bool rxFlag;   // set by the owner's DIO0 (RxDone) handler
+  bool listen;            // receiver on between sends
+};
+
+bool meshInit(MeshRadio &m, void (*dio0)());
+void meshListen(MeshRadio &m);
+void meshRetune(MeshRadio &m);
+
+// Sends buf and goes back to listening; the RadioLib status
+int meshTransmit(MeshRadio &m, const uint8_t *buf, size_t len);
+bool meshSend(MeshRadio &m, const Pkt &p);
+
+// The frame behind rxFlag into buf[cap]; its length, 0 if it could not be read
+size_t meshReceive(MeshRadio &m, uint8_t *buf, size_t cap);
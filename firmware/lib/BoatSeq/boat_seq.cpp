@@ -0,0 +1,20 @@
+#include "boat_seq.h"
+
+bool BoatSeq::begin(const char *ns, uint16_t reserve) {
+  reserve_ = reserve ? reserve : 1;
+  ok_ = prefs_.begin(ns, false);
+  if (!ok_) return false;  // next() still counts, from 0, without persistence
+  epoch_ = prefs_.getUInt("epoch", 0) + 1;
+  prefs_.putUInt("epoch", epoch_);
+  cur_ = limit_ = prefs_.getUInt("mark", 0);  // anything below may have been sent
+  writes_ = 1;
+  return true;
+}
+
+uint32_t BoatSeq::next() {
+  if (cur_ == limit_) {
+    limit_ = cur_ + reserve_;
+    if (ok_) { prefs_.putUInt("mark", limit_); writes_++; }
+  }
+  return cur_++;
+}
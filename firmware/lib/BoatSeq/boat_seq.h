@@ -0,0 +1,37 @@
+/*
+  BoatSeq - frame sequence numbers that survive a reboot
+
+  The counter lives in NVS as a high-water mark: next() hands out numbers
+  below the stored mark and, when it runs into it, moves the mark
+  BOAT_SEQ_RESERVE further in one write. A reset skips whatever was left of
+  the reserved block (at most BOAT_SEQ_RESERVE - 1 numbers) but never reuses
+  one, and flash sees one write per BOAT_SEQ_RESERVE frames.
+
+  epoch() counts boots (one NVS write each). Over the air only the low 16
+  bits of next() fit in Pkt.seq; (epoch, seq) is there for consumers with
+  room for both, and to tell a 16-bit wrap from a reboot in logs.
+
+  Uses its own namespace, so clearing the pairing keeps the counter.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+const uint16_t BOAT_SEQ_RESERVE = 256;
+
+class BoatSeq {
+public:
+  bool begin(const char *ns = "boatseq", uint16_t reserve = BOAT_SEQ_RESERVE);
+  uint32_t next();
+  uint32_t epoch() const { return epoch_; }
+  uint32_t writes() const { return writes_; }   // NVS writes since boot
+
+private:
+  Preferences prefs_;
+  uint32_t cur_ = 0, limit_ = 0;
+  uint16_t reserve_ = BOAT_SEQ_RESERVE;
+  uint32_t epoch_ = 0;
+  uint32_t writes_ = 0;
+  bool ok_ = false;
+};
@@ -0,0 +1,99 @@
+/*
+  boatnode_sim - how the v2 flood holds up with many boats
+
+    boatnode_sim [-n boats] [-H hours] [-r runs] [-j threads] [-s seed]
+                 [-a area_km] [-p report_s] [-e pl_exponent] [-g shadow_db]
+                 [-c capture_db] [-R]
+
+  Runs r independent simulations (seeds s, s+1, ...) of n boats for H hours,
+  spread over j threads (default: all cores), and prints the merged result:
+  delivery ratio over all boat pairs and over pairs in direct range,
+  first-copy latency by hop count, airtime per node, duplicates and where
+  frames were lost. -R turns relaying off for a baseline. The model is
+  described in sim_mesh.h.
+*/
+#include "sim_mesh.h"
+#include <getopt.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+int main(int argc, char **argv) {
+  SimConfig cfg;
+  int runs = 1, threads = std::thread::hardware_concurrency();
+  for (int c; (c = getopt(argc, argv, "n:H:r:j:s:a:p:e:g:c:R")) != -1;) {
+    switch (c) {
+      case 'n': cfg.nodes = atoi(optarg); break;
+      case 'H': cfg.hours = atof(optarg); break;
+      case 'r': runs = atoi(optarg); break;
+      case 'j': threads = atoi(optarg); break;
+      case 's': cfg.seed = strtoull(optarg, NULL, 10); break;
+      case 'a': cfg.areaKm = atof(optarg); break;
+      case 'p': cfg.reportSec = atoi(optarg); break;
+      case 'e': cfg.plExp = atof(optarg); break;
+      case 'g': cfg.shadowDb = atof(optarg); break;
+      case 'c': cfg.captureDb = atof(optarg); break;
+      case 'R': cfg.relay = false; break;
+      default:
+        fprintf(stderr, "usage: %s [-n boats] [-H hours] [-r runs] [-j threads] [-s seed] [-a area_km]\n"
+                        "       [-p report_s] [-e pl_exponent] [-g shadow_db] [-c capture_db] [-R]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (cfg.nodes < 2 || cfg.hours <= 0 || runs < 1 || cfg.areaKm <= 0 || !cfg.reportSec) {
+    fprintf(stderr, "bad arguments\n");
+    return 2;
+  }
+  if (threads < 1) threads = 1;
+  if (threads > runs) threads = runs;
+
+  SimStats total;
+  std::mutex mux;
+  std::atomic<int> next(0);
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; t++) {
+    pool.emplace_back([&]() {
+      for (int r; (r = next++) < runs;) {
+        SimConfig c = cfg;
+        c.seed = cfg.seed + r;
+        SimStats st;
+        simRun(c, st);
+        std::lock_guard<std::mutex> lock(mux);
+        total.add(st);
+      }
+    });
+  }
+  for (std::thread &t : pool) t.join();
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  const SimStats &s = total;
+  auto ratio = [](uint64_t a, uint64_t b) { return b ? (double)a / b : 0.0; };
+  double nodeS = s.nodeHours * 3600;
+  printf("[sim] %u boats, %.1f h x %d runs on %d threads, %.0f km square, report %u s, relay %s\n",
+         cfg.nodes, cfg.hours, runs, threads, cfg.areaKm, cfg.reportSec, cfg.relay ? "on" : "off");
+  printf("[sim] channel SF9/125 kHz, %d dBm, sens %.0f dBm, path loss n=%.1f, shadowing %.1f dB, capture %.0f dB\n",
+         cfg.txDbm, cfg.sensDbm, cfg.plExp, cfg.shadowDb, cfg.captureDb);
+  printf("[sim] %.0f node-hours in %.2f s wall, %.0fx real time\n",
+         s.nodeHours, wall, wall > 0 ? cfg.hours * runs * 3600 / wall : 0);
+  printf("delivery   %.3f of all boat pairs, %.3f of pairs in direct range (%llu reports)\n",
+         ratio(s.delivered, s.pairs), ratio(s.deliveredInRange, s.pairsInRange), (unsigned long long)s.reports);
+  printf("latency    first copy, ms\n");
+  printf("  hops %10s %8s %8s %8s\n", "copies", "mean", "p50", "p95");
+  for (uint8_t h = 0; h < SIM_MAX_HOPS; h++) {
+    uint64_t n = s.latencyCount(h);
+    if (!n) continue;
+    printf("  %4u %10llu %8.0f %8.0f %8.0f\n", h, (unsigned long long)n, s.latencyMean(h),
+           s.latencyQuantile(h, 0.5), s.latencyQuantile(h, 0.95));
+  }
+  printf("airtime    per node %.2f%% (reports %.2f%%, relays %.2f%%), busiest node %.2f%%\n",
+         100 * (s.airReportS + s.airRelayS) / nodeS, 100 * s.airReportS / nodeS, 100 * s.airRelayS / nodeS,
+         100 * s.airMaxShare);
+  printf("duplicates %llu, %.1f per delivered report; %llu relays sent\n", (unsigned long long)s.duplicates,
+         ratio(s.duplicates, s.delivered), (unsigned long long)s.relays);
+  printf("lost       %llu collisions, %llu while sending, %llu relays dropped on a full queue\n",
+         (unsigned long long)s.collisions, (unsigned long long)s.halfDuplex, (unsigned long long)s.queueFull);
+  printf("nearby     %.1f boats cached per node at the end\n", ratio(s.cached, s.cacheNodes));
+  return 0;
+}
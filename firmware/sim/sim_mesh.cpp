@@ -0,0 +1,410 @@
+#include "sim_mesh.h"
+#include <host_lora.h>
+#include <boat_pkt.h>
+#include <boat_mesh.h>
+#include <boat_nearby.h>
+#include <deque>
+#include <queue>
+#include <random>
+
+// As in BoatNode_v2_Full.cpp
+const float    MESH_BW_KHZ       = 125.0;
+const uint8_t  MESH_SF           = 9;
+const uint8_t  MESH_CR           = 5;
+const uint8_t  MESH_TX_QUEUE_LEN = 8;
+const uint16_t REPORT_JITTER_S   = 20;
+
+const double   PL_REFRESH_S  = 10;      // positions and path loss move on this often
+const double   PL_D0_DB      = 31.2;    // free space at 1 m, 865 MHz
+const double   FLOOR_BELOW_DB = 10;     // weaker frames than sens - this do not interfere
+const double   TAIL_S        = 60;      // reports this close to the end are not scored
+const uint8_t  ORIGIN_RING   = 64;      // recent reports per boat we can score
+const int32_t  HARBOUR_LAT = 95000000, HARBOUR_LON = 763000000;  // off Kochi
+const double   M_PER_DEG   = 111320.0;
+
+typedef uint64_t SimTime;  // us since start
+
+SimStats::SimStats() {
+  for (uint8_t h = 0; h < SIM_MAX_HOPS; h++) lat[h].assign(SIM_LAT_BINS, 0);
+}
+
+void SimStats::add(const SimStats &o) {
+  nodeHours += o.nodeHours;
+  reports += o.reports; pairs += o.pairs; pairsInRange += o.pairsInRange;
+  delivered += o.delivered; deliveredInRange += o.deliveredInRange;
+  duplicates += o.duplicates; relays += o.relays; queueFull += o.queueFull;
+  collisions += o.collisions; halfDuplex += o.halfDuplex;
+  cached += o.cached; cacheNodes += o.cacheNodes;
+  airReportS += o.airReportS; airRelayS += o.airRelayS;
+  if (o.airMaxShare > airMaxShare) airMaxShare = o.airMaxShare;
+  for (uint8_t h = 0; h < SIM_MAX_HOPS; h++)
+    for (uint32_t b = 0; b < SIM_LAT_BINS; b++) lat[h][b] += o.lat[h][b];
+}
+
+uint64_t SimStats::latencyCount(uint8_t h) const {
+  uint64_t n = 0;
+  for (uint32_t v : lat[h]) n += v;
+  return n;
+}
+
+double SimStats::latencyMean(uint8_t h) const {
+  uint64_t n = 0;
+  double sum = 0;
+  for (uint32_t b = 0; b < SIM_LAT_BINS; b++) {
+    n += lat[h][b];
+    sum += (double)lat[h][b] * (b + 0.5) * SIM_LAT_BIN_MS;
+  }
+  return n ? sum / n : 0;
+}
+
+double SimStats::latencyQuantile(uint8_t h, double q) const {
+  uint64_t n = latencyCount(h), acc = 0;
+  if (!n) return 0;
+  for (uint32_t b = 0; b < SIM_LAT_BINS; b++) {
+    acc += lat[h][b];
+    if (acc >= q * n) return (b + 0.5) * SIM_LAT_BIN_MS;
+  }
+  return SIM_LAT_BINS * SIM_LAT_BIN_MS;
+}
+
+/* ------------ world ------------- */
+struct Signal {
+  uint32_t tx;
+  float mw;
+};
+
+struct QueuedTx {
+  Pkt pkt;
+  SimTime due;
+};
+
+struct Node {
+  double x, y, vx, vy;   // m, m/s
+  SimTime legEnd;
+  bool moving;
+
+  bool sending = false;
+  int32_t lock = -1;      // transmission being received, -1 none
+  float lockMw = 0;
+  bool lockBad = false;
+  std::vector<Signal> air;  // everything on air here above the floor
+  double airMw = 0;
+
+  uint16_t seq = 0;
+  SimTime nextReport = 0, wakeAt = UINT64_MAX;
+  std::deque<QueuedTx> txq;
+  NearbyCache cache;
+  double airReportS = 0, airRelayS = 0;
+};
+
+struct Transmission {
+  uint16_t node;
+  Pkt pkt;
+  std::vector<std::pair<uint16_t, float>> heard;  // receiver, mW
+};
+
+struct Origin {
+  SimTime t;
+  uint16_t seq;
+  bool scored;
+  std::vector<uint8_t> inRange;  // bitset over receivers
+};
+
+enum : uint8_t { EV_WAKE, EV_TX_END, EV_MOVE };
+
+struct Event {
+  SimTime t;
+  uint64_t order;  // FIFO among equal times, keeps runs reproducible
+  uint8_t kind;
+  uint32_t arg;
+  bool operator>(const Event &o) const { return t != o.t ? t > o.t : order > o.order; }
+};
+
+class World {
+public:
+  World(const SimConfig &cfg, SimStats &st);
+  void run();
+
+private:
+  void move(SimTime now);
+  void newLeg(Node &n, SimTime now);
+  void pathLoss();
+  void schedule(SimTime t, uint8_t kind, uint32_t arg) { events_.push({t, order_++, kind, arg}); }
+  void service(uint16_t i, SimTime now);
+  void startTx(uint16_t i, const Pkt &p, bool relay, SimTime now);
+  void endTx(uint32_t slot, SimTime now);
+  void receive(uint16_t j, const Pkt &p, SimTime now);
+
+  const SimConfig &cfg_;
+  SimStats &st_;
+  uint16_t n_;
+  SimTime end_, scoreEnd_;
+  uint32_t airUs_;
+  std::mt19937_64 rng_;
+  std::normal_distribution<float> shadow_;
+  std::uniform_real_distribution<double> uni_;
+
+  std::vector<Node> nodes_;
+  std::vector<float> pl_;                       // n x n, dB
+  std::vector<std::vector<uint16_t>> hearers_;  // who can get above the floor
+  std::vector<Transmission> txs_;
+  std::vector<uint32_t> freeTx_;
+  std::vector<Origin> origins_;                 // n x ORIGIN_RING
+  std::vector<int32_t> lastSeq_;                // receiver x source, -1 none yet
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+  uint64_t order_ = 0;
+};
+
+World::World(const SimConfig &cfg, SimStats &st)
+    : cfg_(cfg), st_(st), n_(cfg.nodes), rng_(cfg.seed), shadow_(0.0f, (float)cfg.shadowDb), uni_(0.0, 1.0) {
+  end_ = (SimTime)(cfg.hours * 3600e6);
+  scoreEnd_ = end_ > TAIL_S * 1e6 ? end_ - (SimTime)(TAIL_S * 1e6) : 0;
+  airUs_ = hostLoraTimeOnAirUs(sizeof(Pkt), MESH_SF, MESH_BW_KHZ, MESH_CR, true);
+  nodes_.resize(n_);
+  pl_.assign((size_t)n_ * n_, 0);
+  hearers_.resize(n_);
+  origins_.resize((size_t)n_ * ORIGIN_RING);
+  for (Origin &o : origins_) o.inRange.assign((n_ + 7) / 8, 0);
+  lastSeq_.assign((size_t)n_ * n_, -1);
+
+  double a = cfg.areaKm * 1000;
+  for (uint16_t i = 0; i < n_; i++) {
+    Node &n = nodes_[i];
+    n.x = uni_(rng_) * a;
+    n.y = uni_(rng_) * a;
+    n.moving = uni_(rng_) >= cfg.anchored;
+    n.vx = n.vy = 0;
+    n.legEnd = UINT64_MAX;
+    if (n.moving) newLeg(n, 0);
+    // Boots spread over one interval, like a fleet that did not leave together
+    n.nextReport = (SimTime)(uni_(rng_) * cfg.reportSec * 1e6);
+    schedule(n.nextReport, EV_WAKE, i);
+    n.wakeAt = n.nextReport;
+  }
+  pathLoss();
+  schedule((SimTime)(PL_REFRESH_S * 1e6), EV_MOVE, 0);
+}
+
+void World::newLeg(Node &n, SimTime now) {
+  double a = cfg_.areaKm * 1000;
+  double tx = uni_(rng_) * a, ty = uni_(rng_) * a;
+  double v = 0.5 + uni_(rng_) * (cfg_.maxSpeedMps - 0.5);
+  double d = hypot(tx - n.x, ty - n.y);
+  if (d < 1 || v <= 0) { n.vx = n.vy = 0; n.legEnd = now + 600000000ULL; return; }
+  n.vx = (tx - n.x) / d * v;
+  n.vy = (ty - n.y) / d * v;
+  n.legEnd = now + (SimTime)(d / v * 1e6);
+}
+
+void World::move(SimTime now) {
+  for (Node &n : nodes_) {
+    if (!n.moving) continue;
+    n.x += n.vx * PL_REFRESH_S;
+    n.y += n.vy * PL_REFRESH_S;
+    if (now >= n.legEnd) newLeg(n, now);
+  }
+  pathLoss();
+}
+
+void World::pathLoss() {
+  double floorDbm = cfg_.sensDbm - FLOOR_BELOW_DB - 3 * cfg_.shadowDb;
+  for (uint16_t i = 0; i < n_; i++) hearers_[i].clear();
+  for (uint16_t i = 0; i < n_; i++) {
+    for (uint16_t j = i + 1; j < n_; j++) {
+      double d = hypot(nodes_[i].x - nodes_[j].x, nodes_[i].y - nodes_[j].y);
+      float pl = (float)(PL_D0_DB + 10 * cfg_.plExp * log10(d < 1 ? 1 : d));
+      pl_[(size_t)i * n_ + j] = pl_[(size_t)j * n_ + i] = pl;
+      if (cfg_.txDbm - pl >= floorDbm) {
+        hearers_[i].push_back(j);
+        hearers_[j].push_back(i);
+      }
+    }
+  }
+}
+
+// The radio task's TX decisions: queued relay first once due, then the report
+void World::service(uint16_t i, SimTime now) {
+  Node &n = nodes_[i];
+  if (n.sending) return;
+  if (!n.txq.empty() && n.txq.front().due <= now) {
+    Pkt p = n.txq.front().pkt;
+    n.txq.pop_front();
+    startTx(i, p, true, now);
+    return;
+  }
+  if (n.nextReport <= now) {
+    n.nextReport = now + (SimTime)cfg_.reportSec * 1000000 + (SimTime)(uni_(rng_) * REPORT_JITTER_S * 1e6);
+    NavState s = {};
+    s.valid = true;
+    s.lat1e7 = HARBOUR_LAT + (int32_t)(n.y / M_PER_DEG * 1e7);
+    s.lon1e7 = HARBOUR_LON + (int32_t)(n.x / (M_PER_DEG * cos(HARBOUR_LAT / 1e7 * DEG_TO_RAD)) * 1e7);
+    s.spd_cms = (uint16_t)(hypot(n.vx, n.vy) * 100);
+    s.hdg_cdeg = (uint16_t)fmod(atan2(n.vx, n.vy) * RAD_TO_DEG * 100 + 36000, 36000);
+    char name[16];
+    snprintf(name, sizeof(name), "Boat %u", i + 1);
+    Pkt p;
+    pktBuild(p, i + 1, n.seq++, s, 80, i + 1, name);
+
+    Origin &o = origins_[(size_t)i * ORIGIN_RING + p.seq % ORIGIN_RING];
+    o.t = now;
+    o.seq = p.seq;
+    o.scored = now < scoreEnd_;
+    std::fill(o.inRange.begin(), o.inRange.end(), 0);
+    if (o.scored) {
+      st_.reports++;
+      st_.pairs += n_ - 1;
+      for (uint16_t j : hearers_[i]) {
+        if (cfg_.txDbm - pl_[(size_t)i * n_ + j] < cfg_.sensDbm) continue;
+        o.inRange[j >> 3] |= 1 << (j & 7);
+        st_.pairsInRange++;
+      }
+    }
+    startTx(i, p, false, now);
+    return;
+  }
+  SimTime wake = n.nextReport;
+  if (!n.txq.empty() && n.txq.front().due < wake) wake = n.txq.front().due;
+  if (wake < n.wakeAt || n.wakeAt <= now) {
+    n.wakeAt = wake;
+    schedule(wake, EV_WAKE, i);
+  }
+}
+
+void World::startTx(uint16_t i, const Pkt &p, bool relay, SimTime now) {
+  Node &n = nodes_[i];
+  n.sending = true;
+  if (n.lock >= 0) { st_.halfDuplex++; n.lock = -1; }  // transmit() ends the reception
+  (relay ? n.airRelayS : n.airReportS) += airUs_ / 1e6;
+  if (relay) st_.relays++;
+
+  uint32_t slot;
+  if (freeTx_.empty()) { slot = txs_.size(); txs_.emplace_back(); }
+  else { slot = freeTx_.back(); freeTx_.pop_back(); }
+  Transmission &tx = txs_[slot];
+  tx.node = i;
+  tx.pkt = p;
+  tx.heard.clear();
+
+  double floorDbm = cfg_.sensDbm - FLOOR_BELOW_DB;
+  for (uint16_t j : hearers_[i]) {
+    double rssi = cfg_.txDbm - pl_[(size_t)i * n_ + j] + shadow_(rng_);
+    if (rssi < floorDbm) continue;
+    float mw = (float)pow(10.0, rssi / 10);
+    Node &r = nodes_[j];
+    bool decodable = rssi >= cfg_.sensDbm;
+    if (r.sending) {
+      if (decodable) st_.halfDuplex++;
+    } else if (r.lock < 0) {
+      if (decodable && (r.airMw <= 0 || rssi - 10 * log10(r.airMw) >= cfg_.captureDb)) {
+        r.lock = slot;
+        r.lockMw = mw;
+        r.lockBad = false;
+      } else if (decodable) {
+        st_.collisions++;
+      }
+    } else {  // busy with another frame; this one is lost, and may take that one along
+      if (decodable) st_.collisions++;
+      if (!r.lockBad && 10 * log10(r.lockMw / (r.airMw - r.lockMw + mw)) < cfg_.captureDb) r.lockBad = true;
+    }
+    r.air.push_back({slot, mw});
+    r.airMw += mw;
+    tx.heard.push_back({j, mw});
+  }
+  schedule(now + airUs_, EV_TX_END, slot);
+}
+
+void World::endTx(uint32_t slot, SimTime now) {
+  Transmission &tx = txs_[slot];
+  uint16_t i = tx.node;
+  Pkt p = tx.pkt;
+  std::vector<uint16_t> got;
+  for (auto &h : tx.heard) {
+    Node &r = nodes_[h.first];
+    for (size_t k = 0; k < r.air.size(); k++)
+      if (r.air[k].tx == slot) { r.air[k] = r.air.back(); r.air.pop_back(); break; }
+    r.airMw = r.air.empty() ? 0 : r.airMw - h.second;
+    if (r.lock != (int32_t)slot) continue;
+    r.lock = -1;
+    if (r.lockBad) st_.collisions++;
+    else got.push_back(h.first);
+  }
+  freeTx_.push_back(slot);
+  nodes_[i].sending = false;
+  for (uint16_t j : got) receive(j, p, now);
+  service(i, now);
+}
+
+// The radio task's RX path, down to the frame it hands to the http task
+void World::receive(uint16_t j, const Pkt &frame, SimTime now) {
+  Node &r = nodes_[j];
+  uint32_t nowMs = now / 1000;
+  if (meshClassify((const uint8_t *)&frame, sizeof(frame)) == MESH_FRAME_PKT) {
+    Pkt in = frame;
+    uint16_t src = in.src - 1;
+    int32_t &last = lastSeq_[(size_t)j * n_ + src];
+    if (src == j) {
+      // Our own report relayed back: not a delivery (pairs counts n-1 receivers)
+    } else if (last < 0 || (int16_t)(in.seq - last) > 0) {
+      last = in.seq;
+      const Origin &o = origins_[(size_t)src * ORIGIN_RING + in.seq % ORIGIN_RING];
+      if (o.seq == in.seq && o.scored) {
+        st_.delivered++;
+        if (o.inRange[j >> 3] & (1 << (j & 7))) st_.deliveredInRange++;
+        uint32_t bin = (uint32_t)((now - o.t) / 1000 / SIM_LAT_BIN_MS);
+        st_.lat[in.hops < SIM_MAX_HOPS ? in.hops : SIM_MAX_HOPS - 1][bin < SIM_LAT_BINS ? bin : SIM_LAT_BINS - 1]++;
+      }
+    } else {
+      st_.duplicates++;
+    }
+    r.cache.update(in, nowMs);
+
+    Pkt fwd;
+    if (cfg_.relay && meshRelay(in, fwd)) {
+      if (r.txq.size() >= MESH_TX_QUEUE_LEN) {
+        st_.queueFull++;
+      } else {
+        uint32_t jitterMs = MESH_RELAY_MIN_MS + (uint32_t)(uni_(rng_) * (MESH_RELAY_MAX_MS - MESH_RELAY_MIN_MS));
+        r.txq.push_back({fwd, now + jitterMs * 1000ULL});
+      }
+    }
+  }
+  service(j, now);
+}
+
+void World::run() {
+  while (!events_.empty()) {
+    Event e = events_.top();
+    if (e.t > end_) break;
+    events_.pop();
+    switch (e.kind) {
+      case EV_WAKE:
+        if (nodes_[e.arg].wakeAt != e.t) break;  // superseded by an earlier wake
+        nodes_[e.arg].wakeAt = UINT64_MAX;
+        service(e.arg, e.t);
+        break;
+      case EV_TX_END:
+        endTx(e.arg, e.t);
+        break;
+      case EV_MOVE:
+        move(e.t);
+        schedule(e.t + (SimTime)(PL_REFRESH_S * 1e6), EV_MOVE, 0);
+        break;
+    }
+  }
+
+  double secs = end_ / 1e6;
+  st_.nodeHours += n_ * cfg_.hours;
+  for (Node &n : nodes_) {
+    st_.airReportS += n.airReportS;
+    st_.airRelayS += n.airRelayS;
+    double share = (n.airReportS + n.airRelayS) / secs;
+    if (share > st_.airMaxShare) st_.airMaxShare = share;
+    st_.cached += n.cache.boats().size();
+    st_.cacheNodes++;
+  }
+}
+
+void simRun(const SimConfig &cfg, SimStats &out) {
+  World w(cfg, out);
+  w.run();
+}
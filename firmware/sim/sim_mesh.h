@@ -0,0 +1,78 @@
+/*
+  SimMesh - one discrete-event run of the BoatNode v2 mesh
+
+  Every node runs the radio task's mesh path with the firmware's own code:
+  pktBuild() for reports, meshClassify() / meshRelay() (boat_mesh.h) for
+  what comes in, a MESH_TX_QUEUE_LEN FIFO whose head is sent once its
+  relay jitter is due, and a NearbyCache fed with every good frame. Reports
+  go out every reportSec plus 0..REPORT_JITTER_S like nextSendAtMs. The
+  radio is half duplex and blocking, as lora.transmit() is: a node hears
+  nothing while it sends and an ongoing reception is lost.
+
+  The channel is SF9 / 125 kHz / CR 4/5 on one frequency:
+    - log-distance path loss from 1 m, exponent and per-frame log-normal
+      shadowing configurable, refreshed every PL_REFRESH_S of movement
+    - a receiver locks onto a frame that starts above the sensitivity while
+      it is listening and not already locked
+    - it keeps it if the frame stays captureDb above the sum of everything
+      else on air at that receiver; otherwise it is a collision
+  Boats move by random waypoint inside the area; some are anchored.
+
+  No LoRaWAN and no energy tiers: every node listens and relays, which is
+  the "normal" tier without a gateway in reach.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <vector>
+
+struct SimConfig {
+  uint16_t nodes = 200;
+  double hours = 1;
+  uint64_t seed = 1;
+  double areaKm = 20;
+  double anchored = 0.3;      // share of boats that do not move
+  double maxSpeedMps = 4;
+  uint16_t reportSec = 120;   // the "normal" tier
+  bool relay = true;
+  int8_t txDbm = 14;          // MESH_TX_DBM
+  double sensDbm = -129;      // SX1276, SF9 / 125 kHz
+  double plExp = 2.8;         // log-distance exponent; 2 is free space
+  double shadowDb = 4;        // per-frame log-normal shadowing, sigma
+  double captureDb = 6;
+};
+
+const uint8_t SIM_MAX_HOPS = 5;         // hops field 0..MESH_MAX_HOPS
+const uint32_t SIM_LAT_BIN_MS = 10;
+const uint32_t SIM_LAT_BINS = 6000;     // up to 60 s, the last bin takes the rest
+
+// Counters of one or more runs; add() merges runs from other threads
+struct SimStats {
+  double nodeHours = 0;
+  uint64_t reports = 0;           // own reports sent
+  uint64_t pairs = 0;             // reports x other boats
+  uint64_t pairsInRange = 0;      // ... of them in direct range when sent
+  uint64_t delivered = 0;         // first copy of a report at a boat
+  uint64_t deliveredInRange = 0;
+  uint64_t duplicates = 0;        // further copies
+  uint64_t relays = 0;            // relayed frames sent
+  uint64_t queueFull = 0;         // relays dropped, MESH_TX_QUEUE_LEN
+  uint64_t collisions = 0;        // locked frames lost to interference
+  uint64_t halfDuplex = 0;        // frames missed while sending
+  uint64_t cached = 0;            // boats in NearbyCache at the end, summed over nodes
+  uint64_t cacheNodes = 0;
+  double airReportS = 0, airRelayS = 0;  // summed over nodes
+  double airMaxShare = 0;                // busiest node, share of its time
+  std::vector<uint32_t> lat[SIM_MAX_HOPS];  // first-copy latency histograms by hops
+
+  SimStats();
+  void add(const SimStats &o);
+  // q-quantile in ms of the latency histogram for hops h
+  double latencyQuantile(uint8_t h, double q) const;
+  double latencyMean(uint8_t h) const;
+  uint64_t latencyCount(uint8_t h) const;
+};
+
+// Runs cfg from start to end on the calling thread
+void simRun(const SimConfig &cfg, SimStats &out);
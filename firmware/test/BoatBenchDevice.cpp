@@ -0,0 +1,42 @@
+/**
+ * =================================================================================
+ * NEDUVAAI BOAT NODE - ON-DEVICE MICROBENCHMARKS (ESP32)
+ * =================================================================================
+ * Runs the BoatBench cases (lib/BoatBench) on the board and prints the same
+ * JSON report boatnode_bench writes on a PC, with "cycles" taken from
+ * ESP.getCycleCount(). No radio or GPS needs to be attached.
+ *
+ * Flash it in place of the node sketch, open the monitor at 115200 and save
+ * everything between the braces, e.g. as bench-<version>.json. Send a case
+ * prefix (e.g. "nearby/") followed by Enter to run only those cases again.
+ * Build with -DBOAT_FW_VERSION=\"...\" to stamp the report.
+ * =================================================================================
+ */
+
+#include <Arduino.h>
+#include <boat_bench.h>
+
+const uint32_t BENCH_MIN_MS = 200;
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  benchRunJson(Serial, BENCH_MIN_MS);
+}
+
+void loop() {
+  static char filter[32];
+  static size_t n = 0;
+  while (Serial.available()) {
+    char c = Serial.read();
+    if (c == '\r') continue;
+    if (c != '\n') {
+      if (n < sizeof(filter) - 1) filter[n++] = c;
+      continue;
+    }
+    filter[n] = 0;
+    benchRunJson(Serial, BENCH_MIN_MS, n ? filter : NULL);
+    n = 0;
+  }
+  delay(10);
+}
@@ -18,25 +18,36 @@
 #include <hal/hal.h>
 #include <lmic.h>
 
+#include <boat_ble_cmd.h>
+#include <boat_ble_status.h>
+#include <boat_oled.h>
+#include <boat_seq.h>
+
 // --- Configuration ---
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 #define OLED_RESET -1
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET, 400000UL,
+                         400000UL);
+OledDiff oled; // Pushes only the changed part of each frame
 
 TinyGPSPlus gps;
 HardwareSerial gpsSerial(1); // UART 1 for GPS
 
 // BLE UUIDs (Must match Flutter App)
 #define SERVICE_UUID "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
-#define CHAR_DATA_UUID "beb5483e-36e1-4688-b7f5-ea07361b26a8" // Read/Notify
+#define CHAR_DATA_UUID "beb5483e-36e1-4688-b7f5-ea07361b26a8" // Read/Notify, binary (boat_ble_status.h)
 #define CHAR_CMD_UUID "8246d623-6447-4ec6-8c46-d2432924151a"  // Write
+#define CHAR_RESP_UUID "e6f0c3a9-2b7d-4c51-9a8e-0d4b7f1c25e6" // Notify, boat_ble_cmd.h responses
 
 BLEServer *pServer = NULL;
 BLECharacteristic *pDataChar = NULL;
 BLECharacteristic *pCmdChar = NULL;
+BLECharacteristic *pRespChar = NULL;
 bool deviceConnected = false;
 bool oldDeviceConnected = false;
+volatile uint16_t bleConnId = 0;
+BleStatusBatch statusBatch;
 
 // Global State
 String boatId = "1001";
@@ -44,7 +55,9 @@ String boatName = "Boat-Init";
 String userId = "0";
 float batteryLevel = 95.5; // Mock
 String loraStatus = "Init";
+uint8_t loraState = BLE_LORA_IDLE;
 int meshHops = 0;
+bool journeyActive = false;
 
 // Config Persistence (Mock for now)
 void saveConfig(String bid, String uid, String name) {
@@ -93,7 +106,7 @@ void updateDashboard(String status) {
   display.setCursor(0, 54);
   display.print(status.substring(0, 20)); // Truncate
 
-  display.display();
+  oled.push();
 }
 
 // --- LoRa / LMIC Constants & Globals ---
@@ -117,7 +130,7 @@ struct __attribute__((packed)) Pkt {
 };
 
 Pkt myPacket;
-uint16_t globalSeq = 0;
+BoatSeq seq;
 static osjob_t sendjob;
 
 // Pin Mapping
@@ -169,7 +182,7 @@ void os_getDevKey(u1_t *buf) { stringToBytes(appKey_str, buf, 16, false); }
 
 void preparePacket() {
   myPacket.src = (uint16_t)boatId.toInt();
-  myPacket.seq = globalSeq++;
+  myPacket.seq = (uint16_t)seq.next();
 
   if (gps.location.isValid()) {
     myPacket.lat1e7 = (int32_t)(gps.location.lat() * 10000000.0);
@@ -196,15 +209,18 @@ void onEvent(ev_t ev) {
   switch (ev) {
   case EV_JOINING:
     loraStatus = "LoRa Joining...";
+    loraState = BLE_LORA_JOINING;
     updateDashboard(loraStatus);
     break;
   case EV_JOINED:
     loraStatus = "LoRa Joined";
+    loraState = BLE_LORA_JOINED;
     updateDashboard(loraStatus);
     LMIC_setLinkCheckMode(0);
     break;
   case EV_TXCOMPLETE:
     loraStatus = "LoRa Sent (Sleep 30s)";
+    loraState = BLE_LORA_SENT;
     updateDashboard(loraStatus);
 
     // Schedule next packet in 30 seconds
@@ -217,6 +233,7 @@ void onEvent(ev_t ev) {
     break;
   case EV_JOIN_FAILED:
     loraStatus = "LoRa Join Fail";
+    loraState = BLE_LORA_JOIN_FAIL;
     updateDashboard(loraStatus);
     break;
   default:
@@ -232,6 +249,10 @@ class MyServerCallbacks : public BLEServerCallbacks {
     updateDashboard("BLE Connected");
   };
 
+  void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param) {
+    bleConnId = param->connect.conn_id;
+  }
+
   void onDisconnect(BLEServer *pServer) {
     deviceConnected = false;
     Serial.println("BLE Disconnected");
@@ -239,8 +260,66 @@ class MyServerCallbacks : public BLEServerCallbacks {
   }
 };
 
+// Binary commands (boat_ble_cmd.h). This test build has no SOS, tuning or
+// track store, so those answer BLE_CMD_ERR_UNSUPPORTED.
+void handleBinCmd(const uint8_t *f, size_t n) {
+  uint8_t out[BLE_STATUS_MTU];
+  BleCmdResp resp;
+  resp.begin(out, sizeof(out), n > 1 ? f[1] : 0);
+  uint8_t st = bleCmdCheck(f, n);
+
+  BleTlv t;
+  BleTlvReader check(f + 2, st == BLE_CMD_OK ? n - 2 : 0);
+  while (st == BLE_CMD_OK && check.next(t)) {
+    if (t.type == BC_SOS || t.type == BC_TUNE ||
+        (t.type == BC_QUERY && t.v[0] != BQ_CONFIG && t.v[0] != BQ_STATE))
+      st = BLE_CMD_ERR_UNSUPPORTED;
+  }
+
+  if (st == BLE_CMD_OK) {
+    String bid = boatId, uid = userId, name = boatName;
+    bool cfg = false;
+    BleTlvReader rd(f + 2, n - 2);
+    while (rd.next(t)) {
+      if (t.type == BC_BOAT_ID || t.type == BC_NAME) {
+        char buf[16];
+        memcpy(buf, t.v, t.len);
+        buf[t.len] = 0;
+        (t.type == BC_BOAT_ID ? bid : name) = buf;
+        cfg = true;
+      } else if (t.type == BC_USER_ID) {
+        uid = String((unsigned long)bleGetU32(t.v));
+        cfg = true;
+      } else if (t.type == BC_JOURNEY) {
+        journeyActive = t.v[0];
+      } else if (t.type == BC_QUERY && t.v[0] == BQ_CONFIG) {
+        resp.putStr(BC_BOAT_ID, boatId.c_str());
+        resp.putU32(BC_USER_ID, userId.toInt());
+        resp.putStr(BC_NAME, boatName.c_str());
+      } else if (t.type == BC_QUERY) {
+        resp.putU8(BC_JOURNEY, journeyActive);
+      }
+    }
+    if (cfg) {
+      saveConfig(bid, uid, name);
+      updateDashboard("Paired: " + name);
+    }
+  }
+
+  resp.status(st);
+  pRespChar->setValue(out, resp.len());
+  pRespChar->notify();
+}
+
 class MyCallbacks : public BLECharacteristicCallbacks {
   void onWrite(BLECharacteristic *pCharacteristic) {
+    if (pCharacteristic->getLength() > 0 &&
+        pCharacteristic->getData()[0] == BLE_CMD_MAGIC) {
+      handleBinCmd(pCharacteristic->getData(), pCharacteristic->getLength());
+      return;
+    }
+
+    // Legacy text commands
     std::string value = pCharacteristic->getValue();
     if (value.length() > 0) {
       String msg = String(value.c_str());
@@ -261,9 +340,11 @@ class MyCallbacks : public BLECharacteristicCallbacks {
           updateDashboard("Paired: " + newName);
         }
       } else if (msg == "START_JOURNEY") {
+        journeyActive = true;
         Serial.println("Journey Started via BLE");
         // Force immediate packet logic or status update if needed
       } else if (msg == "END_JOURNEY") {
+        journeyActive = false;
         Serial.println("Journey Ended via BLE");
       }
     }
@@ -278,15 +359,18 @@ void setup() {
     Serial.println(F("OLED Allocation Failed"));
   }
   display.display();
+  oled.begin(Wire, 0x3C, display.getBuffer());
   delay(1000);
   display.clearDisplay();
   updateDashboard("Booting...");
 
   // 2. GPS Init
   gpsSerial.begin(9600, SERIAL_8N1, 16, 17);
+  seq.begin();
 
   // 3. BLE Init
   BLEDevice::init("BoatNode-BLE");
+  BLEDevice::setMTU(BLE_STATUS_MTU);
   pServer = BLEDevice::createServer();
   pServer->setCallbacks(new MyServerCallbacks());
 
@@ -303,6 +387,11 @@ void setup() {
                                             BLECharacteristic::PROPERTY_WRITE);
   pCmdChar->setCallbacks(new MyCallbacks());
 
+  // Resp Char (Notify)
+  pRespChar = pService->createCharacteristic(CHAR_RESP_UUID,
+                                             BLECharacteristic::PROPERTY_NOTIFY);
+  pRespChar->addDescriptor(new BLE2902());
+
   pService->start();
 
   // Advertising
@@ -332,18 +421,31 @@ void loop() {
     gps.encode(gpsSerial.read());
   }
 
-  // Notify BLE Client periodically
+  // Notify BLE Client on change (binary status, batched per MTU)
   if (deviceConnected) {
-    static uint32_t lastNotify = 0;
-    if (millis() - lastNotify > 1000) {
-      String data = "SAT:" + String(gps.satellites.value()) +
-                    ",LAT:" + String(gps.location.lat(), 6) +
-                    ",LON:" + String(gps.location.lng(), 6) +
-                    ",BAT:" + String((int)batteryLevel) + ",LORA:" + loraStatus;
-
-      pDataChar->setValue(data.c_str());
-      pDataChar->notify();
-      lastNotify = millis();
+    static uint32_t lastSample = 0;
+    if (gps.location.isUpdated() || millis() - lastSample > 250) {
+      BleStatusRec r;
+      r.age_ds = 0;
+      r.lat1e7 = gps.location.isValid() ? (int32_t)lround(gps.location.lat() * 1e7) : 0;
+      r.lon1e7 = gps.location.isValid() ? (int32_t)lround(gps.location.lng() * 1e7) : 0;
+      r.spd_cms = gps.speed.isValid() ? (uint16_t)(gps.speed.mps() * 100) : 0;
+      r.hdg_cdeg = gps.course.isValid() ? (uint16_t)gps.course.value() : 0;
+      r.sats = gps.satellites.value();
+      r.batt_pc = (uint8_t)batteryLevel;
+      r.flags = (gps.location.isValid() ? BLE_ST_FIX : 0) |
+                (journeyActive ? BLE_ST_JOURNEY : 0) |
+                ((loraState << BLE_ST_LORA_SHIFT) & BLE_ST_LORA_MASK);
+      statusBatch.setMtu(pServer->getPeerMTU(bleConnId));
+      statusBatch.offer(r, millis());
+
+      uint8_t frame[BLE_STATUS_MTU];
+      size_t n = statusBatch.take(frame, sizeof(frame), millis());
+      if (n) {
+        pDataChar->setValue(frame, n);
+        pDataChar->notify();
+      }
+      lastSample = millis();
     }
   }
 
@@ -357,6 +459,7 @@ void loop() {
   }
 
   if (deviceConnected && !oldDeviceConnected) {
+    statusBatch.reset();
     oldDeviceConnected = deviceConnected;
   }
 
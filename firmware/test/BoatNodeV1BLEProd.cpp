@@ -12,6 +12,18 @@
 
 * - Fixed: Added Mutex (prevents BLE vs LoRa crashes)
 
+* - Changed: Mutex replaced by a single-writer seqlock (readers never block the LoRa job)
+
+* - Changed: BLE status is a binary record (boat_ble_status.h), batched and sent on change
+
+* - Added: Journey track log in LittleFS, bulk download over CHAR_TRACK_UUID (boat_ble_track.h)
+
+* - Added: Binary TLV commands with request ids, answered on CHAR_RESP_UUID (boat_ble_cmd.h)
+
+* - Changed: OLED drawn by its own task on core 0, only changed pages pushed at 400 kHz (boat_oled.h)
+
+* - Added: LoRaWAN session kept in RTC/NVS, reboots resume without an OTAA join (boat_lmic_session.h)
+
 * ---------------------------------------------------------------------------------
 
 * * HARDWARE PINOUT MAPPING
@@ -90,14 +102,33 @@
 
 #include <BLEUtils.h>
 
+#include <LittleFS.h>
+
 #include <SPI.h>
 
 #include <TinyGPS++.h>
 
 #include <Wire.h>
+#include <atomic>
 #include <lmic.h>
 #include <hal/hal.h>
 
+#include <boat_ble_cmd.h>
+
+#include <boat_ble_status.h>
+
+#include <boat_ble_track.h>
+
+#include <boat_json.h>
+
+#include <boat_lmic_session.h>
+
+#include <boat_oled.h>
+
+#include <boat_prof.h>
+
+#include <boat_seq.h>
+
 // --- HARDWARE CONFIG ---
 
 // Verify these pins for your specific wiring!
@@ -120,7 +151,9 @@ const lmic_pinmap lmic_pins = {
 
 #define SCREEN_HEIGHT 64
 
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
+Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1, 400000UL, 400000UL); // Fast mode, OLED is alone on the bus
+
+OledDiff oled;
 
 TinyGPSPlus gps;
 
@@ -134,19 +167,38 @@ HardwareSerial gpsSerial(1); // UART 1
 
 #define CHAR_CMD_UUID "8246d623-6447-4ec6-8c46-d2432924151a"
 
+#define CHAR_METRICS_UUID "5d1b0c7a-8e4f-4a3b-9c2d-6f1e0a9b3c71" // read: profPack() v1 record
+
+#define CHAR_TRACK_UUID "a3c87b52-5f1d-4e8e-b0a4-2d6c9e71f0b3" // write + notify: boat_ble_track.h
+
+#define CHAR_RESP_UUID "e6f0c3a9-2b7d-4c51-9a8e-0d4b7f1c25e6" // notify: boat_ble_cmd.h responses
+
 BLEServer *pServer = NULL;
 
 BLECharacteristic *pDataChar = NULL;
 
 BLECharacteristic *pCmdChar = NULL;
 
+BLECharacteristic *pMetricsChar = NULL;
+
+BLECharacteristic *pTrackChar = NULL;
+
+BLECharacteristic *pRespChar = NULL;
+
 bool deviceConnected = false;
 
+volatile uint16_t bleConnId = 0; // For the negotiated MTU
+
+BleStatusBatch statusBatch;
+
 bool oldDeviceConnected = false;
 
-// --- SHARED DATA (Protected by Mutex) ---
+// --- SHARED DATA (Single-writer seqlock) ---
 
-SemaphoreHandle_t dataMutex; // The Guard
+// Only the loop task (LMIC job + callbacks, command queue) writes BoatState.
+// It edits its private copy `state` and publish() copies it into the seqlock
+// slot; any task takes a consistent copy with snapshot() and never blocks the
+// writer. BLE callbacks do not write, they post to cmdQueue.
 
 struct BoatState
 {
@@ -161,11 +213,113 @@ struct BoatState
 
   char loraStatus[20] = "Init";
 
+  uint8_t loraState = BLE_LORA_IDLE; // Same thing as a BleLoraState for the binary status
+
   bool configChanged = false;
 
   bool journeyActive = false; // Privacy: Only track when true
 
-} state;
+  bool sos = false; // Overrides journey privacy, sends on SOS_PORT every BT_SOS_INTERVAL_S
+
+  // BleTune values, settable over BC_TUNE within TUNE_MIN..TUNE_MAX
+
+  uint32_t tune[BT_COUNT] = {
+
+      30,   // BT_TX_INTERVAL_S
+
+      10,   // BT_SOS_INTERVAL_S
+
+      5,    // BT_TRACK_INTERVAL_S
+
+      250,  // BT_STATUS_SAMPLE_MS, the batch drops unchanged samples
+  };
+
+} state; // Writer's copy, loop task only
+
+struct StateSeqlock
+{
+  volatile uint32_t seq = 0; // Odd while a publish is in progress
+  BoatState slot;
+} shared;
+
+// Lock-timing instrumentation, printed every STATE_STATS_MS
+const uint32_t STATE_STATS_MS = 10000;
+
+// Readers run on the loop and display tasks, on both cores: every field is atomic
+struct StateStats
+{
+  std::atomic<uint32_t> pubCount{0}, pubMaxCyc{0};
+  std::atomic<uint32_t> readCount{0}, readMaxCyc{0}, readRetries{0};
+  std::atomic<uint32_t> loraWaitMaxCyc{0}; // Worst wait for state inside do_send()
+} stats;
+
+void statMax(std::atomic<uint32_t> &m, uint32_t v)
+{
+  uint32_t cur = m.load(std::memory_order_relaxed);
+  while (v > cur && !m.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+  {
+  }
+}
+
+void publish()
+{
+  uint32_t t0 = ESP.getCycleCount();
+  shared.seq = shared.seq + 1;
+  __sync_synchronize();
+  memcpy((void *)&shared.slot, &state, sizeof(BoatState));
+  __sync_synchronize();
+  shared.seq = shared.seq + 1;
+  uint32_t dt = ESP.getCycleCount() - t0;
+  stats.pubCount.fetch_add(1, std::memory_order_relaxed);
+  statMax(stats.pubMaxCyc, dt);
+}
+
+BoatState snapshot()
+{
+  BoatState out;
+  uint32_t t0 = ESP.getCycleCount();
+  uint32_t s1, tries = 0;
+  for (;;)
+  {
+    s1 = shared.seq;
+    if (!(s1 & 1))
+    {
+      __sync_synchronize();
+      memcpy(&out, (const void *)&shared.slot, sizeof(BoatState));
+      __sync_synchronize();
+      if (shared.seq == s1)
+        break;
+    }
+    // A higher-priority reader on the writer's core would spin forever, so back off
+    if (++tries > 3)
+      vTaskDelay(1);
+  }
+  uint32_t dt = ESP.getCycleCount() - t0;
+  stats.readCount.fetch_add(1, std::memory_order_relaxed);
+  stats.readRetries.fetch_add(tries, std::memory_order_relaxed);
+  statMax(stats.readMaxCyc, dt);
+  return out;
+}
+
+// BLE -> loop task commands (bounded, never blocks the BLE stack)
+enum CmdType : uint8_t
+{
+  CMD_JOURNEY_START,
+  CMD_JOURNEY_END,
+  CMD_SET,
+  CMD_TRACK, // Raw TRK_* frame from CHAR_TRACK_UUID
+  CMD_BIN,   // boat_ble_cmd.h request, already checked; status != OK means reply only
+};
+
+struct Cmd
+{
+  CmdType type;
+  uint8_t len;
+  uint8_t status;
+  char arg[BLE_CMD_MAX]; // SET payload: JSON object, or legacy boat:user:name
+};
+
+QueueHandle_t cmdQueue;
 
 // --- LORAWAN KEYS (LSB for OTAA) ---
 
@@ -247,48 +401,54 @@ struct __attribute__((packed)) Packet
 
 Packet myPacket;
 
+const uint8_t POS_PORT = 1;
+
+const uint8_t SOS_PORT = 2; // Same payload, the backend raises an SOS for it
+
 static osjob_t sendjob;
 
-uint16_t globalSeq = 0;
+BoatSeq seq; // Survives reboots, one NVS write per BOAT_SEQ_RESERVE packets
 
 // --- HELPERS ---
 
-void updateStatus(const char *newStatus)
+void updateStatus(const char *newStatus, uint8_t loraState = 0xFF)
 {
 
-  xSemaphoreTake(dataMutex, portMAX_DELAY);
-
   strncpy(state.loraStatus, newStatus, sizeof(state.loraStatus) - 1);
 
-  xSemaphoreGive(dataMutex);
-}
-
-void updateDisplay()
-{
+  if (loraState != 0xFF)
 
-  // Only access shared state inside lock
+    state.loraState = loraState;
 
-  char dispStatus[20];
+  publish();
+}
 
-  char dispId[10];
+// --- DISPLAY TASK ---
 
-  bool jActive;
+// The loop task drops a GpsView in a one-slot mailbox (TinyGPSPlus is not
+// safe to read from another task); the display task draws it with a state
+// snapshot and pushes only what changed, so the I2C time is off the loop.
 
-  int sats = gps.satellites.value();
+const uint32_t DISPLAY_MS = 500; // An unchanged frame costs no I2C at all
 
-  double lat = gps.location.lat();
+struct GpsView
+{
+  int sats;
+  double lat, lon;
+};
 
-  double lon = gps.location.lng();
+QueueHandle_t gpsView;
 
-  xSemaphoreTake(dataMutex, portMAX_DELAY);
+void updateDisplay(const GpsView &g)
+{
 
-  strncpy(dispStatus, state.loraStatus, sizeof(dispStatus));
+  BoatState st = snapshot();
 
-  strncpy(dispId, state.boatId, sizeof(dispId));
+  int sats = g.sats;
 
-  jActive = state.journeyActive;
+  double lat = g.lat;
 
-  xSemaphoreGive(dataMutex);
+  double lon = g.lon;
 
   display.clearDisplay();
 
@@ -300,7 +460,7 @@ void updateDisplay()
 
   display.printf("BLE:%s SAT:%d %s", deviceConnected ? "C" : "-", sats,
 
-                 jActive ? "[ON]" : "[OFF]");
+                 st.journeyActive ? "[ON]" : "[OFF]");
 
   display.setCursor(0, 16);
 
@@ -312,15 +472,33 @@ void updateDisplay()
 
   display.setCursor(0, 38);
 
-  display.printf("ID:%s Bat:%.0f%%", dispId, state.battery);
+  display.printf("ID:%s Bat:%.0f%%", st.boatId, st.battery);
 
   display.drawLine(0, 50, 128, 50, WHITE);
 
   display.setCursor(0, 54);
 
-  display.print(dispStatus);
+  display.print(st.loraStatus);
 
-  display.display();
+  oled.push();
+}
+
+void displayTask(void *)
+{
+
+  GpsView g = {0, 0, 0};
+
+  for (;;)
+  {
+
+    vTaskDelay(pdMS_TO_TICKS(DISPLAY_MS));
+
+    xQueuePeek(gpsView, &g, 0);
+
+    PROF_SCOPE("disp.draw");
+
+    updateDisplay(g);
+  }
 }
 
 // --- LORA TX LOGIC ---
@@ -338,15 +516,15 @@ void do_send(osjob_t *j)
 
   // PRIVACY CHECK
 
-  bool active = false;
+  uint32_t w0 = ESP.getCycleCount();
 
-  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  BoatState st = snapshot();
 
-  active = state.journeyActive;
+  uint32_t waited = ESP.getCycleCount() - w0;
 
-  xSemaphoreGive(dataMutex);
+  statMax(stats.loraWaitMaxCyc, waited);
 
-  if (!active)
+  if (!st.journeyActive && !st.sos)
   {
 
     updateStatus("Journey Paused");
@@ -362,17 +540,13 @@ void do_send(osjob_t *j)
 
   // Prepare Packet
 
-  xSemaphoreTake(dataMutex, portMAX_DELAY);
-
-  myPacket.src = atoi(state.boatId);
+  myPacket.src = atoi(st.boatId);
 
-  myPacket.uid = atoi(state.userId);
+  myPacket.uid = atoi(st.userId);
 
-  strncpy(myPacket.name, state.boatName, 12);
+  strncpy(myPacket.name, st.boatName, 12);
 
-  xSemaphoreGive(dataMutex);
-
-  myPacket.seq = globalSeq++;
+  myPacket.seq = (uint16_t)seq.next();
 
   if (gps.location.isValid())
   {
@@ -389,7 +563,7 @@ void do_send(osjob_t *j)
     myPacket.lon1e7 = 0;
   }
 
-  myPacket.batt = (uint8_t)state.battery;
+  myPacket.batt = (uint8_t)st.battery;
 
   myPacket.hops = 0;
 
@@ -401,9 +575,9 @@ void do_send(osjob_t *j)
 
   // Calculation: 2+2+4+4+1+1+2+12 = 28 bytes
 
-  LMIC_setTxData2(1, (uint8_t *)&myPacket, 28, 0);
+  LMIC_setTxData2(st.sos ? SOS_PORT : POS_PORT, (uint8_t *)&myPacket, 28, 0);
 
-  updateStatus("Tx Queued");
+  updateStatus(st.sos ? "SOS Queued" : "Tx Queued");
 }
 
 void onEvent(ev_t ev)
@@ -414,29 +588,45 @@ void onEvent(ev_t ev)
 
   case EV_JOINING:
 
-    updateStatus("Joining...");
+    updateStatus("Joining...", BLE_LORA_JOINING);
 
     break;
 
   case EV_JOINED:
 
-    updateStatus("Joined!");
+    updateStatus("Joined!", BLE_LORA_JOINED);
 
     LMIC_setLinkCheckMode(0); // Disable ADR for mobile nodes
 
+    lmicSessionSave();
+
+    break;
+
+  case EV_LINK_DEAD:
+
+    // Only reachable on a restored session (link check stays on until a real join)
+
+    updateStatus("Rejoining", BLE_LORA_JOINING);
+
+    lmicSessionForget();
+
+    LMIC_unjoinAndRejoin();
+
     break;
 
   case EV_TXCOMPLETE:
 
-    updateStatus("Sent+Sleep");
+    updateStatus("Sent+Sleep", BLE_LORA_SENT);
+
+    lmicSessionTx();
 
-    os_setTimedCallback(&sendjob, os_getTime() + sec2osticks(30), do_send);
+    os_setTimedCallback(&sendjob, os_getTime() + sec2osticks(state.tune[state.sos ? BT_SOS_INTERVAL_S : BT_TX_INTERVAL_S]), do_send);
 
     break;
 
   case EV_JOIN_FAILED:
 
-    updateStatus("Join Fail");
+    updateStatus("Join Fail", BLE_LORA_JOIN_FAIL);
 
     break;
 
@@ -446,197 +636,947 @@ void onEvent(ev_t ev)
   }
 }
 
-// --- BLE CALLBACKS ---
+// --- TRACK LOG ---
 
-class ServerCB : public BLEServerCallbacks
-{
+// While a journey is active a TrackPoint is appended every BT_TRACK_INTERVAL_S.
+// Points are fixed size and in time order, so a time range is a binary search.
 
-  void onConnect(BLEServer *pServer) { deviceConnected = true; };
+const char *TRACK_FILE = "/track.bin";
 
-  void onDisconnect(BLEServer *pServer) { deviceConnected = false; }
-};
+const uint32_t TRACK_MAX_BYTES = 1024 * 1024; // ~3 days at 5 s
 
-class CmdCB : public BLECharacteristicCallbacks
+const uint8_t TRACK_BURST = 8; // Notifications per loop pass, keeps LMIC on time
+
+BleTrackXfer trackXfer;
+
+File trackRd; // Open only while a download runs
+
+uint32_t gpsUnix()
 {
 
-  void onWrite(BLECharacteristic *pChar)
-  {
+  if (!gps.date.isValid() || !gps.time.isValid() || gps.date.year() < 2020)
 
-    std::string val = pChar->getValue();
+    return 0;
 
-    if (val.length() > 0)
-    {
+  // Days since 1970-01-01 (civil calendar, March-based year)
 
-      String valStr = String(val.c_str());
+  int y = gps.date.year(), m = gps.date.month(), d = gps.date.day();
 
-      // Handle Commands
+  y -= m <= 2;
 
-      if (valStr.startsWith("SET:"))
-      {
+  int era = y / 400, yoe = y - era * 400;
 
-        // ... Parsing logic ...
-      }
-      else if (valStr.equals("START_JOURNEY"))
-      {
+  int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
 
-        xSemaphoreTake(dataMutex, portMAX_DELAY);
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
 
-        state.journeyActive = true;
+  uint32_t days = era * 146097 + doe - 719468;
 
-        xSemaphoreGive(dataMutex);
+  return days * 86400UL + gps.time.hour() * 3600UL + gps.time.minute() * 60UL + gps.time.second();
+}
 
-        // Trigger immediate send if needed, or wait for next loop
+void trackAppend()
+{
 
-        os_setTimedCallback(&sendjob, os_getTime() + sec2osticks(1), do_send);
-      }
-      else if (valStr.equals("END_JOURNEY"))
-      {
+  TrackPoint p;
 
-        xSemaphoreTake(dataMutex, portMAX_DELAY);
+  p.t = gpsUnix();
 
-        state.journeyActive = false;
+  if (!p.t || !gps.location.isValid())
 
-        xSemaphoreGive(dataMutex);
-      }
-    }
-  }
-};
+    return;
 
-// --- SETUP ---
+  p.lat1e7 = (int32_t)lround(gps.location.lat() * 1e7);
 
-void setup()
-{
+  p.lon1e7 = (int32_t)lround(gps.location.lng() * 1e7);
 
-  Serial.begin(115200);
+  p.spd_cms = gps.speed.isValid() ? (uint16_t)(gps.speed.mps() * 100) : 0;
 
-  gpsSerial.begin(9600, SERIAL_8N1, 16, 17);
+  p.hdg_cdeg = gps.course.isValid() ? (uint16_t)gps.course.value() : 0;
 
-  dataMutex = xSemaphoreCreateMutex();
+  File f = LittleFS.open(TRACK_FILE, FILE_APPEND);
 
-  Wire.begin();
+  if (!f)
 
-  display.begin(SSD1306_SWITCHCAPVCC, 0x3C);
+    return;
 
-  display.clearDisplay();
+  if (f.size() + sizeof(p) <= TRACK_MAX_BYTES)
 
-  display.print("Booting Neduvaai..."); 
+    f.write((uint8_t *)&p, sizeof(p));
 
-  display.display();
+  else
 
-  // Init BLE
+    updateStatus("Track Full");
 
-  BLEDevice::init("Neduvaai-Node");
+  f.close();
+}
 
-  pServer = BLEDevice::createServer();
+size_t trackRead(uint32_t index, TrackPoint *out, size_t max)
+{
 
-  pServer->setCallbacks(new ServerCB());
+  if (!trackRd || !trackRd.seek(index * sizeof(TrackPoint)))
 
-  BLEService *pService = pServer->createService(SERVICE_UUID);
+    return 0;
 
-  pDataChar = pService->createCharacteristic(
+  return trackRd.read((uint8_t *)out, max * sizeof(TrackPoint)) / sizeof(TrackPoint);
+}
 
-      CHAR_DATA_UUID,
+// First point with t >= unix; 64-bit so that "to + 1" of to = 0xFFFFFFFF is past everything
+uint32_t trackFind(uint32_t count, uint64_t unix)
+{
 
-      BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY);
+  uint32_t lo = 0, hi = count;
 
-  pDataChar->addDescriptor(new BLE2902());
+  while (lo < hi)
+  {
 
-  pCmdChar = pService->createCharacteristic(
-    "?>,
+    uint32_t mid = (lo + hi) / 2;
 
-                                            BLECharacteristic::PROPERTY_WRITE);
+    TrackPoint p;
 
-  pCmdChar->setCallbacks(new CmdCB());
+    if (trackRead(mid, &p, 1) == 1 && p.t < unix)
 
-  pService->start();
+      lo = mid + 1;
 
-  BLEAdvertising *pAdv = BLEDevice::getAdvertising();
+    else
 
-  pAdv->addServiceUUID(SERVICE_UUID);
+      hi = mid;
+  }
 
-  pAdv->start();
+  return lo;
+}
 
-  // Init LoRa
+void trackInfo(uint32_t *count, uint32_t *first, uint32_t *last)
+{
 
-  os_init();
+  *count = *first = *last = 0;
 
-  LMIC_reset();
+  File f = LittleFS.open(TRACK_FILE, FILE_READ); // Own handle, a download may hold trackRd
 
-  // FORCE IN865 (If library config allows runtime, otherwise set in library)
+  if (!f)
 
-  // LMIC_setupChannel(0, 865062500, DR_RANGE_MAP(DR_SF12, DR_SF7), BAND_MILLI);
+    return;
 
-  do_send(&sendjob);
+  TrackPoint p;
+
+  *count = f.size() / sizeof(TrackPoint);
+
+  if (*count && f.read((uint8_t *)&p, sizeof(p)) == sizeof(p))
+
+    *first = p.t;
+
+  if (*count && f.seek((*count - 1) * sizeof(p)) && f.read((uint8_t *)&p, sizeof(p)) == sizeof(p))
+
+    *last = p.t;
+
+  f.close();
 }
 
-// --- LOOP ---
+void trackSendErr(uint8_t code)
+{
 
-void loop()
+  uint8_t e[2] = {TRK_ERR, code};
+
+  pTrackChar->setValue(e, sizeof(e));
+
+  pTrackChar->notify();
+}
+
+void trackCommand(const uint8_t *b, uint8_t len)
 {
 
-  static unsigned long lastNotify = 0;
+  if (len >= 15 && b[0] == TRK_REQ)
+  {
 
-  static unsigned long lastDisplay = 0;
+    if (trackRd)
 
-  // 1. CRITICAL: LoRa Engine (Must run fast)
+      trackRd.close();
 
-  os_runloop_once();
+    trackRd = LittleFS.open(TRACK_FILE, FILE_READ);
 
-  // 2. GPS (Non-blocking)
+    uint32_t count = trackRd ? trackRd.size() / sizeof(TrackPoint) : 0;
 
-  while (gpsSerial.available() > 0)
+    uint32_t first = trackFind(count, bleGetU32(b + 1));
 
-    gps.encode(gpsSerial.read());
+    uint32_t end = trackFind(count, (uint64_t)bleGetU32(b + 5) + 1);
 
-  // 3. BLE Notify (Every 1s)
+    trackXfer.begin(first, end, bleGetU32(b + 9), b[13] | b[14] << 8, millis());
+  }
+  else if (len >= 5 && b[0] == TRK_ACK)
+
+    trackXfer.ack(bleGetU32(b + 1), millis());
+
+  else if (len >= 1 && b[0] == TRK_CANCEL)
+
+    trackXfer.cancel();
+
+  else
+
+    trackSendErr(TRK_ERR_BAD_REQ);
+}
+
+void trackService()
+{
+
+  if (!trackXfer.active())
+  {
+
+    if (trackRd)
+
+      trackRd.close();
+
+    return;
+  }
 
-  if (deviceConnected && (millis() - lastNotify > 1000))
+  if (!deviceConnected)
   {
 
-    char bleBuf[64];
+    trackXfer.cancel(); // The phone resumes with an offset
+
+    return;
+  }
+
+  uint8_t buf[BLE_STATUS_MTU];
+
+  size_t cap = pServer->getPeerMTU(bleConnId) - 3;
 
-    xSemaphoreTake(dataMutex, portMAX_DELAY);
+  if (cap > sizeof(buf))
 
-    snprintf(bleBuf, sizeof(bleBuf), "S:%d,Lat:%.5f,Lon:%.5f,Bat:%.0f,St:%s",
+    cap = sizeof(buf);
 
-             gps.satellites.value(), gps.location.lat(), gps.location.lng(),
+  for (uint8_t i = 0; i < TRACK_BURST; i++)
+  {
 
-             state.battery, state.loraStatus);
+    size_t n = trackXfer.next(buf, cap, trackRead, millis());
 
-    xSemaphoreGive(dataMutex);
+    if (!n)
 
-    pDataChar->setValue((uint8_t *)bleBuf, strlen(bleBuf));
+      break;
 
-    pDataChar->notify();
+    pTrackChar->setValue(buf, n);
 
-    lastNotify = millis();
+    pTrackChar->notify();
   }
+}
 
-  // 4. Re-advertise logic (Non-blocking)
+// --- BLE CALLBACKS ---
 
-  if (!deviceConnected && oldDeviceConnected)
+class ServerCB : public BLEServerCallbacks
+{
+
+  void onConnect(BLEServer *pServer) { deviceConnected = true; };
+
+  void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param) { bleConnId = param->connect.conn_id; }
+
+  void onDisconnect(BLEServer *pServer) { deviceConnected = false; }
+};
+
+class MetricsCB : public BLECharacteristicCallbacks
+{
+
+  void onRead(BLECharacteristic *pChar)
   {
 
-    delay(50); // Small delay is OK for BLE stack stability
+    // Fits one 185-byte MTU read; longer payloads fall back to long reads
 
-    pServer->startAdvertising();
+    static uint8_t buf[512];
 
-    oldDeviceConnected = deviceConnected;
+    size_t n = profPack(buf, sizeof(buf));
+
+    pChar->setValue(buf, n);
   }
+};
 
-  if (deviceConnected && !oldDeviceConnected)
+class TrackCB : public BLECharacteristicCallbacks
+{
+
+  void onWrite(BLECharacteristic *pChar)
   {
 
-    oldDeviceConnected = deviceConnected;
+    // BLE task, like CmdCB: the stack's own buffer, no copy on the heap
+
+    const uint8_t *d = pChar->getData();
+
+    size_t n = pChar->getLength();
+
+    Cmd cmd;
+
+    memset(&cmd, 0, sizeof(cmd));
+
+    cmd.type = CMD_TRACK;
+
+    cmd.len = n < sizeof(cmd.arg) ? n : sizeof(cmd.arg);
+
+    memcpy(cmd.arg, d, cmd.len);
+
+    xQueueSend(cmdQueue, &cmd, 0);
   }
+};
 
-  // 5. Display Refresh (Every 2s - slow!)
+class CmdCB : public BLECharacteristicCallbacks
+{
 
-  if (millis() - lastDisplay > 2000)
+  void onWrite(BLECharacteristic *pChar)
   {
 
-    updateDisplay();
+    // Runs in the BLE task: no shared state, no LMIC calls, just enqueue.
+    // Works on the stack's own buffer, nothing is allocated here.
 
-    lastDisplay = millis();
+    const uint8_t *d = pChar->getData();
+
+    size_t n = pChar->getLength();
+
+    Cmd cmd;
+
+    memset(&cmd, 0, sizeof(cmd));
+
+    if (n >= 1 && d[0] == BLE_CMD_MAGIC)
+    {
+
+      cmd.type = CMD_BIN;
+
+      cmd.status = bleCmdCheck(d, n);
+
+      cmd.len = n < sizeof(cmd.arg) ? n : sizeof(cmd.arg);
+
+      memcpy(cmd.arg, d, cmd.len);
+    }
+    else if (n > 4 && memcmp(d, "SET:", 4) == 0)
+    {
+
+      cmd.type = CMD_SET;
+
+      memcpy(cmd.arg, d + 4, n - 4 < sizeof(cmd.arg) - 1 ? n - 4 : sizeof(cmd.arg) - 1);
+    }
+    else if (n == 13 && memcmp(d, "START_JOURNEY", 13) == 0)
+
+      cmd.type = CMD_JOURNEY_START;
+
+    else if (n == 11 && memcmp(d, "END_JOURNEY", 11) == 0)
+
+      cmd.type = CMD_JOURNEY_END;
+
+    else
+
+      return;
+
+    if (xQueueSend(cmdQueue, &cmd, 0) != pdTRUE && cmd.type == CMD_BIN)
+    {
+
+      uint8_t busy[3] = {BLE_CMD_MAGIC, n > 1 ? d[1] : (uint8_t)0, BLE_CMD_ERR_BUSY};
+
+      pRespChar->setValue(busy, sizeof(busy));
+
+      pRespChar->notify();
+    }
+  }
+};
+
+// SET:{"boat_id":"1001","user_id":7,"display_name":"Kayal"} - any subset.
+// The app's older SET:boat:user:name form is still accepted.
+void applySet(char *arg)
+{
+
+  char boatId[sizeof(state.boatId)] = "";
+
+  char boatName[sizeof(state.boatName)] = "";
+
+  uint32_t userId = 0;
+
+  uint32_t seen = 0;
+
+  if (arg[0] == '{')
+  {
+
+    const JsonField fields[] = {
+
+        JSON_STR_FIELD("boat_id", boatId),
+
+        JSON_UINT_FIELD("user_id", userId),
+
+        JSON_STR_FIELD("display_name", boatName),
+    };
+
+    int err = jsonBind(arg, strlen(arg), fields, 3, &seen);
+
+    if (err != JSON_OK)
+    {
+
+      Serial.printf("[cmd] SET rejected: %s\n", jsonErrStr(err));
+
+      return;
+    }
+  }
+  else
+  {
+
+    char *save = NULL;
+
+    char *b = strtok_r(arg, ":", &save);
+
+    char *u = strtok_r(NULL, ":", &save);
+
+    char *n = strtok_r(NULL, "", &save);
+
+    if (b && strlen(b) < sizeof(boatId))
+    {
+
+      strcpy(boatId, b);
+
+      seen |= 1;
+    }
+
+    if (u)
+    {
+
+      userId = strtoul(u, NULL, 10);
+
+      seen |= 2;
+    }
+
+    if (n && strlen(n) < sizeof(boatName))
+    {
+
+      strcpy(boatName, n);
+
+      seen |= 4;
+    }
+  }
+
+  if (seen & 1)
+
+    strcpy(state.boatId, boatId);
+
+  if (seen & 2)
+
+    snprintf(state.userId, sizeof(state.userId), "%lu", (unsigned long)userId);
+
+  if (seen & 4)
+
+    strcpy(state.boatName, boatName);
+
+  if (seen)
+
+    state.configChanged = true;
+
+  publish();
+}
+
+// --- BINARY COMMANDS (boat_ble_cmd.h) ---
+
+const uint32_t TUNE_MIN[BT_COUNT] = {10, 5, 1, 100};
+
+const uint32_t TUNE_MAX[BT_COUNT] = {3600, 600, 600, 5000};
+
+// Node-side limits; framing and lengths were checked in the BLE callback
+uint8_t binCheck(const uint8_t *tlv, size_t n)
+{
+
+  BleTlvReader rd(tlv, n);
+
+  BleTlv t;
+
+  while (rd.next(t))
+  {
+
+    if (t.type == BC_TUNE)
+    {
+
+      uint32_t v = bleGetU32(t.v + 1);
+
+      if (v < TUNE_MIN[t.v[0]] || v > TUNE_MAX[t.v[0]])
+
+        return BLE_CMD_ERR_RANGE;
+    }
+
+    if (t.type == BC_QUERY && t.v[0] > BQ_TRACK)
+
+      return t.v[0] == BQ_NEARBY ? BLE_CMD_ERR_UNSUPPORTED : BLE_CMD_ERR_RANGE;
+  }
+
+  return BLE_CMD_OK;
+}
+
+void binQuery(uint8_t what, BleCmdResp &resp)
+{
+
+  if (what == BQ_CONFIG)
+  {
+
+    resp.putStr(BC_BOAT_ID, state.boatId);
+
+    resp.putU32(BC_USER_ID, strtoul(state.userId, NULL, 10));
+
+    resp.putStr(BC_NAME, state.boatName);
+  }
+  else if (what == BQ_STATE)
+  {
+
+    resp.putU8(BC_JOURNEY, state.journeyActive);
+
+    resp.putU8(BC_SOS, state.sos);
+
+    for (uint8_t i = 0; i < BT_COUNT; i++)
+    {
+
+      uint8_t v[5] = {i, (uint8_t)state.tune[i], (uint8_t)(state.tune[i] >> 8),
+
+                      (uint8_t)(state.tune[i] >> 16), (uint8_t)(state.tune[i] >> 24)};
+
+      resp.put(BC_TUNE, v, sizeof(v));
+    }
+  }
+  else if (what == BQ_TRACK)
+  {
+
+    uint32_t info[3];
+
+    trackInfo(&info[0], &info[1], &info[2]);
+
+    resp.put(BC_TRACK_INFO, info, sizeof(info)); // ESP32 is little-endian
+  }
+}
+
+void applyBin(const Cmd &cmd)
+{
+
+  const uint8_t *f = (const uint8_t *)cmd.arg;
+
+  uint8_t out[BLE_STATUS_MTU];
+
+  size_t cap = pServer->getPeerMTU(bleConnId) - 3;
+
+  BleCmdResp resp;
+
+  resp.begin(out, cap < sizeof(out) ? cap : sizeof(out), cmd.len > 1 ? f[1] : 0);
+
+  uint8_t st = cmd.status;
+
+  if (st == BLE_CMD_OK)
+
+    st = binCheck(f + 2, cmd.len - 2);
+
+  if (st == BLE_CMD_OK)
+  {
+
+    bool wasJourney = state.journeyActive, wasSos = state.sos;
+
+    BleTlvReader rd(f + 2, cmd.len - 2);
+
+    BleTlv t;
+
+    while (rd.next(t))
+    {
+
+      switch (t.type)
+      {
+
+      case BC_BOAT_ID:
+
+        memcpy(state.boatId, t.v, t.len);
+
+        state.boatId[t.len] = 0;
+
+        state.configChanged = true;
+
+        break;
+
+      case BC_USER_ID:
+
+        snprintf(state.userId, sizeof(state.userId), "%lu", (unsigned long)bleGetU32(t.v));
+
+        state.configChanged = true;
+
+        break;
+
+      case BC_NAME:
+
+        memcpy(state.boatName, t.v, t.len);
+
+        state.boatName[t.len] = 0;
+
+        state.configChanged = true;
+
+        break;
+
+      case BC_JOURNEY:
+
+        state.journeyActive = t.v[0];
+
+        break;
+
+      case BC_SOS:
+
+        state.sos = t.v[0];
+
+        break;
+
+      case BC_TUNE:
+
+        state.tune[t.v[0]] = bleGetU32(t.v + 1);
+
+        resp.put(BC_TUNE, t.v, t.len);
+
+        break;
+
+      case BC_QUERY:
+
+        binQuery(t.v[0], resp);
+
+        break;
+      }
+    }
+
+    publish();
+
+    // Starting a journey or raising SOS should not wait out the current interval
+
+    if ((state.journeyActive && !wasJourney) || (state.sos && !wasSos))
+
+      os_setTimedCallback(&sendjob, os_getTime() + sec2osticks(1), do_send);
+  }
+
+  resp.status(st);
+
+  if (deviceConnected)
+  {
+
+    pRespChar->setValue(out, resp.len());
+
+    pRespChar->notify();
+  }
+}
+
+// Apply queued BLE commands from the loop task, the only writer of state
+void applyCommands()
+{
+
+  Cmd cmd;
+
+  while (xQueueReceive(cmdQueue, &cmd, 0) == pdTRUE)
+  {
+
+    switch (cmd.type)
+    {
+
+    case CMD_SET:
+
+      applySet(cmd.arg);
+
+      break;
+
+    case CMD_JOURNEY_START:
+
+      state.journeyActive = true;
+
+      publish();
+
+      // Trigger immediate send if needed, or wait for next loop
+
+      os_setTimedCallback(&sendjob, os_getTime() + sec2osticks(1), do_send);
+
+      break;
+
+    case CMD_JOURNEY_END:
+
+      state.journeyActive = false;
+
+      publish();
+
+      break;
+
+    case CMD_TRACK:
+
+      trackCommand((const uint8_t *)cmd.arg, cmd.len);
+
+      break;
+
+    case CMD_BIN:
+
+      applyBin(cmd);
+
+      break;
+    }
+  }
+}
+
+void printStateStats()
+{
+
+  uint32_t mhz = ESP.getCpuFreqMHz();
+
+  // Read and reset each counter in one step, so nothing counted meanwhile is lost
+
+  Serial.printf("[state] pub n=%lu max=%luus | read n=%lu max=%luus retries=%lu | lora wait max=%luus\n",
+
+                (unsigned long)stats.pubCount.exchange(0), (unsigned long)(stats.pubMaxCyc.exchange(0) / mhz),
+
+                (unsigned long)stats.readCount.exchange(0), (unsigned long)(stats.readMaxCyc.exchange(0) / mhz),
+
+                (unsigned long)stats.readRetries.exchange(0), (unsigned long)(stats.loraWaitMaxCyc.exchange(0) / mhz));
+
+  OledStats os = oled.stats();
+
+  Serial.printf("[oled] frames %lu skipped %lu bytes %lu\n", (unsigned long)os.frames,
+
+                (unsigned long)os.skipped, (unsigned long)os.bytes);
+
+  oled.resetStats();
+}
+
+// --- SETUP ---
+
+void setup()
+{
+
+  Serial.begin(115200);
+
+  gpsSerial.begin(9600, SERIAL_8N1, 16, 17);
+
+  seq.begin();
+
+  Serial.printf("[seq] boot epoch %lu\n", (unsigned long)seq.epoch());
+
+  cmdQueue = xQueueCreate(8, sizeof(Cmd));
+
+  publish();
+
+  if (!LittleFS.begin(true))
+
+    Serial.println("LittleFS mount failed, no track log");
+
+  Wire.begin();
+
+  display.begin(SSD1306_SWITCHCAPVCC, 0x3C);
+
+  display.clearDisplay();
+
+  display.print("Booting Neduvaai..."); 
+
+  display.display();
+
+  oled.begin(Wire, 0x3C, display.getBuffer());
+
+  gpsView = xQueueCreate(1, sizeof(GpsView));
+
+  xTaskCreatePinnedToCore(displayTask, "display", 4096, NULL, 1, NULL, 0); // loop() is on core 1
+
+  // Init BLE
+
+  BLEDevice::init("Neduvaai-Node");
+
+  BLEDevice::setMTU(BLE_STATUS_MTU); // The phone starts the exchange; we accept up to this
+
+  pServer = BLEDevice::createServer();
+
+  pServer->setCallbacks(new ServerCB());
+
+  BLEService *pService = pServer->createService(BLEUUID(SERVICE_UUID), 30); // Default 15 handles is too few
+
+  pDataChar = pService->createCharacteristic(
+
+      CHAR_DATA_UUID,
+
+      BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY);
+
+  pDataChar->addDescriptor(new BLE2902());
+
+  pCmdChar = pService->createCharacteristic(CHAR_CMD_UUID,
+
+                                            BLECharacteristic::PROPERTY_WRITE);
+
+  pCmdChar->setCallbacks(new CmdCB());
+
+  pMetricsChar = pService->createCharacteristic(CHAR_METRICS_UUID,
+
+                                                BLECharacteristic::PROPERTY_READ);
+
+  pMetricsChar->setCallbacks(new MetricsCB());
+
+  pTrackChar = pService->createCharacteristic(CHAR_TRACK_UUID,
+
+                                              BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY);
+
+  pTrackChar->addDescriptor(new BLE2902());
+
+  pTrackChar->setCallbacks(new TrackCB());
+
+  pRespChar = pService->createCharacteristic(CHAR_RESP_UUID, BLECharacteristic::PROPERTY_NOTIFY);
+
+  pRespChar->addDescriptor(new BLE2902());
+
+  pService->start();
+
+  BLEAdvertising *pAdv = BLEDevice::getAdvertising();
+
+  pAdv->addServiceUUID(SERVICE_UUID);
+
+  pAdv->start();
+
+  // Init LoRa
+
+  os_init();
+
+  LMIC_reset();
+
+  if (lmicSessionRestore())
+  {
+    LMIC_setLinkCheckMode(1); // off after a restore; EV_LINK_DEAD needs it
+    updateStatus("Resumed", BLE_LORA_JOINED);
+  }
+
+  Serial.printf("[wan] session %s\n", lmicSessionSource());
+
+  // FORCE IN865 (If library config allows runtime, otherwise set in library)
+
+  // LMIC_setupChannel(0, 865062500, DR_RANGE_MAP(DR_SF12, DR_SF7), BAND_MILLI);
+
+  do_send(&sendjob);
+}
+
+// --- LOOP ---
+
+void loop()
+{
+
+  static unsigned long lastSample = 0;
+
+  static unsigned long lastDisplay = 0;
+
+  static unsigned long lastStats = 0;
+
+  static unsigned long lastTrack = 0;
+
+  // 1. CRITICAL: LoRa Engine (Must run fast)
+
+  {
+
+    PROF_SCOPE("loop.lmic");
+
+    os_runloop_once();
+  }
+
+  applyCommands();
+
+  // 2. GPS (Non-blocking)
+
+  {
+
+    PROF_SCOPE("loop.gps");
+
+    while (gpsSerial.available() > 0)
+
+      gps.encode(gpsSerial.read());
+  }
+
+  // 3. BLE Notify (binary status, on change, batched per MTU)
+
+  if (deviceConnected && (gps.location.isUpdated() || millis() - lastSample > state.tune[BT_STATUS_SAMPLE_MS]))
+  {
+
+    PROF_SCOPE("loop.notify");
+
+    BoatState st = snapshot();
+
+    BleStatusRec r;
+
+    r.age_ds = 0;
+
+    r.lat1e7 = gps.location.isValid() ? (int32_t)lround(gps.location.lat() * 1e7) : 0;
+
+    r.lon1e7 = gps.location.isValid() ? (int32_t)lround(gps.location.lng() * 1e7) : 0;
+
+    r.spd_cms = gps.speed.isValid() ? (uint16_t)(gps.speed.mps() * 100) : 0;
+
+    r.hdg_cdeg = gps.course.isValid() ? (uint16_t)gps.course.value() : 0;
+
+    r.sats = gps.satellites.value();
+
+    r.batt_pc = (uint8_t)st.battery;
+
+    r.flags = (gps.location.isValid() ? BLE_ST_FIX : 0) | (st.journeyActive ? BLE_ST_JOURNEY : 0) |
+
+              (st.sos ? BLE_ST_SOS : 0) |
+
+              ((st.loraState << BLE_ST_LORA_SHIFT) & BLE_ST_LORA_MASK);
+
+    statusBatch.setMtu(pServer->getPeerMTU(bleConnId));
+
+    statusBatch.offer(r, millis());
+
+    uint8_t frame[BLE_STATUS_MTU];
+
+    size_t n = statusBatch.take(frame, sizeof(frame), millis());
+
+    if (n)
+    {
+
+      pDataChar->setValue(frame, n);
+
+      pDataChar->notify();
+    }
+
+    lastSample = millis();
+  }
+
+  // 3b. Track log and bulk download
+
+  if (millis() - lastTrack > state.tune[BT_TRACK_INTERVAL_S] * 1000)
+  {
+
+    if (snapshot().journeyActive)
+
+      trackAppend();
+
+    lastTrack = millis();
+  }
+
+  {
+
+    PROF_SCOPE("loop.track");
+
+    trackService();
+  }
+
+  // 4. Re-advertise logic (Non-blocking)
+
+  if (!deviceConnected && oldDeviceConnected)
+  {
+
+    delay(50); // Small delay is OK for BLE stack stability
+
+    pServer->startAdvertising();
+
+    oldDeviceConnected = deviceConnected;
+  }
+
+  if (deviceConnected && !oldDeviceConnected)
+  {
+
+    statusBatch.reset();
+
+    oldDeviceConnected = deviceConnected;
+  }
+
+  // 5. Display: hand the GPS values to the display task
+
+  if (millis() - lastDisplay > DISPLAY_MS)
+  {
+
+    GpsView g = {(int)gps.satellites.value(), gps.location.lat(), gps.location.lng()};
+
+    xQueueOverwrite(gpsView, &g);
+
+    lastDisplay = millis();
+  }
+
+  if (millis() - lastStats > STATE_STATS_MS)
+  {
+
+    printStateStats();
+
+    profPrint(Serial);
+
+    lastStats = millis();
   }
 }
\ No newline at end of file